@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+// счётчик вызовов operator new в текущем потоке; считает только при сборке
+// с -DMEM_TRAINER_COUNT_ALLOCATIONS=ON, иначе всегда 0
+class AllocationCounter
+{
+public:
+    static constexpr bool enabled() noexcept
+    {
+#ifdef MEM_TRAINER_COUNT_ALLOCATIONS
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    static uint64_t thread_allocations() noexcept;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "../include/TaskGenerator.hpp"
+
+#include <string>
+#include <vector>
+#include <array>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+class DatabaseSync;
+
+// история тренировок в колоночном виде: одна строка - один раунд
+struct HistoryColumns
+{
+    static constexpr uint8_t UNKNOWN_DIFFICULTY = 0xFF; // старые строки user_progress без сложности
+
+    std::vector<uint32_t> user_id;
+    std::vector<int64_t> started_at; // unix time, секунды
+    std::vector<uint8_t> difficulty; // TaskGenerator::Difficulty или UNKNOWN_DIFFICULTY
+    std::vector<uint16_t> sequence_length;
+    std::vector<float> success_rate;
+
+    std::size_t size() const noexcept { return user_id.size(); }
+    void reserve(std::size_t rows);
+    void push_back(uint32_t user, int64_t started, uint8_t level, uint16_t length, float success);
+};
+
+struct LearningCurvePoint
+{
+    uint32_t attempt; // номер раунда пользователя, с 1
+    uint64_t sessions;
+    double mean_success;
+};
+
+struct DifficultyPercentiles
+{
+    static constexpr std::array<uint32_t, 5> PERCENTILES = {10, 25, 50, 75, 90};
+
+    TaskGenerator::Difficulty difficulty;
+    uint64_t sessions;
+    double mean_success;
+    std::array<float, PERCENTILES.size()> values;
+};
+
+// когорта - пользователи, впервые тренировавшиеся на этой неделе;
+// active[k] - сколько из них тренировались на неделе cohort + k
+struct RetentionCohort
+{
+    static constexpr std::size_t WEEKS = 12;
+
+    int64_t cohort_week; // недели с 1970-01-01 (UTC)
+    uint32_t users;
+    std::array<uint32_t, WEEKS> active;
+};
+
+struct AnalyticsReport
+{
+    std::size_t rows;
+    std::size_t users;
+    std::vector<LearningCurvePoint> learning_curve;
+    std::vector<DifficultyPercentiles> percentiles;
+    std::vector<RetentionCohort> retention;
+};
+
+namespace Analytics
+{
+    constexpr uint32_t MAX_ATTEMPTS = 200; // дальше кривая обучения обрезается
+
+    // история из user_progress через COPY; строки без сложности не входят в процентили
+    HistoryColumns load_from_database(const DatabaseSync &db_sync);
+    // история из журнала сессий; исключение, если журнал не открывается
+    HistoryColumns load_from_session_log(const std::string &path);
+
+    // все агрегаты; threads = 0 - по числу ядер
+    AnalyticsReport analyze(const HistoryColumns &history, unsigned threads = 0);
+
+    void write_learning_curve_csv(const AnalyticsReport &report, std::ostream &out);
+    void write_percentiles_csv(const AnalyticsReport &report, std::ostream &out);
+    void write_retention_csv(const AnalyticsReport &report, std::ostream &out);
+    // короткий текстовый отчёт для консоли
+    void write_summary(const AnalyticsReport &report, std::ostream &out);
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include "../include/TaskGenerator.hpp"
+
+#include <string_view>
+#include <span>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstddef>
+
+class ConfigFile;
+
+// проверка ответов без состояния: используется и в тренировке, и в пакетной проверке экзаменов
+class AnswerGrader
+{
+public:
+    enum class GradingMode : uint8_t
+    {
+        EXACT,  // слово засчитывается только целиком
+        PARTIAL // слово с опечатками получает часть балла
+    };
+
+    enum class Alignment : uint8_t
+    {
+        POSITIONAL, // i-й ответ сравнивается с i-м элементом
+        LCS         // наибольшая общая подпоследовательность: пропуск элемента не сдвигает остальные
+    };
+
+    // правила одного уровня сложности; опечатки допускаются не чаще одной на 3 буквы слова
+    struct GradingRules
+    {
+        GradingMode mode{GradingMode::EXACT};
+        Alignment alignment{Alignment::POSITIONAL};
+        uint32_t max_edits{0};    // расстояние Дамерау-Левенштейна, при котором слово ещё получает балл
+        float edit_penalty{0.5f}; // доля балла, снимаемая за каждую правку
+    };
+
+    using RulesByDifficulty = std::array<GradingRules, TaskGenerator::DIFFICULTY_COUNT>;
+
+    struct Grade
+    {
+        uint32_t correct{0}; // точные совпадения
+        float credit{0.0f};  // сумма баллов с частичными; для EXACT равна correct
+    };
+
+    // секция [grading] config.ini
+    static RulesByDifficulty load_rules(const ConfigFile &config);
+
+    // слово - точное совпадение, символ - без учёта регистра,
+    // числа - по числовому префиксу ответа (float с погрешностью 0.01)
+    static bool grade_item(const TaskGenerator::TaskItemView &item, std::string_view answer) noexcept;
+    // балл элемента от 0 до 1 с учётом частичного зачёта слов
+    static float item_credit(const TaskGenerator::TaskItemView &item, std::string_view answer,
+                             const GradingRules &rules) noexcept;
+
+    // item_correct, если не пуст, получает 1/0 (точное совпадение) на каждый элемент sequence;
+    // при Alignment::LCS - только для элементов, попавших в выравнивание
+    static Grade grade(std::span<const TaskGenerator::TaskItemView> sequence,
+                       std::span<const std::string_view> answers,
+                       std::span<uint8_t> item_correct,
+                       const GradingRules &rules) noexcept;
+    // точное сравнение (GradingMode::EXACT)
+    static Grade grade(std::span<const TaskGenerator::TaskItemView> sequence,
+                       std::span<const std::string_view> answers,
+                       std::span<uint8_t> item_correct = {}) noexcept;
+
+    // оптимальное выравнивание строк (Дамерау-Левенштейн без повторных правок подстроки):
+    // вставка, удаление, замена и перестановка соседних символов стоят 1.
+    // Битово-параллельный алгоритм Майерса с расширением Хюрё для слов до 64 символов.
+    static uint32_t edit_distance(std::string_view expected, std::string_view answer) noexcept;
+
+    // следующий токен line начиная с position (position сдвигается за него); пустой - строка кончилась
+    static std::string_view next_token(std::string_view line, std::size_t &position) noexcept
+    {
+        while (position < line.size() && is_separator(line[position]))
+            ++position;
+        const std::size_t begin = position;
+        while (position < line.size() && !is_separator(line[position]))
+            ++position;
+        return line.substr(begin, position - begin);
+    }
+
+    // разбиение строки ответа по пробельным символам; токены - срезы line
+    template <typename Container>
+    static void tokenize(std::string_view line, Container &tokens)
+    {
+        std::size_t position{0};
+        for (std::string_view token = next_token(line, position); !token.empty(); token = next_token(line, position))
+            tokens.push_back(token);
+    }
+
+private:
+    // LCS с совпадением "ненулевой item_credit", битово-параллельно (Allison-Dix, Hyyrö):
+    // строка матрицы - по биту на элемент, шаг на каждый ответ; выравнивание восстанавливается
+    // по сохранённым строкам
+    static Grade grade_aligned(std::span<const TaskGenerator::TaskItemView> sequence,
+                               std::span<const std::string_view> answers,
+                               std::span<uint8_t> item_correct,
+                               const GradingRules &rules);
+
+    static bool is_separator(char c) noexcept
+    {
+        return std::isspace(static_cast<unsigned char>(c)) != 0;
+    }
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+class ConfigFile;
+class DatabaseSync;
+
+// вход и регистрация с паролями в scrypt. Хэширование идёт на ограниченном пуле потоков:
+// очередь не длиннее queue_limit, лишние запросы сразу получают BUSY, поэтому время входа
+// при наплыве ограничено. Запросы к БД остаются в потоке-владельце db_sync.
+// Успешный вход кэшируется: повторный вход тем же паролем проверяется HMAC без scrypt.
+class AuthService
+{
+public:
+    struct Options
+    {
+        unsigned workers{2};
+        std::size_t queue_limit{64};
+        uint32_t scrypt_log_n{14}; // N = 2^14, r = 8: 16 МиБ на хэш
+        uint32_t scrypt_r{8};
+        uint32_t scrypt_p{1};
+        std::chrono::seconds session_ttl{3600};
+        std::size_t session_cache_entries{1024};
+    };
+
+    enum class Status : uint8_t
+    {
+        OK,
+        INVALID, // нет пользователя или неверный пароль
+        BUSY,    // очередь хэширования заполнена
+        FAILED   // ошибка БД или OpenSSL, текст - в last_error()
+    };
+
+    struct LoginResult
+    {
+        Status status;
+        int32_t user_id{0};
+    };
+
+    // секция [auth] config.ini
+    static Options load_options(const ConfigFile &config);
+
+    AuthService(DatabaseSync &db_sync, Options options);
+    ~AuthService();
+
+    AuthService(const AuthService &) = delete;
+    AuthService &operator=(const AuthService &) = delete;
+
+    // пароль в открытом виде (старые записи) после успешного входа заменяется хэшем
+    LoginResult login(const std::string &username, const std::string &password);
+    Status register_user(const std::string &username, const std::string &password);
+    std::string last_error() const { return error; }
+
+    // "$scrypt$ln=<log2 N>,r=<r>,p=<p>$<соль base64>$<ключ base64>"; исключение при ошибке OpenSSL
+    std::string hash_password(std::string_view password) const;
+    // сравнение за постоянное время; строка без префикса $scrypt$ - старый пароль в открытом виде
+    static bool verify_password(std::string_view password, std::string_view stored);
+    static bool is_hashed(std::string_view stored) noexcept;
+
+private:
+    static constexpr std::size_t TOKEN_BYTES = 32;
+    using Token = std::array<unsigned char, TOKEN_BYTES>;
+
+    // проверка: новый хэш (старый пароль заменяется), "" - верно, nullopt - неверно;
+    // хэширование (регистрация): хэш password
+    struct Job
+    {
+        std::string password;
+        std::string stored;
+        bool hash_only{false};
+        std::promise<std::optional<std::string>> done;
+    };
+
+    struct Session
+    {
+        Token token;          // HMAC(ключ процесса, имя \0 пароль)
+        std::string stored;   // запись в БД на момент входа: смена пароля делает сессию недействительной
+        int32_t user_id;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    // nullopt - очередь заполнена
+    std::optional<std::future<std::optional<std::string>>> submit(std::string password, std::string stored,
+                                                                  bool hash_only);
+    void worker_loop();
+    Token session_token(const std::string &username, const std::string &password) const;
+    std::optional<int32_t> cached_login(const std::string &username, const Token &token,
+                                        const std::string &stored);
+    void remember(const std::string &username, const Token &token, const std::string &stored, int32_t user_id);
+
+    DatabaseSync &db_sync;
+    Options options;
+    std::string error;
+    std::array<unsigned char, TOKEN_BYTES> session_key; // случайный на каждый запуск
+    std::string dummy_hash; // проверяется при входе под несуществующим именем
+
+    std::mutex queue_mutex;
+    std::condition_variable wakeup;
+    std::deque<Job> queue;
+    bool stopping{false};
+    std::vector<std::thread> workers;
+
+    std::unordered_map<std::string, Session> sessions; // по имени пользователя; только поток-владелец
+};
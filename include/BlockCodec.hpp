@@ -0,0 +1,17 @@
+#pragma once
+
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <cstddef>
+
+// LZ77 в формате блока LZ4: токен (длина литералов << 4 | длина совпадения - 4),
+// литералы, смещение u16 LE; последняя последовательность состоит только из литералов.
+// Нужен только для блоков журнала сессий, поэтому без внешней библиотеки сжатия.
+namespace BlockCodec
+{
+    // дописывает сжатые данные в конец output, возвращает их размер
+    std::size_t compress(std::span<const uint8_t> input, std::vector<uint8_t> &output);
+    // output должен иметь ровно исходный размер; false при повреждённых данных
+    bool decompress(std::span<const uint8_t> input, std::span<uint8_t> output) noexcept;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+// ini-файл вида [section] key=value; ключи до первой секции попадают в секцию ""
+class ConfigFile
+{
+public:
+    explicit ConfigFile(const std::string &path);
+
+    bool is_open() const noexcept { return opened; }
+    bool has(const std::string &section, const std::string &key) const;
+    std::string get(const std::string &section, const std::string &key,
+                    const std::string &default_value = "") const;
+    int64_t get_int(const std::string &section, const std::string &key, int64_t default_value) const;
+
+private:
+    bool opened{false};
+    std::unordered_map<std::string, std::string> values; // "section.key" -> value
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "../include/TaskGenerator.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+
+class DatabaseSync;
+
+// ежедневное задание: одна последовательность на уровень сложности для всех пользователей.
+// Seed выводится из даты (UTC), результат генерируется один раз и хранится в daily_challenges
+// и в памяти процесса до смены дня.
+class DailyChallenge
+{
+public:
+    explicit DailyChallenge(DatabaseSync &db_sync);
+
+    // при недоступной БД последовательность генерируется локально из того же seed
+    const std::vector<TaskGenerator::TaskItem> &sequence_for(TaskGenerator::Difficulty difficulty);
+
+    static int64_t current_day() noexcept;      // дни с 1970-01-01, UTC
+    static std::string format_day(int64_t day); // YYYY-MM-DD
+    static uint64_t seed_for(int64_t day, TaskGenerator::Difficulty difficulty) noexcept;
+    static std::size_t length_for(TaskGenerator::Difficulty difficulty) noexcept;
+
+    // элементы через пробел с типом: "u16:812 u32:40177 f:3.25 c:K w:apple"
+    static std::string serialize(const std::vector<TaskGenerator::TaskItem> &sequence);
+    static std::optional<std::vector<TaskGenerator::TaskItem>> parse(std::string_view text);
+
+private:
+    DatabaseSync &db_sync;
+    int64_t cached_day{-1};
+    std::array<std::optional<std::vector<TaskGenerator::TaskItem>>, TaskGenerator::DIFFICULTY_COUNT> cache;
+};
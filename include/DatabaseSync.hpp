@@ -1,39 +1,166 @@
 #pragma once
 
+#include "../include/StorageBackend.hpp"
+
 #include <memory>
-#include <libpq-fe.h>
 #include <string>
 #include <vector>
+#include <utility>
+#include <optional>
+#include <functional>
+#include <future>
+#include <string_view>
+#include <chrono>
 #include <cstdint>
+#include <cstddef>
 
-struct UserProgress
-{
-    int32_t sequence_length;
-    float success_rate;
-    std::string training_date;
-};
+class PostgresStorage;
+class PgEventLoop;
+class ConfigFile;
 
+// фасад хранилища. Для PostgreSQL чтения, которые не обязаны видеть последнюю запись,
+// уходят на реплики из [replicas]: по кругу среди тех, чьё отставание не больше max_lag;
+// в течение read_your_writes после любой записи этой сессии все чтения идут на primary.
+// Методы *_async возвращают future сразу: с одним PostgreSQL запрос уходит в PgEventLoop
+// ([database] async_connections собственных соединений с primary), иначе выполняется
+// синхронно и future уже готов
 class DatabaseSync
 {
 public:
+    // PostgreSQL с явными параметрами соединения
     DatabaseSync(const std::string &conninfo);
+    explicit DatabaseSync(std::unique_ptr<StorageBackend> backend);
+    // [storage] backend= из config.ini: postgres (по умолчанию) или embedded
     DatabaseSync();
     ~DatabaseSync();
 
-    std::string parse_config_file();
     bool connect();
-    inline PGconn* get_connection() const { return db_connection.get(); }
-    bool save_progress(uint32_t user_id, uint32_t sequence_length, float success_rate);
+    bool is_connected() const;
+    std::string last_error() const;
+    StorageBackend &backend() const noexcept { return *storage; }
+
+    // id и сохранённый пароль или nullopt, если пользователя нет; исключение при ошибке запроса
+    std::optional<UserCredential> get_user_credential(const std::string &username) const;
+    // пароли приходят уже хэшированными (AuthService)
+    bool register_user(const std::string &username, const std::string &password);
+    bool update_password(uint32_t user_id, const std::string &password);
+    // id новой строки user_progress или nullopt при ошибке
+    std::optional<int64_t> save_progress(uint32_t user_id, int32_t difficulty, uint32_t sequence_length,
+                                         float success_rate, uint32_t memorization_ms, uint32_t answer_ms);
+    // один COPY FROM STDIN на базу; записанные строки удаляются из items
+    bool save_progress_items(std::vector<ProgressItem> &items);
+    // результаты экзамена: либо все строки, либо ни одной
+    bool save_exam_results(const std::vector<ExamResult> &results);
     bool update_difficulty(uint32_t user_id, uint32_t new_level);
+    // в PostgreSQL - строка в score_events без блокировки строки users
     bool update_score(uint32_t user_id, uint32_t score_delta);
+    // события score_events -> users.total_score и user_score_daily; nullopt при ошибке
+    std::optional<std::size_t> compact_scores(uint32_t max_events);
     std::vector<UserProgress> get_user_progress(uint32_t user_id);
+    std::vector<ProgressPoint> get_progress_buckets(uint32_t user_id, ProgressBucket bucket, uint32_t max_buckets) const;
     int32_t get_user_difficulty(uint32_t user_id) const;
+    std::vector<uint32_t> get_unknown_users(const std::vector<uint32_t> &user_ids) const;
+    std::optional<UserSchedule> get_user_schedule(uint32_t user_id) const;
+    bool save_user_schedule(const UserSchedule &schedule);
+    std::vector<UserSchedule> get_due_schedules(int64_t due_from, int64_t due_before, uint32_t limit) const;
+    std::optional<std::string> get_weak_items(uint32_t user_id) const;
+    bool save_weak_items(uint32_t user_id, const std::string &sketch);
+    bool save_marathon_result(uint32_t user_id, uint32_t length, uint32_t score, float success_rate,
+                              uint32_t memorization_ms, uint32_t answer_ms);
+    // топ-N за период; anchor_date (YYYY-MM-DD) выбирает окно, пустая строка - текущее
+    LeaderboardRows get_leaderboard(LeaderboardPeriod period, uint32_t limit,
+                                    const std::string &anchor_date = "") const;
+
+    // ежедневное задание; day - YYYY-MM-DD, items - строка DailyChallenge::serialize
+    std::optional<std::string> get_daily_challenge(const std::string &day, int32_t difficulty) const;
+    // вставка, если за этот день ещё нет записи; возвращает сохранённую (возможно чужую) строку
+    std::optional<std::string> create_daily_challenge(const std::string &day, int32_t difficulty,
+                                                      const std::string &items);
+    // одна попытка на пользователя в день; false, если результат уже есть или запрос не прошёл
+    bool save_daily_challenge_result(const std::string &day, uint32_t user_id, int32_t difficulty,
+                                     uint32_t score, float success_rate);
+    std::optional<DailyChallengeScore> get_daily_challenge_score(const std::string &day, uint32_t user_id) const;
+    LeaderboardRows get_daily_leaderboard(const std::string &day, int32_t difficulty, uint32_t limit) const;
+
+    // вся история user_progress; строка - user_id, unix time, длина, успех
+    // (текстовый формат COPY, через табуляцию); исключение при ошибке запроса
+    std::size_t export_progress(const std::function<void(std::string_view)> &on_row) const;
+
+    // те же операции без ожидания; результат и исключения - через future.
+    // Взаимного порядка между асинхронными запросами нет
+    std::future<std::optional<UserCredential>> get_user_credential_async(const std::string &username) const;
+    std::future<bool> register_user_async(const std::string &username, const std::string &password);
+    std::future<bool> update_password_async(uint32_t user_id, const std::string &password);
+    std::future<std::optional<int64_t>> save_progress_async(uint32_t user_id, int32_t difficulty,
+                                                            uint32_t sequence_length, float success_rate,
+                                                            uint32_t memorization_ms, uint32_t answer_ms);
+    std::future<bool> save_progress_items_async(const std::vector<ProgressItem> &items);
+    std::future<bool> save_exam_results_async(const std::vector<ExamResult> &results);
+    std::future<bool> update_difficulty_async(uint32_t user_id, uint32_t new_level);
+    std::future<bool> update_score_async(uint32_t user_id, uint32_t score_delta);
+    std::future<std::optional<std::size_t>> compact_scores_async(uint32_t max_events);
+    std::future<std::vector<UserProgress>> get_user_progress_async(uint32_t user_id) const;
+    std::future<std::vector<ProgressPoint>> get_progress_buckets_async(uint32_t user_id, ProgressBucket bucket,
+                                                                       uint32_t max_buckets) const;
+    std::future<int32_t> get_user_difficulty_async(uint32_t user_id) const;
+    std::future<std::optional<UserSchedule>> get_user_schedule_async(uint32_t user_id) const;
+    std::future<bool> save_user_schedule_async(const UserSchedule &schedule);
+    std::future<std::vector<UserSchedule>> get_due_schedules_async(int64_t due_from, int64_t due_before,
+                                                                   uint32_t limit) const;
+    std::future<bool> save_weak_items_async(uint32_t user_id, const std::string &sketch);
+    std::future<bool> save_marathon_result_async(uint32_t user_id, uint32_t length, uint32_t score,
+                                                 float success_rate, uint32_t memorization_ms, uint32_t answer_ms);
+    std::future<LeaderboardRows> get_leaderboard_async(LeaderboardPeriod period, uint32_t limit,
+                                                       const std::string &anchor_date = "") const;
+    std::future<std::optional<std::string>> get_daily_challenge_async(const std::string &day,
+                                                                      int32_t difficulty) const;
+    std::future<std::optional<std::string>> create_daily_challenge_async(const std::string &day, int32_t difficulty,
+                                                                         const std::string &items);
+    std::future<bool> save_daily_challenge_result_async(const std::string &day, uint32_t user_id,
+                                                        int32_t difficulty, uint32_t score, float success_rate);
+    std::future<std::optional<DailyChallengeScore>> get_daily_challenge_score_async(const std::string &day,
+                                                                                    uint32_t user_id) const;
+    std::future<LeaderboardRows> get_daily_leaderboard_async(const std::string &day, int32_t difficulty,
+                                                             uint32_t limit) const;
+    // ошибка последнего неудачного асинхронного запроса (без цикла - last_error())
+    std::string last_async_error() const;
+
+    std::size_t replica_count() const noexcept { return replicas.size(); }
 
 private:
-    std::shared_ptr<PGconn> db_connection;
-    std::string connection_info;
+    struct ReplicaOptions
+    {
+        std::chrono::milliseconds max_lag{5000};
+        std::chrono::milliseconds read_your_writes{5000}; // не меньше max_lag
+        std::chrono::milliseconds check_interval{1000};   // как часто перепроверяется отставание
+    };
+
+    struct ReadReplica
+    {
+        std::string name; // host:port
+        std::unique_ptr<PostgresStorage> storage;
+        bool healthy{false};
+        std::chrono::steady_clock::time_point checked{};
+    };
+
+    void load_replicas(const ConfigFile &config);
+    // реплика для чтения или nullptr (нет подходящей, недавняя запись)
+    ReadReplica *pick_replica() const;
+    void refresh_replica(ReadReplica &replica) const;
+    void note_write() noexcept { last_write = std::chrono::steady_clock::now(); }
+
+    // чтение с реплики; при исключении или потере её соединения - повтор на primary
+    template <typename Read>
+    auto read(Read &&query) const -> decltype(query(std::declval<StorageBackend &>()));
+    // make_request() - в PgEventLoop; без него sync() выполняется сразу
+    template <typename MakeRequest, typename Sync>
+    auto submit(MakeRequest &&make_request, Sync &&sync) const -> std::future<decltype(sync())>;
 
-    PGresult *execute_params(const char *query,
-                             const std::vector<const char *> &values,
-                             const std::vector<int32_t> &lengths);
+    std::unique_ptr<StorageBackend> storage;
+    ReplicaOptions replica_options;
+    mutable std::vector<ReadReplica> replicas;
+    mutable std::size_t next_replica{0};
+    std::chrono::steady_clock::time_point last_write{};
+    std::size_t async_connections{0};
+    std::unique_ptr<PgEventLoop> event_loop; // после connect(), если async_connections > 0
 };
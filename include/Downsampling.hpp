@@ -0,0 +1,16 @@
+#pragma once
+
+#include <span>
+#include <vector>
+#include <cstddef>
+
+// прореживание временных рядов для вывода в ограниченное число колонок
+namespace Downsampling
+{
+    // Largest-Triangle-Three-Buckets (Steinarsson, 2013): индексы target точек ряда, сохраняющих
+    // форму графика. Первая и последняя точки остаются всегда; из каждого промежуточного бакета
+    // берётся точка, образующая треугольник наибольшей площади с предыдущей выбранной и средним
+    // следующего бакета, поэтому пики и провалы не усредняются. x - по возрастанию.
+    // При target >= size возвращаются все индексы
+    std::vector<std::size_t> lttb(std::span<const double> x, std::span<const double> y, std::size_t target);
+}
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "../include/StorageBackend.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+
+// встроенное хранилище без сервера: таблицы в памяти с хэш-индексами, каждое изменение
+// сначала дописывается в журнал (WAL), затем применяется к таблицам. Снимок всех таблиц
+// пишется при росте журнала сверх snapshot_wal_bytes и при закрытии, после чего журнал
+// начинается заново. Формат файлов - docs/EMBEDDED_STORAGE.md. Один процесс на каталог:
+// connect() берёт эксклюзивную блокировку файла LOCK и не открывает занятый каталог.
+class EmbeddedStorage final : public StorageBackend
+{
+public:
+    struct Options
+    {
+        std::filesystem::path directory;
+        uint64_t snapshot_wal_bytes{4u << 20};
+        bool sync_writes{true}; // fsync после каждой записи журнала
+    };
+
+    explicit EmbeddedStorage(Options options);
+    ~EmbeddedStorage() override;
+
+    // загрузка снимка и повтор журнала; оборванная последняя запись журнала отбрасывается
+    bool connect() override;
+    bool is_connected() const override;
+    std::string last_error() const override;
+
+    // снимок всех таблиц и пустой журнал
+    bool write_snapshot();
+
+    std::optional<UserCredential> get_user_credential(const std::string &username) const override;
+    bool register_user(const std::string &username, const std::string &password) override;
+    bool update_password(uint32_t user_id, const std::string &password) override;
+    std::optional<int64_t> save_progress(uint32_t user_id, int32_t difficulty, uint32_t sequence_length,
+                                         float success_rate, uint32_t memorization_ms, uint32_t answer_ms) override;
+    bool save_progress_items(std::vector<ProgressItem> &items) override;
+    bool save_exam_results(const std::vector<ExamResult> &results) override;
+    bool update_difficulty(uint32_t user_id, uint32_t new_level) override;
+    bool update_score(uint32_t user_id, uint32_t score_delta) override;
+    std::optional<std::size_t> compact_scores(uint32_t max_events) override;
+    std::vector<UserProgress> get_user_progress(uint32_t user_id) const override;
+    std::vector<ProgressPoint> get_progress_buckets(uint32_t user_id, ProgressBucket bucket,
+                                                    uint32_t max_buckets) const override;
+    int32_t get_user_difficulty(uint32_t user_id) const override;
+    std::vector<uint32_t> get_unknown_users(const std::vector<uint32_t> &user_ids) const override;
+    std::optional<UserSchedule> get_user_schedule(uint32_t user_id) const override;
+    bool save_user_schedule(const UserSchedule &schedule) override;
+    std::vector<UserSchedule> get_due_schedules(int64_t due_from, int64_t due_before, uint32_t limit) const override;
+    std::optional<std::string> get_weak_items(uint32_t user_id) const override;
+    bool save_weak_items(uint32_t user_id, const std::string &sketch) override;
+    bool save_marathon_result(uint32_t user_id, uint32_t length, uint32_t score, float success_rate,
+                              uint32_t memorization_ms, uint32_t answer_ms) override;
+    LeaderboardRows get_leaderboard(LeaderboardPeriod period, uint32_t limit,
+                                    const std::string &anchor_date) const override;
+
+    std::optional<std::string> get_daily_challenge(const std::string &day, int32_t difficulty) const override;
+    std::optional<std::string> create_daily_challenge(const std::string &day, int32_t difficulty,
+                                                      const std::string &items) override;
+    bool save_daily_challenge_result(const std::string &day, uint32_t user_id, int32_t difficulty,
+                                     uint32_t score, float success_rate) override;
+    std::optional<DailyChallengeScore> get_daily_challenge_score(const std::string &day, uint32_t user_id) const override;
+    LeaderboardRows get_daily_leaderboard(const std::string &day, int32_t difficulty, uint32_t limit) const override;
+
+    std::size_t export_progress(const std::function<void(std::string_view)> &on_row) const override;
+
+private:
+    struct UserRow
+    {
+        std::string username;
+        std::string password;
+        int32_t difficulty_level;
+        uint32_t total_score;
+        int64_t created_at; // unix time, секунды
+    };
+
+    struct ProgressRow
+    {
+        uint32_t user_id;
+        int32_t difficulty; // -1 - раунд записан до появления поля
+        uint32_t sequence_length;
+        float success_rate;
+        uint32_t memorization_ms;
+        uint32_t answer_ms;
+        int64_t training_date;
+    };
+
+    struct DailyResultRow
+    {
+        int32_t difficulty;
+        uint32_t score;
+        float success_rate;
+        int64_t completed_at;
+    };
+
+    struct MarathonRow
+    {
+        uint32_t user_id;
+        uint32_t length;
+        uint32_t score;
+        float success_rate;
+        uint32_t memorization_ms;
+        uint32_t answer_ms;
+        int64_t played_at;
+    };
+
+    struct ExamRow
+    {
+        uint32_t user_id;
+        std::string sequence_id;
+        uint32_t correct;
+        uint32_t total;
+        float credit; // сумма частичного зачёта, <= total
+        int64_t graded_at;
+    };
+
+    using FileHandle = std::unique_ptr<std::FILE, int (*)(std::FILE *)>;
+
+    // запись журнала: добавление в файл, затем применение к таблицам тем же кодом, что и при повторе
+    bool commit(const std::string &payload);
+    void apply(std::string_view payload);
+    bool load_snapshot();
+    bool lock_directory();
+    void unlock_directory() noexcept;
+    bool replay_wal();
+    bool open_wal(bool truncate);
+    bool snapshot_locked();
+    void require_open() const;
+    bool user_exists(uint32_t user_id) const noexcept { return user_id >= 1 && user_id <= users.size(); }
+    LeaderboardRows top_scores(const std::unordered_map<uint32_t, uint64_t> &scores, uint32_t limit) const;
+
+    Options options;
+    mutable std::mutex mutex;
+    mutable std::string error;
+    FileHandle wal{nullptr, std::fclose};
+    // блокировка каталога держится до разрушения объекта
+#ifdef _WIN32
+    void *lock_handle{nullptr};
+#else
+    int lock_descriptor{-1};
+#endif
+    uint64_t next_lsn{1};
+    uint64_t wal_bytes{0};
+
+    // таблицы; id пользователя и записи прогресса - индекс + 1
+    std::vector<UserRow> users;
+    std::unordered_map<std::string, uint32_t> user_by_name;
+    std::vector<ProgressRow> progress;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> progress_by_user;
+    std::vector<ProgressItem> progress_items;
+    std::unordered_set<uint64_t> progress_item_keys; // (progress_id << 16) | position
+    // день (с 1970-01-01, UTC) -> пользователь -> очки
+    std::unordered_map<int64_t, std::unordered_map<uint32_t, uint32_t>> score_by_day;
+    std::unordered_map<uint32_t, UserSchedule> schedules;
+    std::unordered_map<uint32_t, std::string> weak_items; // сериализованный WeakItemSketch
+    std::vector<MarathonRow> marathon_results;
+    std::unordered_map<uint64_t, std::string> daily_challenges; // (день << 8) | сложность
+    std::unordered_map<int64_t, std::unordered_map<uint32_t, DailyResultRow>> daily_results;
+    std::vector<ExamRow> exam_results;
+};
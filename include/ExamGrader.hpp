@@ -0,0 +1,61 @@
+#pragma once
+
+#include "../include/TaskGenerator.hpp"
+#include "../include/AnswerGrader.hpp"
+#include "../include/DatabaseSync.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+class WorkStealingPool;
+
+struct ExamReport
+{
+    std::vector<ExamResult> results; // в порядке строк файла
+    std::size_t invalid_lines{0};
+    uint64_t correct{0};
+    double credit{0.0}; // сумма баллов с частичным зачётом
+    uint64_t total{0};
+    std::chrono::nanoseconds elapsed{0}; // только разбор и проверка, без чтения файла
+};
+
+// пакетная проверка экзаменов: файл последовательностей и файл ответов целиком в памяти,
+// строки ответов проверяются блоками на пуле потоков
+class ExamGrader
+{
+public:
+    static constexpr std::size_t RECORDS_PER_TASK = 1024;
+
+    // строки "<sequence-id>\t<элементы в формате DailyChallenge::serialize>"
+    bool load_sequences(const std::string &path);
+    // строки "<user_id>\t<sequence-id>\t<ответ через пробелы>"; results указывают в буфер файла
+    // и живут, пока жив ExamGrader
+    ExamReport grade_file(const std::string &path, WorkStealingPool &pool);
+
+    std::size_t sequence_count() const noexcept { return sequences.size(); }
+    void set_rules(const AnswerGrader::GradingRules &grading_rules) noexcept { rules = grading_rules; }
+
+    // mem_trainer --grade-exam <answers> --sequences=<file> [--threads=<n>]
+    //             [--difficulty=easy|medium|hard] [--dry-run]
+    static int run_cli(int argc, char **argv);
+
+private:
+    struct Sequence
+    {
+        std::vector<TaskGenerator::TaskItem> items;
+        std::vector<TaskGenerator::TaskItemView> views; // слова указывают в items
+    };
+
+    bool grade_line(std::string_view line, std::vector<std::string_view> &tokens, ExamResult &result) const;
+
+    AnswerGrader::GradingRules rules; // по умолчанию точное сравнение
+    std::string sequences_text;
+    std::string answers_text;
+    std::vector<Sequence> sequences;
+    std::unordered_map<std::string_view, std::size_t> sequence_index; // ключи - срезы sequences_text
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+
+// ленивая последовательность на корутине: тело выполняется до следующего co_yield
+// только при вызове next(), поэтому бесконечный генератор ничего не стоит заранее.
+// Значение копируется в промис, ссылки на локальные переменные корутины не отдаются.
+template <typename T>
+class Generator
+{
+public:
+    struct promise_type
+    {
+        std::optional<T> current;
+        std::exception_ptr error;
+
+        Generator get_return_object() noexcept
+        {
+            return Generator(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        std::suspend_always final_suspend() const noexcept { return {}; }
+
+        template <typename U>
+        std::suspend_always yield_value(U &&value)
+        {
+            current.emplace(std::forward<U>(value));
+            return {};
+        }
+
+        void return_void() const noexcept {}
+        void unhandled_exception() noexcept { error = std::current_exception(); }
+    };
+
+    Generator() noexcept = default;
+
+    Generator(Generator &&other) noexcept
+        : handle(std::exchange(other.handle, nullptr)) {}
+
+    Generator &operator=(Generator &&other) noexcept
+    {
+        if (this != &other)
+        {
+            reset();
+            handle = std::exchange(other.handle, nullptr);
+        }
+        return *this;
+    }
+
+    Generator(const Generator &) = delete;
+    Generator &operator=(const Generator &) = delete;
+
+    ~Generator() { reset(); }
+
+    // следующее значение; nullopt - корутина завершилась. Исключение тела пробрасывается
+    std::optional<T> next()
+    {
+        if (!handle || handle.done())
+        {
+            return std::nullopt;
+        }
+        handle.promise().current.reset();
+        handle.resume();
+        if (handle.promise().error)
+        {
+            std::rethrow_exception(std::exchange(handle.promise().error, nullptr));
+        }
+        if (handle.done())
+        {
+            return std::nullopt;
+        }
+        return std::move(handle.promise().current);
+    }
+
+    explicit operator bool() const noexcept { return handle && !handle.done(); }
+
+private:
+    explicit Generator(std::coroutine_handle<promise_type> handle) noexcept
+        : handle(handle) {}
+
+    void reset() noexcept
+    {
+        if (handle)
+        {
+            handle.destroy();
+            handle = nullptr;
+        }
+    }
+
+    std::coroutine_handle<promise_type> handle{nullptr};
+};
@@ -2,9 +2,23 @@
 
 #include "../include/DatabaseSync.hpp"
 #include "../include/TaskGenerator.hpp"
+#include "../include/DailyChallenge.hpp"
+#include "../include/SessionLog.hpp"
+#include "../include/SharedLeaderboard.hpp"
+#include "../include/AnswerGrader.hpp"
+#include "../include/ScoreCompactor.hpp"
+#include "../include/AuthService.hpp"
+#include "../include/WeakItemSketch.hpp"
 
 #include <memory>
-#include <libpq-fe.h>
+#include <future>
+#include <memory_resource>
+#include <optional>
+#include <array>
+#include <span>
+#include <string_view>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 
 class MainLoop
@@ -16,23 +30,100 @@ public:
     void run();
 
 private:
+    // результат раунда; answers указывают в input, поэтому объект заполняется на месте
+    struct RoundResult
+    {
+        explicit RoundResult(std::pmr::memory_resource *resource)
+            : input(resource), answers(resource), item_correct(resource) {}
+
+        std::pmr::string input;
+        std::pmr::vector<std::string_view> answers;
+        std::pmr::vector<uint8_t> item_correct;
+        uint32_t correct{0};
+        float credit{0.0f}; // с частичным зачётом слов, см. [grading]
+        int64_t started_at_ms{0};
+        std::chrono::milliseconds memorization_time{0};
+        std::chrono::milliseconds answer_time{0};
+    };
+
     bool authenticate_user();
-    bool register_user() const;
+    bool register_user();
     void start_training();
+    void start_daily_challenge();
+    // последовательность растёт на один элемент за успешный раунд до первой ошибки; показывается
+    // только новый элемент, ответ проверяется по ходу разбора строки
+    void start_marathon();
+    // показ, ожидание, ввод и проверка
+    void play_round(std::span<const TaskGenerator::TaskItemView> sequence,
+                    TaskGenerator::Difficulty difficulty, RoundResult &result);
+    void record_round(std::span<const TaskGenerator::TaskItemView> sequence, TaskGenerator::Difficulty difficulty,
+                      SessionMode mode, uint64_t seed, const RoundResult &result);
     void show_leaderboard() const;
+    void show_daily_leaderboard() const;
+    // из общей памяти, если сегмент свежий; иначе запрос к БД (и обновление сегмента по аренде)
+    LeaderboardRows load_leaderboard(SharedLeaderboard::Board board) const;
+    LeaderboardRows query_leaderboard(SharedLeaderboard::Board board, int64_t day) const;
     void display_training_header(TaskGenerator::Difficulty difficulty, std::size_t sequence_length);
-    void display_sequence(const std::vector<TaskGenerator::TaskItem> &sequence);
+    void display_sequence(std::span<const TaskGenerator::TaskItemView> sequence);
     void clear_screen();
-    std::vector<std::string> prompt_user_input();
-    uint32_t check_answers(const std::vector<TaskGenerator::TaskItem> &sequence,
-                           const std::vector<std::string> &user_answers) const;
-    void save_training_results(std::size_t sequence_length, float success_rate, uint32_t score);
+    void count_down(uint32_t seconds) const;
+    static uint32_t memorization_seconds(TaskGenerator::Difficulty difficulty) noexcept;
+    // токены указывают в input, который должен жить не меньше результата
+    std::pmr::vector<std::string_view> prompt_user_input(std::pmr::string &input);
+    // item_correct получает 1/0 на каждый элемент sequence
+    AnswerGrader::Grade check_answers(std::span<const TaskGenerator::TaskItemView> sequence,
+                                      std::span<const std::string_view> user_answers,
+                                      std::span<uint8_t> item_correct,
+                                      TaskGenerator::Difficulty difficulty) const;
+    // записи раунда, отправленные без ожидания
+    struct PendingSave
+    {
+        std::future<std::optional<int64_t>> progress_id;
+        std::future<bool> score;
+        std::future<bool> weak_items; // без промахов - пустой (valid() == false)
+    };
+    PendingSave save_training_results(std::span<const TaskGenerator::TaskItemView> sequence, const RoundResult &round,
+                                      TaskGenerator::Difficulty difficulty, float success_rate, uint32_t score);
+    // ждёт записи; позиции раунда - в пачку user_progress_items (им нужен id прогресса)
+    void finish_training_results(std::span<const TaskGenerator::TaskItemView> sequence, const RoundResult &round,
+                                 PendingSave save);
+    // false - пачка не записана и осталась в pending_items
+    bool flush_progress_items();
+    // sketch промахов текущего пользователя; без сохранённого - пустой
+    void load_weak_items();
+    // промахи раунда в sketch и новый bias для генераторов; future записи или пустой, если промахов нет
+    std::future<bool> update_weak_items(std::span<const TaskGenerator::TaskItemView> sequence,
+                                        std::span<const uint8_t> item_correct);
     void update_difficulty_if_needed(TaskGenerator::Difficulty difficulty, float success_rate);
+    void update_schedule(const std::optional<UserSchedule> &schedule, TaskGenerator::Difficulty difficulty,
+                         std::size_t sequence_length, float success_rate);
     void print_results(uint32_t correct, std::size_t total, float success_rate,
                        uint32_t score, TaskGenerator::Difficulty difficulty) const;
     void show_user_progress();
     uint32_t calculate_score(float, TaskGenerator::Difficulty difficulty) const;
     DatabaseSync db_sync;
-    std::shared_ptr<PGconn> db_connection;
     int32_t current_user_id;
+    DailyChallenge daily_challenge;
+    std::unique_ptr<SessionLogWriter> session_log; // [recording] file=, иначе nullptr
+    std::unique_ptr<SharedLeaderboard> shared_leaderboard; // [leaderboard] shm_name=, иначе nullptr
+    std::unique_ptr<ScoreCompactor> score_compactor; // [scores] compact_seconds > 0, иначе nullptr
+    std::unique_ptr<AuthService> auth;
+    AnswerGrader::RulesByDifficulty grading_rules;
+
+    // позиции раундов копятся и уходят в user_progress_items одним COPY
+    std::vector<ProgressItem> pending_items;
+    std::size_t item_batch_rows{64};
+    uint32_t item_flush_failures{0}; // неудачных записей пачки подряд
+
+    // слабые слова и символы пользователя; bias - nullptr, пока промахов нет
+    WeakItemSketch weak_items;
+    std::shared_ptr<const WeakItemBias> weak_bias;
+
+    // длина марафона, после которой он засчитывается пройденным
+    static constexpr std::size_t MAX_MARATHON_LENGTH = 4096;
+
+    // вся память раунда тренировки берётся отсюда и сбрасывается перед следующим раундом
+    static constexpr std::size_t ROUND_ARENA_BYTES = 4096;
+    alignas(std::max_align_t) std::array<std::byte, ROUND_ARENA_BYTES> round_buffer;
+    std::pmr::monotonic_buffer_resource round_arena;
 };
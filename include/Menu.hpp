@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <string_view>
+#include <span>
 #include <vector>
 #include <utility>
 #include <cstdint>
@@ -11,8 +13,22 @@ class Menu
 public:
     void print_auth_menu() const;
     void print_main_menu() const;
-    void print_leaderboard(const std::vector<std::pair<std::string, std::string>> &leaders) const;
-    void print_message(const std::string &message) const;
+    void print_leaderboard_period_menu() const;
+    void print_progress_period_menu() const;
+    void print_leaderboard(const std::vector<std::pair<std::string, std::string>> &leaders,
+                           const std::string &title = "TOP-10 Players") const;
+    void print_message(std::string_view message) const;
     void print_training_results(uint32_t correct, std::size_t total, float success_rate,
                                 uint32_t score, bool level_increased, bool suggest_easier) const;
+    // столбцы success_rate (0..1, по колонке на точку) высотой CHART_ROWS строк, под ними - подписи
+    // первой и последней точки и sparkline длины последовательностей
+    void print_progress_chart(const std::string &title, std::span<const float> success_rates,
+                              std::span<const float> lengths, std::string_view first_label,
+                              std::string_view last_label) const;
+
+    static constexpr std::size_t CHART_ROWS = 8;
+    // слева от столбцов: подпись оси "100% |"
+    static constexpr std::size_t CHART_AXIS_WIDTH = 6;
+    // колонки терминала (TIOCGWINSZ, затем $COLUMNS), иначе 80
+    static std::size_t terminal_width() noexcept;
 };
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <string>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include <cstddef>
+
+// Гистограмма задержек в стиле HDR: 8 под-бакетов на степень двойки (ошибка <= 12.5%),
+// диапазон 1 нс .. 2^40 нс. Запись идёт в шард текущего потока, шарды сливаются при экспорте.
+class LatencyHistogram
+{
+public:
+    static constexpr std::size_t SUB_BUCKET_BITS = 3;
+    static constexpr std::size_t SUB_BUCKETS = std::size_t{1} << SUB_BUCKET_BITS;
+    static constexpr std::size_t MAX_EXPONENT = 40;
+    static constexpr std::size_t BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+    // labels - готовая строка вида statement="save_progress"
+    LatencyHistogram(const std::string &name, const std::string &help, const std::string &labels = "");
+
+    void record(std::chrono::nanoseconds elapsed) const noexcept;
+
+    static std::size_t bucket_index(uint64_t nanoseconds) noexcept;
+    static uint64_t bucket_upper_bound(std::size_t index) noexcept; // включительно, нс
+
+private:
+    std::size_t slot;
+};
+
+class MetricCounter
+{
+public:
+    MetricCounter(const std::string &name, const std::string &help, const std::string &labels = "");
+
+    void increment(uint64_t delta = 1) const noexcept;
+
+private:
+    std::size_t slot;
+};
+
+class ScopedLatency
+{
+public:
+    explicit ScopedLatency(const LatencyHistogram &histogram) noexcept
+        : target(histogram), started(std::chrono::steady_clock::now()) {}
+    ~ScopedLatency() { target.record(std::chrono::steady_clock::now() - started); }
+
+    ScopedLatency(const ScopedLatency &) = delete;
+    ScopedLatency &operator=(const ScopedLatency &) = delete;
+
+private:
+    const LatencyHistogram &target;
+    std::chrono::steady_clock::time_point started;
+};
+
+class MetricsRegistry
+{
+public:
+    static MetricsRegistry &instance();
+
+    // текстовый формат Prometheus (exposition format 0.0.4)
+    std::string render_prometheus() const;
+    // запись во временный файл и rename, чтобы textfile-коллектор не видел половину файла
+    bool write_prometheus_file(const std::string &path) const;
+
+    void start_file_exporter(const std::string &path, std::chrono::seconds interval);
+    void stop_file_exporter();
+
+private:
+    MetricsRegistry() = default;
+    ~MetricsRegistry();
+
+    std::thread exporter;
+    std::mutex exporter_mutex;
+    std::condition_variable exporter_wakeup;
+    bool exporter_stop{false};
+};
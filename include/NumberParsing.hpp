@@ -0,0 +1,31 @@
+#pragma once
+
+#include <charconv>
+#include <string_view>
+#include <system_error>
+#include <cstddef>
+
+// разбор чисел через std::from_chars: без исключений (в отличие от std::stoul) и без локали
+namespace NumberParsing
+{
+    // text целиком - одно число: пустая строка, пробелы, '+' и хвост после числа - ошибка
+    template <typename T>
+    bool parse_whole(std::string_view text, T &value) noexcept
+    {
+        const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+        return !text.empty() && error == std::errc{} && end == text.data() + text.size();
+    }
+
+    // число в начале text; разобранная часть удаляется из text, остальное остаётся вызывающему
+    template <typename T>
+    bool parse_prefix(std::string_view &text, T &value) noexcept
+    {
+        const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value);
+        if (error != std::errc{})
+        {
+            return false;
+        }
+        text.remove_prefix(static_cast<std::size_t>(end - text.data()));
+        return true;
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "../include/PgRequest.hpp"
+
+#include <deque>
+#include <exception>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <chrono>
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+
+class SlowQueryLog;
+
+// асинхронные запросы к PostgreSQL: несколько неблокирующих соединений и один поток с epoll.
+// submit() ставит PgRequest в очередь и сразу возвращает future; поток отправляет запрос
+// свободному соединению (PQsendQueryParams, PQflush по готовности на запись), читает ответ
+// по готовности сокета (PQconsumeInput, PQisBusy, PQgetResult) и разбирает результат у себя.
+// Порядок выполнения не гарантируется: зависимые запросы ждут future предыдущего.
+// Деструктор дожидается уже поставленных запросов. Только Linux (epoll, eventfd)
+class PgEventLoop
+{
+public:
+    PgEventLoop(std::string conninfo, std::size_t connections, SlowQueryLog *slow_log = nullptr);
+    ~PgEventLoop();
+
+    PgEventLoop(const PgEventLoop &) = delete;
+    PgEventLoop &operator=(const PgEventLoop &) = delete;
+
+    // соединения устанавливаются синхронно; false и текст в last_error() при ошибке
+    bool start();
+    // ошибка последнего неудачного запроса или start()
+    std::string last_error() const;
+
+    template <typename T>
+    std::future<T> submit(PgRequest<T> request)
+    {
+        auto done = std::make_shared<std::promise<T>>();
+        std::future<T> result = done->get_future();
+        enqueue(Job{static_cast<PgQuery &&>(request),
+                    [done, parse = std::move(request.parse)](const PGresult *res, const std::string &error)
+                    {
+                        try
+                        {
+                            done->set_value(parse(res, error));
+                        }
+                        catch (...)
+                        {
+                            done->set_exception(std::current_exception());
+                        }
+                    }});
+        return result;
+    }
+
+private:
+    struct Job
+    {
+        PgQuery query;
+        std::function<void(const PGresult *, const std::string &)> complete;
+        std::chrono::steady_clock::time_point queued{};
+        std::chrono::steady_clock::time_point started{};
+    };
+
+    enum class Phase : uint8_t
+    {
+        IDLE,
+        SENDING, // запрос в буфере libpq, ждём готовности сокета на запись
+        COPYING, // сервер ждёт данных COPY FROM STDIN
+        READING  // ждём результат
+    };
+
+    struct Connection
+    {
+        std::unique_ptr<PGconn, decltype(&PQfinish)> conn{nullptr, PQfinish};
+        int socket{-1};
+        Phase phase{Phase::IDLE};
+        std::unique_ptr<Job> job;
+        PGresult *result{nullptr}; // последний полученный результат запроса
+        std::size_t copy_offset{0};
+        bool copy_ended{false};
+    };
+
+    void enqueue(Job job);
+    void wake();
+    void run();
+    bool open(Connection &connection);
+    // закрывает соединение и снимает его с epoll
+    void drop(Connection &connection);
+    void watch(Connection &connection, bool writable);
+    void begin(Connection &connection, std::unique_ptr<Job> job);
+    void service(Connection &connection, uint32_t events);
+    // false - запрос завершён ошибкой
+    bool flush(Connection &connection);
+    bool send_copy(Connection &connection);
+    void collect(Connection &connection);
+    // отдаёт результат (или failure) в future и освобождает соединение
+    void finish(Connection &connection, const std::optional<std::string> &failure = std::nullopt);
+
+    std::string conninfo;
+    SlowQueryLog *slow_log;
+    std::vector<Connection> connections;
+
+    int epoll_fd{-1};
+    int wakeup_fd{-1};
+    std::thread worker;
+
+    mutable std::mutex mutex;
+    std::deque<Job> queue;
+    bool stopping{false};
+    std::string error;
+};
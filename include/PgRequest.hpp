@@ -0,0 +1,36 @@
+#pragma once
+
+#include <libpq-fe.h>
+#include <string>
+#include <vector>
+#include <optional>
+#include <functional>
+#include <chrono>
+#include <cstddef>
+
+struct SqlStatement;
+class SlowQueryLog;
+
+// запрос без привязки к соединению: параметры (nullopt - NULL) или готовый буфер COPY FROM STDIN
+struct PgQuery
+{
+    const SqlStatement *statement;
+    std::vector<std::optional<std::string>> params;
+    bool copy{false};
+    std::string copy_data{}; // текстовый формат COPY
+    std::size_t copy_rows{0};
+};
+
+// запрос и разбор его результата. Синхронно выполняется PostgresStorage, асинхронно - PgEventLoop.
+// parse получает итоговый результат (nullptr, если запрос не удалось отправить) и текст ошибки;
+// PQclear вызывает исполнитель
+template <typename T>
+struct PgRequest : PgQuery
+{
+    std::function<T(const PGresult *res, const std::string &error)> parse{};
+};
+
+// метрики SqlStatement и slow log для завершённого запроса; общий учёт обоих путей выполнения.
+// copy_bytes - объём отправленного буфера COPY FROM STDIN
+void record_query(const SqlStatement &statement, const PGresult *res, std::chrono::nanoseconds elapsed,
+                  std::size_t param_count, std::size_t copy_bytes, SlowQueryLog *slow_log, const char *error);
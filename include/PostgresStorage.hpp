@@ -0,0 +1,140 @@
+#pragma once
+
+#include "../include/StorageBackend.hpp"
+#include "../include/PgRequest.hpp"
+
+#include <memory>
+#include <libpq-fe.h>
+#include <string>
+#include <vector>
+#include <optional>
+#include <functional>
+#include <string_view>
+#include <span>
+#include <cstdint>
+
+struct SqlStatement;
+class SlowQueryLog;
+class ConfigFile;
+
+// PostgreSQL через libpq: каждый вызов - один запрос (или один COPY)
+class PostgresStorage final : public StorageBackend
+{
+public:
+    explicit PostgresStorage(const std::string &conninfo);
+    PostgresStorage(); // [database] из config.ini
+    ~PostgresStorage() override;
+
+    // строка соединения из [database]; непустые host, port и dbname заменяют значения из файла
+    // (реплики, шарды)
+    static std::string parse_config_file(const std::string &host = "", const std::string &port = "",
+                                         const std::string &dbname = "");
+    bool connect() override;
+    bool is_connected() const override;
+    inline PGconn *get_connection() const { return db_connection.get(); }
+    std::string last_error() const override;
+    const std::string &conninfo() const noexcept { return connection_info; }
+    SlowQueryLog *slow_query_log() const noexcept { return slow_log.get(); }
+    // [database] slow_query_log; nullptr, если не задан. Один журнал разделяют primary, реплики и шарды
+    static std::shared_ptr<SlowQueryLog> slow_query_log_from_config(const ConfigFile &config);
+    const std::shared_ptr<SlowQueryLog> &shared_slow_query_log() const noexcept { return slow_log; }
+    void set_slow_query_log(std::shared_ptr<SlowQueryLog> log) noexcept { slow_log = std::move(log); }
+    // отставание реплики: 0, если весь полученный WAL применён (и для primary),
+    // иначе возраст последней применённой транзакции; nullopt при ошибке запроса
+    std::optional<double> replication_lag_seconds() const;
+
+    std::optional<UserCredential> get_user_credential(const std::string &username) const override;
+    bool register_user(const std::string &username, const std::string &password) override;
+    // false, если следующий id пользователя больше max_id (строка не вставлена); nullopt при ошибке
+    std::optional<bool> register_user_below(const std::string &username, const std::string &password,
+                                            int64_t max_id);
+    bool update_password(uint32_t user_id, const std::string &password) override;
+    std::optional<int64_t> save_progress(uint32_t user_id, int32_t difficulty, uint32_t sequence_length,
+                                         float success_rate, uint32_t memorization_ms, uint32_t answer_ms) override;
+    bool save_progress_items(std::vector<ProgressItem> &items) override;
+    bool save_exam_results(const std::vector<ExamResult> &results) override;
+    bool update_difficulty(uint32_t user_id, uint32_t new_level) override;
+    bool update_score(uint32_t user_id, uint32_t score_delta) override;
+    std::optional<std::size_t> compact_scores(uint32_t max_events) override;
+    std::vector<UserProgress> get_user_progress(uint32_t user_id) const override;
+    std::vector<ProgressPoint> get_progress_buckets(uint32_t user_id, ProgressBucket bucket,
+                                                    uint32_t max_buckets) const override;
+    int32_t get_user_difficulty(uint32_t user_id) const override;
+    std::vector<uint32_t> get_unknown_users(const std::vector<uint32_t> &user_ids) const override;
+    std::optional<UserSchedule> get_user_schedule(uint32_t user_id) const override;
+    bool save_user_schedule(const UserSchedule &schedule) override;
+    std::vector<UserSchedule> get_due_schedules(int64_t due_from, int64_t due_before, uint32_t limit) const override;
+    std::optional<std::string> get_weak_items(uint32_t user_id) const override;
+    bool save_weak_items(uint32_t user_id, const std::string &sketch) override;
+    bool save_marathon_result(uint32_t user_id, uint32_t length, uint32_t score, float success_rate,
+                              uint32_t memorization_ms, uint32_t answer_ms) override;
+    LeaderboardRows get_leaderboard(LeaderboardPeriod period, uint32_t limit,
+                                    const std::string &anchor_date) const override;
+
+    std::optional<std::string> get_daily_challenge(const std::string &day, int32_t difficulty) const override;
+    std::optional<std::string> create_daily_challenge(const std::string &day, int32_t difficulty,
+                                                      const std::string &items) override;
+    bool save_daily_challenge_result(const std::string &day, uint32_t user_id, int32_t difficulty,
+                                     uint32_t score, float success_rate) override;
+    std::optional<DailyChallengeScore> get_daily_challenge_score(const std::string &day, uint32_t user_id) const override;
+    LeaderboardRows get_daily_leaderboard(const std::string &day, int32_t difficulty, uint32_t limit) const override;
+
+    std::size_t export_progress(const std::function<void(std::string_view)> &on_row) const override;
+
+    // те же операции как запросы без соединения: их же выполняют синхронные методы выше,
+    // а PgEventLoop - асинхронно. export_progress сюда не входит: строки COPY TO отдаются потоком
+    static PgRequest<std::optional<UserCredential>> get_user_credential_request(const std::string &username);
+    static PgRequest<bool> register_user_request(const std::string &username, const std::string &password);
+    static PgRequest<bool> update_password_request(uint32_t user_id, const std::string &password);
+    static PgRequest<std::optional<int64_t>> save_progress_request(uint32_t user_id, int32_t difficulty,
+                                                                   uint32_t sequence_length, float success_rate,
+                                                                   uint32_t memorization_ms, uint32_t answer_ms);
+    static PgRequest<bool> save_progress_items_request(const std::vector<ProgressItem> &items);
+    static PgRequest<bool> save_exam_results_request(const std::vector<ExamResult> &results);
+    static PgRequest<bool> update_difficulty_request(uint32_t user_id, uint32_t new_level);
+    static PgRequest<bool> update_score_request(uint32_t user_id, uint32_t score_delta);
+    static PgRequest<std::optional<std::size_t>> compact_scores_request(uint32_t max_events);
+    static PgRequest<std::vector<UserProgress>> get_user_progress_request(uint32_t user_id);
+    static PgRequest<std::vector<ProgressPoint>> get_progress_buckets_request(uint32_t user_id, ProgressBucket bucket,
+                                                                              uint32_t max_buckets);
+    static PgRequest<int32_t> get_user_difficulty_request(uint32_t user_id);
+    static PgRequest<std::vector<uint32_t>> get_unknown_users_request(const std::vector<uint32_t> &user_ids);
+    static PgRequest<std::optional<UserSchedule>> get_user_schedule_request(uint32_t user_id);
+    static PgRequest<bool> save_user_schedule_request(const UserSchedule &schedule);
+    static PgRequest<std::vector<UserSchedule>> get_due_schedules_request(int64_t due_from, int64_t due_before,
+                                                                          uint32_t limit);
+    static PgRequest<std::optional<std::string>> get_weak_items_request(uint32_t user_id);
+    static PgRequest<bool> save_weak_items_request(uint32_t user_id, const std::string &sketch);
+    static PgRequest<bool> save_marathon_result_request(uint32_t user_id, uint32_t length, uint32_t score,
+                                                        float success_rate, uint32_t memorization_ms,
+                                                        uint32_t answer_ms);
+    static PgRequest<LeaderboardRows> get_leaderboard_request(LeaderboardPeriod period, uint32_t limit,
+                                                              const std::string &anchor_date);
+    static PgRequest<std::optional<std::string>> get_daily_challenge_request(const std::string &day,
+                                                                             int32_t difficulty);
+    static PgRequest<std::optional<std::string>> create_daily_challenge_request(const std::string &day,
+                                                                                int32_t difficulty,
+                                                                                const std::string &items);
+    static PgRequest<bool> save_daily_challenge_result_request(const std::string &day, uint32_t user_id,
+                                                               int32_t difficulty, uint32_t score,
+                                                               float success_rate);
+    static PgRequest<std::optional<DailyChallengeScore>> get_daily_challenge_score_request(const std::string &day,
+                                                                                uint32_t user_id);
+    static PgRequest<LeaderboardRows> get_daily_leaderboard_request(const std::string &day, int32_t difficulty,
+                                                                    uint32_t limit);
+
+private:
+    std::shared_ptr<PGconn> db_connection;
+    std::string connection_info;
+    std::shared_ptr<SlowQueryLog> slow_log;
+
+    // единственный путь выполнения запросов: тайминг, метрики и slow log
+    PGresult *execute(const SqlStatement &statement, std::span<const char *const> values) const;
+    // COPY FROM STDIN готового буфера в текстовом формате; rows - для метрик.
+    // Итоговый результат COPY (или результат неудачного начала)
+    PGresult *copy_in(const SqlStatement &statement, const std::string &buffer, std::size_t rows) const;
+    // запрос на собственном соединении; parse - с текстом last_error()
+    template <typename T>
+    T run(const PgRequest<T> &request) const;
+    void require_connection() const;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "../include/Metrics.hpp"
+
+#include <string>
+#include <fstream>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// именованный SQL-запрос со своими метриками; объекты создаются статически рядом с запросом
+struct SqlStatement
+{
+    SqlStatement(const char *statement_name, const char *statement_sql);
+
+    const char *name;
+    const char *sql;
+    LatencyHistogram latency;
+    MetricCounter rows;
+    MetricCounter bytes;
+    MetricCounter errors;
+};
+
+struct QueryRecord
+{
+    const SqlStatement *statement;
+    std::chrono::nanoseconds elapsed;
+    int64_t rows;
+    std::size_t bytes;
+    std::size_t param_count;
+    bool failed;
+    std::string status;
+    std::string error;
+};
+
+// JSON Lines: одна строка на медленный или неудачный запрос, значения параметров не пишутся
+class SlowQueryLog
+{
+public:
+    SlowQueryLog(const std::string &path, std::chrono::milliseconds threshold);
+
+    bool is_open() const noexcept { return log.is_open(); }
+    bool should_log(std::chrono::nanoseconds elapsed, bool failed) const noexcept
+    {
+        return failed || elapsed >= threshold;
+    }
+    void write(const QueryRecord &record);
+
+private:
+    std::mutex mutex;
+    std::ofstream log;
+    std::chrono::milliseconds threshold;
+};
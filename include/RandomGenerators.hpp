@@ -1,8 +1,15 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <array>
+#include <random>
 #include <cstdint>
+#include <cstddef>
+
+// движок для воспроизводимых последовательностей: mt19937_64 и отображение в диапазон
+// заданы явно, поэтому одно зерно даёт одни и те же значения на любой платформе
+using RandomEngine = std::mt19937_64;
 
 class NumberGenerator
 {
@@ -11,6 +18,10 @@ public:
     static uint32_t generate_uint32() noexcept;
     static float generate_float() noexcept;
 
+    static uint16_t generate_uint16(RandomEngine &engine) noexcept;
+    static uint32_t generate_uint32(RandomEngine &engine) noexcept;
+    static float generate_float(RandomEngine &engine) noexcept;
+
 private:
     template <typename T>
     static T generate() noexcept;
@@ -20,10 +31,14 @@ class SymbolGenerator
 {
 public:
     static char generate_char() noexcept;
+    static char generate_char(RandomEngine &engine) noexcept;
     static std::string generate_string(size_t length) noexcept;
 
+    static constexpr std::size_t SYMBOL_COUNT = 52;
+    static constexpr char symbol_at(std::size_t index) noexcept { return symbols[index]; }
+
 private:
-    static constexpr std::array<char, 52> symbols = {
+    static constexpr std::array<char, SYMBOL_COUNT> symbols = {
         'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J',
         'K', 'L', 'M', 'N', 'O', 'P', 'Q', 'R', 'S', 'T',
         'U', 'V', 'W', 'X', 'Y', 'Z',
@@ -36,9 +51,15 @@ class WordGenerator
 {
 public:
     static std::string generate_word() noexcept;
+    // вид на статическую строку словаря, без аллокации
+    static std::string_view generate_word_view() noexcept;
+    static std::string_view generate_word_view(RandomEngine &engine) noexcept;
+
+    static constexpr std::size_t WORD_COUNT = 100;
+    static constexpr std::string_view word_at(std::size_t index) noexcept { return words[index]; }
 
 private:
-    static constexpr std::array<const char *, 100> words = {
+    static constexpr std::array<const char *, WORD_COUNT> words = {
         "treadmill", "dumbbell", "barbell", "squat", "deadlift",
         "benchpress", "pullup", "pushup", "plank", "crunch",
         "kettlebell", "rower", "elliptical", "protein", "creatine",
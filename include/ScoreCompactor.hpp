@@ -0,0 +1,33 @@
+#pragma once
+
+#include <chrono>
+#include <optional>
+#include <cstdint>
+#include <cstddef>
+
+class DatabaseSync;
+
+// перенос накопленных событий очков (score_events) в users.total_score и user_score_daily:
+// из сессии - пачка не чаще раза в interval, из командной строки - до опустошения таблицы
+class ScoreCompactor
+{
+public:
+    static constexpr uint32_t DEFAULT_BATCH_EVENTS = 10000;
+
+    ScoreCompactor(DatabaseSync &db_sync, std::chrono::seconds interval,
+                   uint32_t batch_events = DEFAULT_BATCH_EVENTS);
+
+    // одна пачка, если с прошлого запуска прошло не меньше interval
+    void maybe_compact();
+    // пачки, пока приходят полными; число перенесённых событий или nullopt при ошибке
+    std::optional<std::size_t> compact_all();
+
+    // mem_trainer --compact-scores [--batch=<n>]
+    static int run_cli(int argc, char **argv);
+
+private:
+    DatabaseSync &db_sync;
+    std::chrono::seconds interval;
+    uint32_t batch_events;
+    std::chrono::steady_clock::time_point last_run;
+};
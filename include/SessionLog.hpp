@@ -0,0 +1,122 @@
+#pragma once
+
+#include "../include/TaskGenerator.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <span>
+#include <fstream>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+// Журнал раундов тренировки: только дозапись, блоки по block_records записей,
+// каждый блок сжимается BlockCodec (или хранится как есть, если сжатие не выгодно).
+// Формат описан в docs/SESSION_LOG.md.
+
+enum class SessionMode : uint8_t
+{
+    TRAINING,
+    DAILY_CHALLENGE
+};
+
+// одна запись; все поля - виды, данные принадлежат вызывающему (писатель) или читателю
+struct SessionRecord
+{
+    uint32_t user_id;
+    int64_t started_at_ms; // unix time, мс
+    TaskGenerator::Difficulty difficulty;
+    SessionMode mode;
+    uint64_t seed; // 0 - последовательность не из seed
+    uint32_t memorization_ms;
+    uint32_t answer_ms;
+    std::span<const TaskGenerator::TaskItemView> items;
+    std::span<const std::string_view> answers;
+    std::span<const uint8_t> item_correct; // 1/0 на каждый элемент items
+};
+
+class SessionLogWriter
+{
+public:
+    static constexpr uint32_t DEFAULT_BLOCK_RECORDS = 64;
+
+    SessionLogWriter(const std::string &path, uint32_t block_records = DEFAULT_BLOCK_RECORDS);
+    ~SessionLogWriter();
+
+    SessionLogWriter(const SessionLogWriter &) = delete;
+    SessionLogWriter &operator=(const SessionLogWriter &) = delete;
+
+    bool is_open() const noexcept { return log.is_open(); }
+    void append(const SessionRecord &record);
+    // незаполненный блок пишется сразу (при выходе и по требованию)
+    void flush();
+
+private:
+    void flush_locked();
+    // эксклюзивная блокировка <log>.lock на всё время работы писателя
+    bool lock_file(const std::string &lock_path);
+
+    std::mutex mutex;
+    std::ofstream log;
+    uint32_t block_records;
+
+    // состояние текущего блока; дельты считаются от предыдущей записи блока
+    std::vector<uint8_t> block;
+    std::vector<uint8_t> compressed;
+    std::vector<uint8_t> frame;
+    uint32_t record_count{0};
+    uint32_t previous_user_id{0};
+    int64_t previous_started_at{0};
+
+#ifdef _WIN32
+    void *lock_handle{nullptr};
+#else
+    int lock_descriptor{-1};
+#endif
+};
+
+// чтение через отображение файла в память; несжатые блоки читаются без копирования
+class SessionLogReader
+{
+public:
+    explicit SessionLogReader(const std::string &path);
+    ~SessionLogReader();
+
+    SessionLogReader(const SessionLogReader &) = delete;
+    SessionLogReader &operator=(const SessionLogReader &) = delete;
+
+    bool is_open() const noexcept { return opened; }
+    // следующая запись; виды действительны до следующего вызова next().
+    // false в конце файла или на повреждённом/недописанном блоке (см. corrupted())
+    bool next(SessionRecord &record);
+    bool corrupted() const noexcept { return damaged; }
+    void rewind() noexcept;
+
+private:
+    bool load_block();
+
+    bool opened{false};
+    const uint8_t *data{nullptr};
+    std::size_t size{0};
+#ifdef _WIN32
+    void *file_handle{nullptr};
+    void *mapping_handle{nullptr};
+#else
+    int file_descriptor{-1};
+#endif
+
+    std::size_t block_offset{0};
+    bool damaged{false};
+
+    std::span<const uint8_t> payload;
+    std::size_t payload_position{0};
+    uint32_t records_left{0};
+    uint32_t previous_user_id{0};
+    int64_t previous_started_at{0};
+
+    std::vector<uint8_t> decompressed;
+    std::vector<TaskGenerator::TaskItemView> items;
+    std::vector<std::string_view> answers;
+    std::vector<uint8_t> item_correct;
+};
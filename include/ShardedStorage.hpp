@@ -0,0 +1,118 @@
+#pragma once
+
+#include "../include/StorageBackend.hpp"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <limits>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+class PostgresStorage;
+class ConfigFile;
+
+// пользователи и всё, что к ним привязано, распределены по нескольким базам PostgreSQL ([shards]).
+// Домашний шард пользователя - jump consistent hash от FNV-1a имени: при добавлении шарда в конец
+// списка переезжает лишь ~1/N пользователей. Снаружи id пользователя (и записи прогресса) -
+// local_id * MAX_SHARDS + шард, поэтому запросы по id сразу идут в нужную базу без справочника.
+// Рейтинги запрашиваются со всех шардов параллельно и сливаются в общий топ-N; общие для всех
+// ежедневные задания хранятся в шарде 0. Схема каждой базы - install_db.sql.
+class ShardedStorage final : public StorageBackend
+{
+public:
+    static constexpr std::size_t MAX_SHARDS = 256;
+    // id пользователя остаётся 32-битным: local_id * MAX_SHARDS + шард <= INT32_MAX.
+    // Шард, выдавший все id, отказывает в регистрации, а не во входе
+    static constexpr int64_t MAX_LOCAL_USER_ID =
+        std::numeric_limits<int32_t>::max() / static_cast<int64_t>(MAX_SHARDS);
+
+    struct RebalanceReport
+    {
+        std::size_t scanned{0};
+        std::size_t moved{0}; // при dry_run - сколько переехало бы
+        std::size_t failed{0};
+    };
+
+    explicit ShardedStorage(std::vector<std::unique_ptr<PostgresStorage>> shards);
+    ~ShardedStorage() override;
+
+    // [shards] databases=host[:port]/dbname,...; пустой вектор, если шардов нет
+    static std::vector<std::unique_ptr<PostgresStorage>> shards_from_config(const ConfigFile &config);
+    // mem_trainer --rebalance-shards [--dry-run]
+    static int run_cli(int argc, char **argv);
+
+    std::size_t shard_count() const noexcept { return shards.size(); }
+    std::size_t home_shard(std::string_view username) const noexcept;
+    static std::size_t shard_of(int64_t id) noexcept { return static_cast<std::size_t>(id % MAX_SHARDS); }
+    static int64_t local_id(int64_t id) noexcept { return id / static_cast<int64_t>(MAX_SHARDS); }
+    static int64_t global_id(int64_t local, std::size_t shard) noexcept
+    {
+        return local * static_cast<int64_t>(MAX_SHARDS) + static_cast<int64_t>(shard);
+    }
+
+    // переносит пользователей, живущих не в домашнем шарде (после изменения [shards]), со всеми
+    // их строками: копия в целевой базе одной транзакцией, затем удаление в исходной.
+    // Прерванный перенос безопасно повторяется. Переезжающий пользователь не должен играть:
+    // его id меняется
+    RebalanceReport rebalance(bool dry_run, const std::function<void(std::string_view)> &on_user);
+
+    bool connect() override;
+    bool is_connected() const override;
+    std::string last_error() const override;
+
+    std::optional<UserCredential> get_user_credential(const std::string &username) const override;
+    bool register_user(const std::string &username, const std::string &password) override;
+    bool update_password(uint32_t user_id, const std::string &password) override;
+    std::optional<int64_t> save_progress(uint32_t user_id, int32_t difficulty, uint32_t sequence_length,
+                                         float success_rate, uint32_t memorization_ms, uint32_t answer_ms) override;
+    // по пачке на шард; атомарность - в пределах шарда, в items остаются строки упавших шардов
+    bool save_progress_items(std::vector<ProgressItem> &items) override;
+    bool save_exam_results(const std::vector<ExamResult> &results) override;
+    bool update_difficulty(uint32_t user_id, uint32_t new_level) override;
+    bool update_score(uint32_t user_id, uint32_t score_delta) override;
+    std::optional<std::size_t> compact_scores(uint32_t max_events) override;
+    std::vector<UserProgress> get_user_progress(uint32_t user_id) const override;
+    std::vector<ProgressPoint> get_progress_buckets(uint32_t user_id, ProgressBucket bucket,
+                                                    uint32_t max_buckets) const override;
+    int32_t get_user_difficulty(uint32_t user_id) const override;
+    std::vector<uint32_t> get_unknown_users(const std::vector<uint32_t> &user_ids) const override;
+    std::optional<UserSchedule> get_user_schedule(uint32_t user_id) const override;
+    bool save_user_schedule(const UserSchedule &schedule) override;
+    std::vector<UserSchedule> get_due_schedules(int64_t due_from, int64_t due_before, uint32_t limit) const override;
+    std::optional<std::string> get_weak_items(uint32_t user_id) const override;
+    bool save_weak_items(uint32_t user_id, const std::string &sketch) override;
+    bool save_marathon_result(uint32_t user_id, uint32_t length, uint32_t score, float success_rate,
+                              uint32_t memorization_ms, uint32_t answer_ms) override;
+    LeaderboardRows get_leaderboard(LeaderboardPeriod period, uint32_t limit,
+                                    const std::string &anchor_date) const override;
+
+    std::optional<std::string> get_daily_challenge(const std::string &day, int32_t difficulty) const override;
+    std::optional<std::string> create_daily_challenge(const std::string &day, int32_t difficulty,
+                                                      const std::string &items) override;
+    bool save_daily_challenge_result(const std::string &day, uint32_t user_id, int32_t difficulty,
+                                     uint32_t score, float success_rate) override;
+    std::optional<DailyChallengeScore> get_daily_challenge_score(const std::string &day, uint32_t user_id) const override;
+    LeaderboardRows get_daily_leaderboard(const std::string &day, int32_t difficulty, uint32_t limit) const override;
+
+    // id пользователя в строках переводится в глобальный
+    std::size_t export_progress(const std::function<void(std::string_view)> &on_row) const override;
+
+private:
+    // шард записи; nullptr (и текст в error), если id указывает за пределы [shards]
+    PostgresStorage *route(int64_t id) const;
+    // чтение: то же, но с исключением
+    PostgresStorage &route_read(int64_t id) const;
+    // запрос ко всем шардам параллельно; результаты в порядке шардов
+    template <typename Query>
+    auto scatter(Query &&query) const -> std::vector<decltype(query(std::declval<PostgresStorage &>()))>;
+    static LeaderboardRows merge_top(std::vector<LeaderboardRows> parts, uint32_t limit);
+    bool move_user(std::size_t from, std::size_t to, int64_t local, const std::string &username);
+
+    std::vector<std::unique_ptr<PostgresStorage>> shards;
+    mutable std::size_t last_shard{0};
+    mutable std::string error; // ошибка маршрутизации; иначе last_error() последнего шарда
+};
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "../include/StorageBackend.hpp"
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <optional>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+
+// топ рейтингов в общей памяти для процессов на одной машине (shm_open + mmap,
+// на Windows - именованный file mapping). Запись под seqlock: читатели не берут блокировок
+// и повторяют чтение, если писатель успел изменить данные. Обновляет сегмент один процесс,
+// получивший аренду; остальные читают его вместо запроса к БД.
+class SharedLeaderboard
+{
+public:
+    static constexpr std::size_t TOP_N = 10;
+    static constexpr std::size_t NAME_BYTES = 52; // users.username VARCHAR(50) + '\0'
+
+    enum class Board : uint8_t
+    {
+        DAY,
+        WEEK,
+        MONTH,
+        ALL_TIME,
+        // ежедневное задание, по рейтингу на уровень в порядке TaskGenerator::Difficulty
+        DAILY_EASY,
+        DAILY_MEDIUM,
+        DAILY_HARD
+    };
+    static constexpr std::size_t BOARD_COUNT = 7;
+
+    using Snapshot = std::array<LeaderboardRows, BOARD_COUNT>;
+
+    // name - имя сегмента ("/mem_trainer_leaderboard"); max_age - срок свежести и аренды
+    SharedLeaderboard(const std::string &name, std::chrono::seconds max_age);
+    ~SharedLeaderboard();
+
+    SharedLeaderboard(const SharedLeaderboard &) = delete;
+    SharedLeaderboard &operator=(const SharedLeaderboard &) = delete;
+
+    bool is_open() const noexcept { return segment != nullptr; }
+
+    // nullopt - сегмент пуст, данные за другой день, устарели (если не allow_stale)
+    // или писатель не закончил запись
+    std::optional<LeaderboardRows> read(Board board, int64_t day, bool allow_stale = false) const;
+    // true - аренда у этого процесса и он должен вызвать publish
+    bool try_acquire_refresh();
+    // false - сегмент сейчас пишет другой процесс
+    bool publish(int64_t day, const Snapshot &boards);
+
+private:
+    struct Entry
+    {
+        char username[NAME_BYTES];
+        uint32_t reserved;
+        uint64_t score;
+    };
+
+    struct BoardSlot
+    {
+        uint32_t count;
+        uint32_t reserved;
+        Entry entries[TOP_N];
+    };
+
+    // нулевой сегмент - корректное пустое состояние
+    struct Segment
+    {
+        std::atomic<uint32_t> layout;
+        std::atomic<uint32_t> sequence; // нечётный - идёт запись
+        std::atomic<uint64_t> lease;    // (срок аренды, unix-секунды << 32) | pid
+        int64_t day;                    // дни с 1970-01-01, UTC
+        int64_t refreshed_at_ms;        // unix time
+        BoardSlot boards[BOARD_COUNT];
+    };
+
+    static_assert(std::atomic<uint32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+                  "seqlock in shared memory needs address-free atomics");
+
+    Segment *segment{nullptr};
+    std::chrono::seconds max_age;
+#ifdef _WIN32
+    void *mapping_handle{nullptr};
+#endif
+};
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+// пароль из users.password: хэш scrypt (AuthService) или старая запись в открытом виде
+struct UserCredential
+{
+    int32_t user_id;
+    std::string password;
+};
+
+struct UserProgress
+{
+    int32_t sequence_length;
+    float success_rate;
+    std::string training_date;
+};
+
+enum class ProgressBucket
+{
+    DAY,
+    WEEK // с понедельника, как date_trunc('week')
+};
+
+// тренировки пользователя за один день или неделю
+struct ProgressPoint
+{
+    int64_t bucket_start; // unix time, секунды; дата без часового пояса, как в user_progress
+    uint32_t rounds;
+    float success_rate; // среднее за бакет
+    float sequence_length;
+};
+
+// состояние планировщика интервальных повторений (SM-2)
+struct UserSchedule
+{
+    uint32_t user_id;
+    float ease_factor;
+    uint32_t repetitions;
+    int64_t interval_seconds;
+    uint32_t next_length;
+    int64_t due_at; // unix time, секунды
+};
+
+// верность одной позиции раунда; строка user_progress_items
+struct ProgressItem
+{
+    int64_t progress_id; // ShardedStorage добавляет к id строки номер шарда
+    uint16_t position;
+    uint8_t kind; // TaskGenerator::ItemKind
+    bool correct;
+};
+
+// итог проверки одной экзаменационной строки; sequence_id указывает в буфер файла ответов
+struct ExamResult
+{
+    uint32_t user_id;
+    std::string_view sequence_id;
+    uint32_t correct;
+    uint32_t total;
+    float credit; // с учётом частичного зачёта; success_rate = credit / total
+};
+
+// сыгранное ежедневное задание: уровень - тот, на котором играли, а не текущий
+struct DailyChallengeScore
+{
+    int32_t difficulty;
+    uint32_t score;
+};
+
+enum class LeaderboardPeriod
+{
+    DAY,
+    WEEK,
+    MONTH,
+    ALL_TIME
+};
+
+using LeaderboardRows = std::vector<std::pair<std::string, std::string>>; // username, score
+
+// хранилище пользователей, прогресса, очков и рейтингов. Соглашения об ошибках общие для всех
+// реализаций: чтение бросает std::runtime_error, запись возвращает false/nullopt, текст - в last_error()
+class StorageBackend
+{
+public:
+    virtual ~StorageBackend() = default;
+
+    virtual bool connect() = 0;
+    virtual bool is_connected() const = 0;
+    virtual std::string last_error() const = 0;
+
+    // nullopt, если пользователя нет (или имя неоднозначно); пароль проверяет AuthService
+    virtual std::optional<UserCredential> get_user_credential(const std::string &username) const = 0;
+    // password - уже хэшированная строка
+    virtual bool register_user(const std::string &username, const std::string &password) = 0;
+    virtual bool update_password(uint32_t user_id, const std::string &password) = 0;
+    // id новой записи прогресса
+    virtual std::optional<int64_t> save_progress(uint32_t user_id, int32_t difficulty, uint32_t sequence_length,
+                                                 float success_rate, uint32_t memorization_ms, uint32_t answer_ms) = 0;
+    // записанные строки удаляются из items; false - часть строк осталась для повтора.
+    // Одна база пишет пачку целиком или не пишет, шарды - каждый свою часть
+    virtual bool save_progress_items(std::vector<ProgressItem> &items) = 0;
+    virtual bool save_exam_results(const std::vector<ExamResult> &results) = 0;
+    virtual bool update_difficulty(uint32_t user_id, uint32_t new_level) = 0;
+    // total_score и дневной бакет периодических рейтингов; может лишь записать событие,
+    // которое compact_scores позже перенесёт в итоги (рейтинги видят его сразу)
+    virtual bool update_score(uint32_t user_id, uint32_t score_delta) = 0;
+    // перенос до max_events накопленных событий очков в итоги; число перенесённых или nullopt
+    virtual std::optional<std::size_t> compact_scores(uint32_t max_events) = 0;
+    // от новых к старым
+    virtual std::vector<UserProgress> get_user_progress(uint32_t user_id) const = 0;
+    // последние max_buckets непустых бакетов, от старых к новым: объём ответа не зависит от длины истории
+    virtual std::vector<ProgressPoint> get_progress_buckets(uint32_t user_id, ProgressBucket bucket,
+                                                            uint32_t max_buckets) const = 0;
+    virtual int32_t get_user_difficulty(uint32_t user_id) const = 0;
+    // id из user_ids, для которых нет строки users; проверка пачки перед массовой записью
+    virtual std::vector<uint32_t> get_unknown_users(const std::vector<uint32_t> &user_ids) const = 0;
+    virtual std::optional<UserSchedule> get_user_schedule(uint32_t user_id) const = 0;
+    virtual bool save_user_schedule(const UserSchedule &schedule) = 0;
+    // due_at в [due_from, due_before) по возрастанию, unix-секунды
+    virtual std::vector<UserSchedule> get_due_schedules(int64_t due_from, int64_t due_before,
+                                                        uint32_t limit) const = 0;
+    // сериализованный WeakItemSketch; nullopt, если промахи ещё не сохранялись
+    virtual std::optional<std::string> get_weak_items(uint32_t user_id) const = 0;
+    virtual bool save_weak_items(uint32_t user_id, const std::string &sketch) = 0;
+    // марафон - отдельная таблица: длины до тысяч элементов исказили бы историю тренировок,
+    // графики прогресса и аналитику по user_progress
+    virtual bool save_marathon_result(uint32_t user_id, uint32_t length, uint32_t score, float success_rate,
+                                      uint32_t memorization_ms, uint32_t answer_ms) = 0;
+    virtual LeaderboardRows get_leaderboard(LeaderboardPeriod period, uint32_t limit,
+                                            const std::string &anchor_date) const = 0;
+
+    virtual std::optional<std::string> get_daily_challenge(const std::string &day, int32_t difficulty) const = 0;
+    virtual std::optional<std::string> create_daily_challenge(const std::string &day, int32_t difficulty,
+                                                              const std::string &items) = 0;
+    virtual bool save_daily_challenge_result(const std::string &day, uint32_t user_id, int32_t difficulty,
+                                             uint32_t score, float success_rate) = 0;
+    virtual std::optional<DailyChallengeScore> get_daily_challenge_score(const std::string &day, uint32_t user_id) const = 0;
+    // свой рейтинг на каждый уровень: у уровней разные последовательности и множитель очков
+    virtual LeaderboardRows get_daily_leaderboard(const std::string &day, int32_t difficulty,
+                                                  uint32_t limit) const = 0;
+
+    // строки "user_id\tunix time\tдлина\tуспех\tсложность" в формате COPY TO STDOUT;
+    // сложность \N - раунд записан до появления столбца
+    virtual std::size_t export_progress(const std::function<void(std::string_view)> &on_row) const = 0;
+};
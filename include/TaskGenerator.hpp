@@ -1,11 +1,21 @@
 #pragma once
 
+#include "../include/Generator.hpp"
+
 #include <vector>
 #include <string>
+#include <string_view>
 #include <variant>
+#include <array>
+#include <span>
+#include <memory>
+#include <memory_resource>
 #include <cstdint>
 #include <cstddef>
 
+class TaskBatch;
+class WeakItemBias;
+
 class TaskGenerator
 {
 public:
@@ -16,27 +26,114 @@ public:
         HARD
     };
 
+    enum class ItemKind : uint8_t
+    {
+        UINT16,
+        UINT32,
+        FLOAT,
+        SYMBOL,
+        WORD
+    };
+
+    static constexpr std::size_t ITEM_KIND_COUNT = 5;
+    static constexpr std::size_t MAX_LAYOUTS = 4;
+
+    // раскладка последовательности: вес выбора и распределение типов элементов внутри неё
+    struct SequenceLayout
+    {
+        double weight;
+        std::array<double, ITEM_KIND_COUNT> item_weights; // по ItemKind
+    };
+
+    struct DifficultyProfile
+    {
+        std::size_t min_length;
+        std::size_t max_length;
+        std::array<SequenceLayout, MAX_LAYOUTS> layouts; // неиспользуемые - с нулевым весом
+    };
+
     struct DifficultyParams
     {
         std::size_t min_length;
         std::size_t max_length;
-        float float_probability;
-        bool mixed_types;
     };
 
+    // полное распределение типов для каждого уровня; новый уровень - новая запись (и значение Difficulty)
+    static constexpr std::array<DifficultyProfile, 3> PROFILES = {{
+        // EASY: половина последовательностей смешанные, остальные однотипные
+        {3, 4, {{{0.50, {0.4 / 3, 0.4 / 3, 0.4 / 3, 0.3, 0.3}},
+                 {0.10, {1.0, 1.0, 1.0, 0.0, 0.0}},
+                 {0.24, {0.0, 0.0, 0.0, 1.0, 0.0}},
+                 {0.16, {0.0, 0.0, 0.0, 0.0, 1.0}}}}},
+        // MEDIUM: числа или слова
+        {5, 6, {{{0.3, {1.0, 1.0, 1.0, 0.0, 0.0}},
+                 {0.7, {0.0, 0.0, 0.0, 0.0, 1.0}}}}},
+        // HARD
+        {6, 8, {{{0.3, {1.0, 1.0, 1.0, 0.0, 0.0}},
+                 {0.7, {0.0, 0.0, 0.0, 0.0, 1.0}}}}},
+    }};
+    static constexpr std::size_t DIFFICULTY_COUNT = PROFILES.size();
+
     using TaskItem = std::variant<uint16_t, uint32_t, float, char, std::string>;
+    // лёгкий вариант элемента: слова указывают в статический словарь WordGenerator
+    using TaskItemView = std::variant<uint16_t, uint32_t, float, char, std::string_view>;
+
+    enum class BatchMode
+    {
+        SEQUENTIAL,
+        PARALLEL
+    };
 
     TaskGenerator(Difficulty initial_difficulty = Difficulty::MEDIUM);
 
     void set_difficulty(Difficulty new_difficulty);
+    // чаще выбирать слова и символы, на которых пользователь ошибался (nullptr - равномерно).
+    // Действует на обычные последовательности, пакеты и поток; seed-вариант не меняется
+    void set_weak_items(std::shared_ptr<const WeakItemBias> bias);
 
     std::vector<TaskItem> generate_sequence(std::size_t length);
+    // вариант без владения словами: вектор целиком живёт в переданном ресурсе
+    std::pmr::vector<TaskItemView> generate_sequence(std::size_t length, std::pmr::memory_resource *resource) const;
+    // детерминированная последовательность: одинаковый seed - одинаковый результат
+    std::vector<TaskItem> generate_sequence(std::size_t length, uint64_t seed) const;
+    // бесконечный ленивый поток элементов (марафон): раскладка выбирается один раз, как для
+    // обычной последовательности, каждый next() - одна выборка, без ограничения max_length
+    Generator<TaskItemView> stream() const;
+    // count последовательностей одной длины в одной арене; PARALLEL делит их между ядрами
+    TaskBatch generate_batch(std::size_t count, std::size_t length, BatchMode mode = BatchMode::SEQUENTIAL) const;
     static DifficultyParams get_params_for_difficulty(Difficulty level) noexcept;
+    static TaskItem to_item(const TaskItemView &view);
+    // вид на элемент; слова указывают в строку item
+    static TaskItemView to_view(const TaskItem &item) noexcept;
 
 private:
     Difficulty current_difficulty;
+    std::shared_ptr<const WeakItemBias> weak_items;
+};
+
+// пакет последовательностей в monotonic_buffer_resource; память освобождается целиком
+class TaskBatch
+{
+public:
+    TaskBatch(std::size_t count, std::size_t length);
+
+    TaskBatch(TaskBatch &&) noexcept = default;
+    TaskBatch &operator=(TaskBatch &&) noexcept = default;
+
+    std::size_t size() const noexcept { return count; }
+    std::size_t sequence_length() const noexcept { return length; }
+    std::span<const TaskGenerator::TaskItemView> operator[](std::size_t index) const noexcept
+    {
+        return {items + index * length, length};
+    }
+
+    void release() noexcept;
+
+private:
+    friend class TaskGenerator;
 
-    std::vector<TaskItem> generate_number_sequence(std::size_t length) const;
-    std::vector<TaskItem> generate_symbol_sequence(std::size_t length) const;
-    std::vector<TaskItem> generate_word_sequence(std::size_t length) const;
+    std::unique_ptr<std::pmr::monotonic_buffer_resource> arena;
+    TaskGenerator::TaskItemView *items{nullptr};
+    std::size_t count{0};
+    std::size_t length{0};
 };
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// временная шкала сессии в формате Chrome trace (JSON, события "X"): файл открывается в Perfetto
+// (ui.perfetto.dev) или chrome://tracing. У каждого потока своё кольцо на events_per_thread спанов,
+// при переполнении затираются самые старые; кольцо завершившегося потока переходит к следующему
+// новому потоку, так что колец не больше, чем потоков, живших одновременно. Пока трассировка выключена, спан стоит одну
+// relaxed-загрузку флага и ничего не пишет
+class Tracer
+{
+public:
+    static constexpr std::size_t DEFAULT_EVENTS_PER_THREAD = 16384;
+
+    static Tracer &instance();
+
+    static bool enabled() noexcept { return active.load(std::memory_order_relaxed); }
+
+    // file - куда stop() запишет трассу; повторный вызов при включённой трассировке ничего не меняет
+    void start(const std::string &file, std::size_t events_per_thread = DEFAULT_EVENTS_PER_THREAD);
+    // выключает запись и сохраняет трассу (временный файл и rename); false, если файл не записан
+    bool stop();
+
+    // name и category хранятся указателями: только строки со статическим временем жизни
+    void record(const char *name, const char *category, std::chrono::steady_clock::time_point begin,
+                std::chrono::steady_clock::time_point end) noexcept;
+    // подпись текущего потока в просмотрщике (строка со статическим временем жизни)
+    void name_thread(const char *name);
+    // дорожка для спанов текущего потока (0 - сам поток). Просмотрщик требует, чтобы спаны одной
+    // дорожки были вложены друг в друга, поэтому параллельные операции одного потока
+    // (соединения PgEventLoop) пишутся на разные дорожки
+    static void set_lane(uint16_t lane) noexcept;
+
+    std::string render_json() const;
+
+private:
+    Tracer() = default;
+
+    inline static std::atomic<bool> active{false};
+};
+
+// спан от конструктора до деструктора, по образцу ScopedLatency
+class TraceSpan
+{
+public:
+    explicit TraceSpan(const char *name, const char *category = "app") noexcept
+        : name(Tracer::enabled() ? name : nullptr), category(category)
+    {
+        if (this->name)
+        {
+            started = std::chrono::steady_clock::now();
+        }
+    }
+    ~TraceSpan()
+    {
+        if (name)
+        {
+            Tracer::instance().record(name, category, started, std::chrono::steady_clock::now());
+        }
+    }
+
+    TraceSpan(const TraceSpan &) = delete;
+    TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+    const char *name;
+    const char *category;
+    std::chrono::steady_clock::time_point started{};
+};
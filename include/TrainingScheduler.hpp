@@ -0,0 +1,43 @@
+#pragma once
+
+#include "../include/DatabaseSync.hpp"
+#include "../include/TaskGenerator.hpp"
+
+#include <vector>
+#include <optional>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+class TrainingScheduler
+{
+public:
+    static UserSchedule initial_schedule(uint32_t user_id, std::size_t length, int64_t now) noexcept;
+    // SM-2: пересчёт интервала и длины следующей тренировки по результату раунда;
+    // до due_at пересчитывается только длина
+    static UserSchedule review(const UserSchedule &schedule, float success_rate,
+                               TaskGenerator::Difficulty difficulty, int64_t now) noexcept;
+
+    static constexpr uint32_t DEFAULT_DUE_LIMIT = 10000;
+    static constexpr int64_t DEFAULT_REFRESH_SECONDS = 60;
+
+    // due-list: min-heap по due_at, все операции O(log n)
+    void schedule(const UserSchedule &entry);
+    bool remove(uint32_t user_id);
+    std::optional<UserSchedule> pop_due(int64_t now);
+    std::vector<UserSchedule> pop_all_due(int64_t now, std::size_t limit);
+    std::optional<int64_t> next_due_at() const noexcept;
+    std::size_t size() const noexcept;
+
+    // mem_trainer --due-list [--limit=<n>] [--watch] [--refresh=<seconds>]
+    static int run_cli(int argc, char **argv);
+
+private:
+    std::vector<UserSchedule> heap;
+    std::unordered_map<uint32_t, std::size_t> positions; // user_id -> индекс в heap
+
+    void sift_up(std::size_t index);
+    void sift_down(std::size_t index);
+    void swap_nodes(std::size_t a, std::size_t b);
+    UserSchedule extract(std::size_t index);
+};
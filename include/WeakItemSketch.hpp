@@ -0,0 +1,74 @@
+#pragma once
+
+#include "../include/TaskGenerator.hpp"
+#include "../include/RandomGenerators.hpp"
+#include "../include/WeightedSampling.hpp"
+
+#include <array>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+// промахи пользователя по конкретным словам и символам в count-min sketch фиксированного размера
+// (DEPTH строк по WIDTH счётчиков uint8_t), сколько бы разных элементов ни встречалось.
+// Оценка - минимум по строкам: может быть завышена коллизиями, но не занижена.
+// Обновление консервативное: растут лишь счётчики, равные текущей оценке. Каждые DECAY_MISSES
+// промахов все счётчики делятся пополам, поэтому давние ошибки постепенно забываются.
+// Числа не учитываются: их значения случайны и почти не повторяются
+class WeakItemSketch
+{
+public:
+    static constexpr std::size_t DEPTH = 4;
+    static constexpr std::size_t WIDTH = 256;
+    static constexpr uint32_t DECAY_MISSES = 256;
+    // версия, 3 байта резерва, промахи с последнего деления (uint32 LE), счётчики по строкам
+    static constexpr std::size_t SERIALIZED_BYTES = 8 + DEPTH * WIDTH;
+
+    // промахи раунда: элементы sequence с item_correct == 0
+    void record_round(std::span<const TaskGenerator::TaskItemView> sequence,
+                      std::span<const uint8_t> item_correct) noexcept;
+    void record_miss(const TaskGenerator::TaskItemView &item) noexcept;
+
+    uint32_t misses(std::string_view word) const noexcept;
+    uint32_t misses(char symbol) const noexcept;
+    bool empty() const noexcept;
+
+    std::string serialize() const;
+    // nullopt при неизвестной версии или неверной длине
+    static std::optional<WeakItemSketch> deserialize(std::string_view bytes);
+
+private:
+    void add(uint64_t hash) noexcept;
+    uint32_t estimate(uint64_t hash) const noexcept;
+    void decay() noexcept;
+
+    std::array<std::array<uint8_t, WIDTH>, DEPTH> counters{};
+    uint32_t since_decay{0};
+};
+
+// выбор слов и символов с весом 1 + WEAK_WEIGHT * min(промахи, WEAK_CAP). Таблицы строятся
+// из sketch один раз (после раунда), дальше каждый выбор - O(1), как у типов элементов
+class WeakItemBias
+{
+public:
+    static constexpr double WEAK_WEIGHT = 2.0;
+    static constexpr uint32_t WEAK_CAP = 8;
+
+    explicit WeakItemBias(const WeakItemSketch &sketch);
+
+    std::string_view word(uint64_t random) const noexcept
+    {
+        return WordGenerator::word_at(WeightedSampling::sample(words, random));
+    }
+    char symbol(uint64_t random) const noexcept
+    {
+        return SymbolGenerator::symbol_at(WeightedSampling::sample(symbols, random));
+    }
+
+private:
+    WeightedSampling::AliasTable<WordGenerator::WORD_COUNT> words;
+    WeightedSampling::AliasTable<SymbolGenerator::SYMBOL_COUNT> symbols;
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+// выборка из дискретного распределения за O(1): таблица строится один раз (в том числе constexpr)
+namespace WeightedSampling
+{
+    // таблица Уокера/Воуза: колонка остаётся с вероятностью threshold / 2^32, иначе берётся alias
+    template <std::size_t N>
+    struct AliasTable
+    {
+        static_assert(N <= 256, "alias index is stored in uint8_t");
+
+        std::array<uint64_t, N> threshold{};
+        std::array<uint8_t, N> alias{};
+    };
+
+    constexpr uint64_t ALWAYS_KEEP = uint64_t{1} << 32;
+
+    constexpr uint64_t to_threshold(double probability)
+    {
+        const double scaled = probability * static_cast<double>(ALWAYS_KEEP);
+        return scaled >= static_cast<double>(ALWAYS_KEEP) ? ALWAYS_KEEP : static_cast<uint64_t>(scaled);
+    }
+
+    template <std::size_t N>
+    constexpr AliasTable<N> build_alias_table(const std::array<double, N> &weights)
+    {
+        double total{0.0};
+        for (const double weight : weights)
+        {
+            total += weight;
+        }
+
+        std::array<double, N> scaled{};
+        std::array<std::size_t, N> small{};
+        std::array<std::size_t, N> large{};
+        std::size_t small_count{0};
+        std::size_t large_count{0};
+
+        for (std::size_t i{0}; i < N; ++i)
+        {
+            // пустое распределение (неиспользуемая раскладка) превращается в равномерное
+            scaled[i] = total > 0.0 ? weights[i] * N / total : 1.0;
+            if (scaled[i] < 1.0)
+                small[small_count++] = i;
+            else
+                large[large_count++] = i;
+        }
+
+        AliasTable<N> table{};
+        while (small_count > 0 && large_count > 0)
+        {
+            const std::size_t less = small[--small_count];
+            const std::size_t more = large[--large_count];
+
+            table.threshold[less] = to_threshold(scaled[less]);
+            table.alias[less] = static_cast<uint8_t>(more);
+
+            scaled[more] = (scaled[more] + scaled[less]) - 1.0;
+            if (scaled[more] < 1.0)
+                small[small_count++] = more;
+            else
+                large[large_count++] = more;
+        }
+
+        // остатки из-за погрешности округления забирают колонку целиком
+        while (large_count > 0)
+        {
+            const std::size_t index = large[--large_count];
+            table.threshold[index] = ALWAYS_KEEP;
+            table.alias[index] = static_cast<uint8_t>(index);
+        }
+        while (small_count > 0)
+        {
+            const std::size_t index = small[--small_count];
+            table.threshold[index] = ALWAYS_KEEP;
+            table.alias[index] = static_cast<uint8_t>(index);
+        }
+        return table;
+    }
+
+    // старшие 32 бита выбирают колонку, младшие - монетку; без ветвлений по данным
+    template <std::size_t N>
+    constexpr std::size_t sample(const AliasTable<N> &table, uint64_t random) noexcept
+    {
+        const std::size_t column = static_cast<std::size_t>(((random >> 32) * N) >> 32);
+        const bool keep = (random & 0xFFFFFFFFu) < table.threshold[column];
+        return keep ? column : table.alias[column];
+    }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+// пул с очередью на каждого исполнителя: свои задачи берутся с конца очереди,
+// освободившийся поток забирает чужие с начала. Вызывающий run() поток - исполнитель 0.
+class WorkStealingPool
+{
+public:
+    using Task = std::function<void(std::size_t index, unsigned worker)>;
+
+    // threads = 0 - по числу ядер
+    explicit WorkStealingPool(unsigned threads = 0);
+    ~WorkStealingPool();
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    unsigned size() const noexcept { return static_cast<unsigned>(queues.size()); }
+
+    // task(index, worker) для каждого index из [0, count); возвращается после последней задачи.
+    // Задачи сначала делятся между очередями непрерывными диапазонами. task не должна бросать исключений.
+    void run(std::size_t count, const Task &task);
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::size_t> tasks;
+    };
+
+    void worker_loop(unsigned worker);
+    void drain(unsigned worker);
+    bool pop_local(unsigned worker, std::size_t &index);
+    bool steal(unsigned thief, std::size_t &index);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex state_mutex;
+    std::condition_variable wakeup;
+    std::condition_variable finished;
+    const Task *current{nullptr};
+    uint64_t generation{0};
+    unsigned busy{0};
+    bool stopping{false};
+    std::atomic<std::size_t> remaining{0};
+};
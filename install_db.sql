@@ -15,6 +15,9 @@ CREATE TABLE user_progress (
     sequence_length INTEGER NOT NULL,
     success_rate DOUBLE PRECISION NOT NULL,
     training_date TIMESTAMP WITHOUT TIME ZONE NOT NULL DEFAULT CURRENT_TIMESTAMP,
+    memorization_ms INTEGER,
+    answer_ms INTEGER,
+    difficulty INTEGER,
     
     -- Foreign key relationship with users table
     CONSTRAINT fk_user
@@ -23,11 +26,145 @@ CREATE TABLE user_progress (
         ON DELETE CASCADE
 );
 
+-- Create user_progress_items table (per-position correctness of a round)
+CREATE TABLE user_progress_items (
+    progress_id INTEGER NOT NULL,
+    position SMALLINT NOT NULL,
+    kind SMALLINT NOT NULL,
+    correct BOOLEAN NOT NULL,
+
+    PRIMARY KEY (progress_id, position),
+
+    CONSTRAINT fk_progress
+        FOREIGN KEY(progress_id)
+        REFERENCES user_progress(id)
+        ON DELETE CASCADE
+);
+
+CREATE TABLE exam_results (
+    id SERIAL PRIMARY KEY,
+    user_id INTEGER NOT NULL,
+    sequence_id VARCHAR(64) NOT NULL,
+    correct INTEGER NOT NULL,
+    total INTEGER NOT NULL,
+    success_rate FLOAT NOT NULL CHECK (success_rate BETWEEN 0 AND 1),
+    graded_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
+
+    CONSTRAINT fk_user
+        FOREIGN KEY(user_id)
+        REFERENCES users(id)
+        ON DELETE CASCADE
+);
+
+-- Create user_score_daily table (per-user score rollup by day)
+CREATE TABLE user_score_daily (
+    user_id INTEGER NOT NULL,
+    day DATE NOT NULL DEFAULT CURRENT_DATE,
+    score INTEGER NOT NULL DEFAULT 0,
+
+    PRIMARY KEY (user_id, day),
+
+    CONSTRAINT fk_user
+        FOREIGN KEY(user_id)
+        REFERENCES users(id)
+        ON DELETE CASCADE
+);
+
+-- Create score_events table (append-only score deltas, folded by compaction)
+CREATE TABLE score_events (
+    id BIGSERIAL PRIMARY KEY,
+    user_id INTEGER NOT NULL,
+    day DATE NOT NULL DEFAULT CURRENT_DATE,
+    delta INTEGER NOT NULL,
+
+    CONSTRAINT fk_user
+        FOREIGN KEY(user_id)
+        REFERENCES users(id)
+        ON DELETE CASCADE
+);
+
+-- Create user_schedule table (spaced-repetition state, one row per user)
+CREATE TABLE user_schedule (
+    user_id INTEGER PRIMARY KEY,
+    ease_factor REAL NOT NULL DEFAULT 2.5,
+    repetitions INTEGER NOT NULL DEFAULT 0,
+    interval_seconds BIGINT NOT NULL DEFAULT 0,
+    next_length INTEGER NOT NULL,
+    due_at TIMESTAMP WITHOUT TIME ZONE NOT NULL,
+
+    CONSTRAINT fk_user
+        FOREIGN KEY(user_id)
+        REFERENCES users(id)
+        ON DELETE CASCADE
+);
+
+-- Create daily_challenges table (one shared sequence per day and difficulty)
+CREATE TABLE daily_challenges (
+    day DATE NOT NULL,
+    difficulty INTEGER NOT NULL,
+    items TEXT NOT NULL,
+    created_at TIMESTAMP WITHOUT TIME ZONE NOT NULL DEFAULT CURRENT_TIMESTAMP,
+
+    PRIMARY KEY (day, difficulty)
+);
+
+-- Create daily_challenge_results table (one attempt per user per day)
+CREATE TABLE daily_challenge_results (
+    day DATE NOT NULL,
+    user_id INTEGER NOT NULL,
+    difficulty INTEGER NOT NULL,
+    score INTEGER NOT NULL,
+    success_rate DOUBLE PRECISION NOT NULL,
+    completed_at TIMESTAMP WITHOUT TIME ZONE NOT NULL DEFAULT CURRENT_TIMESTAMP,
+
+    PRIMARY KEY (day, user_id),
+
+    CONSTRAINT fk_user
+        FOREIGN KEY(user_id)
+        REFERENCES users(id)
+        ON DELETE CASCADE
+);
+
+-- Create user_weak_items table (count-min sketch of missed words and symbols, one row per user)
+CREATE TABLE user_weak_items (
+    user_id INTEGER PRIMARY KEY,
+    sketch BYTEA NOT NULL,
+    updated_at TIMESTAMP WITHOUT TIME ZONE NOT NULL DEFAULT CURRENT_TIMESTAMP,
+
+    CONSTRAINT fk_user
+        FOREIGN KEY(user_id)
+        REFERENCES users(id)
+        ON DELETE CASCADE
+);
+
+-- Create marathon_results table (marathon runs, kept out of user_progress)
+CREATE TABLE marathon_results (
+    id SERIAL PRIMARY KEY,
+    user_id INTEGER NOT NULL,
+    length INTEGER NOT NULL,
+    score INTEGER NOT NULL,
+    success_rate DOUBLE PRECISION NOT NULL,
+    memorization_ms INTEGER,
+    answer_ms INTEGER,
+    played_at TIMESTAMP WITHOUT TIME ZONE NOT NULL DEFAULT CURRENT_TIMESTAMP,
+
+    CONSTRAINT fk_user
+        FOREIGN KEY(user_id)
+        REFERENCES users(id)
+        ON DELETE CASCADE
+);
+
 -- Create indexes for query optimization
 CREATE INDEX idx_user_progress_user_id ON user_progress(user_id);
 CREATE INDEX idx_user_progress_training_date ON user_progress(training_date);
 CREATE INDEX idx_users_username ON users(username);
 CREATE INDEX idx_users_total_score ON users(total_score DESC);
+CREATE INDEX idx_user_schedule_due_at ON user_schedule(due_at);
+CREATE INDEX idx_user_score_daily_day ON user_score_daily(day) INCLUDE (user_id, score);
+CREATE INDEX idx_score_events_day ON score_events(day) INCLUDE (user_id, delta);
+CREATE INDEX idx_daily_challenge_results_day_score ON daily_challenge_results(day, difficulty, score DESC);
+CREATE INDEX idx_exam_results_sequence ON exam_results(sequence_id);
+CREATE INDEX idx_marathon_results_user_id ON marathon_results(user_id);
 
 -- Table and column comments
 COMMENT ON TABLE users IS 'System users table';
@@ -36,3 +173,30 @@ COMMENT ON COLUMN users.total_score IS 'User''s total score';
 
 COMMENT ON TABLE user_progress IS 'User training history';
 COMMENT ON COLUMN user_progress.success_rate IS 'Success completion percentage (0.0-1.0)';
+COMMENT ON COLUMN user_progress.memorization_ms IS 'Time the sequence was on screen (steady clock)';
+COMMENT ON COLUMN user_progress.answer_ms IS 'Time from the answer prompt to submit (steady clock)';
+COMMENT ON COLUMN user_progress.difficulty IS 'Difficulty the round was played at: 0=EASY, 1=MEDIUM, 2=HARD; NULL for older rounds';
+
+COMMENT ON TABLE user_progress_items IS 'Per-position correctness of each round, written with COPY';
+COMMENT ON COLUMN user_progress_items.kind IS 'Item type: 0=uint16, 1=uint32, 2=float, 3=symbol, 4=word';
+
+COMMENT ON TABLE user_score_daily IS 'Per-user score buckets by day for period leaderboards';
+COMMENT ON COLUMN user_score_daily.score IS 'Points earned by the user on that day';
+
+COMMENT ON TABLE score_events IS 'Score deltas not yet folded into users.total_score and user_score_daily';
+COMMENT ON COLUMN score_events.day IS 'Day bucket the delta belongs to in user_score_daily';
+
+COMMENT ON TABLE user_schedule IS 'Spaced-repetition (SM-2) training schedule per user';
+COMMENT ON COLUMN user_schedule.due_at IS 'When the user should train next (UTC)';
+COMMENT ON COLUMN user_schedule.next_length IS 'Sequence length for the next training';
+
+COMMENT ON TABLE daily_challenges IS 'Daily challenge sequence shared by all users (seeded by date)';
+COMMENT ON COLUMN daily_challenges.items IS 'Space-separated typed items, e.g. u16:812 f:3.25 c:K w:apple';
+
+COMMENT ON TABLE daily_challenge_results IS 'Daily challenge scores for the daily leaderboard';
+
+COMMENT ON TABLE exam_results IS 'Bulk-graded exam answers (mem_trainer --grade-exam), written with COPY';
+COMMENT ON COLUMN exam_results.sequence_id IS 'Sequence id from the exam sequences file';
+
+COMMENT ON TABLE user_weak_items IS 'Per-user misses on words and symbols; training picks them more often';
+COMMENT ON COLUMN user_weak_items.sketch IS 'Serialized WeakItemSketch: version byte, 3 reserved bytes, u32 misses since last decay, 4x256 u8 counters';
@@ -1,7 +1,30 @@
 #include "include/MainLoop.hpp"
+#include "include/ExamGrader.hpp"
+#include "include/ScoreCompactor.hpp"
+#include "include/ShardedStorage.hpp"
+#include "include/TrainingScheduler.hpp"
+
+#include <string_view>
 
 int main(int argc, char** argv){
+    if (argc > 1 && std::string_view(argv[1]) == "--grade-exam")
+    {
+        return ExamGrader::run_cli(argc, argv);
+    }
+    if (argc > 1 && std::string_view(argv[1]) == "--compact-scores")
+    {
+        return ScoreCompactor::run_cli(argc, argv);
+    }
+    if (argc > 1 && std::string_view(argv[1]) == "--rebalance-shards")
+    {
+        return ShardedStorage::run_cli(argc, argv);
+    }
+    if (argc > 1 && std::string_view(argv[1]) == "--due-list")
+    {
+        return TrainingScheduler::run_cli(argc, argv);
+    }
+
     MainLoop app;
     app.run();
     return 0;
-}
\ No newline at end of file
+}
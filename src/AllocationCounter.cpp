@@ -0,0 +1,54 @@
+#include "../include/AllocationCounter.hpp"
+
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+    thread_local uint64_t allocations{0};
+}
+
+uint64_t AllocationCounter::thread_allocations() noexcept
+{
+    return allocations;
+}
+
+#ifdef MEM_TRAINER_COUNT_ALLOCATIONS
+
+// замена глобальных operator new/delete; nothrow, sized и array-формы по умолчанию идут через них
+void *operator new(std::size_t size)
+{
+    ++allocations;
+    if (void *memory = std::malloc(size ? size : 1))
+    {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+#endif
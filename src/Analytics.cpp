@@ -0,0 +1,503 @@
+#include "../include/Analytics.hpp"
+#include "../include/DatabaseSync.hpp"
+#include "../include/SessionLog.hpp"
+#include "../include/Metrics.hpp"
+#include "../include/NumberParsing.hpp"
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <limits>
+#include <map>
+#include <numeric>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+    LatencyHistogram load_latency("mem_trainer_analytics_load_duration_seconds", "Time spent loading training history");
+    LatencyHistogram analyze_latency("mem_trainer_analytics_analyze_duration_seconds", "Time spent computing aggregates");
+
+    constexpr int64_t SECONDS_PER_WEEK = 7 * 24 * 60 * 60;
+
+    // fn(worker, begin, end) для непрерывных диапазонов; нулевой диапазон выполняет текущий поток
+    template <typename Fn>
+    void parallel_chunks(std::size_t count, unsigned workers, Fn fn)
+    {
+        const std::size_t chunk = (count + workers - 1) / workers;
+        std::vector<std::thread> threads;
+        threads.reserve(workers - 1);
+        for (unsigned worker{1}; worker < workers; ++worker)
+        {
+            const std::size_t begin = std::min(count, worker * chunk);
+            const std::size_t end = std::min(count, begin + chunk);
+            threads.emplace_back(fn, worker, begin, end);
+        }
+        fn(0u, std::size_t{0}, std::min(count, chunk));
+
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    // сортировка кусков в своих потоках, затем попарные слияния (слияния одного прохода параллельны)
+    template <typename Less>
+    void parallel_sort(std::vector<uint32_t> &order, unsigned workers, Less less)
+    {
+        const std::size_t chunk = (order.size() + workers - 1) / workers;
+        std::vector<std::size_t> bounds;
+        for (std::size_t begin{0}; begin < order.size(); begin += chunk)
+        {
+            bounds.push_back(begin);
+        }
+        const std::size_t parts = bounds.size();
+        bounds.push_back(order.size());
+
+        parallel_chunks(parts, static_cast<unsigned>(std::max<std::size_t>(parts, 1)),
+                        [&](unsigned, std::size_t first, std::size_t last)
+                        {
+                            for (std::size_t part{first}; part < last; ++part)
+                                std::sort(order.begin() + bounds[part], order.begin() + bounds[part + 1], less);
+                        });
+
+        for (std::size_t width{1}; width < parts; width *= 2)
+        {
+            std::vector<std::thread> merges;
+            for (std::size_t part{0}; part + width < parts; part += 2 * width)
+            {
+                const auto first = order.begin() + bounds[part];
+                const auto middle = order.begin() + bounds[part + width];
+                const auto last = order.begin() + bounds[std::min(part + 2 * width, parts)];
+                merges.emplace_back([first, middle, last, less]
+                                    { std::inplace_merge(first, middle, last, less); });
+            }
+            for (auto &merge : merges)
+            {
+                merge.join();
+            }
+        }
+    }
+
+    template <typename T>
+    bool parse_field(std::string_view &row, T &value) noexcept
+    {
+        const std::size_t tab = std::min(row.find('\t'), row.size());
+        const std::string_view field = row.substr(0, tab);
+        row.remove_prefix(std::min(tab + 1, row.size()));
+        return NumberParsing::parse_whole(field, value);
+    }
+
+    int64_t week_of(int64_t seconds) noexcept
+    {
+        return (seconds >= 0 ? seconds : seconds - SECONDS_PER_WEEK + 1) / SECONDS_PER_WEEK;
+    }
+
+    // начало серии строк пользователя, к которой относится позиция position
+    std::size_t run_start(const HistoryColumns &history, const std::vector<uint32_t> &order, std::size_t position)
+    {
+        const uint32_t user = history.user_id[order[position]];
+        while (position > 0 && history.user_id[order[position - 1]] == user)
+        {
+            --position;
+        }
+        return position;
+    }
+
+    std::vector<LearningCurvePoint> learning_curve(const HistoryColumns &history, const std::vector<uint32_t> &order,
+                                                   unsigned workers)
+    {
+        std::vector<std::array<double, Analytics::MAX_ATTEMPTS>> sums(workers);
+        std::vector<std::array<uint64_t, Analytics::MAX_ATTEMPTS>> counts(workers);
+
+        parallel_chunks(order.size(), workers, [&](unsigned worker, std::size_t begin, std::size_t end)
+                        {
+            auto &sum = sums[worker];
+            auto &count = counts[worker];
+            sum.fill(0.0);
+            count.fill(0);
+            if (begin == end)
+                return;
+
+            std::size_t attempt = begin - run_start(history, order, begin);
+            for (std::size_t i{begin}; i < end; ++i)
+            {
+                if (i > begin && history.user_id[order[i]] != history.user_id[order[i - 1]])
+                    attempt = 0;
+                if (attempt < Analytics::MAX_ATTEMPTS)
+                {
+                    sum[attempt] += history.success_rate[order[i]];
+                    ++count[attempt];
+                }
+                ++attempt;
+            } });
+
+        std::vector<LearningCurvePoint> curve;
+        for (uint32_t attempt{0}; attempt < Analytics::MAX_ATTEMPTS; ++attempt)
+        {
+            double sum{0.0};
+            uint64_t count{0};
+            for (unsigned worker{0}; worker < workers; ++worker)
+            {
+                sum += sums[worker][attempt];
+                count += counts[worker][attempt];
+            }
+            if (count == 0)
+            {
+                break; // у следующих номеров попыток данных тоже нет
+            }
+            curve.push_back({attempt + 1, count, sum / count});
+        }
+        return curve;
+    }
+
+    std::vector<DifficultyPercentiles> percentiles(const HistoryColumns &history, unsigned workers)
+    {
+        constexpr std::size_t LEVELS = TaskGenerator::DIFFICULTY_COUNT;
+
+        // подсчёт по уровням, затем раскладка значений в непрерывные области без блокировок
+        std::vector<std::array<std::size_t, LEVELS>> counts(workers);
+        parallel_chunks(history.size(), workers, [&](unsigned worker, std::size_t begin, std::size_t end)
+                        {
+            counts[worker].fill(0);
+            for (std::size_t i{begin}; i < end; ++i)
+                if (history.difficulty[i] < LEVELS)
+                    ++counts[worker][history.difficulty[i]]; });
+
+        std::array<std::size_t, LEVELS + 1> level_begin{};
+        std::vector<std::array<std::size_t, LEVELS>> offsets(workers);
+        for (std::size_t level{0}; level < LEVELS; ++level)
+        {
+            std::size_t position = level_begin[level];
+            for (unsigned worker{0}; worker < workers; ++worker)
+            {
+                offsets[worker][level] = position;
+                position += counts[worker][level];
+            }
+            level_begin[level + 1] = position;
+        }
+
+        std::vector<float> values(history.size());
+        parallel_chunks(history.size(), workers, [&](unsigned worker, std::size_t begin, std::size_t end)
+                        {
+            auto &offset = offsets[worker];
+            for (std::size_t i{begin}; i < end; ++i)
+                if (history.difficulty[i] < LEVELS)
+                    values[offset[history.difficulty[i]]++] = history.success_rate[i]; });
+
+        std::vector<DifficultyPercentiles> result(LEVELS);
+        parallel_chunks(LEVELS, static_cast<unsigned>(LEVELS), [&](unsigned, std::size_t begin, std::size_t end)
+                        {
+            for (std::size_t level{begin}; level < end; ++level)
+            {
+                auto &entry = result[level];
+                entry.difficulty = static_cast<TaskGenerator::Difficulty>(level);
+                const auto first = values.begin() + level_begin[level];
+                const auto last = values.begin() + level_begin[level + 1];
+                entry.sessions = static_cast<uint64_t>(last - first);
+                entry.values.fill(0.0f);
+                entry.mean_success = 0.0;
+                if (first == last)
+                    continue;
+
+                entry.mean_success = std::accumulate(first, last, 0.0) / entry.sessions;
+                // nearest-rank; каждый следующий процентиль ищется правее предыдущего
+                auto lower = first;
+                for (std::size_t p{0}; p < DifficultyPercentiles::PERCENTILES.size(); ++p)
+                {
+                    const std::size_t rank = (DifficultyPercentiles::PERCENTILES[p] * entry.sessions + 99) / 100;
+                    const auto nth = first + static_cast<std::ptrdiff_t>(std::max<std::size_t>(rank, 1) - 1);
+                    std::nth_element(lower, nth, last);
+                    entry.values[p] = *nth;
+                    lower = nth;
+                }
+            } });
+        return result;
+    }
+
+    std::vector<RetentionCohort> retention(const HistoryColumns &history, const std::vector<uint32_t> &order,
+                                           unsigned workers, std::size_t &users)
+    {
+        std::vector<std::map<int64_t, RetentionCohort>> partial(workers);
+        std::vector<std::size_t> partial_users(workers, 0);
+
+        parallel_chunks(order.size(), workers, [&](unsigned worker, std::size_t begin, std::size_t end)
+                        {
+            // серия пользователя целиком достаётся потоку, в диапазоне которого она начинается
+            if (begin > 0 && begin < end && history.user_id[order[begin]] == history.user_id[order[begin - 1]])
+            {
+                const uint32_t user = history.user_id[order[begin]];
+                while (begin < end && history.user_id[order[begin]] == user)
+                    ++begin;
+            }
+
+            auto &cohorts = partial[worker];
+            std::size_t i{begin};
+            while (i < end)
+            {
+                const uint32_t user = history.user_id[order[i]];
+                const int64_t first_week = week_of(history.started_at[order[i]]);
+                std::bitset<RetentionCohort::WEEKS> active;
+                for (; i < order.size() && history.user_id[order[i]] == user; ++i)
+                {
+                    const int64_t offset = week_of(history.started_at[order[i]]) - first_week;
+                    if (offset < static_cast<int64_t>(RetentionCohort::WEEKS))
+                        active.set(static_cast<std::size_t>(offset));
+                }
+
+                auto [entry, inserted] = cohorts.try_emplace(first_week, RetentionCohort{first_week, 0, {}});
+                ++entry->second.users;
+                for (std::size_t week{0}; week < RetentionCohort::WEEKS; ++week)
+                    entry->second.active[week] += active[week];
+                ++partial_users[worker];
+            } });
+
+        std::map<int64_t, RetentionCohort> merged;
+        users = 0;
+        for (unsigned worker{0}; worker < workers; ++worker)
+        {
+            users += partial_users[worker];
+            for (const auto &[week, cohort] : partial[worker])
+            {
+                auto [entry, inserted] = merged.try_emplace(week, RetentionCohort{week, 0, {}});
+                entry->second.users += cohort.users;
+                for (std::size_t k{0}; k < RetentionCohort::WEEKS; ++k)
+                    entry->second.active[k] += cohort.active[k];
+            }
+        }
+
+        std::vector<RetentionCohort> result;
+        result.reserve(merged.size());
+        for (const auto &[week, cohort] : merged)
+        {
+            result.push_back(cohort);
+        }
+        return result;
+    }
+
+    const char *difficulty_name(TaskGenerator::Difficulty difficulty) noexcept
+    {
+        switch (difficulty)
+        {
+        case TaskGenerator::Difficulty::EASY:
+            return "EASY";
+        case TaskGenerator::Difficulty::MEDIUM:
+            return "MEDIUM";
+        case TaskGenerator::Difficulty::HARD:
+            return "HARD";
+        }
+        return "UNKNOWN";
+    }
+}
+
+void HistoryColumns::reserve(std::size_t rows)
+{
+    user_id.reserve(rows);
+    started_at.reserve(rows);
+    difficulty.reserve(rows);
+    sequence_length.reserve(rows);
+    success_rate.reserve(rows);
+}
+
+void HistoryColumns::push_back(uint32_t user, int64_t started, uint8_t level, uint16_t length, float success)
+{
+    user_id.push_back(user);
+    started_at.push_back(started);
+    difficulty.push_back(level);
+    sequence_length.push_back(length);
+    success_rate.push_back(success);
+}
+
+HistoryColumns Analytics::load_from_database(const DatabaseSync &db_sync)
+{
+    ScopedLatency timer(load_latency);
+    HistoryColumns history;
+    std::size_t skipped{0};
+
+    std::size_t unleveled{0};
+    db_sync.export_progress([&history, &skipped, &unleveled](std::string_view row)
+                            {
+        uint32_t user{0};
+        int64_t started{0};
+        uint32_t length{0};
+        float success{0.0f};
+        uint8_t level{HistoryColumns::UNKNOWN_DIFFICULTY};
+        if (!parse_field(row, user) || !parse_field(row, started) ||
+            !parse_field(row, length) || !parse_field(row, success))
+        {
+            ++skipped;
+            return;
+        }
+        // \N - раунд записан до появления столбца difficulty
+        if (row == "\\N")
+            ++unleveled;
+        else if (!parse_field(row, level) || level >= TaskGenerator::DIFFICULTY_COUNT)
+        {
+            ++skipped;
+            return;
+        }
+        history.push_back(user, started, level, static_cast<uint16_t>(length), success); });
+
+    if (skipped)
+    {
+        std::cerr << "Skipped " << skipped << " malformed rows\n";
+    }
+    if (unleveled)
+    {
+        std::cerr << unleveled << " rounds have no recorded difficulty and are left out of the difficulty report\n";
+    }
+    return history;
+}
+
+HistoryColumns Analytics::load_from_session_log(const std::string &path)
+{
+    ScopedLatency timer(load_latency);
+    SessionLogReader reader(path);
+    if (!reader.is_open())
+    {
+        throw std::runtime_error("Cannot open session log " + path);
+    }
+
+    HistoryColumns history;
+    SessionRecord record{};
+    while (reader.next(record))
+    {
+        const auto correct = std::count(record.item_correct.begin(), record.item_correct.end(), uint8_t{1});
+        const float success = record.items.empty() ? 0.0f
+                                                   : static_cast<float>(correct) / record.items.size();
+        history.push_back(record.user_id,
+                          record.started_at_ms / 1000,
+                          static_cast<uint8_t>(record.difficulty),
+                          static_cast<uint16_t>(record.items.size()),
+                          success);
+    }
+
+    if (reader.corrupted())
+    {
+        std::cerr << "Session log " << path << " is damaged after " << history.size() << " records\n";
+    }
+    return history;
+}
+
+AnalyticsReport Analytics::analyze(const HistoryColumns &history, unsigned threads)
+{
+    ScopedLatency timer(analyze_latency);
+    if (history.size() > std::numeric_limits<uint32_t>::max())
+    {
+        throw std::length_error("History has more rows than the 32-bit row index supports");
+    }
+
+    const unsigned workers = std::max(1u, threads ? threads : std::thread::hardware_concurrency());
+
+    // порядок строк (пользователь, время) для кривой обучения и когорт
+    std::vector<uint32_t> order(history.size());
+    std::iota(order.begin(), order.end(), 0u);
+    parallel_sort(order, workers, [&history](uint32_t left, uint32_t right)
+                  {
+        if (history.user_id[left] != history.user_id[right])
+            return history.user_id[left] < history.user_id[right];
+        return history.started_at[left] < history.started_at[right]; });
+
+    AnalyticsReport report{};
+    report.rows = history.size();
+    report.learning_curve = learning_curve(history, order, workers);
+    report.percentiles = percentiles(history, workers);
+    report.retention = retention(history, order, workers, report.users);
+    return report;
+}
+
+void Analytics::write_learning_curve_csv(const AnalyticsReport &report, std::ostream &out)
+{
+    out << "attempt,sessions,mean_success\n";
+    out << std::fixed << std::setprecision(4);
+    for (const auto &point : report.learning_curve)
+    {
+        out << point.attempt << "," << point.sessions << "," << point.mean_success << "\n";
+    }
+}
+
+void Analytics::write_percentiles_csv(const AnalyticsReport &report, std::ostream &out)
+{
+    out << "difficulty,sessions,mean";
+    for (const uint32_t percentile : DifficultyPercentiles::PERCENTILES)
+    {
+        out << ",p" << percentile;
+    }
+    out << "\n"
+        << std::fixed << std::setprecision(4);
+    for (const auto &entry : report.percentiles)
+    {
+        out << difficulty_name(entry.difficulty) << "," << entry.sessions << "," << entry.mean_success;
+        for (const float value : entry.values)
+        {
+            out << "," << value;
+        }
+        out << "\n";
+    }
+}
+
+void Analytics::write_retention_csv(const AnalyticsReport &report, std::ostream &out)
+{
+    out << "cohort_week_start,users";
+    for (std::size_t week{0}; week < RetentionCohort::WEEKS; ++week)
+    {
+        out << ",week_" << week;
+    }
+    out << "\n"
+        << std::fixed << std::setprecision(4);
+    for (const auto &cohort : report.retention)
+    {
+        const std::chrono::year_month_day start{
+            std::chrono::sys_days{std::chrono::days{cohort.cohort_week * 7}}};
+        out << static_cast<int>(start.year()) << "-"
+            << std::setw(2) << std::setfill('0') << static_cast<unsigned>(start.month()) << "-"
+            << std::setw(2) << static_cast<unsigned>(start.day()) << std::setfill(' ')
+            << "," << cohort.users;
+        for (const uint32_t active : cohort.active)
+        {
+            out << "," << static_cast<double>(active) / cohort.users;
+        }
+        out << "\n";
+    }
+}
+
+void Analytics::write_summary(const AnalyticsReport &report, std::ostream &out)
+{
+    out << "Rounds: " << report.rows << ", users: " << report.users << "\n"
+        << std::fixed << std::setprecision(1);
+
+    out << "\nSuccess by difficulty (%):\n";
+    for (const auto &entry : report.percentiles)
+    {
+        out << "  " << std::left << std::setw(7) << difficulty_name(entry.difficulty) << std::right
+            << " n=" << entry.sessions << " mean=" << entry.mean_success * 100;
+        for (std::size_t p{0}; p < DifficultyPercentiles::PERCENTILES.size(); ++p)
+        {
+            out << " p" << DifficultyPercentiles::PERCENTILES[p] << "=" << entry.values[p] * 100;
+        }
+        out << "\n";
+    }
+
+    out << "\nLearning curve (first attempts):\n";
+    for (std::size_t i{0}; i < std::min<std::size_t>(report.learning_curve.size(), 10); ++i)
+    {
+        const auto &point = report.learning_curve[i];
+        out << "  #" << point.attempt << ": " << point.mean_success * 100 << "% (n=" << point.sessions << ")\n";
+    }
+
+    // взвешенное по размеру когорт удержание на 1-й и 4-й неделе
+    uint64_t users{0}, week_1{0}, week_4{0};
+    for (const auto &cohort : report.retention)
+    {
+        users += cohort.users;
+        week_1 += cohort.active[1];
+        week_4 += cohort.active[4];
+    }
+    if (users)
+    {
+        out << "\nRetention: week 1 " << 100.0 * week_1 / users << "%, week 4 " << 100.0 * week_4 / users
+            << "% over " << report.retention.size() << " cohorts\n";
+    }
+}
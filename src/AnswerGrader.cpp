@@ -0,0 +1,457 @@
+#include "../include/AnswerGrader.hpp"
+#include "../include/ConfigFile.hpp"
+#include "../include/NumberParsing.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <string>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+namespace
+{
+    constexpr std::array<const char *, TaskGenerator::DIFFICULTY_COUNT> LEVEL_KEYS = {"easy", "medium", "hard"};
+    constexpr std::array<uint32_t, TaskGenerator::DIFFICULTY_COUNT> DEFAULT_MAX_EDITS = {2, 1, 1};
+    constexpr std::array<float, TaskGenerator::DIFFICULTY_COUNT> DEFAULT_EDIT_PENALTY = {0.25f, 0.5f, 0.5f};
+
+    // обычная динамика по двум строкам + строка для перестановок; для слов длиннее 64 символов
+    uint32_t edit_distance_dp(std::string_view a, std::string_view b)
+    {
+        std::vector<uint32_t> before(b.size() + 1), previous(b.size() + 1), current(b.size() + 1);
+        for (std::size_t j{0}; j <= b.size(); ++j)
+        {
+            previous[j] = static_cast<uint32_t>(j);
+        }
+        for (std::size_t i{1}; i <= a.size(); ++i)
+        {
+            current[0] = static_cast<uint32_t>(i);
+            for (std::size_t j{1}; j <= b.size(); ++j)
+            {
+                const uint32_t cost = a[i - 1] == b[j - 1] ? 0 : 1;
+                current[j] = std::min({previous[j] + 1, current[j - 1] + 1, previous[j - 1] + cost});
+                if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1])
+                {
+                    current[j] = std::min(current[j], before[j - 2] + 1);
+                }
+            }
+            std::swap(before, previous);
+            std::swap(previous, current);
+        }
+        return previous[b.size()];
+    }
+
+    // токен ответа с разбором чисел по требованию: при выравнивании один токен сравнивается
+    // со всеми элементами, и каждый числовой тип разбирается не больше одного раза
+    class AnswerToken
+    {
+    public:
+        explicit AnswerToken(std::string_view answer) noexcept : text(answer) {}
+
+        // слово - точное совпадение, символ - без учёта регистра,
+        // числа - по числовому префиксу ответа (float с погрешностью 0.01)
+        bool matches(const TaskGenerator::TaskItemView &item) noexcept
+        {
+            if (text.empty())
+            {
+                return false;
+            }
+
+            return std::visit([this](auto &&arg) -> bool
+                              {
+                using T = std::decay_t<decltype(arg)>;
+                if constexpr (std::is_same_v<T, std::string_view>) {
+                    return arg == text;
+                }
+                else if constexpr (std::is_same_v<T, char>) {
+                    return std::tolower(arg) == std::tolower(text[0]);
+                }
+                else if constexpr (std::is_same_v<T, uint16_t>) {
+                    return parsed(u16_state, u16) && arg == u16;
+                }
+                else if constexpr (std::is_same_v<T, uint32_t>) {
+                    return parsed(u32_state, u32) && arg == u32;
+                }
+                else {
+                    if (!parsed(float_state, f))
+                        return false;
+                    const float epsilon = 0.01f;
+                    return (f == arg) || (std::abs(arg - f) < epsilon);
+                } }, item);
+        }
+
+        // ключ элемента: равные ключи элемента и токена (AnswerToken::key) означают совпадение,
+        // для слов - после сравнения строк; считается один раз на элемент последовательности
+        static uint64_t item_key(const TaskGenerator::TaskItemView &item) noexcept
+        {
+            return std::visit([](auto &&arg) -> uint64_t
+                              {
+                using T = std::decay_t<decltype(arg)>;
+                if constexpr (std::is_same_v<T, std::string_view>) {
+                    return hash(arg);
+                }
+                else if constexpr (std::is_same_v<T, char>) {
+                    return static_cast<uint64_t>(std::tolower(arg));
+                }
+                else if constexpr (std::is_integral_v<T>) {
+                    return arg;
+                }
+                else {
+                    return 0; // float сравнивается с погрешностью, ключа нет
+                } }, item);
+        }
+
+        // ключ токена для элементов типа kind; false - токен не может совпасть ни с одним из них
+        bool key(TaskGenerator::ItemKind kind, uint64_t &value) noexcept
+        {
+            if (text.empty())
+            {
+                return false;
+            }
+
+            switch (kind)
+            {
+            case TaskGenerator::ItemKind::WORD:
+                value = hash(text);
+                return true;
+            case TaskGenerator::ItemKind::SYMBOL:
+                value = static_cast<uint64_t>(std::tolower(text[0]));
+                return true;
+            case TaskGenerator::ItemKind::UINT16:
+                return parsed(u16_state, u16) && ((value = u16), true);
+            case TaskGenerator::ItemKind::UINT32:
+                return parsed(u32_state, u32) && ((value = u32), true);
+            default:
+                return false;
+            }
+        }
+
+        bool equals(std::string_view word) const noexcept { return word == text; }
+
+        float credit(const TaskGenerator::TaskItemView &item, const AnswerGrader::GradingRules &rules) noexcept
+        {
+            return matches(item) ? 1.0f : partial_credit(item, rules);
+        }
+
+        // балл слова, не совпавшего точно
+        float partial_credit(const TaskGenerator::TaskItemView &item, const AnswerGrader::GradingRules &rules) noexcept
+        {
+            const auto *word = std::get_if<std::string_view>(&item);
+            if (rules.mode != AnswerGrader::GradingMode::PARTIAL || !word || text.empty())
+            {
+                return 0.0f;
+            }
+
+            // короткому слову - меньше опечаток: "cat" -> "bat" уже другое слово
+            const uint32_t allowed = std::min<uint32_t>(rules.max_edits, static_cast<uint32_t>(word->size() / 3));
+            const std::size_t length_gap = word->size() > text.size() ? word->size() - text.size()
+                                                                       : text.size() - word->size();
+            if (allowed == 0 || length_gap > allowed)
+            {
+                return 0.0f;
+            }
+
+            const uint32_t distance = AnswerGrader::edit_distance(*word, text);
+            if (distance > allowed)
+            {
+                return 0.0f;
+            }
+            return std::max(0.0f, 1.0f - static_cast<float>(distance) * rules.edit_penalty);
+        }
+
+    private:
+        enum class ParseState : uint8_t
+        {
+            PENDING,
+            FAILED,
+            DONE
+        };
+
+        static uint64_t hash(std::string_view bytes) noexcept
+        {
+            uint64_t value = 14695981039346656037ull; // FNV-1a
+            for (const char c : bytes)
+            {
+                value = (value ^ static_cast<unsigned char>(c)) * 1099511628211ull;
+            }
+            return value;
+        }
+
+        template <typename T>
+        bool parsed(ParseState &state, T &value) noexcept
+        {
+            if (state == ParseState::PENDING)
+            {
+                state = NumberParsing::parse_whole(text, value) ? ParseState::DONE : ParseState::FAILED;
+            }
+            return state == ParseState::DONE;
+        }
+
+        std::string_view text;
+        uint16_t u16{0};
+        uint32_t u32{0};
+        float f{0.0f};
+        ParseState u16_state{ParseState::PENDING};
+        ParseState u32_state{ParseState::PENDING};
+        ParseState float_state{ParseState::PENDING};
+    };
+}
+
+AnswerGrader::RulesByDifficulty AnswerGrader::load_rules(const ConfigFile &config)
+{
+    const GradingMode mode = config.get("grading", "mode", "exact") == "partial" ? GradingMode::PARTIAL
+                                                                                  : GradingMode::EXACT;
+    const Alignment alignment = config.get("grading", "alignment", "positional") == "lcs" ? Alignment::LCS
+                                                                                          : Alignment::POSITIONAL;
+    RulesByDifficulty rules;
+    for (std::size_t level{0}; level < rules.size(); ++level)
+    {
+        const std::string prefix = LEVEL_KEYS[level];
+        rules[level].mode = mode;
+        rules[level].alignment = alignment;
+        rules[level].max_edits = static_cast<uint32_t>(
+            std::max<int64_t>(0, config.get_int("grading", prefix + "_max_edits", DEFAULT_MAX_EDITS[level])));
+        const std::string penalty = config.get("grading", prefix + "_edit_penalty");
+        float value = DEFAULT_EDIT_PENALTY[level];
+        if (!penalty.empty() && !NumberParsing::parse_whole(penalty, value))
+        {
+            value = DEFAULT_EDIT_PENALTY[level];
+        }
+        rules[level].edit_penalty = std::clamp(value, 0.0f, 1.0f);
+    }
+    return rules;
+}
+
+bool AnswerGrader::grade_item(const TaskGenerator::TaskItemView &item, std::string_view answer) noexcept
+{
+    return AnswerToken(answer).matches(item);
+}
+
+float AnswerGrader::item_credit(const TaskGenerator::TaskItemView &item, std::string_view answer,
+                                const GradingRules &rules) noexcept
+{
+    return AnswerToken(answer).credit(item, rules);
+}
+
+AnswerGrader::Grade AnswerGrader::grade(std::span<const TaskGenerator::TaskItemView> sequence,
+                                        std::span<const std::string_view> answers,
+                                        std::span<uint8_t> item_correct,
+                                        const GradingRules &rules) noexcept
+{
+    if (rules.alignment == Alignment::LCS && !sequence.empty() && !answers.empty())
+    {
+        try
+        {
+            return grade_aligned(sequence, answers, item_correct, rules);
+        }
+        catch (...)
+        {
+            // нет памяти под строки матрицы - позиционная проверка
+        }
+    }
+
+    Grade result;
+    for (std::size_t i{0}; i < sequence.size(); ++i)
+    {
+        const float credit = i < answers.size() ? item_credit(sequence[i], answers[i], rules) : 0.0f;
+        const bool is_correct = credit == 1.0f;
+        if (i < item_correct.size())
+        {
+            item_correct[i] = is_correct ? 1 : 0;
+        }
+        if (is_correct)
+            result.correct++;
+        result.credit += credit;
+    }
+    return result;
+}
+
+AnswerGrader::Grade AnswerGrader::grade(std::span<const TaskGenerator::TaskItemView> sequence,
+                                        std::span<const std::string_view> answers,
+                                        std::span<uint8_t> item_correct) noexcept
+{
+    return grade(sequence, answers, item_correct, GradingRules{});
+}
+
+AnswerGrader::Grade AnswerGrader::grade_aligned(std::span<const TaskGenerator::TaskItemView> sequence,
+                                                std::span<const std::string_view> answers,
+                                                std::span<uint8_t> item_correct,
+                                                const GradingRules &rules)
+{
+    const std::size_t n = sequence.size();
+    const std::size_t m = answers.size();
+    const std::size_t words = (n + 63) / 64;
+
+    // rows[j] - строка V после j ответов; нулевой бит i - LCS растёт на элементе i
+    thread_local std::vector<uint64_t> rows;
+    thread_local std::vector<uint64_t> match;
+    thread_local std::vector<uint64_t> keys;
+    thread_local std::vector<AnswerToken> tokens; // разобранные числа нужны и при восстановлении
+    rows.assign((m + 1) * words, ~uint64_t{0});
+    match.resize(words);
+    keys.resize(n);
+    uint32_t kinds_present{0};
+    for (std::size_t i{0}; i < n; ++i)
+    {
+        keys[i] = AnswerToken::item_key(sequence[i]);
+        kinds_present |= 1u << sequence[i].index();
+    }
+    tokens.clear();
+    tokens.reserve(m);
+
+    constexpr std::size_t FLOAT = static_cast<std::size_t>(TaskGenerator::ItemKind::FLOAT);
+    constexpr std::size_t WORD = static_cast<std::size_t>(TaskGenerator::ItemKind::WORD);
+    const bool partial = rules.mode == GradingMode::PARTIAL;
+    for (std::size_t j{0}; j < m; ++j)
+    {
+        // маска совпадений ответа j: ключ токена считается один раз на тип, дальше - сравнение чисел
+        AnswerToken &token = tokens.emplace_back(answers[j]);
+        std::array<uint64_t, TaskGenerator::ITEM_KIND_COUNT> answer_keys{};
+        uint32_t has_key{0};
+        for (std::size_t kind{0}; kind < TaskGenerator::ITEM_KIND_COUNT; ++kind)
+        {
+            if (((kinds_present >> kind) & 1) && token.key(static_cast<TaskGenerator::ItemKind>(kind), answer_keys[kind]))
+                has_key |= 1u << kind;
+        }
+
+        std::fill(match.begin(), match.end(), 0);
+        for (std::size_t i{0}; i < n; ++i)
+        {
+            // ключи совпадают редко; слово при совпадении ключа сверяется строкой
+            const std::size_t kind = sequence[i].index();
+            uint64_t hit = ((has_key >> kind) & 1) & static_cast<uint64_t>(answer_keys[kind] == keys[i]);
+            if (hit && kind == WORD)
+                hit = token.equals(std::get<WORD>(sequence[i]));
+            else if (kind == FLOAT)
+                hit = token.matches(sequence[i]);
+            if (!hit && partial && kind == WORD)
+                hit = token.partial_credit(sequence[i], rules) > 0.0f;
+            match[i / 64] |= hit << (i % 64);
+        }
+
+        // V' = (V + (V & M)) | (V & ~M), сложение с переносом между словами
+        const uint64_t *previous = rows.data() + j * words;
+        uint64_t *current = rows.data() + (j + 1) * words;
+        uint64_t carry{0};
+        for (std::size_t w{0}; w < words; ++w)
+        {
+            const uint64_t v = previous[w];
+            const uint64_t u = v & match[w];
+            const uint64_t sum = v + u;
+            const uint64_t total = sum + carry;
+            carry = (sum < v) | (total < sum);
+            current[w] = total | (v & ~match[w]);
+        }
+    }
+
+    // D[j][i] - число нулевых битов строки j среди первых i элементов
+    const auto prefix_length = [&](std::size_t j, std::size_t i)
+    {
+        const uint64_t *row = rows.data() + j * words;
+        std::size_t length{0};
+        for (std::size_t w{0}; w < i / 64; ++w)
+            length += std::popcount(~row[w]);
+        if (i % 64)
+            length += std::popcount(~row[i / 64] & ((uint64_t{1} << (i % 64)) - 1));
+        return length;
+    };
+    const auto bit_set = [&](std::size_t j, std::size_t i)
+    {
+        return (rows[j * words + i / 64] >> (i % 64)) & 1;
+    };
+
+    std::fill(item_correct.begin(), item_correct.end(), 0);
+    Grade result;
+    std::size_t i{n};
+    std::size_t j{m};
+    std::size_t length = prefix_length(m, n);
+    while (i > 0 && j > 0 && length > 0)
+    {
+        if (bit_set(j, i - 1))
+        {
+            --i; // D[j][i] == D[j][i-1]
+        }
+        else if (prefix_length(j - 1, i) == length)
+        {
+            --j;
+        }
+        else
+        {
+            // диагональ: ответ j-1 выровнен с элементом i-1
+            const float credit = tokens[j - 1].credit(sequence[i - 1], rules);
+            if (credit == 1.0f)
+            {
+                result.correct++;
+                if (i - 1 < item_correct.size())
+                    item_correct[i - 1] = 1;
+            }
+            result.credit += credit;
+            --i;
+            --j;
+            --length;
+        }
+    }
+    return result;
+}
+
+uint32_t AnswerGrader::edit_distance(std::string_view expected, std::string_view answer) noexcept
+{
+    const std::size_t m = expected.size();
+    if (m == 0)
+    {
+        return static_cast<uint32_t>(answer.size());
+    }
+    if (m > 64)
+    {
+        try
+        {
+            return edit_distance_dp(expected, answer);
+        }
+        catch (...)
+        {
+            return static_cast<uint32_t>(std::max(m, answer.size()));
+        }
+    }
+
+    // маски позиций каждого байта в expected; таблица потока обнуляется обратно после расчёта
+    thread_local std::array<uint64_t, 256> peq{};
+    for (std::size_t i{0}; i < m; ++i)
+    {
+        peq[static_cast<unsigned char>(expected[i])] |= uint64_t{1} << i;
+    }
+
+    // столбцы матрицы расстояний хранятся как вертикальные разности +1/-1 (Pv/Mv)
+    const uint64_t last = uint64_t{1} << (m - 1);
+    uint64_t pv = ~uint64_t{0};
+    uint64_t mv = 0;
+    uint64_t previous_d0 = 0;
+    uint64_t previous_eq = 0;
+    uint32_t distance = static_cast<uint32_t>(m);
+    for (const char c : answer)
+    {
+        const uint64_t eq = peq[static_cast<unsigned char>(c)];
+        // перестановка соседних символов: диагональ через два столбца (Hyyrö 2003)
+        const uint64_t transposition = (((~previous_d0) & eq) << 1) & previous_eq;
+        const uint64_t d0 = (((eq & pv) + pv) ^ pv) | eq | mv | transposition;
+        uint64_t hp = mv | ~(d0 | pv);
+        uint64_t hn = d0 & pv;
+        if (hp & last)
+            ++distance;
+        else if (hn & last)
+            --distance;
+        // граница сверху растёт на 1 в каждом столбце: расстояние между строками целиком
+        hp = (hp << 1) | 1;
+        hn <<= 1;
+        pv = hn | ~(d0 | hp);
+        mv = hp & d0;
+        previous_d0 = d0;
+        previous_eq = eq;
+    }
+
+    for (std::size_t i{0}; i < m; ++i)
+    {
+        peq[static_cast<unsigned char>(expected[i])] = 0;
+    }
+    return distance;
+}
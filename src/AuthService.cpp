@@ -0,0 +1,458 @@
+#include "../include/AuthService.hpp"
+#include "../include/DatabaseSync.hpp"
+#include "../include/ConfigFile.hpp"
+#include "../include/Metrics.hpp"
+#include "../include/NumberParsing.hpp"
+
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace
+{
+    LatencyHistogram login_latency("mem_trainer_auth_duration_seconds",
+                                   "Login time including the credential query and the hashing queue",
+                                   "operation=\"login\"");
+    LatencyHistogram register_latency("mem_trainer_auth_duration_seconds",
+                                      "Login time including the credential query and the hashing queue",
+                                      "operation=\"register\"");
+    LatencyHistogram hash_latency("mem_trainer_auth_hash_duration_seconds", "Time of one scrypt derivation");
+    MetricCounter login_ok("mem_trainer_auth_logins_total", "Login attempts by outcome", "result=\"ok\"");
+    MetricCounter login_cached("mem_trainer_auth_logins_total", "Login attempts by outcome", "result=\"cached\"");
+    MetricCounter login_invalid("mem_trainer_auth_logins_total", "Login attempts by outcome", "result=\"invalid\"");
+    MetricCounter login_busy("mem_trainer_auth_logins_total", "Login attempts by outcome", "result=\"busy\"");
+    MetricCounter login_failed("mem_trainer_auth_logins_total", "Login attempts by outcome", "result=\"failed\"");
+    MetricCounter passwords_upgraded("mem_trainer_auth_passwords_upgraded_total",
+                                     "Plaintext passwords replaced with scrypt hashes on login");
+
+    constexpr std::string_view HASH_PREFIX = "$scrypt$";
+    constexpr std::size_t SALT_BYTES = 16;
+    constexpr std::size_t KEY_BYTES = 32;
+
+    // пределы параметров из записи в БД: испорченная строка не должна занять всю память
+    constexpr uint32_t MAX_LOG_N = 20;
+    constexpr uint32_t MAX_R = 32;
+    constexpr uint32_t MAX_P = 16;
+
+    struct HashParams
+    {
+        uint32_t log_n;
+        uint32_t r;
+        uint32_t p;
+    };
+
+    void derive(std::string_view password, const unsigned char *salt, std::size_t salt_size,
+                const HashParams &params, unsigned char *key, std::size_t key_size)
+    {
+        const uint64_t n = uint64_t{1} << params.log_n;
+        // рабочая память scrypt: 128 * r * (N + 2) на таблицу V и 128 * r * p на блоки B
+        const uint64_t max_memory = 128 * uint64_t{params.r} * (n + 2 + params.p) + (uint64_t{1} << 20);
+        ScopedLatency timer(hash_latency);
+        if (EVP_PBE_scrypt(password.data(), password.size(), salt, salt_size, n, params.r, params.p,
+                           max_memory, key, key_size) != 1)
+        {
+            throw std::runtime_error("scrypt failed");
+        }
+    }
+
+    std::string encode_base64(const unsigned char *data, std::size_t size)
+    {
+        std::string text(4 * ((size + 2) / 3), '\0');
+        const int written = EVP_EncodeBlock(reinterpret_cast<unsigned char *>(text.data()), data,
+                                            static_cast<int>(size));
+        text.resize(static_cast<std::size_t>(written));
+        return text;
+    }
+
+    // EVP_DecodeBlock возвращает длину с учётом байтов дополнения '='; лишнее отрезается по size
+    bool decode_base64(std::string_view text, unsigned char *data, std::size_t size)
+    {
+        if (text.size() != 4 * ((size + 2) / 3))
+        {
+            return false;
+        }
+        std::string buffer(text.size() / 4 * 3, '\0');
+        const int decoded = EVP_DecodeBlock(reinterpret_cast<unsigned char *>(buffer.data()),
+                                            reinterpret_cast<const unsigned char *>(text.data()),
+                                            static_cast<int>(text.size()));
+        if (decoded < static_cast<int>(size))
+        {
+            return false;
+        }
+        std::copy_n(buffer.begin(), size, data);
+        return true;
+    }
+
+    bool parse_param(std::string_view &text, std::string_view name, uint32_t &value, uint32_t max_value)
+    {
+        if (!text.starts_with(name))
+        {
+            return false;
+        }
+        text.remove_prefix(name.size());
+        return NumberParsing::parse_prefix(text, value) && value != 0 && value <= max_value;
+    }
+
+    // "$scrypt$ln=14,r=8,p=1$<соль>$<ключ>"
+    bool parse_hash(std::string_view stored, HashParams &params, unsigned char *salt, unsigned char *key)
+    {
+        if (!stored.starts_with(HASH_PREFIX))
+        {
+            return false;
+        }
+        stored.remove_prefix(HASH_PREFIX.size());
+        if (!parse_param(stored, "ln=", params.log_n, MAX_LOG_N) ||
+            !parse_param(stored, ",r=", params.r, MAX_R) ||
+            !parse_param(stored, ",p=", params.p, MAX_P) ||
+            !stored.starts_with('$'))
+        {
+            return false;
+        }
+        stored.remove_prefix(1);
+        const std::size_t separator = stored.find('$');
+        return separator != std::string_view::npos &&
+               decode_base64(stored.substr(0, separator), salt, SALT_BYTES) &&
+               decode_base64(stored.substr(separator + 1), key, KEY_BYTES);
+    }
+}
+
+AuthService::Options AuthService::load_options(const ConfigFile &config)
+{
+    Options options;
+    options.workers = static_cast<unsigned>(std::clamp<int64_t>(config.get_int("auth", "workers", 2), 1, 64));
+    options.queue_limit = static_cast<std::size_t>(std::max<int64_t>(1, config.get_int("auth", "queue_limit", 64)));
+    options.scrypt_log_n = static_cast<uint32_t>(std::clamp<int64_t>(config.get_int("auth", "scrypt_log_n", 14), 10, MAX_LOG_N));
+    options.scrypt_r = static_cast<uint32_t>(std::clamp<int64_t>(config.get_int("auth", "scrypt_r", 8), 1, MAX_R));
+    options.scrypt_p = static_cast<uint32_t>(std::clamp<int64_t>(config.get_int("auth", "scrypt_p", 1), 1, MAX_P));
+    options.session_ttl = std::chrono::seconds(std::max<int64_t>(0, config.get_int("auth", "session_ttl_seconds", 3600)));
+    options.session_cache_entries = static_cast<std::size_t>(
+        std::max<int64_t>(0, config.get_int("auth", "session_cache_entries", 1024)));
+    return options;
+}
+
+AuthService::AuthService(DatabaseSync &db_sync, Options options)
+    : db_sync(db_sync), options(options)
+{
+    if (RAND_bytes(session_key.data(), static_cast<int>(session_key.size())) != 1)
+    {
+        throw std::runtime_error("Cannot generate the session key");
+    }
+    // хэш случайного пароля, который никто не знает: проверка по нему всегда неуспешна
+    std::array<unsigned char, KEY_BYTES> unknown{};
+    if (RAND_bytes(unknown.data(), static_cast<int>(unknown.size())) != 1)
+    {
+        throw std::runtime_error("Cannot generate the placeholder password");
+    }
+    dummy_hash = hash_password(encode_base64(unknown.data(), unknown.size()));
+    OPENSSL_cleanse(unknown.data(), unknown.size());
+
+    workers.reserve(this->options.workers);
+    for (unsigned i{0}; i < this->options.workers; ++i)
+    {
+        workers.emplace_back(&AuthService::worker_loop, this);
+    }
+}
+
+AuthService::~AuthService()
+{
+    {
+        std::lock_guard lock(queue_mutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+    OPENSSL_cleanse(session_key.data(), session_key.size());
+}
+
+AuthService::LoginResult AuthService::login(const std::string &username, const std::string &password)
+{
+    ScopedLatency timer(login_latency);
+
+    std::optional<UserCredential> credential;
+    try
+    {
+        credential = db_sync.get_user_credential(username);
+    }
+    catch (const std::exception &e)
+    {
+        error = e.what();
+        login_failed.increment();
+        return {Status::FAILED};
+    }
+    if (!credential)
+    {
+        // тот же scrypt с параметрами конфигурации и та же очередь, что и для существующего имени:
+        // ни по времени ответа, ни по BUSY нельзя узнать, зарегистрировано ли имя
+        auto pending = submit(password, dummy_hash, false);
+        if (!pending)
+        {
+            login_busy.increment();
+            return {Status::BUSY};
+        }
+        try
+        {
+            pending->get();
+        }
+        catch (const std::exception &)
+        {
+            // исход известен заранее: INVALID
+        }
+        login_invalid.increment();
+        return {Status::INVALID};
+    }
+
+    // повторный вход: HMAC вместо scrypt, пока запись в БД не изменилась
+    const Token token = session_token(username, password);
+    if (const auto user_id = cached_login(username, token, credential->password))
+    {
+        login_cached.increment();
+        return {Status::OK, *user_id};
+    }
+
+    auto pending = submit(password, credential->password, false);
+    if (!pending)
+    {
+        login_busy.increment();
+        return {Status::BUSY};
+    }
+
+    std::optional<std::string> outcome;
+    try
+    {
+        outcome = pending->get();
+    }
+    catch (const std::exception &e)
+    {
+        error = e.what();
+        login_failed.increment();
+        return {Status::FAILED};
+    }
+    if (!outcome)
+    {
+        login_invalid.increment();
+        return {Status::INVALID};
+    }
+
+    std::string stored = std::move(credential->password);
+    if (!outcome->empty())
+    {
+        if (db_sync.update_password(static_cast<uint32_t>(credential->user_id), *outcome))
+        {
+            passwords_upgraded.increment();
+            stored = std::move(*outcome);
+        }
+        else
+        {
+            std::cerr << "Failed to store the password hash: " << db_sync.last_error() << "\n";
+        }
+    }
+
+    remember(username, token, stored, credential->user_id);
+    login_ok.increment();
+    return {Status::OK, credential->user_id};
+}
+
+AuthService::Status AuthService::register_user(const std::string &username, const std::string &password)
+{
+    ScopedLatency timer(register_latency);
+
+    auto pending = submit(password, {}, true);
+    if (!pending)
+    {
+        return Status::BUSY;
+    }
+
+    std::string hash;
+    try
+    {
+        hash = *pending->get();
+    }
+    catch (const std::exception &e)
+    {
+        error = e.what();
+        return Status::FAILED;
+    }
+
+    if (!db_sync.register_user(username, hash))
+    {
+        error = db_sync.last_error();
+        return Status::FAILED;
+    }
+    return Status::OK;
+}
+
+std::string AuthService::hash_password(std::string_view password) const
+{
+    std::array<unsigned char, SALT_BYTES> salt;
+    if (RAND_bytes(salt.data(), static_cast<int>(salt.size())) != 1)
+    {
+        throw std::runtime_error("Cannot generate a password salt");
+    }
+
+    std::array<unsigned char, KEY_BYTES> key;
+    const HashParams params{options.scrypt_log_n, options.scrypt_r, options.scrypt_p};
+    derive(password, salt.data(), salt.size(), params, key.data(), key.size());
+
+    std::string stored(HASH_PREFIX);
+    stored += "ln=" + std::to_string(params.log_n) + ",r=" + std::to_string(params.r) +
+              ",p=" + std::to_string(params.p) + "$";
+    stored += encode_base64(salt.data(), salt.size());
+    stored += '$';
+    stored += encode_base64(key.data(), key.size());
+    OPENSSL_cleanse(key.data(), key.size());
+    return stored;
+}
+
+bool AuthService::verify_password(std::string_view password, std::string_view stored)
+{
+    if (!is_hashed(stored))
+    {
+        return password.size() == stored.size() &&
+               CRYPTO_memcmp(password.data(), stored.data(), stored.size()) == 0;
+    }
+
+    HashParams params;
+    std::array<unsigned char, SALT_BYTES> salt;
+    std::array<unsigned char, KEY_BYTES> expected;
+    if (!parse_hash(stored, params, salt.data(), expected.data()))
+    {
+        return false;
+    }
+
+    std::array<unsigned char, KEY_BYTES> key;
+    derive(password, salt.data(), salt.size(), params, key.data(), key.size());
+    const bool match = CRYPTO_memcmp(key.data(), expected.data(), key.size()) == 0;
+    OPENSSL_cleanse(key.data(), key.size());
+    return match;
+}
+
+bool AuthService::is_hashed(std::string_view stored) noexcept
+{
+    return stored.starts_with(HASH_PREFIX);
+}
+
+std::optional<std::future<std::optional<std::string>>> AuthService::submit(std::string password, std::string stored,
+                                                                           bool hash_only)
+{
+    std::future<std::optional<std::string>> result;
+    {
+        std::lock_guard lock(queue_mutex);
+        if (queue.size() >= options.queue_limit)
+        {
+            return std::nullopt;
+        }
+        Job &job = queue.emplace_back(Job{std::move(password), std::move(stored), hash_only, {}});
+        result = job.done.get_future();
+    }
+    wakeup.notify_one();
+    return result;
+}
+
+void AuthService::worker_loop()
+{
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock lock(queue_mutex);
+            wakeup.wait(lock, [this]
+                        { return stopping || !queue.empty(); });
+            if (queue.empty())
+            {
+                return;
+            }
+            job = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        try
+        {
+            if (job.hash_only)
+            {
+                job.done.set_value(hash_password(job.password));
+            }
+            else if (!verify_password(job.password, job.stored))
+            {
+                job.done.set_value(std::nullopt);
+            }
+            else
+            {
+                // старый пароль в открытом виде заменяется хэшем, пока пароль ещё под рукой
+                job.done.set_value(is_hashed(job.stored) ? std::string{} : hash_password(job.password));
+            }
+        }
+        catch (...)
+        {
+            job.done.set_exception(std::current_exception());
+        }
+        OPENSSL_cleanse(job.password.data(), job.password.size());
+    }
+}
+
+AuthService::Token AuthService::session_token(const std::string &username, const std::string &password) const
+{
+    std::string message;
+    message.reserve(username.size() + 1 + password.size());
+    message += username;
+    message += '\0';
+    message += password;
+
+    Token token{};
+    unsigned int size = static_cast<unsigned int>(token.size());
+    HMAC(EVP_sha256(), session_key.data(), static_cast<int>(session_key.size()),
+         reinterpret_cast<const unsigned char *>(message.data()), message.size(), token.data(), &size);
+    OPENSSL_cleanse(message.data(), message.size());
+    return token;
+}
+
+std::optional<int32_t> AuthService::cached_login(const std::string &username, const Token &token,
+                                                 const std::string &stored)
+{
+    const auto found = sessions.find(username);
+    if (found == sessions.end())
+    {
+        return std::nullopt;
+    }
+
+    const Session &session = found->second;
+    if (session.expires <= std::chrono::steady_clock::now() || session.stored != stored)
+    {
+        sessions.erase(found);
+        return std::nullopt;
+    }
+    if (CRYPTO_memcmp(session.token.data(), token.data(), token.size()) != 0)
+    {
+        return std::nullopt;
+    }
+    return session.user_id;
+}
+
+void AuthService::remember(const std::string &username, const Token &token, const std::string &stored,
+                           int32_t user_id)
+{
+    if (options.session_cache_entries == 0 || options.session_ttl.count() == 0)
+    {
+        return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (sessions.size() >= options.session_cache_entries && !sessions.contains(username))
+    {
+        std::erase_if(sessions, [now](const auto &entry)
+                      { return entry.second.expires <= now; });
+        if (sessions.size() >= options.session_cache_entries)
+        {
+            sessions.erase(std::min_element(sessions.begin(), sessions.end(), [](const auto &a, const auto &b)
+                                            { return a.second.expires < b.second.expires; }));
+        }
+    }
+    sessions[username] = Session{token, stored, user_id, now + options.session_ttl};
+}
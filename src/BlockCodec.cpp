@@ -0,0 +1,162 @@
+#include "../include/BlockCodec.hpp"
+
+#include <array>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+    constexpr std::size_t MIN_MATCH = 4;
+    constexpr std::size_t MAX_OFFSET = 65535;
+    constexpr std::size_t HASH_BITS = 12;
+    constexpr uint8_t NIBBLE_MAX = 15;
+
+    inline uint32_t read32(const uint8_t *data) noexcept
+    {
+        uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    inline std::size_t hash(uint32_t value) noexcept
+    {
+        return (value * 2654435761u) >> (32 - HASH_BITS);
+    }
+
+    void write_length(std::vector<uint8_t> &output, std::size_t length)
+    {
+        while (length >= 255)
+        {
+            output.push_back(255);
+            length -= 255;
+        }
+        output.push_back(static_cast<uint8_t>(length));
+    }
+
+    void write_sequence(std::vector<uint8_t> &output, const uint8_t *literals, std::size_t literal_count,
+                        std::size_t offset, std::size_t match_length)
+    {
+        const std::size_t match_code = match_length ? match_length - MIN_MATCH : 0;
+        output.push_back(static_cast<uint8_t>(
+            (std::min<std::size_t>(literal_count, NIBBLE_MAX) << 4) |
+            std::min<std::size_t>(match_code, NIBBLE_MAX)));
+        if (literal_count >= NIBBLE_MAX)
+        {
+            write_length(output, literal_count - NIBBLE_MAX);
+        }
+        output.insert(output.end(), literals, literals + literal_count);
+
+        if (match_length)
+        {
+            output.push_back(static_cast<uint8_t>(offset & 0xFF));
+            output.push_back(static_cast<uint8_t>(offset >> 8));
+            if (match_code >= NIBBLE_MAX)
+            {
+                write_length(output, match_code - NIBBLE_MAX);
+            }
+        }
+    }
+
+    // длина, продолженная байтами 255; false при выходе за конец входа
+    bool read_length(const uint8_t *&in, const uint8_t *end, std::size_t &length) noexcept
+    {
+        uint8_t byte;
+        do
+        {
+            if (in == end)
+                return false;
+            byte = *in++;
+            length += byte;
+        } while (byte == 255);
+        return true;
+    }
+}
+
+std::size_t BlockCodec::compress(std::span<const uint8_t> input, std::vector<uint8_t> &output)
+{
+    const std::size_t start_size = output.size();
+    const uint8_t *data = input.data();
+    const std::size_t size = input.size();
+
+    // позиция + 1, 0 - пустая ячейка
+    std::array<uint32_t, std::size_t{1} << HASH_BITS> table{};
+    std::size_t anchor{0};
+    std::size_t position{0};
+
+    while (position + MIN_MATCH <= size)
+    {
+        const uint32_t sequence = read32(data + position);
+        uint32_t &slot = table[hash(sequence)];
+        const std::size_t candidate = slot;
+        slot = static_cast<uint32_t>(position + 1);
+
+        if (candidate && position - (candidate - 1) <= MAX_OFFSET && read32(data + candidate - 1) == sequence)
+        {
+            const std::size_t match = candidate - 1;
+            std::size_t length = MIN_MATCH;
+            while (position + length < size && data[match + length] == data[position + length])
+            {
+                ++length;
+            }
+
+            write_sequence(output, data + anchor, position - anchor, position - match, length);
+            position += length;
+            anchor = position;
+        }
+        else
+        {
+            ++position;
+        }
+    }
+
+    write_sequence(output, data + anchor, size - anchor, 0, 0);
+    return output.size() - start_size;
+}
+
+bool BlockCodec::decompress(std::span<const uint8_t> input, std::span<uint8_t> output) noexcept
+{
+    const uint8_t *in = input.data();
+    const uint8_t *const in_end = in + input.size();
+    std::size_t written{0};
+
+    while (in < in_end)
+    {
+        const uint8_t token = *in++;
+
+        std::size_t literal_count = token >> 4;
+        if (literal_count == NIBBLE_MAX && !read_length(in, in_end, literal_count))
+            return false;
+        if (literal_count > static_cast<std::size_t>(in_end - in) || literal_count > output.size() - written)
+            return false;
+        if (literal_count)
+        {
+            std::memcpy(output.data() + written, in, literal_count);
+        }
+        in += literal_count;
+        written += literal_count;
+
+        if (in == in_end)
+            break; // последняя последовательность - только литералы
+
+        if (in_end - in < 2)
+            return false;
+        const std::size_t offset = in[0] | (std::size_t{in[1]} << 8);
+        in += 2;
+        if (offset == 0 || offset > written)
+            return false;
+
+        std::size_t match_length = token & NIBBLE_MAX;
+        if (match_length == NIBBLE_MAX && !read_length(in, in_end, match_length))
+            return false;
+        match_length += MIN_MATCH;
+        if (match_length > output.size() - written)
+            return false;
+
+        // совпадение может перекрывать само себя, поэтому побайтно
+        for (std::size_t i{0}; i < match_length; ++i, ++written)
+        {
+            output[written] = output[written - offset];
+        }
+    }
+    return written == output.size();
+}
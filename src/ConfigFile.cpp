@@ -0,0 +1,90 @@
+#include "../include/ConfigFile.hpp"
+
+#include <fstream>
+#include <stdexcept>
+
+ConfigFile::ConfigFile(const std::string &path)
+{
+    std::ifstream config(path);
+    if (!config.is_open())
+    {
+        return;
+    }
+    opened = true;
+
+    std::string section;
+    std::string line;
+    while (getline(config, line))
+    {
+        size_t comment_pos = line.find_first_of('#');
+        if (comment_pos != std::string::npos)
+        {
+            line.erase(comment_pos);
+        }
+
+        line.erase(0, line.find_first_not_of(" \t\r"));
+        line.erase(line.find_last_not_of(" \t\r") + 1);
+
+        if (line.empty())
+            continue;
+
+        if (line.front() == '[' && line.back() == ']')
+        {
+            section = line.substr(1, line.size() - 2);
+            continue;
+        }
+
+        size_t pos = line.find('=');
+        if (pos == std::string::npos || pos == 0)
+            continue;
+
+        std::string key = line.substr(0, pos);
+        key.erase(key.find_last_not_of(" \t") + 1);
+        std::string value = line.substr(pos + 1);
+        value.erase(0, value.find_first_not_of(" \t"));
+
+        if (!value.empty())
+        {
+            if (value.front() == '"' || value.front() == '\'')
+            {
+                value.erase(0, 1);
+            }
+            if (!value.empty() && (value.back() == '"' || value.back() == '\''))
+            {
+                value.pop_back();
+            }
+        }
+
+        values[section + "." + key] = value;
+    }
+}
+
+bool ConfigFile::has(const std::string &section, const std::string &key) const
+{
+    return values.contains(section + "." + key);
+}
+
+std::string ConfigFile::get(const std::string &section, const std::string &key,
+                            const std::string &default_value) const
+{
+    auto it = values.find(section + "." + key);
+    return it != values.end() ? it->second : default_value;
+}
+
+int64_t ConfigFile::get_int(const std::string &section, const std::string &key, int64_t default_value) const
+{
+    auto it = values.find(section + "." + key);
+    if (it == values.end() || it->second.empty())
+    {
+        return default_value;
+    }
+
+    try
+    {
+        return std::stoll(it->second);
+    }
+    catch (const std::logic_error &e)
+    {
+        throw std::runtime_error("Invalid numeric value for " + section + "." + key + " in config");
+    }
+}
@@ -0,0 +1,213 @@
+#include "../include/DailyChallenge.hpp"
+#include "../include/DatabaseSync.hpp"
+#include "../include/NumberParsing.hpp"
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <charconv>
+#include <algorithm>
+#include <variant>
+#include <type_traits>
+
+namespace
+{
+    // splitmix64: соседние дни дают несвязанные зёрна
+    constexpr uint64_t mix(uint64_t value) noexcept
+    {
+        value += 0x9E3779B97F4A7C15ull;
+        value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+        value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+        return value ^ (value >> 31);
+    }
+
+    std::vector<TaskGenerator::TaskItem> generate(int64_t day, TaskGenerator::Difficulty difficulty)
+    {
+        const TaskGenerator generator(difficulty);
+        return generator.generate_sequence(DailyChallenge::length_for(difficulty),
+                                           DailyChallenge::seed_for(day, difficulty));
+    }
+
+    std::optional<TaskGenerator::TaskItem> parse_item(std::string_view token)
+    {
+        const std::size_t colon = token.find(':');
+        if (colon == std::string_view::npos)
+        {
+            return std::nullopt;
+        }
+        const std::string_view tag = token.substr(0, colon);
+        const std::string_view value = token.substr(colon + 1);
+
+        if (tag == "u16")
+        {
+            uint16_t number{};
+            if (NumberParsing::parse_whole(value, number))
+                return TaskGenerator::TaskItem{number};
+        }
+        else if (tag == "u32")
+        {
+            uint32_t number{};
+            if (NumberParsing::parse_whole(value, number))
+                return TaskGenerator::TaskItem{number};
+        }
+        else if (tag == "f")
+        {
+            float number{};
+            if (NumberParsing::parse_whole(value, number))
+                return TaskGenerator::TaskItem{number};
+        }
+        else if (tag == "c")
+        {
+            if (value.size() == 1)
+                return TaskGenerator::TaskItem{value[0]};
+        }
+        else if (tag == "w")
+        {
+            if (!value.empty())
+                return TaskGenerator::TaskItem{std::string(value)};
+        }
+        return std::nullopt;
+    }
+}
+
+DailyChallenge::DailyChallenge(DatabaseSync &db_sync)
+    : db_sync(db_sync)
+{
+}
+
+const std::vector<TaskGenerator::TaskItem> &DailyChallenge::sequence_for(TaskGenerator::Difficulty difficulty)
+{
+    const int64_t today = current_day();
+    if (today != cached_day)
+    {
+        cache = {};
+        cached_day = today;
+    }
+
+    auto &cached = cache[static_cast<std::size_t>(difficulty)];
+    if (cached)
+    {
+        return *cached;
+    }
+
+    const std::string day = format_day(today);
+    const int32_t level = static_cast<int32_t>(difficulty);
+    try
+    {
+        // первый клиент за день записывает последовательность, остальные читают её
+        std::optional<std::string> stored = db_sync.get_daily_challenge(day, level);
+        if (!stored)
+        {
+            stored = db_sync.create_daily_challenge(day, level, serialize(generate(today, difficulty)));
+        }
+
+        if (stored)
+        {
+            if (auto sequence = parse(*stored))
+            {
+                cached = std::move(*sequence);
+                return *cached;
+            }
+            std::cerr << "Stored daily challenge for " << day << " is malformed, regenerating\n";
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Failed to load daily challenge: " << e.what() << "\n";
+    }
+
+    cached = generate(today, difficulty);
+    return *cached;
+}
+
+int64_t DailyChallenge::current_day() noexcept
+{
+    return std::chrono::floor<std::chrono::days>(std::chrono::system_clock::now())
+        .time_since_epoch()
+        .count();
+}
+
+std::string DailyChallenge::format_day(int64_t day)
+{
+    const std::chrono::year_month_day date{std::chrono::sys_days{std::chrono::days{day}}};
+
+    std::ostringstream oss;
+    oss << std::setfill('0')
+        << std::setw(4) << static_cast<int>(date.year()) << "-"
+        << std::setw(2) << static_cast<unsigned>(date.month()) << "-"
+        << std::setw(2) << static_cast<unsigned>(date.day());
+    return oss.str();
+}
+
+uint64_t DailyChallenge::seed_for(int64_t day, TaskGenerator::Difficulty difficulty) noexcept
+{
+    return mix((static_cast<uint64_t>(day) << 8) | static_cast<uint64_t>(difficulty));
+}
+
+std::size_t DailyChallenge::length_for(TaskGenerator::Difficulty difficulty) noexcept
+{
+    return TaskGenerator::get_params_for_difficulty(difficulty).max_length;
+}
+
+std::string DailyChallenge::serialize(const std::vector<TaskGenerator::TaskItem> &sequence)
+{
+    std::string result;
+    std::array<char, 32> number;
+    for (const auto &item : sequence)
+    {
+        if (!result.empty())
+        {
+            result += ' ';
+        }
+        std::visit([&](const auto &value)
+                   {
+            using T = std::decay_t<decltype(value)>;
+            if constexpr (std::is_same_v<T, std::string>) {
+                result += "w:";
+                result += value;
+            }
+            else if constexpr (std::is_same_v<T, char>) {
+                result += "c:";
+                result += value;
+            }
+            else {
+                if constexpr (std::is_same_v<T, uint16_t>)
+                    result += "u16:";
+                else if constexpr (std::is_same_v<T, uint32_t>)
+                    result += "u32:";
+                else
+                    result += "f:";
+                // кратчайшая запись, которая читается обратно в то же значение
+                const auto converted = std::to_chars(number.data(), number.data() + number.size(), value);
+                result.append(number.data(), converted.ptr);
+            } }, item);
+    }
+    return result;
+}
+
+std::optional<std::vector<TaskGenerator::TaskItem>> DailyChallenge::parse(std::string_view text)
+{
+    std::vector<TaskGenerator::TaskItem> sequence;
+    std::size_t position{0};
+    while (position < text.size())
+    {
+        const std::size_t end = std::min(text.find(' ', position), text.size());
+        if (end > position)
+        {
+            auto item = parse_item(text.substr(position, end - position));
+            if (!item)
+            {
+                return std::nullopt;
+            }
+            sequence.push_back(std::move(*item));
+        }
+        position = end + 1;
+    }
+
+    if (sequence.empty())
+    {
+        return std::nullopt;
+    }
+    return sequence;
+}
@@ -1,272 +1,661 @@
 #include "../include/DatabaseSync.hpp"
+#include "../include/PostgresStorage.hpp"
+#include "../include/EmbeddedStorage.hpp"
+#include "../include/ShardedStorage.hpp"
+#include "../include/PgEventLoop.hpp"
+#include "../include/ConfigFile.hpp"
 #include "../include/Menu.hpp"
+#include "../include/Metrics.hpp"
+#include "../include/Tracing.hpp"
 
+#include <algorithm>
+#include <stdexcept>
 #include <iostream>
-#include <fstream>
-#include <system_error>
-#include <format>
-#include <unordered_map>
+#include <cctype>
+
+namespace
+{
+    MetricCounter primary_reads("mem_trainer_db_reads_total", "Read queries by target", "target=\"primary\"");
+    MetricCounter replica_reads("mem_trainer_db_reads_total", "Read queries by target", "target=\"replica\"");
+    MetricCounter replica_fallbacks("mem_trainer_db_replica_fallbacks_total",
+                                    "Replica reads retried on the primary after a replica error");
+
+    std::unique_ptr<StorageBackend> backend_from_config()
+    {
+        ConfigFile config("config.ini");
+        const std::string backend = config.get("storage", "backend", "postgres");
+        if (backend == "postgres")
+        {
+            auto shards = ShardedStorage::shards_from_config(config);
+            if (shards.empty())
+            {
+                return std::make_unique<PostgresStorage>();
+            }
+            Menu().print_message("Using " + std::to_string(shards.size()) + " database shards\n");
+            return std::make_unique<ShardedStorage>(std::move(shards));
+        }
+        if (backend == "embedded")
+        {
+            EmbeddedStorage::Options options;
+            options.directory = config.get("storage", "path", "mem_trainer_data");
+            options.snapshot_wal_bytes = static_cast<uint64_t>(
+                std::max<int64_t>(4096, config.get_int("storage", "snapshot_wal_bytes", 4 << 20)));
+            options.sync_writes = config.get_int("storage", "sync_writes", 1) != 0;
+            Menu().print_message("Using embedded storage in " + options.directory.string() + "\n");
+            return std::make_unique<EmbeddedStorage>(std::move(options));
+        }
+        throw std::runtime_error("Unknown storage backend in config.ini: " + backend);
+    }
+}
 
 DatabaseSync::DatabaseSync(const std::string &conninfo)
-    : connection_info(conninfo)
+    : storage(std::make_unique<PostgresStorage>(conninfo))
+{
+}
+
+DatabaseSync::DatabaseSync(std::unique_ptr<StorageBackend> backend)
+    : storage(std::move(backend))
 {
-    std::cout << "Using explicit connection parameters\n";
 }
 
-// config.ini
 DatabaseSync::DatabaseSync()
+    : storage(backend_from_config())
 {
-    connection_info = parse_config_file();
-    if (connection_info.empty())
-    {
-        throw std::runtime_error("Invalid database configuration in config.ini");
-    }
-    auto menu = std::make_unique<Menu>();
-    menu->print_message("Using config.ini file connection\n");
+    const ConfigFile config("config.ini");
+    load_replicas(config);
+    async_connections = static_cast<std::size_t>(
+        std::clamp<int64_t>(config.get_int("database", "async_connections", 2), 0, 64));
 }
 
-DatabaseSync::~DatabaseSync()
+DatabaseSync::~DatabaseSync() = default;
+
+void DatabaseSync::load_replicas(const ConfigFile &config)
 {
-    if (db_connection)
+    const std::string hosts = config.get("replicas", "hosts");
+    if (hosts.empty())
+    {
+        return;
+    }
+    if (config.get("storage", "backend", "postgres") != "postgres")
+    {
+        std::cerr << "[replicas] is ignored: read replicas need the postgres backend\n";
+        return;
+    }
+    if (!config.get("shards", "databases").empty())
     {
-        PQfinish(db_connection.get());
+        std::cerr << "[replicas] is ignored: read replicas are not supported together with [shards]\n";
+        return;
+    }
+
+    const auto millis = [&config](const char *key, int64_t default_value)
+    {
+        return std::chrono::milliseconds(std::max<int64_t>(0, config.get_int("replicas", key, default_value)));
+    };
+    replica_options.max_lag = millis("max_lag_ms", 5000);
+    replica_options.read_your_writes = std::max(millis("read_your_writes_ms", 5000), replica_options.max_lag);
+    replica_options.check_interval = millis("check_interval_ms", 1000);
+
+    // hosts=host[:port],host[:port]; остальные параметры соединения - из [database]
+    std::size_t begin{0};
+    while (begin <= hosts.size())
+    {
+        const std::size_t end = std::min(hosts.find(',', begin), hosts.size());
+        std::string entry = hosts.substr(begin, end - begin);
+        entry.erase(std::remove_if(entry.begin(), entry.end(), [](unsigned char c)
+                                   { return std::isspace(c) != 0; }),
+                    entry.end());
+        begin = end + 1;
+        if (entry.empty())
+        {
+            continue;
+        }
+
+        const std::size_t colon = entry.rfind(':');
+        const std::string host = entry.substr(0, colon);
+        const std::string port = colon == std::string::npos ? "" : entry.substr(colon + 1);
+        // недоступная реплика не должна задерживать запуск дольше пары секунд
+        const std::string conninfo = PostgresStorage::parse_config_file(host, port) + " connect_timeout=2";
+        auto replica = std::make_unique<PostgresStorage>(conninfo);
+        // медленные чтения с реплик пишутся в тот же журнал, что и запросы к primary
+        if (const auto *primary = dynamic_cast<const PostgresStorage *>(storage.get()))
+        {
+            replica->set_slow_query_log(primary->shared_slow_query_log());
+        }
+        replicas.push_back(ReadReplica{entry, std::move(replica)});
     }
 }
 
-std::string DatabaseSync::parse_config_file()
+bool DatabaseSync::connect()
 {
-    std::ifstream config("config.ini");
-    if (!config.is_open())
+    const TraceSpan span("connect", "db");
+    if (!storage->connect())
     {
-        throw std::runtime_error("Configuration file config.ini not found");
+        return false;
     }
 
-    std::unordered_map<std::string, std::string> params = {
-        {"host", "localhost"},
-        {"port", "5432"},
-        {"dbname", ""},
-        {"user", ""},
-        {"password", ""}};
-
-    std::string line;
-    while (getline(config, line))
+    // асинхронные запросы - только к единственному PostgreSQL; шарды и встроенное хранилище
+    // выполняют *_async синхронно
+    auto *postgres = dynamic_cast<PostgresStorage *>(storage.get());
+    if (postgres && async_connections > 0 && !event_loop)
     {
-        size_t comment_pos = line.find_first_of('#');
-        if (comment_pos != std::string::npos)
+        event_loop = std::make_unique<PgEventLoop>(postgres->conninfo(), async_connections,
+                                                   postgres->slow_query_log());
+        if (!event_loop->start())
         {
-            line.erase(comment_pos);
+            std::cerr << "Asynchronous queries are disabled: " << event_loop->last_error() << "\n";
+            event_loop.reset();
         }
+    }
 
-        line.erase(0, line.find_first_not_of(" \t"));
-        line.erase(line.find_last_not_of(" \t") + 1);
-
-        if (line.empty())
-            continue;
-
-        for (auto &[key, _] : params)
+    for (auto &replica : replicas)
+    {
+        // реплики необязательны: без них все чтения идут на primary
+        replica.healthy = false;
+        if (replica.storage->connect())
         {
-            size_t pos = line.find(key + "=");
-            if (pos != std::string::npos && pos == 0)
-            {
-                std::string value = line.substr(key.length() + 1);
-
-                if (!value.empty())
-                {
-                    if (value.front() == '"' || value.front() == '\'')
-                    {
-                        value.erase(0, 1);
-                    }
-                    if (value.back() == '"' || value.back() == '\'')
-                    {
-                        value.pop_back();
-                    }
-                }
-
-                params[key] = value;
-                break;
-            }
+            refresh_replica(replica);
+        }
+        else
+        {
+            replica.checked = std::chrono::steady_clock::now();
+            std::cerr << "Read replica " << replica.name << " is unavailable, reading from the primary\n";
         }
     }
+    return true;
+}
 
-    if (params["dbname"].empty() || params["user"].empty() || params["password"].empty())
+void DatabaseSync::refresh_replica(ReadReplica &replica) const
+{
+    replica.checked = std::chrono::steady_clock::now();
+    if (!replica.storage->is_connected() && !replica.storage->connect())
     {
-        throw std::runtime_error("Missing required database parameters in config.ini");
+        replica.healthy = false;
+        return;
     }
 
-    return std::format(
-        "host={} port={} dbname={} user={} password={}",
-        params["host"], params["port"], params["dbname"],
-        params["user"], params["password"]);
+    const std::optional<double> lag = replica.storage->replication_lag_seconds();
+    replica.healthy = lag && std::chrono::duration<double>(*lag) <= replica_options.max_lag;
 }
 
-bool DatabaseSync::connect()
+DatabaseSync::ReadReplica *DatabaseSync::pick_replica() const
 {
-    db_connection = std::shared_ptr<PGconn>(
-        PQconnectdb(connection_info.c_str()),
-        PQfinish);
+    if (replicas.empty())
+    {
+        return nullptr;
+    }
 
-    if (PQstatus(db_connection.get()) != CONNECTION_OK)
+    // своя запись могла ещё не дойти до реплики
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_write < replica_options.read_your_writes)
     {
-        std::cerr << "PQerrorMessage: " << PQerrorMessage(db_connection.get()) << std::endl;
-        return false;
+        return nullptr;
     }
 
-    return true;
+    for (std::size_t attempt{0}; attempt < replicas.size(); ++attempt)
+    {
+        ReadReplica &replica = replicas[next_replica++ % replicas.size()];
+        if (now - replica.checked >= replica_options.check_interval)
+        {
+            refresh_replica(replica);
+        }
+        if (replica.healthy)
+        {
+            return &replica;
+        }
+    }
+    return nullptr;
 }
 
-PGresult *DatabaseSync::execute_params(const char *query,
-                                       const std::vector<const char *> &values,
-                                       const std::vector<int32_t> &lengths)
+template <typename Read>
+auto DatabaseSync::read(Read &&query) const -> decltype(query(std::declval<StorageBackend &>()))
 {
-    return PQexecParams(
-        get_connection(),
-        query,
-        values.size(),
-        nullptr,
-        values.data(),
-        lengths.data(),
-        nullptr,
-        0);
+    if (ReadReplica *replica = pick_replica())
+    {
+        try
+        {
+            auto result = query(static_cast<StorageBackend &>(*replica->storage));
+            // часть запросов при ошибке возвращает пустой результат; потерянное соединение
+            // значит, что ему нельзя верить
+            if (replica->storage->is_connected())
+            {
+                replica_reads.increment();
+                return result;
+            }
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Read replica query failed, retrying on the primary: " << e.what() << "\n";
+        }
+        replica->healthy = false;
+        replica_fallbacks.increment();
+    }
+
+    primary_reads.increment();
+    return query(*storage);
 }
 
-bool DatabaseSync::save_progress(uint32_t user_id, uint32_t sequence_length, float success_rate)
+bool DatabaseSync::is_connected() const
 {
-    std::string sl_str = std::to_string(sequence_length);
-    std::string sr_str = std::to_string(success_rate);
-    std::string uid_str = std::to_string(user_id);
+    return storage->is_connected();
+}
 
-    std::vector<const char *> values = {
-        uid_str.c_str(),
-        sl_str.c_str(),
-        sr_str.c_str()};
+std::string DatabaseSync::last_error() const
+{
+    return storage->last_error();
+}
 
-    std::vector<int32_t> lengths(values.size(), -1); // -1 - строки с null-terminator
+std::optional<UserCredential> DatabaseSync::get_user_credential(const std::string &username) const
+{
+    const TraceSpan span("get_user_credential", "db");
+    return storage->get_user_credential(username);
+}
 
-    PGresult *res = execute_params(
-        "INSERT INTO user_progress (user_id, sequence_length, success_rate) VALUES ($1, $2, $3)",
-        values,
-        lengths);
+bool DatabaseSync::register_user(const std::string &username, const std::string &password)
+{
+    const TraceSpan span("register_user", "db");
+    note_write();
+    return storage->register_user(username, password);
+}
 
-    bool success = PQresultStatus(res) == PGRES_COMMAND_OK;
-    PQclear(res);
-    return success;
+bool DatabaseSync::update_password(uint32_t user_id, const std::string &password)
+{
+    const TraceSpan span("update_password", "db");
+    note_write();
+    return storage->update_password(user_id, password);
 }
 
-bool DatabaseSync::update_difficulty(uint32_t user_id, uint32_t new_level)
+std::optional<int64_t> DatabaseSync::save_progress(uint32_t user_id, int32_t difficulty, uint32_t sequence_length,
+                                                   float success_rate, uint32_t memorization_ms, uint32_t answer_ms)
 {
-    const char *params[2] = {
-        std::to_string(new_level).c_str(),
-        std::to_string(user_id).c_str()};
+    const TraceSpan span("save_progress", "db");
+    note_write();
+    return storage->save_progress(user_id, difficulty, sequence_length, success_rate, memorization_ms, answer_ms);
+}
+
+bool DatabaseSync::save_progress_items(std::vector<ProgressItem> &items)
+{
+    const TraceSpan span("save_progress_items", "db");
+    note_write();
+    return storage->save_progress_items(items);
+}
 
-    PGresult *res = PQexecParams(get_connection(),
-                                 "UPDATE users SET difficulty_level = $1 WHERE id = $2",
-                                 2, NULL, params, NULL, NULL, 0);
+bool DatabaseSync::save_exam_results(const std::vector<ExamResult> &results)
+{
+    const TraceSpan span("save_exam_results", "db");
+    note_write();
+    return storage->save_exam_results(results);
+}
 
-    bool success = PQresultStatus(res) == PGRES_COMMAND_OK;
-    PQclear(res);
-    return success;
+bool DatabaseSync::update_difficulty(uint32_t user_id, uint32_t new_level)
+{
+    const TraceSpan span("update_difficulty", "db");
+    note_write();
+    return storage->update_difficulty(user_id, new_level);
 }
 
 bool DatabaseSync::update_score(uint32_t user_id, uint32_t score_delta)
 {
-    const char *params[2] = {
-        std::to_string(score_delta).c_str(),
-        std::to_string(user_id).c_str()};
+    const TraceSpan span("update_score", "db");
+    note_write();
+    return storage->update_score(user_id, score_delta);
+}
 
-    PGresult *res = PQexecParams(get_connection(),
-                                 "UPDATE users SET total_score = total_score + $1 WHERE id = $2",
-                                 2, NULL, params, NULL, NULL, 0);
+std::optional<std::size_t> DatabaseSync::compact_scores(uint32_t max_events)
+{
+    const TraceSpan span("compact_scores", "db");
+    note_write();
+    return storage->compact_scores(max_events);
+}
+
+std::vector<UserProgress> DatabaseSync::get_user_progress(uint32_t user_id)
+{
+    const TraceSpan span("get_user_progress", "db");
+    return read([&](StorageBackend &backend)
+                { return backend.get_user_progress(user_id); });
+}
 
-    bool success = PQresultStatus(res) == PGRES_COMMAND_OK;
-    PQclear(res);
-    return success;
+std::vector<ProgressPoint> DatabaseSync::get_progress_buckets(uint32_t user_id, ProgressBucket bucket,
+                                                              uint32_t max_buckets) const
+{
+    const TraceSpan span("get_progress_buckets", "db");
+    return read([&](StorageBackend &backend)
+                { return backend.get_progress_buckets(user_id, bucket, max_buckets); });
 }
 
 int32_t DatabaseSync::get_user_difficulty(uint32_t user_id) const
 {
-    if (!db_connection || PQstatus(get_connection()) != CONNECTION_OK)
-    {
-        throw std::runtime_error("Database connection error");
-    }
+    const TraceSpan span("get_user_difficulty", "db");
+    return read([&](StorageBackend &backend)
+                { return backend.get_user_difficulty(user_id); });
+}
 
-    const char *params[1] = {
-        std::to_string(user_id).c_str()};
+std::vector<uint32_t> DatabaseSync::get_unknown_users(const std::vector<uint32_t> &user_ids) const
+{
+    const TraceSpan span("get_unknown_users", "db");
+    return read([&](StorageBackend &backend)
+                { return backend.get_unknown_users(user_ids); });
+}
 
-    PGresult *res = PQexecParams(get_connection(),
-                                 "SELECT difficulty_level FROM users WHERE id = $1",
-                                 1, NULL, params, NULL, NULL, 0);
+std::optional<UserSchedule> DatabaseSync::get_user_schedule(uint32_t user_id) const
+{
+    const TraceSpan span("get_user_schedule", "db");
+    return read([&](StorageBackend &backend)
+                { return backend.get_user_schedule(user_id); });
+}
 
-    if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0)
-    {
-        PQclear(res);
-        return 0; // EASY по умолчанию
-    }
+bool DatabaseSync::save_user_schedule(const UserSchedule &schedule)
+{
+    const TraceSpan span("save_user_schedule", "db");
+    note_write();
+    return storage->save_user_schedule(schedule);
+}
 
-    int32_t difficulty = std::stoi(PQgetvalue(res, 0, 0));
-    PQclear(res);
-    return difficulty;
+std::vector<UserSchedule> DatabaseSync::get_due_schedules(int64_t due_from, int64_t due_before,
+                                                         uint32_t limit) const
+{
+    const TraceSpan span("get_due_schedules", "db");
+    return read([&](StorageBackend &backend)
+                { return backend.get_due_schedules(due_from, due_before, limit); });
 }
 
-std::vector<UserProgress> DatabaseSync::get_user_progress(uint32_t user_id)
+std::optional<std::string> DatabaseSync::get_weak_items(uint32_t user_id) const
 {
-    // проверка соединения
-    if (!db_connection || PQstatus(get_connection()) != CONNECTION_OK)
-    {
-        throw std::runtime_error("Database connection is not established");
-    }
+    const TraceSpan span("get_weak_items", "db");
+    return read([&](StorageBackend &backend)
+                { return backend.get_weak_items(user_id); });
+}
 
-    std::vector<UserProgress> progress;
-    const std::string user_id_str = std::to_string(user_id);
-    const char *params[1] = {user_id_str.c_str()};
+bool DatabaseSync::save_weak_items(uint32_t user_id, const std::string &sketch)
+{
+    const TraceSpan span("save_weak_items", "db");
+    note_write();
+    return storage->save_weak_items(user_id, sketch);
+}
+
+bool DatabaseSync::save_marathon_result(uint32_t user_id, uint32_t length, uint32_t score, float success_rate,
+                                        uint32_t memorization_ms, uint32_t answer_ms)
+{
+    const TraceSpan span("save_marathon_result", "db");
+    note_write();
+    return storage->save_marathon_result(user_id, length, score, success_rate, memorization_ms, answer_ms);
+}
+
+LeaderboardRows DatabaseSync::get_leaderboard(LeaderboardPeriod period, uint32_t limit,
+                                              const std::string &anchor_date) const
+{
+    const TraceSpan span("get_leaderboard", "db");
+    return read([&](StorageBackend &backend)
+                { return backend.get_leaderboard(period, limit, anchor_date); });
+}
 
-    PGresult *res = PQexecParams(get_connection(),
-                                 "SELECT sequence_length, success_rate, training_date FROM user_progress "
-                                 "WHERE user_id = $1 ORDER BY training_date DESC",
-                                 1, nullptr, params, nullptr, nullptr, 0);
+std::optional<std::string> DatabaseSync::get_daily_challenge(const std::string &day, int32_t difficulty) const
+{
+    const TraceSpan span("get_daily_challenge", "db");
+    return storage->get_daily_challenge(day, difficulty);
+}
 
-    if (PQresultStatus(res) != PGRES_TUPLES_OK)
+std::optional<std::string> DatabaseSync::create_daily_challenge(const std::string &day, int32_t difficulty,
+                                                                const std::string &items)
+{
+    const TraceSpan span("create_daily_challenge", "db");
+    note_write();
+    return storage->create_daily_challenge(day, difficulty, items);
+}
+
+bool DatabaseSync::save_daily_challenge_result(const std::string &day, uint32_t user_id, int32_t difficulty,
+                                               uint32_t score, float success_rate)
+{
+    const TraceSpan span("save_daily_challenge_result", "db");
+    note_write();
+    return storage->save_daily_challenge_result(day, user_id, difficulty, score, success_rate);
+}
+
+std::optional<DailyChallengeScore> DatabaseSync::get_daily_challenge_score(const std::string &day, uint32_t user_id) const
+{
+    const TraceSpan span("get_daily_challenge_score", "db");
+    return read([&](StorageBackend &backend)
+                { return backend.get_daily_challenge_score(day, user_id); });
+}
+
+LeaderboardRows DatabaseSync::get_daily_leaderboard(const std::string &day, int32_t difficulty,
+                                                    uint32_t limit) const
+{
+    const TraceSpan span("get_daily_leaderboard", "db");
+    return read([&](StorageBackend &backend)
+                { return backend.get_daily_leaderboard(day, difficulty, limit); });
+}
+
+std::size_t DatabaseSync::export_progress(const std::function<void(std::string_view)> &on_row) const
+{
+    const TraceSpan span("export_progress", "db");
+    // строки уже отданы on_row по ходу чтения, поэтому повтора на primary нет
+    if (ReadReplica *replica = pick_replica())
+    {
+        replica_reads.increment();
+        return replica->storage->export_progress(on_row);
+    }
+    primary_reads.increment();
+    return storage->export_progress(on_row);
+}
+
+template <typename MakeRequest, typename Sync>
+auto DatabaseSync::submit(MakeRequest &&make_request, Sync &&sync) const -> std::future<decltype(sync())>
+{
+    if (event_loop)
     {
-        const std::string error_msg = PQerrorMessage(get_connection());
-        PQclear(res);
-        throw std::runtime_error("Database query failed: " + error_msg);
+        return event_loop->submit(make_request());
     }
 
+    std::promise<decltype(sync())> done;
     try
     {
-        const uint32_t rows = PQntuples(res);
-        progress.reserve(rows);
+        done.set_value(sync());
+    }
+    catch (...)
+    {
+        done.set_exception(std::current_exception());
+    }
+    return done.get_future();
+}
 
-        for (std::size_t i{0}; i < rows; ++i)
-        {
-            UserProgress record;
+std::string DatabaseSync::last_async_error() const
+{
+    return event_loop ? event_loop->last_error() : storage->last_error();
+}
 
-            const char *length_str = PQgetvalue(res, i, 0);
-            const char *rate_str = PQgetvalue(res, i, 1);
+std::future<std::optional<UserCredential>> DatabaseSync::get_user_credential_async(const std::string &username) const
+{
+    return submit([&] { return PostgresStorage::get_user_credential_request(username); },
+                  [&] { return get_user_credential(username); });
+}
 
-            try
-            {
-                record.sequence_length = std::stoi(length_str);
-                record.success_rate = std::stof(rate_str);
-            }
-            catch (const std::invalid_argument &e)
-            {
-                throw std::runtime_error("Invalid numeric format in database record");
-            }
-            catch (const std::out_of_range &e)
-            {
-                throw std::runtime_error("Numeric value out of range in database record");
-            }
+std::future<bool> DatabaseSync::register_user_async(const std::string &username, const std::string &password)
+{
+    note_write();
+    return submit([&] { return PostgresStorage::register_user_request(username, password); },
+                  [&] { return storage->register_user(username, password); });
+}
 
-            record.training_date = PQgetvalue(res, i, 2);
-            progress.push_back(std::move(record));
-        }
+std::future<bool> DatabaseSync::update_password_async(uint32_t user_id, const std::string &password)
+{
+    note_write();
+    return submit([&] { return PostgresStorage::update_password_request(user_id, password); },
+                  [&] { return storage->update_password(user_id, password); });
+}
+
+std::future<std::optional<int64_t>> DatabaseSync::save_progress_async(uint32_t user_id, int32_t difficulty,
+                                                                      uint32_t sequence_length, float success_rate,
+                                                                      uint32_t memorization_ms, uint32_t answer_ms)
+{
+    note_write();
+    return submit([&]
+                  { return PostgresStorage::save_progress_request(user_id, difficulty, sequence_length, success_rate,
+                                                                  memorization_ms, answer_ms); },
+                  [&]
+                  { return storage->save_progress(user_id, difficulty, sequence_length, success_rate,
+                                                  memorization_ms, answer_ms); });
+}
+
+std::future<bool> DatabaseSync::save_progress_items_async(const std::vector<ProgressItem> &items)
+{
+    note_write();
+    if (items.empty())
+    {
+        std::promise<bool> done;
+        done.set_value(true);
+        return done.get_future();
     }
-    catch (...)
+    return submit([&] { return PostgresStorage::save_progress_items_request(items); },
+                  [&]
+                  {
+                      std::vector<ProgressItem> rest = items;
+                      return storage->save_progress_items(rest);
+                  });
+}
+
+std::future<bool> DatabaseSync::save_exam_results_async(const std::vector<ExamResult> &results)
+{
+    note_write();
+    if (results.empty())
     {
-        PQclear(res);
-        throw;
+        std::promise<bool> done;
+        done.set_value(true);
+        return done.get_future();
     }
+    return submit([&] { return PostgresStorage::save_exam_results_request(results); },
+                  [&] { return storage->save_exam_results(results); });
+}
+
+std::future<bool> DatabaseSync::update_difficulty_async(uint32_t user_id, uint32_t new_level)
+{
+    note_write();
+    return submit([&] { return PostgresStorage::update_difficulty_request(user_id, new_level); },
+                  [&] { return storage->update_difficulty(user_id, new_level); });
+}
+
+std::future<bool> DatabaseSync::update_score_async(uint32_t user_id, uint32_t score_delta)
+{
+    note_write();
+    return submit([&] { return PostgresStorage::update_score_request(user_id, score_delta); },
+                  [&] { return storage->update_score(user_id, score_delta); });
+}
+
+std::future<std::optional<std::size_t>> DatabaseSync::compact_scores_async(uint32_t max_events)
+{
+    note_write();
+    return submit([&] { return PostgresStorage::compact_scores_request(max_events); },
+                  [&] { return storage->compact_scores(max_events); });
+}
+
+std::future<std::vector<UserProgress>> DatabaseSync::get_user_progress_async(uint32_t user_id) const
+{
+    return submit([&] { return PostgresStorage::get_user_progress_request(user_id); },
+                  [&] { return read([&](StorageBackend &backend)
+                                    { return backend.get_user_progress(user_id); }); });
+}
+
+std::future<std::vector<ProgressPoint>> DatabaseSync::get_progress_buckets_async(uint32_t user_id,
+                                                                                 ProgressBucket bucket,
+                                                                                 uint32_t max_buckets) const
+{
+    return submit([&] { return PostgresStorage::get_progress_buckets_request(user_id, bucket, max_buckets); },
+                  [&] { return get_progress_buckets(user_id, bucket, max_buckets); });
+}
+
+std::future<int32_t> DatabaseSync::get_user_difficulty_async(uint32_t user_id) const
+{
+    return submit([&] { return PostgresStorage::get_user_difficulty_request(user_id); },
+                  [&] { return get_user_difficulty(user_id); });
+}
+
+std::future<std::optional<UserSchedule>> DatabaseSync::get_user_schedule_async(uint32_t user_id) const
+{
+    return submit([&] { return PostgresStorage::get_user_schedule_request(user_id); },
+                  [&] { return get_user_schedule(user_id); });
+}
+
+std::future<bool> DatabaseSync::save_user_schedule_async(const UserSchedule &schedule)
+{
+    note_write();
+    return submit([&] { return PostgresStorage::save_user_schedule_request(schedule); },
+                  [&] { return storage->save_user_schedule(schedule); });
+}
+
+std::future<std::vector<UserSchedule>> DatabaseSync::get_due_schedules_async(int64_t due_from,
+                                                                             int64_t due_before,
+                                                                             uint32_t limit) const
+{
+    return submit([&] { return PostgresStorage::get_due_schedules_request(due_from, due_before, limit); },
+                  [&] { return get_due_schedules(due_from, due_before, limit); });
+}
+
+std::future<bool> DatabaseSync::save_weak_items_async(uint32_t user_id, const std::string &sketch)
+{
+    note_write();
+    return submit([&] { return PostgresStorage::save_weak_items_request(user_id, sketch); },
+                  [&] { return storage->save_weak_items(user_id, sketch); });
+}
+
+std::future<bool> DatabaseSync::save_marathon_result_async(uint32_t user_id, uint32_t length, uint32_t score,
+                                                           float success_rate, uint32_t memorization_ms,
+                                                           uint32_t answer_ms)
+{
+    note_write();
+    return submit([&]
+                  { return PostgresStorage::save_marathon_result_request(user_id, length, score, success_rate,
+                                                                         memorization_ms, answer_ms); },
+                  [&]
+                  { return storage->save_marathon_result(user_id, length, score, success_rate, memorization_ms,
+                                                         answer_ms); });
+}
+
+std::future<LeaderboardRows> DatabaseSync::get_leaderboard_async(LeaderboardPeriod period, uint32_t limit,
+                                                                 const std::string &anchor_date) const
+{
+    return submit([&] { return PostgresStorage::get_leaderboard_request(period, limit, anchor_date); },
+                  [&] { return get_leaderboard(period, limit, anchor_date); });
+}
 
-    PQclear(res);
-    return progress;
+std::future<std::optional<std::string>> DatabaseSync::get_daily_challenge_async(const std::string &day,
+                                                                                int32_t difficulty) const
+{
+    return submit([&] { return PostgresStorage::get_daily_challenge_request(day, difficulty); },
+                  [&] { return get_daily_challenge(day, difficulty); });
+}
+
+std::future<std::optional<std::string>> DatabaseSync::create_daily_challenge_async(const std::string &day,
+                                                                                   int32_t difficulty,
+                                                                                   const std::string &items)
+{
+    note_write();
+    return submit([&] { return PostgresStorage::create_daily_challenge_request(day, difficulty, items); },
+                  [&] { return storage->create_daily_challenge(day, difficulty, items); });
+}
+
+std::future<bool> DatabaseSync::save_daily_challenge_result_async(const std::string &day, uint32_t user_id,
+                                                                  int32_t difficulty, uint32_t score,
+                                                                  float success_rate)
+{
+    note_write();
+    return submit([&]
+                  { return PostgresStorage::save_daily_challenge_result_request(day, user_id, difficulty, score,
+                                                                                success_rate); },
+                  [&]
+                  { return storage->save_daily_challenge_result(day, user_id, difficulty, score,
+                                                                success_rate); });
+}
+
+std::future<std::optional<DailyChallengeScore>> DatabaseSync::get_daily_challenge_score_async(const std::string &day,
+                                                                                              uint32_t user_id) const
+{
+    return submit([&] { return PostgresStorage::get_daily_challenge_score_request(day, user_id); },
+                  [&] { return get_daily_challenge_score(day, user_id); });
+}
+
+std::future<LeaderboardRows> DatabaseSync::get_daily_leaderboard_async(const std::string &day,
+                                                                       int32_t difficulty,
+                                                                       uint32_t limit) const
+{
+    return submit([&] { return PostgresStorage::get_daily_leaderboard_request(day, difficulty, limit); },
+                  [&] { return get_daily_leaderboard(day, difficulty, limit); });
 }
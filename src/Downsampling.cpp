@@ -0,0 +1,75 @@
+#include "../include/Downsampling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+std::vector<std::size_t> Downsampling::lttb(std::span<const double> x, std::span<const double> y,
+                                            std::size_t target)
+{
+    const std::size_t size = std::min(x.size(), y.size());
+    std::vector<std::size_t> selected;
+    if (target >= size || size <= 2)
+    {
+        selected.resize(size);
+        std::iota(selected.begin(), selected.end(), std::size_t{0});
+        return selected;
+    }
+    if (target < 3)
+    {
+        // промежуточных бакетов нет: только концы ряда
+        selected.push_back(0);
+        if (target == 2)
+        {
+            selected.push_back(size - 1);
+        }
+        return selected;
+    }
+
+    selected.reserve(target);
+    selected.push_back(0);
+
+    // концы ряда не делятся: остальные size - 2 точки - на target - 2 бакета
+    const double bucket_size = static_cast<double>(size - 2) / static_cast<double>(target - 2);
+    const auto bucket_begin = [&](std::size_t bucket)
+    {
+        return std::min(size - 1, static_cast<std::size_t>(std::floor(bucket * bucket_size)) + 1);
+    };
+
+    std::size_t previous{0};
+    for (std::size_t bucket{0}; bucket < target - 2; ++bucket)
+    {
+        // третья вершина - среднее следующего бакета (для последнего - последняя точка)
+        const std::size_t next_begin = bucket_begin(bucket + 1);
+        const std::size_t next_end = std::max(next_begin + 1, bucket_begin(bucket + 2));
+        double average_x{0.0};
+        double average_y{0.0};
+        for (std::size_t i{next_begin}; i < next_end; ++i)
+        {
+            average_x += x[i];
+            average_y += y[i];
+        }
+        average_x /= static_cast<double>(next_end - next_begin);
+        average_y /= static_cast<double>(next_end - next_begin);
+
+        const std::size_t end = bucket_begin(bucket + 1);
+        std::size_t best{bucket_begin(bucket)};
+        double best_area{-1.0};
+        for (std::size_t i{bucket_begin(bucket)}; i < end; ++i)
+        {
+            // удвоенная площадь; для сравнения множитель 1/2 не нужен
+            const double area = std::abs((x[previous] - average_x) * (y[i] - y[previous]) -
+                                         (x[previous] - x[i]) * (average_y - y[previous]));
+            if (area > best_area)
+            {
+                best_area = area;
+                best = i;
+            }
+        }
+        selected.push_back(best);
+        previous = best;
+    }
+
+    selected.push_back(size - 1);
+    return selected;
+}
@@ -0,0 +1,1541 @@
+#include "../include/EmbeddedStorage.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+#include <charconv>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <stdexcept>
+#include <system_error>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr char WAL_MAGIC[4] = {'M', 'T', 'W', 'L'};
+    constexpr char SNAPSHOT_MAGIC[4] = {'M', 'T', 'S', 'S'};
+    constexpr uint32_t FORMAT_VERSION = 1;
+    constexpr std::size_t WAL_HEADER_BYTES = 8;       // magic, версия
+    constexpr std::size_t SNAPSHOT_HEADER_BYTES = 16; // magic, версия, lsn
+    constexpr std::size_t FRAME_HEADER_BYTES = 16;    // длина, контрольная сумма, lsn
+    constexpr std::size_t SNAPSHOT_BATCH_ROWS = 4096;
+    constexpr std::size_t MAX_USERNAME = 50;
+    constexpr std::size_t MAX_PASSWORD = 100;
+    constexpr std::size_t MAX_SEQUENCE_ID = 64;
+
+    enum class WalOp : uint8_t
+    {
+        USER_PUT = 1,
+        DIFFICULTY_SET,
+        SCORE_ADD,
+        SCORE_DAILY_PUT,
+        PROGRESS_INSERT, // формат до сохранения сложности раунда: difficulty = -1
+        ITEMS_INSERT,
+        SCHEDULE_PUT,
+        CHALLENGE_PUT,
+        CHALLENGE_RESULT_PUT,
+        EXAM_INSERT, // формат до частичного зачёта: credit = correct
+        SNAPSHOT_END,
+        EXAM_GRADED_INSERT,
+        PASSWORD_SET,
+        WEAK_ITEMS_PUT,
+        MARATHON_INSERT,
+        PROGRESS_LEVEL_INSERT
+    };
+
+    uint32_t fnv1a(std::string_view bytes, uint32_t hash = 2166136261u) noexcept
+    {
+        for (const char byte : bytes)
+        {
+            hash = (hash ^ static_cast<uint8_t>(byte)) * 16777619u;
+        }
+        return hash;
+    }
+
+    // поля записи в порядке байтов платформы, строки - с длиной uint32
+    class RecordWriter
+    {
+    public:
+        explicit RecordWriter(WalOp op) { put(static_cast<uint8_t>(op)); }
+
+        template <typename T>
+        void put(T value)
+        {
+            payload.append(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+
+        void put_string(std::string_view value)
+        {
+            put(static_cast<uint32_t>(value.size()));
+            payload.append(value);
+        }
+
+        std::string payload;
+    };
+
+    class RecordReader
+    {
+    public:
+        explicit RecordReader(std::string_view payload) : data(payload) {}
+
+        template <typename T>
+        T get()
+        {
+            if (data.size() < sizeof(T))
+            {
+                throw std::runtime_error("truncated storage record");
+            }
+            T value;
+            std::memcpy(&value, data.data(), sizeof(T));
+            data.remove_prefix(sizeof(T));
+            return value;
+        }
+
+        std::string get_string()
+        {
+            const uint32_t length = get<uint32_t>();
+            if (data.size() < length)
+            {
+                throw std::runtime_error("truncated storage record");
+            }
+            std::string value(data.substr(0, length));
+            data.remove_prefix(length);
+            return value;
+        }
+
+    private:
+        std::string_view data;
+    };
+
+    template <typename T>
+    void append_raw(std::string &out, T value)
+    {
+        out.append(reinterpret_cast<const char *>(&value), sizeof(T));
+    }
+
+    void append_frame(std::string &out, uint64_t lsn, std::string_view payload)
+    {
+        const std::string_view lsn_bytes(reinterpret_cast<const char *>(&lsn), sizeof(lsn));
+        append_raw(out, static_cast<uint32_t>(payload.size()));
+        append_raw(out, fnv1a(payload, fnv1a(lsn_bytes)));
+        append_raw(out, lsn);
+        out.append(payload);
+    }
+
+    // целые кадры с начала data; возвращает длину корректного префикса
+    template <typename Callback>
+    std::size_t read_frames(std::string_view data, Callback &&on_frame)
+    {
+        std::size_t offset{0};
+        while (data.size() - offset >= FRAME_HEADER_BYTES)
+        {
+            uint32_t length;
+            uint32_t checksum;
+            uint64_t lsn;
+            std::memcpy(&length, data.data() + offset, sizeof(length));
+            std::memcpy(&checksum, data.data() + offset + 4, sizeof(checksum));
+            std::memcpy(&lsn, data.data() + offset + 8, sizeof(lsn));
+            if (length == 0 || data.size() - offset - FRAME_HEADER_BYTES < length)
+            {
+                break;
+            }
+            const std::string_view payload = data.substr(offset + FRAME_HEADER_BYTES, length);
+            const std::string_view lsn_bytes(data.data() + offset + 8, sizeof(lsn));
+            if (fnv1a(payload, fnv1a(lsn_bytes)) != checksum)
+            {
+                break;
+            }
+            on_frame(lsn, payload);
+            offset += FRAME_HEADER_BYTES + length;
+        }
+        return offset;
+    }
+
+    bool read_file(const std::filesystem::path &path, std::string &content)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+        {
+            return false;
+        }
+        std::ostringstream buffer;
+        buffer << in.rdbuf();
+        content = std::move(buffer).str();
+        return true;
+    }
+
+    bool sync_file(std::FILE *file) noexcept
+    {
+        if (std::fflush(file) != 0)
+        {
+            return false;
+        }
+#ifdef _WIN32
+        return _commit(_fileno(file)) == 0;
+#else
+        return fsync(fileno(file)) == 0;
+#endif
+    }
+
+    int64_t unix_now() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+
+    // дни с 1970-01-01, UTC
+    int64_t day_of(int64_t unix_seconds) noexcept
+    {
+        return std::chrono::floor<std::chrono::days>(std::chrono::sys_seconds{std::chrono::seconds{unix_seconds}})
+            .time_since_epoch()
+            .count();
+    }
+
+    // строго YYYY-MM-DD
+    std::optional<int64_t> parse_day(std::string_view text) noexcept
+    {
+        if (text.size() != 10 || text[4] != '-' || text[7] != '-')
+        {
+            return std::nullopt;
+        }
+        int32_t year{0};
+        uint32_t month{0};
+        uint32_t day{0};
+        if (std::from_chars(text.data(), text.data() + 4, year).ptr != text.data() + 4 ||
+            std::from_chars(text.data() + 5, text.data() + 7, month).ptr != text.data() + 7 ||
+            std::from_chars(text.data() + 8, text.data() + 10, day).ptr != text.data() + 10)
+        {
+            return std::nullopt;
+        }
+        const std::chrono::year_month_day date{std::chrono::year{year}, std::chrono::month{month},
+                                               std::chrono::day{day}};
+        if (!date.ok())
+        {
+            return std::nullopt;
+        }
+        return std::chrono::sys_days{date}.time_since_epoch().count();
+    }
+
+    int64_t require_day(const std::string &text)
+    {
+        const auto day = parse_day(text);
+        if (!day)
+        {
+            throw std::runtime_error("Invalid date: " + text);
+        }
+        return *day;
+    }
+
+    // [начало, конец) периода в днях, как date_trunc в PostgreSQL (неделя - с понедельника)
+    std::pair<int64_t, int64_t> period_window(LeaderboardPeriod period, int64_t anchor)
+    {
+        using namespace std::chrono;
+        const sys_days day{days{anchor}};
+        if (period == LeaderboardPeriod::WEEK)
+        {
+            const sys_days start = day - days{weekday{day}.iso_encoding() - 1};
+            return {start.time_since_epoch().count(), (start + days{7}).time_since_epoch().count()};
+        }
+        if (period == LeaderboardPeriod::MONTH)
+        {
+            const year_month_day date{day};
+            const year_month_day first{date.year() / date.month() / 1};
+            return {sys_days{first}.time_since_epoch().count(),
+                    sys_days{first + months{1}}.time_since_epoch().count()};
+        }
+        return {anchor, anchor + 1};
+    }
+
+    // как текстовый TIMESTAMP в PostgreSQL, без долей секунды
+    std::string format_timestamp(int64_t unix_seconds)
+    {
+        const std::time_t seconds = static_cast<std::time_t>(unix_seconds);
+        std::tm utc{};
+#ifdef _WIN32
+        gmtime_s(&utc, &seconds);
+#else
+        gmtime_r(&seconds, &utc);
+#endif
+        char buffer[32];
+        std::strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", &utc);
+        return buffer;
+    }
+
+    uint64_t challenge_key(int64_t day, int32_t difficulty) noexcept
+    {
+        return (static_cast<uint64_t>(day) << 8) | static_cast<uint8_t>(difficulty);
+    }
+
+    uint64_t item_key(int64_t progress_id, uint16_t position) noexcept
+    {
+        return (static_cast<uint64_t>(static_cast<uint32_t>(progress_id)) << 16) | position;
+    }
+}
+
+EmbeddedStorage::EmbeddedStorage(Options options)
+    : options(std::move(options))
+{
+}
+
+EmbeddedStorage::~EmbeddedStorage()
+{
+    std::lock_guard lock(mutex);
+    if (wal && wal_bytes > WAL_HEADER_BYTES)
+    {
+        try
+        {
+            snapshot_locked();
+        }
+        catch (const std::exception &e)
+        {
+            // журнал остаётся и будет повторён при следующем запуске
+            std::cerr << "Embedded storage snapshot failed: " << e.what() << "\n";
+        }
+    }
+    wal.reset();
+    unlock_directory();
+}
+
+bool EmbeddedStorage::connect()
+{
+    std::lock_guard lock(mutex);
+    wal.reset();
+    error.clear();
+    next_lsn = 1;
+    users.clear();
+    user_by_name.clear();
+    progress.clear();
+    progress_by_user.clear();
+    progress_items.clear();
+    progress_item_keys.clear();
+    score_by_day.clear();
+    schedules.clear();
+    weak_items.clear();
+    marathon_results.clear();
+    daily_challenges.clear();
+    daily_results.clear();
+    exam_results.clear();
+
+    std::error_code ec;
+    std::filesystem::create_directories(options.directory, ec);
+    if (ec)
+    {
+        error = "Cannot create " + options.directory.string() + ": " + ec.message();
+        return false;
+    }
+    if (!lock_directory())
+    {
+        return false;
+    }
+
+    try
+    {
+        return load_snapshot() && replay_wal();
+    }
+    catch (const std::exception &e)
+    {
+        error = e.what();
+        wal.reset();
+        return false;
+    }
+}
+
+bool EmbeddedStorage::lock_directory()
+{
+    // два процесса на одном каталоге дописывали бы один журнал и затирали снимки друг друга
+#ifdef _WIN32
+    if (lock_handle)
+    {
+        return true;
+    }
+    const auto path = options.directory / "LOCK";
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                              nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        error = "Cannot open " + path.string();
+        return false;
+    }
+    OVERLAPPED overlapped{};
+    if (!LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, MAXDWORD, MAXDWORD, &overlapped))
+    {
+        CloseHandle(file);
+        error = options.directory.string() + " is already used by another process";
+        return false;
+    }
+    lock_handle = file;
+#else
+    if (lock_descriptor >= 0)
+    {
+        return true;
+    }
+    const auto path = options.directory / "LOCK";
+    const int descriptor = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (descriptor < 0)
+    {
+        error = "Cannot open " + path.string() + ": " + std::strerror(errno);
+        return false;
+    }
+    if (::flock(descriptor, LOCK_EX | LOCK_NB) != 0)
+    {
+        const int lock_error = errno;
+        ::close(descriptor);
+        error = lock_error == EWOULDBLOCK ? options.directory.string() + " is already used by another process"
+                                          : "Cannot lock " + path.string() + ": " + std::strerror(lock_error);
+        return false;
+    }
+    lock_descriptor = descriptor;
+#endif
+    return true;
+}
+
+void EmbeddedStorage::unlock_directory() noexcept
+{
+#ifdef _WIN32
+    if (lock_handle)
+    {
+        CloseHandle(lock_handle);
+        lock_handle = nullptr;
+    }
+#else
+    if (lock_descriptor >= 0)
+    {
+        // блокировка снимается вместе с закрытием дескриптора
+        ::close(lock_descriptor);
+        lock_descriptor = -1;
+    }
+#endif
+}
+
+bool EmbeddedStorage::is_connected() const
+{
+    std::lock_guard lock(mutex);
+    return wal != nullptr;
+}
+
+std::string EmbeddedStorage::last_error() const
+{
+    std::lock_guard lock(mutex);
+    return error.empty() ? (wal ? "" : "embedded storage is not open") : error;
+}
+
+bool EmbeddedStorage::write_snapshot()
+{
+    std::lock_guard lock(mutex);
+    return wal && snapshot_locked();
+}
+
+void EmbeddedStorage::require_open() const
+{
+    if (!wal)
+    {
+        throw std::runtime_error("Embedded storage is not open");
+    }
+}
+
+bool EmbeddedStorage::load_snapshot()
+{
+    const auto path = options.directory / "snapshot.bin";
+    if (!std::filesystem::exists(path))
+    {
+        return true;
+    }
+
+    std::string content;
+    if (!read_file(path, content))
+    {
+        error = "Cannot read " + path.string();
+        return false;
+    }
+    uint32_t version{0};
+    uint64_t lsn{0};
+    if (content.size() >= SNAPSHOT_HEADER_BYTES)
+    {
+        std::memcpy(&version, content.data() + 4, sizeof(version));
+        std::memcpy(&lsn, content.data() + 8, sizeof(lsn));
+    }
+    if (content.size() < SNAPSHOT_HEADER_BYTES || std::memcmp(content.data(), SNAPSHOT_MAGIC, 4) != 0 ||
+        version != FORMAT_VERSION)
+    {
+        error = path.string() + " is not a storage snapshot";
+        return false;
+    }
+
+    // снимок пишется во временный файл и переименовывается, поэтому он либо целый, либо испорчен
+    bool complete{false};
+    const std::string_view frames = std::string_view(content).substr(SNAPSHOT_HEADER_BYTES);
+    const std::size_t valid = read_frames(frames, [&](uint64_t, std::string_view payload)
+                                          {
+                                              if (complete)
+                                              {
+                                                  throw std::runtime_error("data after snapshot end");
+                                              }
+                                              if (static_cast<WalOp>(payload[0]) == WalOp::SNAPSHOT_END)
+                                              {
+                                                  complete = true;
+                                                  return;
+                                              }
+                                              apply(payload); });
+    if (!complete || valid != frames.size())
+    {
+        error = path.string() + " is corrupted";
+        return false;
+    }
+    next_lsn = lsn + 1;
+    return true;
+}
+
+bool EmbeddedStorage::replay_wal()
+{
+    const auto path = options.directory / "wal.bin";
+    std::string content;
+    if (!std::filesystem::exists(path) || !read_file(path, content) || content.size() < WAL_HEADER_BYTES)
+    {
+        // журнала нет или оборван заголовок: после снимка в нём ничего не было
+        return open_wal(true);
+    }
+    uint32_t version{0};
+    std::memcpy(&version, content.data() + 4, sizeof(version));
+    if (std::memcmp(content.data(), WAL_MAGIC, 4) != 0 || version != FORMAT_VERSION)
+    {
+        error = path.string() + " is not a storage log";
+        return false;
+    }
+
+    const std::string_view frames = std::string_view(content).substr(WAL_HEADER_BYTES);
+    const std::size_t valid = read_frames(frames, [this](uint64_t lsn, std::string_view payload)
+                                          {
+                                              // записи до снимка уже в нём: сбой между rename и усечением журнала
+                                              if (lsn < next_lsn)
+                                              {
+                                                  return;
+                                              }
+                                              apply(payload);
+                                              next_lsn = lsn + 1; });
+    if (valid != frames.size())
+    {
+        std::cerr << "Embedded storage: dropping " << frames.size() - valid << " bytes of an incomplete log record\n";
+        std::error_code ec;
+        std::filesystem::resize_file(path, WAL_HEADER_BYTES + valid, ec);
+        if (ec)
+        {
+            error = "Cannot truncate " + path.string() + ": " + ec.message();
+            return false;
+        }
+    }
+    return open_wal(false);
+}
+
+bool EmbeddedStorage::open_wal(bool truncate)
+{
+    const auto path = options.directory / "wal.bin";
+    wal.reset(std::fopen(path.string().c_str(), truncate ? "wb" : "ab"));
+    if (!wal)
+    {
+        error = "Cannot open " + path.string();
+        return false;
+    }
+
+    if (truncate)
+    {
+        std::string header(WAL_MAGIC, sizeof(WAL_MAGIC));
+        append_raw(header, FORMAT_VERSION);
+        if (std::fwrite(header.data(), 1, header.size(), wal.get()) != header.size() || !sync_file(wal.get()))
+        {
+            error = "Cannot write " + path.string();
+            wal.reset();
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    wal_bytes = std::filesystem::file_size(path, ec);
+    return true;
+}
+
+bool EmbeddedStorage::commit(const std::string &payload)
+{
+    if (!wal)
+    {
+        error = "Embedded storage is not open";
+        return false;
+    }
+
+    std::string frame;
+    frame.reserve(FRAME_HEADER_BYTES + payload.size());
+    append_frame(frame, next_lsn, payload);
+    const bool written = std::fwrite(frame.data(), 1, frame.size(), wal.get()) == frame.size() &&
+                         (options.sync_writes ? sync_file(wal.get()) : std::fflush(wal.get()) == 0);
+    if (!written)
+    {
+        // после частичной записи дописывать нельзя: повтор остановится на оборванном кадре
+        error = "Cannot write storage log: " + std::string(std::strerror(errno));
+        wal.reset();
+        return false;
+    }
+
+    apply(payload);
+    ++next_lsn;
+    wal_bytes += frame.size();
+    if (wal_bytes >= options.snapshot_wal_bytes)
+    {
+        snapshot_locked();
+    }
+    return true;
+}
+
+void EmbeddedStorage::apply(std::string_view payload)
+{
+    RecordReader record(payload);
+    const auto op = static_cast<WalOp>(record.get<uint8_t>());
+    switch (op)
+    {
+    case WalOp::USER_PUT:
+    {
+        const uint32_t id = record.get<uint32_t>();
+        UserRow row;
+        row.username = record.get_string();
+        row.password = record.get_string();
+        row.difficulty_level = record.get<int32_t>();
+        row.total_score = record.get<uint32_t>();
+        row.created_at = record.get<int64_t>();
+        if (id == users.size() + 1)
+        {
+            users.push_back(std::move(row));
+        }
+        else if (user_exists(id))
+        {
+            user_by_name.erase(users[id - 1].username);
+            users[id - 1] = std::move(row);
+        }
+        else
+        {
+            throw std::runtime_error("storage log: user id out of order");
+        }
+        user_by_name[users[id - 1].username] = id;
+        break;
+    }
+    case WalOp::DIFFICULTY_SET:
+    {
+        const uint32_t user_id = record.get<uint32_t>();
+        const int32_t level = record.get<int32_t>();
+        if (!user_exists(user_id))
+        {
+            throw std::runtime_error("storage log: unknown user");
+        }
+        users[user_id - 1].difficulty_level = level;
+        break;
+    }
+    case WalOp::PASSWORD_SET:
+    {
+        const uint32_t user_id = record.get<uint32_t>();
+        std::string password = record.get_string();
+        if (!user_exists(user_id))
+        {
+            throw std::runtime_error("storage log: unknown user");
+        }
+        users[user_id - 1].password = std::move(password);
+        break;
+    }
+    case WalOp::SCORE_ADD:
+    {
+        const uint32_t user_id = record.get<uint32_t>();
+        const int64_t day = record.get<int64_t>();
+        const uint32_t delta = record.get<uint32_t>();
+        if (!user_exists(user_id))
+        {
+            throw std::runtime_error("storage log: unknown user");
+        }
+        users[user_id - 1].total_score += delta;
+        score_by_day[day][user_id] += delta;
+        break;
+    }
+    case WalOp::SCORE_DAILY_PUT:
+    {
+        const uint32_t user_id = record.get<uint32_t>();
+        const int64_t day = record.get<int64_t>();
+        score_by_day[day][user_id] = record.get<uint32_t>();
+        break;
+    }
+    case WalOp::PROGRESS_INSERT:
+    case WalOp::PROGRESS_LEVEL_INSERT:
+    {
+        const uint32_t id = record.get<uint32_t>();
+        ProgressRow row;
+        row.user_id = record.get<uint32_t>();
+        row.difficulty = op == WalOp::PROGRESS_LEVEL_INSERT ? record.get<int32_t>() : -1;
+        row.sequence_length = record.get<uint32_t>();
+        row.success_rate = record.get<float>();
+        row.memorization_ms = record.get<uint32_t>();
+        row.answer_ms = record.get<uint32_t>();
+        row.training_date = record.get<int64_t>();
+        if (id != progress.size() + 1)
+        {
+            throw std::runtime_error("storage log: progress id out of order");
+        }
+        progress.push_back(row);
+        progress_by_user[row.user_id].push_back(id);
+        break;
+    }
+    case WalOp::ITEMS_INSERT:
+    {
+        const uint32_t count = record.get<uint32_t>();
+        progress_items.reserve(progress_items.size() + count);
+        for (uint32_t i{0}; i < count; ++i)
+        {
+            ProgressItem item;
+            item.progress_id = record.get<int32_t>();
+            item.position = record.get<uint16_t>();
+            item.kind = record.get<uint8_t>();
+            item.correct = record.get<uint8_t>() != 0;
+            progress_items.push_back(item);
+            progress_item_keys.insert(item_key(item.progress_id, item.position));
+        }
+        break;
+    }
+    case WalOp::SCHEDULE_PUT:
+    {
+        UserSchedule schedule;
+        schedule.user_id = record.get<uint32_t>();
+        schedule.ease_factor = record.get<float>();
+        schedule.repetitions = record.get<uint32_t>();
+        schedule.interval_seconds = record.get<int64_t>();
+        schedule.next_length = record.get<uint32_t>();
+        schedule.due_at = record.get<int64_t>();
+        schedules[schedule.user_id] = schedule;
+        break;
+    }
+    case WalOp::WEAK_ITEMS_PUT:
+    {
+        const uint32_t user_id = record.get<uint32_t>();
+        weak_items[user_id] = record.get_string();
+        break;
+    }
+    case WalOp::MARATHON_INSERT:
+    {
+        MarathonRow row;
+        row.user_id = record.get<uint32_t>();
+        row.length = record.get<uint32_t>();
+        row.score = record.get<uint32_t>();
+        row.success_rate = record.get<float>();
+        row.memorization_ms = record.get<uint32_t>();
+        row.answer_ms = record.get<uint32_t>();
+        row.played_at = record.get<int64_t>();
+        marathon_results.push_back(row);
+        break;
+    }
+    case WalOp::CHALLENGE_PUT:
+    {
+        const int64_t day = record.get<int64_t>();
+        const int32_t difficulty = record.get<int32_t>();
+        daily_challenges[challenge_key(day, difficulty)] = record.get_string();
+        break;
+    }
+    case WalOp::CHALLENGE_RESULT_PUT:
+    {
+        const int64_t day = record.get<int64_t>();
+        const uint32_t user_id = record.get<uint32_t>();
+        DailyResultRow row;
+        row.difficulty = record.get<int32_t>();
+        row.score = record.get<uint32_t>();
+        row.success_rate = record.get<float>();
+        row.completed_at = record.get<int64_t>();
+        daily_results[day][user_id] = row;
+        break;
+    }
+    case WalOp::EXAM_INSERT:
+    case WalOp::EXAM_GRADED_INSERT:
+    {
+        const bool graded = op == WalOp::EXAM_GRADED_INSERT;
+        const uint32_t count = record.get<uint32_t>();
+        exam_results.reserve(exam_results.size() + count);
+        for (uint32_t i{0}; i < count; ++i)
+        {
+            ExamRow row;
+            row.user_id = record.get<uint32_t>();
+            row.sequence_id = record.get_string();
+            row.correct = record.get<uint32_t>();
+            row.total = record.get<uint32_t>();
+            row.credit = graded ? record.get<float>() : static_cast<float>(row.correct);
+            row.graded_at = record.get<int64_t>();
+            exam_results.push_back(std::move(row));
+        }
+        break;
+    }
+    case WalOp::SNAPSHOT_END:
+        break;
+    default:
+        throw std::runtime_error("storage log: unknown record type");
+    }
+}
+
+bool EmbeddedStorage::snapshot_locked()
+{
+    const uint64_t lsn = next_lsn - 1;
+    std::string content(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    append_raw(content, FORMAT_VERSION);
+    append_raw(content, lsn);
+
+    // снимок - те же записи журнала, описывающие текущее состояние таблиц
+    for (std::size_t i{0}; i < users.size(); ++i)
+    {
+        const UserRow &row = users[i];
+        RecordWriter record(WalOp::USER_PUT);
+        record.put(static_cast<uint32_t>(i + 1));
+        record.put_string(row.username);
+        record.put_string(row.password);
+        record.put(row.difficulty_level);
+        record.put(row.total_score);
+        record.put(row.created_at);
+        append_frame(content, lsn, record.payload);
+    }
+    for (std::size_t i{0}; i < progress.size(); ++i)
+    {
+        const ProgressRow &row = progress[i];
+        RecordWriter record(WalOp::PROGRESS_LEVEL_INSERT);
+        record.put(static_cast<uint32_t>(i + 1));
+        record.put(row.user_id);
+        record.put(row.difficulty);
+        record.put(row.sequence_length);
+        record.put(row.success_rate);
+        record.put(row.memorization_ms);
+        record.put(row.answer_ms);
+        record.put(row.training_date);
+        append_frame(content, lsn, record.payload);
+    }
+    for (std::size_t begin{0}; begin < progress_items.size(); begin += SNAPSHOT_BATCH_ROWS)
+    {
+        const std::size_t end = std::min(progress_items.size(), begin + SNAPSHOT_BATCH_ROWS);
+        RecordWriter record(WalOp::ITEMS_INSERT);
+        record.put(static_cast<uint32_t>(end - begin));
+        for (std::size_t i{begin}; i < end; ++i)
+        {
+            record.put(static_cast<int32_t>(progress_items[i].progress_id));
+            record.put(progress_items[i].position);
+            record.put(progress_items[i].kind);
+            record.put(static_cast<uint8_t>(progress_items[i].correct));
+        }
+        append_frame(content, lsn, record.payload);
+    }
+    for (const auto &[day, scores] : score_by_day)
+    {
+        for (const auto &[user_id, score] : scores)
+        {
+            RecordWriter record(WalOp::SCORE_DAILY_PUT);
+            record.put(user_id);
+            record.put(day);
+            record.put(score);
+            append_frame(content, lsn, record.payload);
+        }
+    }
+    for (const auto &[user_id, schedule] : schedules)
+    {
+        RecordWriter record(WalOp::SCHEDULE_PUT);
+        record.put(schedule.user_id);
+        record.put(schedule.ease_factor);
+        record.put(schedule.repetitions);
+        record.put(schedule.interval_seconds);
+        record.put(schedule.next_length);
+        record.put(schedule.due_at);
+        append_frame(content, lsn, record.payload);
+    }
+    for (const auto &[user_id, sketch] : weak_items)
+    {
+        RecordWriter record(WalOp::WEAK_ITEMS_PUT);
+        record.put(user_id);
+        record.put_string(sketch);
+        append_frame(content, lsn, record.payload);
+    }
+    for (const MarathonRow &row : marathon_results)
+    {
+        RecordWriter record(WalOp::MARATHON_INSERT);
+        record.put(row.user_id);
+        record.put(row.length);
+        record.put(row.score);
+        record.put(row.success_rate);
+        record.put(row.memorization_ms);
+        record.put(row.answer_ms);
+        record.put(row.played_at);
+        append_frame(content, lsn, record.payload);
+    }
+    for (const auto &[key, items] : daily_challenges)
+    {
+        RecordWriter record(WalOp::CHALLENGE_PUT);
+        record.put(static_cast<int64_t>(key >> 8));
+        record.put(static_cast<int32_t>(key & 0xFF));
+        record.put_string(items);
+        append_frame(content, lsn, record.payload);
+    }
+    for (const auto &[day, results] : daily_results)
+    {
+        for (const auto &[user_id, row] : results)
+        {
+            RecordWriter record(WalOp::CHALLENGE_RESULT_PUT);
+            record.put(day);
+            record.put(user_id);
+            record.put(row.difficulty);
+            record.put(row.score);
+            record.put(row.success_rate);
+            record.put(row.completed_at);
+            append_frame(content, lsn, record.payload);
+        }
+    }
+    for (std::size_t begin{0}; begin < exam_results.size(); begin += SNAPSHOT_BATCH_ROWS)
+    {
+        const std::size_t end = std::min(exam_results.size(), begin + SNAPSHOT_BATCH_ROWS);
+        RecordWriter record(WalOp::EXAM_GRADED_INSERT);
+        record.put(static_cast<uint32_t>(end - begin));
+        for (std::size_t i{begin}; i < end; ++i)
+        {
+            record.put(exam_results[i].user_id);
+            record.put_string(exam_results[i].sequence_id);
+            record.put(exam_results[i].correct);
+            record.put(exam_results[i].total);
+            record.put(exam_results[i].credit);
+            record.put(exam_results[i].graded_at);
+        }
+        append_frame(content, lsn, record.payload);
+    }
+    append_frame(content, lsn, RecordWriter(WalOp::SNAPSHOT_END).payload);
+
+    const auto path = options.directory / "snapshot.bin";
+    const auto temporary = options.directory / "snapshot.bin.tmp";
+    {
+        FileHandle file(std::fopen(temporary.string().c_str(), "wb"), std::fclose);
+        if (!file || std::fwrite(content.data(), 1, content.size(), file.get()) != content.size() ||
+            !sync_file(file.get()))
+        {
+            error = "Cannot write " + temporary.string();
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temporary, path, ec);
+    if (ec)
+    {
+        error = "Cannot replace " + path.string() + ": " + ec.message();
+        return false;
+    }
+    // журнал начинается заново; его старые записи покрыты снимком
+    return open_wal(true);
+}
+
+std::optional<UserCredential> EmbeddedStorage::get_user_credential(const std::string &username) const
+{
+    std::lock_guard lock(mutex);
+    require_open();
+
+    const auto found = user_by_name.find(username);
+    if (found == user_by_name.end())
+    {
+        return std::nullopt;
+    }
+    return UserCredential{static_cast<int32_t>(found->second), users[found->second - 1].password};
+}
+
+bool EmbeddedStorage::register_user(const std::string &username, const std::string &password)
+{
+    std::lock_guard lock(mutex);
+    if (username.empty() || username.size() > MAX_USERNAME || password.size() > MAX_PASSWORD)
+    {
+        error = "username or password has invalid length";
+        return false;
+    }
+    if (user_by_name.contains(username))
+    {
+        error = "user " + username + " already exists";
+        return false;
+    }
+
+    RecordWriter record(WalOp::USER_PUT);
+    record.put(static_cast<uint32_t>(users.size() + 1));
+    record.put_string(username);
+    record.put_string(password);
+    record.put(int32_t{0});
+    record.put(uint32_t{0});
+    record.put(unix_now());
+    return commit(record.payload);
+}
+
+bool EmbeddedStorage::update_password(uint32_t user_id, const std::string &password)
+{
+    std::lock_guard lock(mutex);
+    if (!user_exists(user_id) || password.size() > MAX_PASSWORD)
+    {
+        error = "invalid password update for user " + std::to_string(user_id);
+        return false;
+    }
+
+    RecordWriter record(WalOp::PASSWORD_SET);
+    record.put(user_id);
+    record.put_string(password);
+    return commit(record.payload);
+}
+
+std::optional<int64_t> EmbeddedStorage::save_progress(uint32_t user_id, int32_t difficulty, uint32_t sequence_length,
+                                                      float success_rate, uint32_t memorization_ms, uint32_t answer_ms)
+{
+    std::lock_guard lock(mutex);
+    if (!user_exists(user_id))
+    {
+        error = "unknown user " + std::to_string(user_id);
+        return std::nullopt;
+    }
+
+    const uint32_t id = static_cast<uint32_t>(progress.size() + 1);
+    RecordWriter record(WalOp::PROGRESS_LEVEL_INSERT);
+    record.put(id);
+    record.put(user_id);
+    record.put(difficulty);
+    record.put(sequence_length);
+    record.put(success_rate);
+    record.put(memorization_ms);
+    record.put(answer_ms);
+    record.put(unix_now());
+    if (!commit(record.payload))
+    {
+        return std::nullopt;
+    }
+    return static_cast<int64_t>(id);
+}
+
+bool EmbeddedStorage::save_progress_items(std::vector<ProgressItem> &items)
+{
+    if (items.empty())
+    {
+        return true;
+    }
+
+    std::lock_guard lock(mutex);
+    // как COPY: пачка отклоняется целиком при нарушении ключа или ссылки
+    std::unordered_set<uint64_t> batch_keys;
+    batch_keys.reserve(items.size());
+    for (const auto &item : items)
+    {
+        const uint64_t key = item_key(item.progress_id, item.position);
+        if (item.progress_id < 1 || static_cast<std::size_t>(item.progress_id) > progress.size() ||
+            progress_item_keys.contains(key) || !batch_keys.insert(key).second)
+        {
+            error = "invalid or duplicate progress item for progress " + std::to_string(item.progress_id);
+            return false;
+        }
+    }
+
+    RecordWriter record(WalOp::ITEMS_INSERT);
+    record.payload.reserve(8 + items.size() * 8);
+    record.put(static_cast<uint32_t>(items.size()));
+    for (const auto &item : items)
+    {
+        record.put(static_cast<int32_t>(item.progress_id)); // проверен выше: не больше числа строк прогресса
+        record.put(item.position);
+        record.put(item.kind);
+        record.put(static_cast<uint8_t>(item.correct));
+    }
+    if (!commit(record.payload))
+    {
+        return false;
+    }
+    items.clear();
+    return true;
+}
+
+bool EmbeddedStorage::save_exam_results(const std::vector<ExamResult> &results)
+{
+    if (results.empty())
+    {
+        return true;
+    }
+
+    std::lock_guard lock(mutex);
+    for (const auto &result : results)
+    {
+        if (!user_exists(result.user_id) || result.sequence_id.size() > MAX_SEQUENCE_ID ||
+            result.correct > result.total || !(result.credit >= 0.0f) ||
+            result.credit > static_cast<float>(result.total))
+        {
+            error = "invalid exam result for user " + std::to_string(result.user_id);
+            return false;
+        }
+    }
+
+    const int64_t now = unix_now();
+    RecordWriter record(WalOp::EXAM_GRADED_INSERT);
+    record.put(static_cast<uint32_t>(results.size()));
+    for (const auto &result : results)
+    {
+        record.put(result.user_id);
+        record.put_string(result.sequence_id);
+        record.put(result.correct);
+        record.put(result.total);
+        record.put(result.credit);
+        record.put(now);
+    }
+    return commit(record.payload);
+}
+
+bool EmbeddedStorage::update_difficulty(uint32_t user_id, uint32_t new_level)
+{
+    std::lock_guard lock(mutex);
+    if (!user_exists(user_id))
+    {
+        return true; // UPDATE без строк в PostgreSQL тоже успешен
+    }
+
+    RecordWriter record(WalOp::DIFFICULTY_SET);
+    record.put(user_id);
+    record.put(static_cast<int32_t>(new_level));
+    return commit(record.payload);
+}
+
+bool EmbeddedStorage::update_score(uint32_t user_id, uint32_t score_delta)
+{
+    std::lock_guard lock(mutex);
+    if (!user_exists(user_id))
+    {
+        error = "unknown user " + std::to_string(user_id);
+        return false;
+    }
+
+    RecordWriter record(WalOp::SCORE_ADD);
+    record.put(user_id);
+    record.put(day_of(unix_now()));
+    record.put(score_delta);
+    return commit(record.payload);
+}
+
+// SCORE_ADD и так дописывается в журнал и применяется без блокировок строк:
+// журнал - лента событий, снимок - её свёртка; переносить нечего
+std::optional<std::size_t> EmbeddedStorage::compact_scores(uint32_t)
+{
+    return std::size_t{0};
+}
+
+std::vector<UserProgress> EmbeddedStorage::get_user_progress(uint32_t user_id) const
+{
+    std::lock_guard lock(mutex);
+    require_open();
+
+    std::vector<UserProgress> result;
+    const auto found = progress_by_user.find(user_id);
+    if (found == progress_by_user.end())
+    {
+        return result;
+    }
+
+    // id растут вместе со временем записи: обратный порядок - от новых к старым
+    result.reserve(found->second.size());
+    for (auto id = found->second.rbegin(); id != found->second.rend(); ++id)
+    {
+        const ProgressRow &row = progress[*id - 1];
+        result.push_back(UserProgress{static_cast<int32_t>(row.sequence_length), row.success_rate,
+                                      format_timestamp(row.training_date)});
+    }
+    return result;
+}
+
+int32_t EmbeddedStorage::get_user_difficulty(uint32_t user_id) const
+{
+    std::lock_guard lock(mutex);
+    require_open();
+    return user_exists(user_id) ? users[user_id - 1].difficulty_level : 0;
+}
+
+std::vector<uint32_t> EmbeddedStorage::get_unknown_users(const std::vector<uint32_t> &user_ids) const
+{
+    std::lock_guard lock(mutex);
+    require_open();
+
+    std::vector<uint32_t> unknown;
+    for (const uint32_t user_id : user_ids)
+    {
+        if (!user_exists(user_id))
+        {
+            unknown.push_back(user_id);
+        }
+    }
+    return unknown;
+}
+
+std::optional<UserSchedule> EmbeddedStorage::get_user_schedule(uint32_t user_id) const
+{
+    std::lock_guard lock(mutex);
+    require_open();
+
+    const auto found = schedules.find(user_id);
+    if (found == schedules.end())
+    {
+        return std::nullopt;
+    }
+    return found->second;
+}
+
+bool EmbeddedStorage::save_user_schedule(const UserSchedule &schedule)
+{
+    std::lock_guard lock(mutex);
+    if (!user_exists(schedule.user_id))
+    {
+        error = "unknown user " + std::to_string(schedule.user_id);
+        return false;
+    }
+
+    RecordWriter record(WalOp::SCHEDULE_PUT);
+    record.put(schedule.user_id);
+    record.put(schedule.ease_factor);
+    record.put(schedule.repetitions);
+    record.put(schedule.interval_seconds);
+    record.put(schedule.next_length);
+    record.put(schedule.due_at);
+    return commit(record.payload);
+}
+
+std::vector<UserSchedule> EmbeddedStorage::get_due_schedules(int64_t due_from, int64_t due_before,
+                                                            uint32_t limit) const
+{
+    std::lock_guard lock(mutex);
+    require_open();
+
+    std::vector<UserSchedule> due;
+    for (const auto &[user_id, schedule] : schedules)
+    {
+        if (schedule.due_at >= due_from && schedule.due_at < due_before)
+        {
+            due.push_back(schedule);
+        }
+    }
+    const auto by_due = [](const UserSchedule &a, const UserSchedule &b)
+    {
+        return a.due_at < b.due_at;
+    };
+    if (due.size() > limit)
+    {
+        std::partial_sort(due.begin(), due.begin() + limit, due.end(), by_due);
+        due.resize(limit);
+    }
+    else
+    {
+        std::sort(due.begin(), due.end(), by_due);
+    }
+    return due;
+}
+
+std::optional<std::string> EmbeddedStorage::get_weak_items(uint32_t user_id) const
+{
+    std::lock_guard lock(mutex);
+    require_open();
+
+    const auto found = weak_items.find(user_id);
+    if (found == weak_items.end())
+    {
+        return std::nullopt;
+    }
+    return found->second;
+}
+
+bool EmbeddedStorage::save_weak_items(uint32_t user_id, const std::string &sketch)
+{
+    std::lock_guard lock(mutex);
+    if (!user_exists(user_id))
+    {
+        error = "unknown user " + std::to_string(user_id);
+        return false;
+    }
+
+    RecordWriter record(WalOp::WEAK_ITEMS_PUT);
+    record.put(user_id);
+    record.put_string(sketch);
+    return commit(record.payload);
+}
+
+bool EmbeddedStorage::save_marathon_result(uint32_t user_id, uint32_t length, uint32_t score, float success_rate,
+                                           uint32_t memorization_ms, uint32_t answer_ms)
+{
+    std::lock_guard lock(mutex);
+    if (!user_exists(user_id))
+    {
+        error = "unknown user " + std::to_string(user_id);
+        return false;
+    }
+
+    RecordWriter record(WalOp::MARATHON_INSERT);
+    record.put(user_id);
+    record.put(length);
+    record.put(score);
+    record.put(success_rate);
+    record.put(memorization_ms);
+    record.put(answer_ms);
+    record.put(unix_now());
+    return commit(record.payload);
+}
+
+std::vector<ProgressPoint> EmbeddedStorage::get_progress_buckets(uint32_t user_id, ProgressBucket bucket,
+                                                                 uint32_t max_buckets) const
+{
+    constexpr int64_t SECONDS_PER_DAY = 86400;
+
+    std::lock_guard lock(mutex);
+    require_open();
+
+    std::vector<ProgressPoint> points;
+    const auto found = progress_by_user.find(user_id);
+    if (found == progress_by_user.end() || max_buckets == 0)
+    {
+        return points;
+    }
+
+    // строки пользователя идут по времени, поэтому бакет копится, пока не сменится его начало
+    std::vector<std::pair<double, double>> sums; // успех, длина
+    for (const uint32_t id : found->second)
+    {
+        const ProgressRow &row = progress[id - 1];
+        int64_t day = row.training_date / SECONDS_PER_DAY - (row.training_date % SECONDS_PER_DAY < 0);
+        if (bucket == ProgressBucket::WEEK)
+        {
+            // 1970-01-01 - четверг: неделя начинается на 3 дня раньше его
+            day -= ((day + 3) % 7 + 7) % 7;
+        }
+        const int64_t start = day * SECONDS_PER_DAY;
+        if (points.empty() || points.back().bucket_start != start)
+        {
+            points.push_back(ProgressPoint{start, 0, 0.0f, 0.0f});
+            sums.emplace_back(0.0, 0.0);
+        }
+        ++points.back().rounds;
+        sums.back().first += row.success_rate;
+        sums.back().second += row.sequence_length;
+    }
+    for (std::size_t i{0}; i < points.size(); ++i)
+    {
+        points[i].success_rate = static_cast<float>(sums[i].first / points[i].rounds);
+        points[i].sequence_length = static_cast<float>(sums[i].second / points[i].rounds);
+    }
+
+    if (points.size() > max_buckets)
+    {
+        points.erase(points.begin(), points.end() - max_buckets);
+    }
+    return points;
+}
+
+LeaderboardRows EmbeddedStorage::top_scores(const std::unordered_map<uint32_t, uint64_t> &scores,
+                                            uint32_t limit) const
+{
+    std::vector<std::pair<uint32_t, uint64_t>> ranked;
+    ranked.reserve(scores.size());
+    for (const auto &[user_id, score] : scores)
+    {
+        if (score > 0)
+        {
+            ranked.emplace_back(user_id, score);
+        }
+    }
+
+    // равные очки - по имени, чтобы порядок не зависел от хэш-таблицы
+    const auto by_score = [this](const auto &a, const auto &b)
+    {
+        return a.second != b.second ? a.second > b.second
+                                    : users[a.first - 1].username < users[b.first - 1].username;
+    };
+    const std::size_t count = std::min<std::size_t>(limit, ranked.size());
+    std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(), by_score);
+
+    LeaderboardRows leaders;
+    leaders.reserve(count);
+    for (std::size_t i{0}; i < count; ++i)
+    {
+        leaders.emplace_back(users[ranked[i].first - 1].username, std::to_string(ranked[i].second));
+    }
+    return leaders;
+}
+
+LeaderboardRows EmbeddedStorage::get_leaderboard(LeaderboardPeriod period, uint32_t limit,
+                                                 const std::string &anchor_date) const
+{
+    std::lock_guard lock(mutex);
+    require_open();
+
+    std::unordered_map<uint32_t, uint64_t> scores;
+    if (period == LeaderboardPeriod::ALL_TIME)
+    {
+        for (std::size_t i{0}; i < users.size(); ++i)
+        {
+            scores.emplace(static_cast<uint32_t>(i + 1), users[i].total_score);
+        }
+        return top_scores(scores, limit);
+    }
+
+    const int64_t anchor = anchor_date.empty() ? day_of(unix_now()) : require_day(anchor_date);
+    const auto [first_day, end_day] = period_window(period, anchor);
+    for (int64_t day{first_day}; day < end_day; ++day)
+    {
+        const auto bucket = score_by_day.find(day);
+        if (bucket == score_by_day.end())
+        {
+            continue;
+        }
+        for (const auto &[user_id, score] : bucket->second)
+        {
+            scores[user_id] += score;
+        }
+    }
+    return top_scores(scores, limit);
+}
+
+std::optional<std::string> EmbeddedStorage::get_daily_challenge(const std::string &day, int32_t difficulty) const
+{
+    std::lock_guard lock(mutex);
+    require_open();
+
+    const auto found = daily_challenges.find(challenge_key(require_day(day), difficulty));
+    if (found == daily_challenges.end())
+    {
+        return std::nullopt;
+    }
+    return found->second;
+}
+
+std::optional<std::string> EmbeddedStorage::create_daily_challenge(const std::string &day, int32_t difficulty,
+                                                                   const std::string &items)
+{
+    std::lock_guard lock(mutex);
+    require_open();
+
+    const int64_t day_number = require_day(day);
+    const auto found = daily_challenges.find(challenge_key(day_number, difficulty));
+    if (found != daily_challenges.end())
+    {
+        return found->second;
+    }
+
+    RecordWriter record(WalOp::CHALLENGE_PUT);
+    record.put(day_number);
+    record.put(difficulty);
+    record.put_string(items);
+    if (!commit(record.payload))
+    {
+        throw std::runtime_error(error);
+    }
+    return items;
+}
+
+bool EmbeddedStorage::save_daily_challenge_result(const std::string &day, uint32_t user_id, int32_t difficulty,
+                                                  uint32_t score, float success_rate)
+{
+    std::lock_guard lock(mutex);
+    const auto day_number = parse_day(day);
+    if (!day_number || !user_exists(user_id))
+    {
+        error = "invalid daily challenge result";
+        return false;
+    }
+    const auto bucket = daily_results.find(*day_number);
+    if (bucket != daily_results.end() && bucket->second.contains(user_id))
+    {
+        return false;
+    }
+
+    RecordWriter record(WalOp::CHALLENGE_RESULT_PUT);
+    record.put(*day_number);
+    record.put(user_id);
+    record.put(difficulty);
+    record.put(score);
+    record.put(success_rate);
+    record.put(unix_now());
+    return commit(record.payload);
+}
+
+std::optional<DailyChallengeScore> EmbeddedStorage::get_daily_challenge_score(const std::string &day, uint32_t user_id) const
+{
+    std::lock_guard lock(mutex);
+    require_open();
+
+    const auto bucket = daily_results.find(require_day(day));
+    if (bucket == daily_results.end())
+    {
+        return std::nullopt;
+    }
+    const auto found = bucket->second.find(user_id);
+    if (found == bucket->second.end())
+    {
+        return std::nullopt;
+    }
+    return DailyChallengeScore{found->second.difficulty, found->second.score};
+}
+
+LeaderboardRows EmbeddedStorage::get_daily_leaderboard(const std::string &day, int32_t difficulty,
+                                                       uint32_t limit) const
+{
+    std::lock_guard lock(mutex);
+    require_open();
+
+    LeaderboardRows leaders;
+    const auto bucket = daily_results.find(require_day(day));
+    if (bucket == daily_results.end())
+    {
+        return leaders;
+    }
+
+    std::vector<std::pair<uint32_t, const DailyResultRow *>> ranked;
+    ranked.reserve(bucket->second.size());
+    for (const auto &[user_id, row] : bucket->second)
+    {
+        if (row.difficulty == difficulty)
+        {
+            ranked.emplace_back(user_id, &row);
+        }
+    }
+    // как ORDER BY score DESC, completed_at
+    const auto by_score = [](const auto &a, const auto &b)
+    {
+        return a.second->score != b.second->score ? a.second->score > b.second->score
+                                                  : a.second->completed_at < b.second->completed_at;
+    };
+    const std::size_t count = std::min<std::size_t>(limit, ranked.size());
+    std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(), by_score);
+
+    leaders.reserve(count);
+    for (std::size_t i{0}; i < count; ++i)
+    {
+        leaders.emplace_back(users[ranked[i].first - 1].username, std::to_string(ranked[i].second->score));
+    }
+    return leaders;
+}
+
+std::size_t EmbeddedStorage::export_progress(const std::function<void(std::string_view)> &on_row) const
+{
+    std::lock_guard lock(mutex);
+    require_open();
+
+    std::string row;
+    char number[32];
+    for (const ProgressRow &progress_row : progress)
+    {
+        row = std::to_string(progress_row.user_id);
+        row += '\t';
+        row += std::to_string(progress_row.training_date);
+        row += '\t';
+        row += std::to_string(progress_row.sequence_length);
+        row += '\t';
+        const auto [end, ec] = std::to_chars(number, number + sizeof(number), progress_row.success_rate);
+        row.append(number, ec == std::errc{} ? end : number);
+        row += '\t';
+        // NULL в текстовом формате COPY
+        row += progress_row.difficulty >= 0 ? std::to_string(progress_row.difficulty) : "\\N";
+        on_row(row);
+    }
+    return progress.size();
+}
@@ -0,0 +1,301 @@
+#include "../include/ExamGrader.hpp"
+#include "../include/AnswerGrader.hpp"
+#include "../include/DailyChallenge.hpp"
+#include "../include/WorkStealingPool.hpp"
+#include "../include/ConfigFile.hpp"
+#include "../include/NumberParsing.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstring>
+#include <unordered_set>
+
+namespace
+{
+    bool read_file(const std::string &path, std::string &content)
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in)
+        {
+            return false;
+        }
+        std::ostringstream buffer;
+        buffer << in.rdbuf();
+        content = std::move(buffer).str();
+        return true;
+    }
+
+    // строки без завершающего \r; пустые пропускаются
+    std::vector<std::string_view> split_lines(std::string_view text)
+    {
+        std::vector<std::string_view> lines;
+        lines.reserve(text.size() / 32);
+        while (!text.empty())
+        {
+            const void *found = std::memchr(text.data(), '\n', text.size());
+            const std::size_t end = found ? static_cast<const char *>(found) - text.data() : text.size();
+            std::string_view line = text.substr(0, end);
+            if (!line.empty() && line.back() == '\r')
+            {
+                line.remove_suffix(1);
+            }
+            if (!line.empty())
+            {
+                lines.push_back(line);
+            }
+            text.remove_prefix(std::min(text.size(), end + 1));
+        }
+        return lines;
+    }
+
+    void print_usage()
+    {
+        std::cerr << "Usage: mem_trainer --grade-exam <answers file> --sequences=<file>\n"
+                     "                   [--threads=<n>] [--difficulty=easy|medium|hard] [--dry-run]\n"
+                     "  answers file: <user_id>\\t<sequence-id>\\t<answer tokens>, one per line\n"
+                     "  sequences:    <sequence-id>\\t<items as stored in daily_challenges>\n"
+                     "  --difficulty  [grading] rules of this level (default medium)\n"
+                     "  --dry-run     grade and report without writing exam_results\n";
+    }
+}
+
+bool ExamGrader::load_sequences(const std::string &path)
+{
+    if (!read_file(path, sequences_text))
+    {
+        std::cerr << "Cannot read " << path << "\n";
+        return false;
+    }
+
+    sequences.clear();
+    sequence_index.clear();
+    std::size_t line_number{0};
+    for (const std::string_view line : split_lines(sequences_text))
+    {
+        ++line_number;
+        const std::size_t tab = line.find('\t');
+        const std::string_view id = line.substr(0, tab);
+        auto items = tab == std::string_view::npos ? std::nullopt : DailyChallenge::parse(line.substr(tab + 1));
+        if (id.empty() || !items || items->empty())
+        {
+            std::cerr << path << ":" << line_number << ": malformed sequence\n";
+            return false;
+        }
+        if (!sequence_index.emplace(id, sequences.size()).second)
+        {
+            std::cerr << path << ":" << line_number << ": duplicate sequence id\n";
+            return false;
+        }
+        sequences.push_back({std::move(*items), {}});
+    }
+
+    // виды строятся после заполнения: перенос вектора sequences не двигает сами элементы
+    for (auto &sequence : sequences)
+    {
+        sequence.views.reserve(sequence.items.size());
+        for (const auto &item : sequence.items)
+        {
+            sequence.views.push_back(TaskGenerator::to_view(item));
+        }
+    }
+    return true;
+}
+
+bool ExamGrader::grade_line(std::string_view line, std::vector<std::string_view> &tokens, ExamResult &result) const
+{
+    const std::size_t first_tab = line.find('\t');
+    const std::size_t second_tab = line.find('\t', first_tab == std::string_view::npos ? line.size() : first_tab + 1);
+    if (second_tab == std::string_view::npos)
+    {
+        return false;
+    }
+
+    if (!NumberParsing::parse_whole(line.substr(0, first_tab), result.user_id))
+    {
+        return false;
+    }
+
+    result.sequence_id = line.substr(first_tab + 1, second_tab - first_tab - 1);
+    const auto found = sequence_index.find(result.sequence_id);
+    if (found == sequence_index.end())
+    {
+        return false;
+    }
+
+    const Sequence &sequence = sequences[found->second];
+    tokens.clear();
+    AnswerGrader::tokenize(line.substr(second_tab + 1), tokens);
+    const AnswerGrader::Grade grade = AnswerGrader::grade(sequence.views, tokens, {}, rules);
+    result.correct = grade.correct;
+    result.credit = grade.credit;
+    result.total = static_cast<uint32_t>(sequence.views.size());
+    return true;
+}
+
+ExamReport ExamGrader::grade_file(const std::string &path, WorkStealingPool &pool)
+{
+    ExamReport report;
+    if (!read_file(path, answers_text))
+    {
+        throw std::runtime_error("Cannot read " + path);
+    }
+
+    const auto started = std::chrono::steady_clock::now();
+    const std::vector<std::string_view> lines = split_lines(answers_text);
+
+    // у каждой строки свой слот: потоки пишут без синхронизации, порядок сохраняется
+    std::vector<ExamResult> slots(lines.size());
+    std::vector<uint8_t> valid(lines.size());
+    std::vector<std::vector<std::string_view>> tokens(pool.size());
+    const std::size_t tasks = (lines.size() + RECORDS_PER_TASK - 1) / RECORDS_PER_TASK;
+
+    pool.run(tasks, [&](std::size_t task, unsigned worker)
+             {
+                 const std::size_t begin = task * RECORDS_PER_TASK;
+                 const std::size_t end = std::min(lines.size(), begin + RECORDS_PER_TASK);
+                 for (std::size_t i{begin}; i < end; ++i)
+                 {
+                     valid[i] = grade_line(lines[i], tokens[worker], slots[i]);
+                 } });
+
+    report.results.reserve(lines.size());
+    for (std::size_t i{0}; i < lines.size(); ++i)
+    {
+        if (!valid[i])
+        {
+            ++report.invalid_lines;
+            continue;
+        }
+        report.correct += slots[i].correct;
+        report.credit += slots[i].credit;
+        report.total += slots[i].total;
+        report.results.push_back(slots[i]);
+    }
+    report.elapsed = std::chrono::steady_clock::now() - started;
+    return report;
+}
+
+int ExamGrader::run_cli(int argc, char **argv)
+{
+    std::string answers_path;
+    std::string sequences_path;
+    unsigned threads{0};
+    std::size_t difficulty{static_cast<std::size_t>(TaskGenerator::Difficulty::MEDIUM)};
+    bool dry_run{false};
+
+    for (int i{2}; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        if (arg.starts_with("--sequences="))
+            sequences_path = arg.substr(12);
+        else if (arg.starts_with("--threads="))
+        {
+            if (!NumberParsing::parse_whole(arg.substr(10), threads))
+            {
+                print_usage();
+                return 2;
+            }
+        }
+        else if (arg == "--difficulty=easy")
+            difficulty = static_cast<std::size_t>(TaskGenerator::Difficulty::EASY);
+        else if (arg == "--difficulty=medium")
+            difficulty = static_cast<std::size_t>(TaskGenerator::Difficulty::MEDIUM);
+        else if (arg == "--difficulty=hard")
+            difficulty = static_cast<std::size_t>(TaskGenerator::Difficulty::HARD);
+        else if (arg == "--dry-run")
+            dry_run = true;
+        else if (!arg.starts_with("--") && answers_path.empty())
+            answers_path = arg;
+        else
+        {
+            print_usage();
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+    if (answers_path.empty() || sequences_path.empty())
+    {
+        print_usage();
+        return 2;
+    }
+
+    try
+    {
+        ExamGrader grader;
+        grader.set_rules(AnswerGrader::load_rules(ConfigFile("config.ini"))[difficulty]);
+        if (!grader.load_sequences(sequences_path))
+        {
+            return 1;
+        }
+
+        WorkStealingPool pool(threads);
+        ExamReport report = grader.grade_file(answers_path, pool);
+
+        using ms = std::chrono::milliseconds;
+        const double seconds = std::chrono::duration<double>(report.elapsed).count();
+        const std::size_t graded = report.results.size();
+        std::cout << "Graded " << graded << " records against " << grader.sequence_count()
+                  << " sequences on " << pool.size() << " threads in "
+                  << std::chrono::duration_cast<ms>(report.elapsed).count() << " ms ("
+                  << static_cast<uint64_t>(seconds > 0 ? (graded + report.invalid_lines) / seconds : 0)
+                  << " records/s)\n";
+        if (report.total)
+        {
+            std::cout << "Mean success: " << 100.0 * report.credit / report.total << "%\n";
+        }
+        if (report.invalid_lines)
+        {
+            std::cerr << "Skipped " << report.invalid_lines << " malformed lines or unknown sequences\n";
+        }
+
+        if (dry_run || report.results.empty())
+        {
+            return 0;
+        }
+
+        DatabaseSync db_sync;
+        if (!db_sync.connect())
+        {
+            std::cerr << "Failed to connect to database\n";
+            return 1;
+        }
+        // пачка пишется одним COPY: строка с несуществующим пользователем сорвала бы её целиком
+        std::unordered_set<uint32_t> seen;
+        std::vector<uint32_t> user_ids;
+        for (const auto &result : report.results)
+        {
+            if (seen.insert(result.user_id).second)
+            {
+                user_ids.push_back(result.user_id);
+            }
+        }
+        const std::vector<uint32_t> unknown_ids = db_sync.get_unknown_users(user_ids);
+        if (!unknown_ids.empty())
+        {
+            const std::unordered_set<uint32_t> unknown(unknown_ids.begin(), unknown_ids.end());
+            const std::size_t removed = std::erase_if(report.results, [&](const ExamResult &result)
+                                                      { return unknown.contains(result.user_id); });
+            std::cerr << "Skipped " << removed << " records of " << unknown.size() << " unknown users\n";
+            if (report.results.empty())
+            {
+                return 0;
+            }
+        }
+
+        const auto save_started = std::chrono::steady_clock::now();
+        if (!db_sync.save_exam_results(report.results))
+        {
+            std::cerr << "Failed to save exam results: " << db_sync.last_error() << "\n";
+            return 1;
+        }
+        std::cout << "Saved " << report.results.size() << " results in "
+                  << std::chrono::duration_cast<ms>(std::chrono::steady_clock::now() - save_started).count()
+                  << " ms\n";
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -1,5 +1,13 @@
 #include "../include/MainLoop.hpp"
 #include "../include/Menu.hpp"
+#include "../include/TrainingScheduler.hpp"
+#include "../include/DailyChallenge.hpp"
+#include "../include/ConfigFile.hpp"
+#include "../include/Metrics.hpp"
+#include "../include/AllocationCounter.hpp"
+#include "../include/AnswerGrader.hpp"
+#include "../include/Tracing.hpp"
+#include "../include/Downsampling.hpp"
 
 #include <iostream>
 #include <string>
@@ -8,21 +16,84 @@
 #include <iomanip>
 #include <thread>
 #include <chrono>
-#include <iterator>
+#include <charconv>
+#include <algorithm>
+#include <type_traits>
 #include <cstdlib>
 #include <utility>
 
+namespace
+{
+    constexpr const char *RENDER_LATENCY = "mem_trainer_render_duration_seconds";
+    constexpr const char *RENDER_LATENCY_HELP = "Time spent rendering console views";
+
+    LatencyHistogram check_answers_latency("mem_trainer_check_answers_duration_seconds", "Time spent grading answers");
+    LatencyHistogram render_sequence_latency(RENDER_LATENCY, RENDER_LATENCY_HELP, "view=\"sequence\"");
+    LatencyHistogram render_results_latency(RENDER_LATENCY, RENDER_LATENCY_HELP, "view=\"results\"");
+    LatencyHistogram render_leaderboard_latency(RENDER_LATENCY, RENDER_LATENCY_HELP, "view=\"leaderboard\"");
+    MetricCounter reconnects("mem_trainer_db_reconnects_total", "Connection retries after a failed attempt");
+    MetricCounter shared_leaderboard_hits("mem_trainer_shared_leaderboard_reads_total",
+                                          "Leaderboard views by source", "source=\"shared_memory\"");
+    MetricCounter shared_leaderboard_refreshes("mem_trainer_shared_leaderboard_reads_total",
+                                               "Leaderboard views by source", "source=\"refresh\"");
+    MetricCounter shared_leaderboard_misses("mem_trainer_shared_leaderboard_reads_total",
+                                            "Leaderboard views by source", "source=\"database\"");
+    MetricCounter training_rounds("mem_trainer_training_rounds_total", "Completed training rounds");
+    MetricCounter marathon_rounds("mem_trainer_marathon_rounds_total", "Marathon rounds recalled without a mistake");
+    MetricCounter round_allocations("mem_trainer_training_round_allocations_total",
+                                    "operator new calls during training rounds (MEM_TRAINER_COUNT_ALLOCATIONS builds)");
+
+    constexpr uint32_t MARATHON_ITEM_POINTS = 10;
+
+    // повторов записи пачки позиций после неудачи; дальше она ждёт выхода
+    constexpr uint32_t MAX_ITEM_FLUSH_RETRIES = 3;
+    // сколько пачек буфер хранит, пока повторы исчерпаны; старые строки сверх этого теряются
+    constexpr std::size_t MAX_PENDING_ITEM_BATCHES = 4;
+
+    // бакетов прогресса, запрашиваемых на одну колонку графика (остальное прореживает LTTB)
+    constexpr std::size_t PROGRESS_OVERSAMPLE = 4;
+    constexpr std::size_t MIN_CHART_COLUMNS = 16;
+
+    // число в буфер на стеке; float - как у operator<< по умолчанию (%g, 6 знаков)
+    template <typename T>
+    std::string_view format_number(std::array<char, 32> &buffer, T value) noexcept
+    {
+        std::to_chars_result result;
+        if constexpr (std::is_floating_point_v<T>)
+            result = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value, std::chars_format::general, 6);
+        else
+            result = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+        return {buffer.data(), static_cast<std::size_t>(result.ptr - buffer.data())};
+    }
+}
+
 MainLoop::MainLoop()
     : db_sync(),
-      current_user_id(-1)
+      current_user_id(-1),
+      daily_challenge(db_sync),
+      round_arena(round_buffer.data(), round_buffer.size())
 {
     try
     {
+        ConfigFile config("config.ini");
+
+        // трасса сессии с самого подключения; пишется в файл при выходе
+        const std::string trace_file = config.get("tracing", "file");
+        if (!trace_file.empty())
+        {
+            Tracer::instance().start(
+                trace_file, static_cast<std::size_t>(std::max<int64_t>(
+                                1, config.get_int("tracing", "buffer_events",
+                                                  static_cast<int64_t>(Tracer::DEFAULT_EVENTS_PER_THREAD)))));
+            Tracer::instance().name_thread("main");
+        }
+
         auto menu = std::make_unique<Menu>();
         uint16_t attempts{0};
         bool connected{false};
         while (attempts < 3 && !connected)
         {
+            const TraceSpan span("connect_attempt", "session");
             if (db_sync.connect())
             {
                 connected = true;
@@ -32,6 +103,7 @@ MainLoop::MainLoop()
                 attempts++;
                 if (attempts < 3)
                 {
+                    reconnects.increment();
                     menu->print_message("Retrying connection... (" + std::to_string(attempts) + "/3)\n");
                     std::this_thread::sleep_for(std::chrono::seconds(2));
                 }
@@ -39,9 +111,61 @@ MainLoop::MainLoop()
         }
         if (!connected)
         {
-            throw std::runtime_error("Failed to connect to database after 3 attempts");
+            const std::string reason = db_sync.last_error();
+            throw std::runtime_error("Failed to connect to database after 3 attempts" +
+                                     (reason.empty() ? std::string{} : ": " + reason));
         }
         menu->print_message("Connected to database successfully.\n");
+
+        // экспорт метрик в файл для textfile-коллектора node_exporter
+        const std::string metrics_file = config.get("metrics", "file");
+        if (!metrics_file.empty())
+        {
+            MetricsRegistry::instance().start_file_exporter(
+                metrics_file, std::chrono::seconds(config.get_int("metrics", "interval_seconds", 15)));
+        }
+
+        auth = std::make_unique<AuthService>(db_sync, AuthService::load_options(config));
+        grading_rules = AnswerGrader::load_rules(config);
+        item_batch_rows = static_cast<std::size_t>(std::max<int64_t>(1, config.get_int("database", "item_batch_rows", 64)));
+
+        // двоичный журнал раундов для офлайн-анализа
+        const std::string recording_file = config.get("recording", "file");
+        if (!recording_file.empty())
+        {
+            session_log = std::make_unique<SessionLogWriter>(
+                recording_file,
+                static_cast<uint32_t>(config.get_int("recording", "block_records",
+                                                     SessionLogWriter::DEFAULT_BLOCK_RECORDS)));
+            if (!session_log->is_open())
+            {
+                std::cerr << "Failed to open session log " << recording_file << "\n";
+                session_log.reset();
+            }
+        }
+
+        // события очков сворачиваются в итоги по ходу сессии
+        const int64_t compact_seconds = config.get_int("scores", "compact_seconds", 60);
+        if (compact_seconds > 0)
+        {
+            score_compactor = std::make_unique<ScoreCompactor>(
+                db_sync, std::chrono::seconds(compact_seconds),
+                static_cast<uint32_t>(std::max<int64_t>(1, config.get_int("scores", "compact_batch",
+                                                                          ScoreCompactor::DEFAULT_BATCH_EVENTS))));
+        }
+
+        // общий для процессов на этой машине топ рейтингов
+        const std::string leaderboard_segment = config.get("leaderboard", "shm_name");
+        if (!leaderboard_segment.empty())
+        {
+            shared_leaderboard = std::make_unique<SharedLeaderboard>(
+                leaderboard_segment,
+                std::chrono::seconds(std::max<int64_t>(1, config.get_int("leaderboard", "refresh_seconds", 5))));
+            if (!shared_leaderboard->is_open())
+            {
+                shared_leaderboard.reset();
+            }
+        }
     }
     catch (const std::exception &e)
     {
@@ -53,9 +177,15 @@ MainLoop::MainLoop()
 
 MainLoop::~MainLoop()
 {
-    if (db_sync.get_connection())
+    // последняя попытка: после неё несохранённые позиции теряются
+    if (!flush_progress_items())
     {
-        PQfinish(db_sync.get_connection());
+        std::cerr << "Dropping " << pending_items.size() << " unsaved progress items\n";
+    }
+    MetricsRegistry::instance().stop_file_exporter();
+    if (Tracer::enabled() && !Tracer::instance().stop())
+    {
+        std::cerr << "Failed to write the session trace\n";
     }
 }
 
@@ -71,37 +201,31 @@ bool MainLoop::authenticate_user()
     menu->print_message("Enter password: ");
     std::getline(std::cin, password);
 
-    const char *paramValues[2] = {username.c_str(), password.c_str()};
-    int32_t paramLengths[2] = {static_cast<int32_t>(username.length()), static_cast<int32_t>(password.length())};
-    int32_t paramFormats[2] = {0, 0}; // 0 = text
-
-    PGresult *res = PQexecParams(db_sync.get_connection(),
-                                 "SELECT id FROM users WHERE username = $1 AND password = $2",
-                                 2, NULL, paramValues, paramLengths, paramFormats, 0);
-
-    if (PQresultStatus(res) != PGRES_TUPLES_OK)
+    const AuthService::LoginResult result = [&]
     {
-        std::cerr << "Authentication failed: " << PQerrorMessage(db_sync.get_connection()) << "\n";
-        PQclear(res);
-        return false;
-    }
-
-    bool success = (PQntuples(res) == 1);
-    if (success)
+        const TraceSpan span("login", "session");
+        return auth->login(username, password);
+    }();
+    switch (result.status)
     {
-        current_user_id = std::stoi(PQgetvalue(res, 0, 0));
+    case AuthService::Status::OK:
+        current_user_id = result.user_id;
+        load_weak_items();
         menu->print_message("Login successful!\n");
-    }
-    else
-    {
+        return true;
+    case AuthService::Status::INVALID:
         menu->print_message("Invalid username or password.\n");
+        return false;
+    case AuthService::Status::BUSY:
+        menu->print_message("Too many logins right now. Please try again in a moment.\n");
+        return false;
+    default:
+        std::cerr << "Authentication failed: " << auth->last_error() << "\n";
+        return false;
     }
-
-    PQclear(res);
-    return success;
 }
 
-bool MainLoop::register_user() const
+bool MainLoop::register_user()
 {
     auto menu = std::make_unique<Menu>();
 
@@ -113,58 +237,135 @@ bool MainLoop::register_user() const
     menu->print_message("Enter new password: ");
     std::getline(std::cin, password);
 
-    const char *paramValues[2] = {username.c_str(), password.c_str()};
-    int32_t paramLengths[2] = {static_cast<int32_t>(username.length()), static_cast<int32_t>(password.length())};
-    int32_t paramFormats[2] = {0, 0}; // 0 = text
-
-    PGresult *res = PQexecParams(db_sync.get_connection(),
-                                 "INSERT INTO users (username, password) VALUES ($1, $2)",
-                                 2, NULL, paramValues, paramLengths, paramFormats, 0);
-
-    if (PQresultStatus(res) != PGRES_COMMAND_OK)
+    const AuthService::Status status = auth->register_user(username, password);
+    if (status == AuthService::Status::BUSY)
     {
-        std::cerr << "Registration failed: " << PQerrorMessage(db_sync.get_connection()) << "\n";
-        PQclear(res);
+        menu->print_message("Too many requests right now. Please try again in a moment.\n");
+        return false;
+    }
+    if (status != AuthService::Status::OK)
+    {
+        std::cerr << "Registration failed: " << auth->last_error() << "\n";
         return false;
     }
 
-    PQclear(res);
     menu->print_message("Registration successful! You can now login.\n");
     return true;
 }
 
 void MainLoop::start_training()
 {
-    auto menu = std::make_unique<Menu>();
+    const TraceSpan span("training_round", "session");
+    // предыдущий раунд больше не нужен: арена возвращается к началу буфера
+    round_arena.release();
+    const uint64_t allocations_before = AllocationCounter::thread_allocations();
 
     int32_t difficulty_level{db_sync.get_user_difficulty(current_user_id)};
     TaskGenerator::Difficulty difficulty = static_cast<TaskGenerator::Difficulty>(difficulty_level);
 
+    // длина берётся из расписания повторений, если оно уже есть
+    std::optional<UserSchedule> schedule;
+    try
+    {
+        schedule = db_sync.get_user_schedule(current_user_id);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Failed to load training schedule: " << e.what() << "\n";
+    }
+
     TaskGenerator generator(difficulty);
-    auto sequence = generator.generate_sequence(
-        generator.get_params_for_difficulty(difficulty).min_length);
+    generator.set_weak_items(weak_bias);
+    const auto sequence = generator.generate_sequence(
+        schedule ? schedule->next_length
+                 : generator.get_params_for_difficulty(difficulty).min_length,
+        &round_arena);
+
+    RoundResult round(&round_arena);
+    play_round(sequence, difficulty, round);
+    record_round(sequence, difficulty, SessionMode::TRAINING, 0, round);
+
+    const uint32_t correct = round.correct;
+    float success_rate = round.credit / sequence.size();
+    uint32_t score = calculate_score(success_rate, difficulty);
+
+    // запись уходит в БД, пока на экран выводятся результаты
+    PendingSave save = save_training_results(sequence, round, difficulty, success_rate, score);
+    update_difficulty_if_needed(difficulty, success_rate);
+
+    print_results(correct, sequence.size(), success_rate, score, difficulty);
+    finish_training_results(sequence, round, std::move(save));
+    update_schedule(schedule, difficulty, sequence.size(), success_rate);
+
+    training_rounds.increment();
+    if constexpr (AllocationCounter::enabled())
+    {
+        round_allocations.increment(AllocationCounter::thread_allocations() - allocations_before);
+    }
+}
+
+void MainLoop::play_round(std::span<const TaskGenerator::TaskItemView> sequence,
+                          TaskGenerator::Difficulty difficulty, RoundResult &result)
+{
+    result.started_at_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                               std::chrono::system_clock::now().time_since_epoch())
+                               .count();
+    const auto shown_at = std::chrono::steady_clock::now();
+
+    {
+        const TraceSpan span("display_sequence", "render");
+        display_training_header(difficulty, sequence.size());
+        display_sequence(sequence);
+    }
+    {
+        const TraceSpan span("memorize", "user");
+        count_down(memorization_seconds(difficulty));
+    }
+
+    clear_screen();
+    const auto prompted_at = std::chrono::steady_clock::now();
+    result.memorization_time = std::chrono::duration_cast<std::chrono::milliseconds>(prompted_at - shown_at);
+    {
+        const TraceSpan span("answer", "user");
+        result.answers = prompt_user_input(result.input);
+    }
+    result.answer_time = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - prompted_at);
+
+    if (result.answers.size() != sequence.size())
+    {
+        std::cerr << "Please enter exactly " << sequence.size() << " items." << std::endl;
+    }
 
-    display_training_header(difficulty, sequence.size());
-    display_sequence(sequence);
+    result.item_correct.assign(sequence.size(), 0);
+    const AnswerGrader::Grade grade = check_answers(sequence, result.answers, result.item_correct, difficulty);
+    result.correct = grade.correct;
+    result.credit = grade.credit;
+}
 
-    uint32_t memorization_time;
+uint32_t MainLoop::memorization_seconds(TaskGenerator::Difficulty difficulty) noexcept
+{
     switch (difficulty)
     {
     case TaskGenerator::Difficulty::EASY:
-        memorization_time = 7;
-        break; // EASY
+        return 7;
     case TaskGenerator::Difficulty::MEDIUM:
-        memorization_time = 6;
-        break; // MEDIUM
+        return 6;
     case TaskGenerator::Difficulty::HARD:
-        memorization_time = 5;
-        break; // HARD
+        return 5;
     }
-    std::ostringstream oss;
-    oss << "\n\nYou have " << memorization_time << " seconds to remember...\n";
-    menu->print_message(oss.str());
+    return 6;
+}
+
+void MainLoop::count_down(uint32_t seconds) const
+{
+    const Menu menu;
+    std::array<char, 32> number;
+    menu.print_message("\n\nYou have ");
+    menu.print_message(format_number(number, seconds));
+    menu.print_message(" seconds to remember...\n");
     auto start_time = std::chrono::steady_clock::now();
-    auto end_time = start_time + std::chrono::seconds(memorization_time);
+    auto end_time = start_time + std::chrono::seconds(seconds);
 
     while (std::chrono::steady_clock::now() < end_time)
     {
@@ -172,65 +373,283 @@ void MainLoop::start_training()
                              end_time - std::chrono::steady_clock::now())
                              .count();
 
-        std::ostringstream oss;
-        oss << "\rTime left: " << remaining << " seconds";
-        menu->print_message(oss.str());
+        menu.print_message("\rTime left: ");
+        menu.print_message(format_number(number, remaining));
+        menu.print_message(" seconds");
         std::cout << std::flush;
 
         std::this_thread::sleep_for(std::chrono::milliseconds(100));
     }
     std::cout << std::endl;
+}
 
-    clear_screen();
-    auto user_answers = prompt_user_input();
+void MainLoop::record_round(std::span<const TaskGenerator::TaskItemView> sequence,
+                            TaskGenerator::Difficulty difficulty, SessionMode mode, uint64_t seed,
+                            const RoundResult &result)
+{
+    if (!session_log)
+    {
+        return;
+    }
+
+    session_log->append(SessionRecord{
+        static_cast<uint32_t>(current_user_id),
+        result.started_at_ms,
+        difficulty,
+        mode,
+        seed,
+        static_cast<uint32_t>(result.memorization_time.count()),
+        static_cast<uint32_t>(result.answer_time.count()),
+        sequence,
+        result.answers,
+        result.item_correct});
+}
+
+void MainLoop::start_daily_challenge()
+{
+    const TraceSpan span("daily_challenge", "session");
+    round_arena.release();
+    const Menu menu;
+
+    int32_t difficulty_level{db_sync.get_user_difficulty(current_user_id)};
+    TaskGenerator::Difficulty difficulty = static_cast<TaskGenerator::Difficulty>(difficulty_level);
+    const std::string day = DailyChallenge::format_day(DailyChallenge::current_day());
 
-    if (user_answers.size() != sequence.size())
+    // одна попытка в день, иначе результаты нельзя сравнивать
+    try
     {
-        std::cerr << "Please enter exactly " << sequence.size() << " items." << std::endl;
+        if (const auto played = db_sync.get_daily_challenge_score(day, current_user_id))
+        {
+            menu.print_message("\nYou have already completed today's challenge (" +
+                               std::to_string(played->score) + " points).\n");
+            return;
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Failed to check daily challenge: " << e.what() << "\n";
+        return;
+    }
+
+    const auto &items = daily_challenge.sequence_for(difficulty);
+    std::pmr::vector<TaskGenerator::TaskItemView> sequence(&round_arena);
+    sequence.reserve(items.size());
+    for (const auto &item : items)
+    {
+        sequence.push_back(TaskGenerator::to_view(item));
     }
 
-    uint32_t correct = check_answers(sequence, user_answers);
-    float success_rate = static_cast<float>(correct) / sequence.size();
+    menu.print_message("\n=== Daily Challenge " + day + " ===\n");
+    RoundResult round(&round_arena);
+    play_round(sequence, difficulty, round);
+    record_round(sequence, difficulty, SessionMode::DAILY_CHALLENGE,
+                 DailyChallenge::seed_for(DailyChallenge::current_day(), difficulty), round);
+
+    const uint32_t correct = round.correct;
+    float success_rate = round.credit / sequence.size();
     uint32_t score = calculate_score(success_rate, difficulty);
 
-    save_training_results(sequence.size(), success_rate, score);
-    update_difficulty_if_needed(difficulty, success_rate);
+    if (!db_sync.save_daily_challenge_result(day, current_user_id, difficulty_level, score, success_rate))
+    {
+        std::cerr << "Failed to save daily challenge result: " << db_sync.last_error() << "\n";
+    }
 
-    print_results(correct, sequence.size(), success_rate, score, difficulty);
+    ScopedLatency timer(render_results_latency);
+    menu.print_training_results(correct, sequence.size(), success_rate, score, false, false);
+}
+
+void MainLoop::start_marathon()
+{
+    const TraceSpan span("marathon", "session");
+    const Menu menu;
+
+    int32_t difficulty_level{db_sync.get_user_difficulty(current_user_id)};
+    TaskGenerator::Difficulty difficulty = static_cast<TaskGenerator::Difficulty>(difficulty_level);
+    const AnswerGrader::GradingRules &rules = grading_rules[static_cast<std::size_t>(difficulty)];
+    const auto params = TaskGenerator::get_params_for_difficulty(difficulty);
+
+    // элементы берутся из ленивого потока по одному; вектор, строка ввода и её буфер
+    // переиспользуются между раундами, поэтому раунд не выделяет память после разгона
+    TaskGenerator generator(difficulty);
+    generator.set_weak_items(weak_bias);
+    Generator<TaskGenerator::TaskItemView> items = generator.stream();
+    std::vector<TaskGenerator::TaskItemView> sequence;
+    sequence.reserve(params.max_length);
+    std::string input;
+
+    std::chrono::milliseconds memorization_time{0};
+    std::chrono::milliseconds answer_time{0};
+    std::future<bool> weak_saved;
+    std::size_t completed{0}; // длина последней полностью воспроизведённой последовательности
+    float credit{0.0f};       // её сумма баллов; при ошибке - баллы верного префикса
+
+    display_training_header(difficulty, params.min_length);
+    menu.print_message("Marathon: one new item per round, recall the whole sequence each time.\n");
+
+    std::array<char, 32> number;
+    bool failed{false};
+    while (!failed && completed < MAX_MARATHON_LENGTH)
+    {
+        // первый раунд - минимальная длина уровня, затем по одному элементу
+        const std::size_t shown_from = sequence.size();
+        const std::size_t target = shown_from == 0 ? params.min_length : shown_from + 1;
+        while (sequence.size() < target)
+        {
+            sequence.push_back(*items.next());
+        }
+
+        // на экран выводится только новый хвост: старые элементы игрок уже запомнил
+        const auto shown_at = std::chrono::steady_clock::now();
+        menu.print_message("\nItem ");
+        menu.print_message(format_number(number, shown_from + 1));
+        if (sequence.size() > shown_from + 1)
+        {
+            menu.print_message("-");
+            menu.print_message(format_number(number, sequence.size()));
+        }
+        menu.print_message(": ");
+        display_sequence(std::span<const TaskGenerator::TaskItemView>(sequence).subspan(shown_from));
+        count_down(memorization_seconds(difficulty));
+        clear_screen();
+
+        const auto prompted_at = std::chrono::steady_clock::now();
+        memorization_time += std::chrono::duration_cast<std::chrono::milliseconds>(prompted_at - shown_at);
+        Tracer::instance().record("memorize", "user", shown_at, prompted_at);
+        menu.print_message("Enter the whole sequence (");
+        menu.print_message(format_number(number, sequence.size()));
+        menu.print_message(" items):\n");
+        input.clear();
+        if (!std::getline(std::cin, input))
+        {
+            failed = true;
+            credit = 0.0f;
+            break;
+        }
+        const auto answered_at = std::chrono::steady_clock::now();
+        answer_time += std::chrono::duration_cast<std::chrono::milliseconds>(answered_at - prompted_at);
+        Tracer::instance().record("answer", "user", prompted_at, answered_at);
+
+        // проверка по ходу разбора строки, без вектора токенов: первая ошибка завершает марафон
+        float round_credit{0.0f};
+        std::size_t index{0};
+        {
+            ScopedLatency timer(check_answers_latency);
+            const TraceSpan span("grade", "grading");
+            std::size_t position{0};
+            const std::string_view line(input);
+            for (; index < sequence.size(); ++index)
+            {
+                const std::string_view answer = AnswerGrader::next_token(line, position);
+                const float item = answer.empty() ? 0.0f : AnswerGrader::item_credit(sequence[index], answer, rules);
+                if (item <= 0.0f)
+                {
+                    break;
+                }
+                round_credit += item;
+            }
+        }
+
+        if (index < sequence.size())
+        {
+            failed = true;
+            credit = round_credit;
+            menu.print_message("Mistake at item ");
+            menu.print_message(format_number(number, index + 1));
+            menu.print_message(", it was: ");
+            display_sequence(std::span<const TaskGenerator::TaskItemView>(sequence).subspan(index, 1));
+            menu.print_message("\n");
+            static constexpr std::array<uint8_t, 1> MISSED{0};
+            weak_saved = update_weak_items(std::span<const TaskGenerator::TaskItemView>(sequence).subspan(index, 1),
+                                           MISSED);
+            break;
+        }
+        completed = sequence.size();
+        credit = round_credit;
+        marathon_rounds.increment();
+        menu.print_message("Correct! Length ");
+        menu.print_message(format_number(number, completed));
+        menu.print_message(".\n");
+    }
+
+    const std::size_t length = failed ? sequence.size() : completed;
+    const float success_rate = credit / static_cast<float>(length);
+    // очки последнего раунда плюс MARATHON_ITEM_POINTS (с множителем уровня) за каждый элемент сверх стартовых
+    const std::size_t extra_items = completed > params.min_length ? completed - params.min_length : 0;
+    const uint32_t score = calculate_score(success_rate, difficulty) +
+                           static_cast<uint32_t>(extra_items) * MARATHON_ITEM_POINTS *
+                               (static_cast<uint32_t>(difficulty) + 1);
+
+    // не в user_progress: история тренировок, графики и аналитика видят только обычные раунды
+    auto result_saved = db_sync.save_marathon_result_async(current_user_id, static_cast<uint32_t>(length), score,
+                                                           success_rate,
+                                                           static_cast<uint32_t>(memorization_time.count()),
+                                                           static_cast<uint32_t>(answer_time.count()));
+    auto score_saved = db_sync.update_score_async(current_user_id, score);
+
+    menu.print_message("\nMarathon over: ");
+    menu.print_message(format_number(number, completed));
+    menu.print_message(" items recalled, ");
+    menu.print_message(format_number(number, score));
+    menu.print_message(" points.\n");
+
+    if (!result_saved.get())
+    {
+        std::cerr << "Failed to save marathon result: " << db_sync.last_async_error() << "\n";
+    }
+    if (!score_saved.get())
+    {
+        std::cerr << "Failed to update score: " << db_sync.last_async_error() << "\n";
+    }
+    if (weak_saved.valid() && !weak_saved.get())
+    {
+        std::cerr << "Failed to save weak items: " << db_sync.last_async_error() << "\n";
+    }
+    if (score_compactor)
+    {
+        score_compactor->maybe_compact();
+    }
 }
 
 void MainLoop::display_training_header(TaskGenerator::Difficulty difficulty, std::size_t sequence_length)
 {
-    auto menu = std::make_unique<Menu>();
-    menu->print_message("\n=== Memory Training ===\n");
-    menu->print_message("Difficulty: ");
+    const Menu menu;
+    menu.print_message("\n=== Memory Training ===\n");
+    menu.print_message("Difficulty: ");
     switch (difficulty)
     {
     case TaskGenerator::Difficulty::EASY:
-        menu->print_message("EASY");
+        menu.print_message("EASY");
         break;
     case TaskGenerator::Difficulty::MEDIUM:
-        menu->print_message("MEDIUM");
+        menu.print_message("MEDIUM");
         break;
     case TaskGenerator::Difficulty::HARD:
-        menu->print_message("HARD");
+        menu.print_message("HARD");
         break;
     }
-    menu->print_message("\nRemember this sequence (" +
-                        std::to_string(sequence_length) +
-                        " items):\n");
+    std::array<char, 32> number;
+    menu.print_message("\nRemember this sequence (");
+    menu.print_message(format_number(number, sequence_length));
+    menu.print_message(" items):\n");
 }
 
-void MainLoop::display_sequence(const std::vector<TaskGenerator::TaskItem> &sequence)
+void MainLoop::display_sequence(std::span<const TaskGenerator::TaskItemView> sequence)
 {
-    auto menu = std::make_unique<Menu>();
+    ScopedLatency timer(render_sequence_latency);
+    const Menu menu;
+    std::array<char, 32> number;
     for (const auto &item : sequence)
     {
-        std::visit([&menu](auto &&arg)
+        std::visit([&](auto &&arg)
                    {
-            std::ostringstream oss;
-            oss << arg << " ";
-            menu->print_message(oss.str()); }, item);
+            using T = std::decay_t<decltype(arg)>;
+            if constexpr (std::is_same_v<T, std::string_view>)
+                menu.print_message(arg);
+            else if constexpr (std::is_same_v<T, char>)
+                menu.print_message(std::string_view(&arg, 1));
+            else
+                menu.print_message(format_number(number, arg));
+            menu.print_message(" "); }, item);
     }
 }
 
@@ -243,86 +662,148 @@ void MainLoop::clear_screen()
 #endif
 }
 
-std::vector<std::string> MainLoop::prompt_user_input()
+std::pmr::vector<std::string_view> MainLoop::prompt_user_input(std::pmr::string &input)
 {
-    auto menu = std::make_unique<Menu>();
+    const Menu menu;
 
-    menu->print_message("Enter the sequence (separate items with spaces):\n");
-    std::string input;
+    menu.print_message("Enter the sequence (separate items with spaces):\n");
+    input.reserve(256);
     std::getline(std::cin, input);
 
-    std::istringstream iss(input);
-    return {std::istream_iterator<std::string>{iss},
-            std::istream_iterator<std::string>{}};
+    // разбиение по пробелам без istringstream: токены - срезы строки input
+    std::pmr::vector<std::string_view> tokens(input.get_allocator());
+    tokens.reserve(TaskGenerator::PROFILES.back().max_length);
+    AnswerGrader::tokenize(input, tokens);
+    return tokens;
 }
 
-uint32_t MainLoop::check_answers(const std::vector<TaskGenerator::TaskItem> &sequence,
-                                 const std::vector<std::string> &user_answers) const
+AnswerGrader::Grade MainLoop::check_answers(std::span<const TaskGenerator::TaskItemView> sequence,
+                                            std::span<const std::string_view> user_answers,
+                                            std::span<uint8_t> item_correct,
+                                            TaskGenerator::Difficulty difficulty) const
 {
-    uint32_t correct{0};
-    for (std::size_t i{0}; i < sequence.size(); ++i)
+    ScopedLatency timer(check_answers_latency);
+    const TraceSpan span("grade", "grading");
+    return AnswerGrader::grade(sequence, user_answers, item_correct,
+                               grading_rules[static_cast<std::size_t>(difficulty)]);
+}
+
+uint32_t MainLoop::calculate_score(float success_rate, TaskGenerator::Difficulty difficulty) const
+{
+    return static_cast<uint32_t>(success_rate * 100 * (static_cast<uint32_t>(difficulty) + 1));
+}
+
+MainLoop::PendingSave MainLoop::save_training_results(std::span<const TaskGenerator::TaskItemView> sequence,
+                                                      const RoundResult &round, TaskGenerator::Difficulty difficulty,
+                                                      float success_rate, uint32_t score)
+{
+    return PendingSave{
+        db_sync.save_progress_async(current_user_id, static_cast<int32_t>(difficulty), sequence.size(), success_rate,
+                                    static_cast<uint32_t>(round.memorization_time.count()),
+                                    static_cast<uint32_t>(round.answer_time.count())),
+        db_sync.update_score_async(current_user_id, score),
+        update_weak_items(sequence, round.item_correct)};
+}
+
+void MainLoop::finish_training_results(std::span<const TaskGenerator::TaskItemView> sequence,
+                                       const RoundResult &round, PendingSave save)
+{
+    const TraceSpan span("wait_writes", "db");
+    const auto progress_id = save.progress_id.get();
+    if (!progress_id)
     {
-        if (i < user_answers.size() && !user_answers[i].empty())
+        std::cerr << "Failed to save progress: " << db_sync.last_async_error() << "\n";
+    }
+    else
+    {
+        for (std::size_t i{0}; i < sequence.size(); ++i)
+        {
+            pending_items.push_back(ProgressItem{*progress_id,
+                                                 static_cast<uint16_t>(i),
+                                                 static_cast<uint8_t>(sequence[i].index()),
+                                                 round.item_correct[i] != 0});
+        }
+        // неудачная пачка остаётся в буфере и повторяется на следующих раундах
+        if (pending_items.size() >= item_batch_rows && item_flush_failures <= MAX_ITEM_FLUSH_RETRIES)
+        {
+            flush_progress_items();
+        }
+        else if (item_flush_failures > MAX_ITEM_FLUSH_RETRIES &&
+                 pending_items.size() > item_batch_rows * MAX_PENDING_ITEM_BATCHES)
         {
-            bool is_correct = false;
-            std::visit([&](auto &&arg)
-                       {
-                using T = std::decay_t<decltype(arg)>;
-                try {
-                    if constexpr (std::is_same_v<T, std::string>) {
-                        // сравнение строк (для слов)
-                        is_correct = (arg == user_answers[i]);
-                    } 
-                    else if constexpr (std::is_same_v<T, char>) {
-                        // сравнение символов (регистронезависимо)
-                        is_correct = (std::tolower(arg) == std::tolower(user_answers[i][0]));
-                    } 
-                    else if constexpr (std::is_integral_v<T>) {
-                        // сравнение целых чисел
-                        is_correct = (arg == std::stoi(user_answers[i]));
-                    } 
-                    else if constexpr (std::is_floating_point_v<T>) {
-                        // сравнение float с погрешностью
-                        const float user_value = std::stof(user_answers[i]);
-                        if (user_value == arg) 
-                        {
-                        is_correct = true;
-                        }
-                        else 
-                        {
-                            const float epsilon = 0.01f;
-                            is_correct = (std::abs(arg - user_value) < epsilon);
-                        }
-                    }
-                } 
-                catch (...) {
-                    is_correct = false;
-                } }, sequence[i]);
-
-            if (is_correct)
-                correct++;
+            const std::size_t dropped = pending_items.size() - item_batch_rows * MAX_PENDING_ITEM_BATCHES;
+            pending_items.erase(pending_items.begin(), pending_items.begin() + static_cast<std::ptrdiff_t>(dropped));
+            std::cerr << "Dropping " << dropped << " oldest unsaved progress items\n";
         }
     }
-    return correct;
+
+    if (!save.score.get())
+    {
+        std::cerr << "Failed to update score: " << db_sync.last_async_error() << "\n";
+    }
+    if (save.weak_items.valid() && !save.weak_items.get())
+    {
+        std::cerr << "Failed to save weak items: " << db_sync.last_async_error() << "\n";
+    }
+    if (score_compactor)
+    {
+        score_compactor->maybe_compact();
+    }
 }
 
-uint32_t MainLoop::calculate_score(float success_rate, TaskGenerator::Difficulty difficulty) const
+void MainLoop::load_weak_items()
 {
-    return static_cast<uint32_t>(success_rate * 100 * (static_cast<uint32_t>(difficulty) + 1));
+    weak_items = WeakItemSketch{};
+    try
+    {
+        if (const auto stored = db_sync.get_weak_items(current_user_id))
+        {
+            if (auto sketch = WeakItemSketch::deserialize(*stored))
+            {
+                weak_items = *sketch;
+            }
+            else
+            {
+                std::cerr << "Ignoring weak items saved in an unknown format\n";
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Failed to load weak items: " << e.what() << "\n";
+    }
+    weak_bias = weak_items.empty() ? nullptr : std::make_shared<const WeakItemBias>(weak_items);
 }
 
-void MainLoop::save_training_results(std::size_t sequence_length, float success_rate, uint32_t score)
+std::future<bool> MainLoop::update_weak_items(std::span<const TaskGenerator::TaskItemView> sequence,
+                                              std::span<const uint8_t> item_correct)
 {
-    const char *progress_params[3] = {
-        std::to_string(current_user_id).c_str(),
-        std::to_string(sequence_length).c_str(),
-        std::to_string(success_rate).c_str()};
-    PGresult *progress_res = PQexecParams(db_sync.get_connection(),
-                                          "INSERT INTO user_progress (user_id, sequence_length, success_rate) VALUES ($1, $2, $3)",
-                                          3, NULL, progress_params, NULL, NULL, 0);
-    PQclear(progress_res);
+    const std::size_t count = std::min(sequence.size(), item_correct.size());
+    if (std::find(item_correct.begin(), item_correct.begin() + count, 0) == item_correct.begin() + count)
+    {
+        return {};
+    }
+
+    weak_items.record_round(sequence, item_correct);
+    weak_bias = weak_items.empty() ? nullptr : std::make_shared<const WeakItemBias>(weak_items);
+    return db_sync.save_weak_items_async(current_user_id, weak_items.serialize());
+}
 
-    db_sync.update_score(current_user_id, score);
+bool MainLoop::flush_progress_items()
+{
+    if (pending_items.empty())
+    {
+        return true;
+    }
+    // при частичной записи (шарды) в pending_items остаются только незаписанные строки
+    if (!db_sync.save_progress_items(pending_items))
+    {
+        ++item_flush_failures;
+        std::cerr << "Failed to save " << pending_items.size() << " progress items: " << db_sync.last_error() << "\n";
+        return false;
+    }
+    item_flush_failures = 0;
+    return true;
 }
 
 void MainLoop::update_difficulty_if_needed(TaskGenerator::Difficulty difficulty, float success_rate)
@@ -339,82 +820,320 @@ void MainLoop::update_difficulty_if_needed(TaskGenerator::Difficulty difficulty,
     }
 }
 
+void MainLoop::update_schedule(const std::optional<UserSchedule> &schedule, TaskGenerator::Difficulty difficulty,
+                               std::size_t sequence_length, float success_rate)
+{
+    const int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+                            std::chrono::system_clock::now().time_since_epoch())
+                            .count();
+
+    const UserSchedule current = schedule ? *schedule
+                                          : TrainingScheduler::initial_schedule(current_user_id, sequence_length, now);
+    const UserSchedule next = TrainingScheduler::review(current, success_rate, difficulty, now);
+
+    if (!db_sync.save_user_schedule(next))
+    {
+        std::cerr << "Failed to save training schedule: " << db_sync.last_error() << "\n";
+        return;
+    }
+
+    const Menu menu;
+    std::array<char, 32> number;
+    // до срока интервал не меняется: выводится, сколько осталось до due_at
+    const int64_t minutes = std::max<int64_t>(next.due_at - now, 0) / 60;
+    menu.print_message("Next training: ");
+    menu.print_message(format_number(number, next.next_length));
+    menu.print_message(" items in ");
+    if (minutes < 60)
+    {
+        menu.print_message(format_number(number, minutes));
+        menu.print_message(" minutes\n");
+    }
+    else if (minutes < 24 * 60)
+    {
+        menu.print_message(format_number(number, minutes / 60));
+        menu.print_message(" hours\n");
+    }
+    else
+    {
+        menu.print_message(format_number(number, minutes / (24 * 60)));
+        menu.print_message(" days\n");
+    }
+}
+
 void MainLoop::print_results(uint32_t correct, std::size_t total, float success_rate,
                              uint32_t score, TaskGenerator::Difficulty difficulty) const
 {
-    auto menu = std::make_unique<Menu>();
+    ScopedLatency timer(render_results_latency);
+    const TraceSpan span("render_results", "render");
+    const Menu menu;
     bool level_increased = (success_rate > 0.75f &&
                             difficulty != TaskGenerator::Difficulty::HARD);
     bool suggest_easier = (success_rate < 0.3f &&
                            difficulty != TaskGenerator::Difficulty::EASY);
 
-    menu->print_training_results(correct, total, success_rate, score,
+    menu.print_training_results(correct, total, success_rate, score,
                                  level_increased, suggest_easier);
 }
 
 void MainLoop::show_leaderboard() const
 {
-    if (!db_sync.get_connection() || PQstatus(db_sync.get_connection()) != CONNECTION_OK)
+    const TraceSpan span("leaderboard", "session");
+    if (!db_sync.is_connected())
     {
         std::cerr << "Failure: no connection to db.\n";
         return;
     }
 
-    // топ-10 игроков по очкам
-    const char *query =
-        "SELECT username, total_score FROM users "
-        "WHERE total_score > 0 "
-        "ORDER BY total_score DESC "
-        "LIMIT 10";
+    auto menu = std::make_unique<Menu>();
+    menu->print_leaderboard_period_menu();
 
-    PGresult *res = PQexec(db_sync.get_connection(), query);
+    uint32_t choice{0};
+    if (!(std::cin >> choice))
+    {
+        std::cin.clear();
+    }
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+    SharedLeaderboard::Board board;
+    std::string title;
+    switch (choice)
+    {
+    case 1:
+        board = SharedLeaderboard::Board::DAY;
+        title = "TOP-10 Today";
+        break;
+    case 2:
+        board = SharedLeaderboard::Board::WEEK;
+        title = "TOP-10 This Week";
+        break;
+    case 3:
+        board = SharedLeaderboard::Board::MONTH;
+        title = "TOP-10 This Month";
+        break;
+    case 4:
+        board = SharedLeaderboard::Board::ALL_TIME;
+        title = "TOP-10 Players";
+        break;
+    case 5:
+        show_daily_leaderboard();
+        return;
+    default:
+        menu->print_message("Invalid choice.\n");
+        return;
+    }
 
-    if (PQresultStatus(res) != PGRES_TUPLES_OK)
+    // топ-10 игроков по очкам за период
+    LeaderboardRows leaders;
+    try
+    {
+        leaders = load_leaderboard(board);
+    }
+    catch (const std::exception &e)
     {
-        std::cerr << "Failure on getting leaderboard: " << PQerrorMessage(db_sync.get_connection()) << "\n";
-        PQclear(res);
+        std::cerr << "Failure on getting leaderboard: " << e.what() << "\n";
         return;
     }
 
     // вывод leaderboard
+    ScopedLatency timer(render_leaderboard_latency);
+    if (leaders.empty())
+    {
+        menu->print_message("\nLeaderboard is clear. Be first!\n");
+    }
+    else
+    {
+        menu->print_leaderboard(leaders, title);
+    }
+}
+
+void MainLoop::show_daily_leaderboard() const
+{
+    const TraceSpan span("daily_leaderboard", "session");
     auto menu = std::make_unique<Menu>();
-    uint32_t rows = PQntuples(res);
-    std::vector<std::pair<std::string, std::string>> leaders;
+    const std::string day = DailyChallenge::format_day(DailyChallenge::current_day());
 
-    if (rows == 0)
+    // рейтинг уровня, на котором сыграно сегодняшнее задание; кто ещё не играл - текущего уровня
+    LeaderboardRows leaders;
+    std::string title = "Daily Challenge " + day;
+    try
     {
-        menu->print_message("\nLeaderboard is clear. Be first!\n");
+        const auto played = db_sync.get_daily_challenge_score(day, current_user_id);
+        const int32_t difficulty_level{played ? played->difficulty : db_sync.get_user_difficulty(current_user_id)};
+        const auto board = static_cast<SharedLeaderboard::Board>(
+            static_cast<int32_t>(SharedLeaderboard::Board::DAILY_EASY) + difficulty_level);
+        switch (board)
+        {
+        case SharedLeaderboard::Board::DAILY_EASY:
+            title += " (EASY)";
+            break;
+        case SharedLeaderboard::Board::DAILY_MEDIUM:
+            title += " (MEDIUM)";
+            break;
+        case SharedLeaderboard::Board::DAILY_HARD:
+            title += " (HARD)";
+            break;
+        default:
+            std::cerr << "Failure on getting daily leaderboard: unknown difficulty " << difficulty_level << "\n";
+            return;
+        }
+        leaders = load_leaderboard(board);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Failure on getting daily leaderboard: " << e.what() << "\n";
+        return;
+    }
+
+    ScopedLatency timer(render_leaderboard_latency);
+    if (leaders.empty())
+    {
+        menu->print_message("\nNobody has completed today's challenge yet. Be first!\n");
     }
     else
     {
-        for (std::size_t i{0}; i < rows; ++i)
+        menu->print_leaderboard(leaders, title);
+    }
+}
+
+LeaderboardRows MainLoop::load_leaderboard(SharedLeaderboard::Board board) const
+{
+    const int64_t day = DailyChallenge::current_day();
+    if (shared_leaderboard)
+    {
+        if (auto rows = shared_leaderboard->read(board, day))
         {
-            leaders.emplace_back(
-                PQgetvalue(res, i, 0), // username
-                PQgetvalue(res, i, 1)  // score
-            );
+            shared_leaderboard_hits.increment();
+            return std::move(*rows);
+        }
+
+        // сегмент пуст или устарел: обновляет только получивший аренду, все рейтинги сразу
+        if (shared_leaderboard->try_acquire_refresh())
+        {
+            SharedLeaderboard::Snapshot boards;
+            for (std::size_t i{0}; i < SharedLeaderboard::BOARD_COUNT; ++i)
+            {
+                boards[i] = query_leaderboard(static_cast<SharedLeaderboard::Board>(i), day);
+            }
+            shared_leaderboard->publish(day, boards);
+            shared_leaderboard_refreshes.increment();
+            return std::move(boards[static_cast<std::size_t>(board)]);
+        }
+
+        // обновляет другой процесс: прошлые данные лучше ещё одного запроса
+        if (auto rows = shared_leaderboard->read(board, day, true))
+        {
+            shared_leaderboard_hits.increment();
+            return std::move(*rows);
         }
-        menu->print_leaderboard(leaders);
     }
 
-    PQclear(res);
+    shared_leaderboard_misses.increment();
+    return query_leaderboard(board, day);
+}
+
+LeaderboardRows MainLoop::query_leaderboard(SharedLeaderboard::Board board, int64_t day) const
+{
+    constexpr uint32_t limit = SharedLeaderboard::TOP_N;
+    switch (board)
+    {
+    case SharedLeaderboard::Board::DAY:
+        return db_sync.get_leaderboard(LeaderboardPeriod::DAY, limit);
+    case SharedLeaderboard::Board::WEEK:
+        return db_sync.get_leaderboard(LeaderboardPeriod::WEEK, limit);
+    case SharedLeaderboard::Board::MONTH:
+        return db_sync.get_leaderboard(LeaderboardPeriod::MONTH, limit);
+    case SharedLeaderboard::Board::ALL_TIME:
+        return db_sync.get_leaderboard(LeaderboardPeriod::ALL_TIME, limit);
+    case SharedLeaderboard::Board::DAILY_EASY:
+    case SharedLeaderboard::Board::DAILY_MEDIUM:
+    case SharedLeaderboard::Board::DAILY_HARD:
+        return db_sync.get_daily_leaderboard(
+            DailyChallenge::format_day(day),
+            static_cast<int32_t>(board) - static_cast<int32_t>(SharedLeaderboard::Board::DAILY_EASY), limit);
+    }
+    return {};
 }
 
 void MainLoop::show_user_progress()
 {
+    const TraceSpan span("user_progress", "session");
     auto menu = std::make_unique<Menu>();
-    auto progress = db_sync.get_user_progress(current_user_id);
+    menu->print_progress_period_menu();
+
+    uint32_t choice{0};
+    if (!(std::cin >> choice))
+    {
+        std::cin.clear();
+    }
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+    ProgressBucket bucket;
+    std::string unit;
+    switch (choice)
+    {
+    case 1:
+        bucket = ProgressBucket::DAY;
+        unit = "day";
+        break;
+    case 2:
+        bucket = ProgressBucket::WEEK;
+        unit = "week";
+        break;
+    default:
+        menu->print_message("Invalid choice.\n");
+        return;
+    }
+
+    // по колонке на точку: с сервера приходит не больше PROGRESS_OVERSAMPLE бакетов на колонку,
+    // сколько бы тренировок ни было в истории
+    const std::size_t columns =
+        std::max(Menu::terminal_width(), Menu::CHART_AXIS_WIDTH + MIN_CHART_COLUMNS + 1) - Menu::CHART_AXIS_WIDTH - 1;
+    const auto max_buckets = static_cast<uint32_t>(columns * PROGRESS_OVERSAMPLE);
+    std::vector<ProgressPoint> points;
+    try
+    {
+        points = db_sync.get_progress_buckets(current_user_id, bucket, max_buckets);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Failed to load progress: " << e.what() << "\n";
+        return;
+    }
+    if (points.empty())
+    {
+        menu->print_message("No trainings yet.\n");
+        return;
+    }
+
+    std::vector<double> times;
+    std::vector<double> rates;
+    times.reserve(points.size());
+    rates.reserve(points.size());
+    uint64_t rounds{0};
+    for (const ProgressPoint &point : points)
+    {
+        times.push_back(static_cast<double>(point.bucket_start));
+        rates.push_back(point.success_rate);
+        rounds += point.rounds;
+    }
 
-    menu->print_message("\n=== Your Training History ===\n");
-    for (const auto &record : progress)
+    // длинный ряд прореживается до ширины экрана с сохранением пиков и провалов
+    std::vector<float> shown_rates;
+    std::vector<float> shown_lengths;
+    for (const std::size_t index : Downsampling::lttb(times, rates, columns))
     {
-        std::ostringstream oss;
-        oss << "Date: " << record.training_date.substr(0, 10)
-            << " | Length: " << record.sequence_length
-            << " items | Success: " << std::fixed << std::setprecision(1)
-            << (record.success_rate * 100) << "%";
-        menu->print_message(oss.str());
+        shown_rates.push_back(points[index].success_rate);
+        shown_lengths.push_back(points[index].sequence_length);
     }
+
+    constexpr int64_t SECONDS_PER_DAY = 86400;
+    menu->print_progress_chart("Success rate by " + unit, shown_rates, shown_lengths,
+                               DailyChallenge::format_day(points.front().bucket_start / SECONDS_PER_DAY),
+                               DailyChallenge::format_day(points.back().bucket_start / SECONDS_PER_DAY));
+    menu->print_message(std::to_string(rounds) + " trainings in " + std::to_string(points.size()) + " " + unit +
+                        (points.size() == 1 ? "" : "s") +
+                        (points.size() == max_buckets ? " (most recent)" : "") + "\n");
 }
 
 void MainLoop::run()
@@ -478,6 +1197,15 @@ void MainLoop::run()
             show_leaderboard();
             break;
         case 3:
+            start_daily_challenge();
+            break;
+        case 4:
+            start_marathon();
+            break;
+        case 5:
+            show_user_progress();
+            break;
+        case 6:
             return;
         default:
             menu->print_message("Invalid choice. Try again.\n");
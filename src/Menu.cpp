@@ -2,7 +2,15 @@
 
 #include <iostream>
 #include <iomanip>
-#include <sstream>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+
+#ifndef _WIN32
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
 
 namespace
 {
@@ -45,11 +53,36 @@ void Menu::print_main_menu() const
         "Main Menu",
         "1. Start Training\n"
         "2. View Leaderboard\n"
-        "3. Logout and exit\n",
+        "3. Daily Challenge\n"
+        "4. Marathon\n"
+        "5. My Progress\n"
+        "6. Logout and exit\n",
         "=", 24);
 }
 
-void Menu::print_leaderboard(const std::vector<std::pair<std::string, std::string>> &leaders) const
+void Menu::print_leaderboard_period_menu() const
+{
+    print_menu(
+        "Leaderboard",
+        "1. Today\n"
+        "2. This week\n"
+        "3. This month\n"
+        "4. All time\n"
+        "5. Daily challenge\n",
+        "=", 26);
+}
+
+void Menu::print_progress_period_menu() const
+{
+    print_menu(
+        "Progress",
+        "1. By day\n"
+        "2. By week\n",
+        "=", 22);
+}
+
+void Menu::print_leaderboard(const std::vector<std::pair<std::string, std::string>> &leaders,
+                             const std::string &title) const
 {
     constexpr const char *GRAY = "\033[38;2;180;180;180m";
     constexpr const char *ITALIC = "\033[3m";
@@ -57,7 +90,7 @@ void Menu::print_leaderboard(const std::vector<std::pair<std::string, std::strin
     constexpr const char *RESET = "\033[0m";
 
     std::cout << GRAY << ITALIC
-              << "\n======= " << BOLD << "TOP-10 Players" << RESET << GRAY << ITALIC << " =======\n"
+              << "\n======= " << BOLD << title << RESET << GRAY << ITALIC << " =======\n"
               << RESET;
 
     std::cout << GRAY << BOLD
@@ -78,7 +111,7 @@ void Menu::print_leaderboard(const std::vector<std::pair<std::string, std::strin
               << RESET << "\n";
 }
 
-void Menu::print_message(const std::string &message) const
+void Menu::print_message(std::string_view message) const
 {
     constexpr const char *GRAY = "\033[38;2;180;180;180m";
     constexpr const char *RESET = "\033[0m";
@@ -89,22 +122,118 @@ void Menu::print_message(const std::string &message) const
 void Menu::print_training_results(uint32_t correct, size_t total, float success_rate,
                                   uint32_t score, bool level_increased, bool suggest_easier) const
 {
-    std::ostringstream oss;
+    // пишется напрямую в std::cout, без промежуточной строки
+    const auto flags = std::cout.flags();
+    const auto precision = std::cout.precision();
 
-    oss << "\nTraining results:\n"
-        << "Correct: " << correct << "/" << total << "\n"
-        << "Success rate: " << std::fixed << std::setprecision(1)
-        << (success_rate * 100) << "%\n"
-        << "Points earned: " << score << "\n";
+    std::cout << GRAY
+              << "\nTraining results:\n"
+              << "Correct: " << correct << "/" << total << "\n"
+              << "Success rate: " << std::fixed << std::setprecision(1)
+              << (success_rate * 100) << "%\n"
+              << "Points earned: " << score << "\n";
 
     if (level_increased)
     {
-        oss << "Congratulations! Difficulty level increased!\n";
+        std::cout << "Congratulations! Difficulty level increased!\n";
     }
     else if (suggest_easier)
     {
-        oss << "Try easier difficulty next time!\n";
+        std::cout << "Try easier difficulty next time!\n";
+    }
+
+    std::cout << RESET;
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+}
+
+void Menu::print_progress_chart(const std::string &title, std::span<const float> success_rates,
+                                std::span<const float> lengths, std::string_view first_label,
+                                std::string_view last_label) const
+{
+    // восемь ступеней высоты одного символа
+    constexpr std::array<const char *, 8> SPARKS = {"▁", "▂", "▃", "▄",
+                                                    "▅", "▆", "▇", "█"};
+
+    const auto flags = std::cout.flags();
+    const auto precision = std::cout.precision();
+
+    std::cout << GRAY << ITALIC
+              << "\n======= " << BOLD << title << RESET << GRAY << ITALIC << " =======\n"
+              << RESET << GRAY;
+
+    // строка row закрашена у столбцов, доходящих до её середины
+    for (std::size_t row{CHART_ROWS}; row > 0; --row)
+    {
+        if (row == CHART_ROWS)
+            std::cout << "100% |";
+        else if (row == CHART_ROWS / 2)
+            std::cout << " 50% |";
+        else
+            std::cout << "     |";
+
+        const float threshold = (static_cast<float>(row) - 0.5f) / CHART_ROWS;
+        for (const float rate : success_rates)
+        {
+            std::cout << (rate >= threshold ? '#' : ' ');
+        }
+        std::cout << "\n";
+    }
+    std::cout << "  0% +" << std::string(success_rates.size(), '-') << "\n";
+
+    // подписи концов оси времени; если колонок мало, последняя переносится на свою строку
+    std::cout << std::string(CHART_AXIS_WIDTH, ' ') << first_label;
+    if (success_rates.size() > first_label.size() + last_label.size())
+    {
+        std::cout << std::string(success_rates.size() - first_label.size() - last_label.size(), ' ')
+                  << last_label << "\n";
+    }
+    else if (last_label != first_label)
+    {
+        std::cout << "\n" << std::string(CHART_AXIS_WIDTH, ' ') << last_label << "\n";
+    }
+    else
+    {
+        std::cout << "\n";
+    }
+
+    if (!lengths.empty())
+    {
+        const auto [shortest, longest] = std::minmax_element(lengths.begin(), lengths.end());
+        const float range = *longest - *shortest;
+        std::cout << "\nLen  |";
+        for (const float length : lengths)
+        {
+            const std::size_t step = range > 0.0f
+                                         ? static_cast<std::size_t>(std::lround((length - *shortest) / range * 7.0f))
+                                         : 0;
+            std::cout << SPARKS[step];
+        }
+        std::cout << "\n" << std::string(CHART_AXIS_WIDTH, ' ') << "items per sequence: " << std::fixed
+                  << std::setprecision(1) << *shortest << " - " << *longest << "\n";
     }
 
-    print_message(oss.str());
+    std::cout << RESET;
+    std::cout.flags(flags);
+    std::cout.precision(precision);
+}
+
+std::size_t Menu::terminal_width() noexcept
+{
+#ifndef _WIN32
+    winsize size{};
+    if (::ioctl(STDOUT_FILENO, TIOCGWINSZ, &size) == 0 && size.ws_col > 0)
+    {
+        return size.ws_col;
+    }
+#endif
+    if (const char *columns = std::getenv("COLUMNS"))
+    {
+        const long value = std::strtol(columns, nullptr, 10);
+        if (value > 0)
+        {
+            return static_cast<std::size_t>(value);
+        }
+    }
+    return 80;
 }
@@ -0,0 +1,402 @@
+#include "../include/Metrics.hpp"
+
+#include <array>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <bit>
+#include <new>
+#include <sstream>
+#include <iomanip>
+#include <fstream>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+
+namespace
+{
+    constexpr std::size_t MAX_HISTOGRAMS = 128;
+    constexpr std::size_t MAX_COUNTERS = 256;
+
+    struct HistogramShard
+    {
+        std::array<std::atomic<uint64_t>, LatencyHistogram::BUCKET_COUNT> buckets{};
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> sum_ns{0};
+    };
+
+    // у каждого потока свой шард: запись без RMW и без разделяемых кэш-линий
+    struct ThreadShard
+    {
+        std::array<std::atomic<HistogramShard *>, MAX_HISTOGRAMS> histograms{};
+        std::array<std::atomic<uint64_t>, MAX_COUNTERS> counters{};
+
+        ~ThreadShard()
+        {
+            for (auto &histogram : histograms)
+            {
+                delete histogram.load(std::memory_order_relaxed);
+            }
+        }
+    };
+
+    struct MetricInfo
+    {
+        std::string name;
+        std::string help;
+        std::string labels;
+    };
+
+    struct RegistryState
+    {
+        std::mutex mutex;
+        std::vector<MetricInfo> histograms;
+        std::vector<MetricInfo> counters;
+        std::vector<ThreadShard *> live_shards;
+        ThreadShard retired; // итоги завершившихся потоков
+    };
+
+    RegistryState &registry_state()
+    {
+        static RegistryState state;
+        return state;
+    }
+
+    inline void bump(std::atomic<uint64_t> &value, uint64_t delta) noexcept
+    {
+        // у шарда один писатель, поэтому достаточно relaxed load + store
+        value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+
+    // nullptr - не хватило памяти; запись тогда пропускается, а record и increment остаются noexcept
+    HistogramShard *histogram_shard(ThreadShard &shard, std::size_t slot) noexcept
+    {
+        HistogramShard *histogram = shard.histograms[slot].load(std::memory_order_acquire);
+        if (!histogram)
+        {
+            histogram = new (std::nothrow) HistogramShard;
+            if (histogram)
+            {
+                shard.histograms[slot].store(histogram, std::memory_order_release);
+            }
+        }
+        return histogram;
+    }
+
+    void merge_into(const ThreadShard &source, ThreadShard &target)
+    {
+        for (std::size_t slot{0}; slot < MAX_HISTOGRAMS; ++slot)
+        {
+            const HistogramShard *from = source.histograms[slot].load(std::memory_order_acquire);
+            if (!from)
+                continue;
+
+            HistogramShard *to = histogram_shard(target, slot);
+            if (!to)
+                continue;
+            for (std::size_t i{0}; i < LatencyHistogram::BUCKET_COUNT; ++i)
+            {
+                to->buckets[i].fetch_add(from->buckets[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+            to->count.fetch_add(from->count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            to->sum_ns.fetch_add(from->sum_ns.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+        for (std::size_t slot{0}; slot < MAX_COUNTERS; ++slot)
+        {
+            target.counters[slot].fetch_add(source.counters[slot].load(std::memory_order_relaxed),
+                                            std::memory_order_relaxed);
+        }
+    }
+
+    // создаётся при первой записи потока внутри noexcept-функций, поэтому сам не бросает:
+    // без памяти shard остаётся nullptr и записи этого потока пропускаются
+    struct ShardHandle
+    {
+        ThreadShard *shard;
+
+        ShardHandle() noexcept : shard(new (std::nothrow) ThreadShard)
+        {
+            if (!shard)
+            {
+                return;
+            }
+            try
+            {
+                auto &state = registry_state();
+                std::lock_guard lock(state.mutex);
+                state.live_shards.push_back(shard);
+            }
+            catch (...)
+            {
+                delete shard;
+                shard = nullptr;
+            }
+        }
+
+        ~ShardHandle()
+        {
+            if (!shard)
+            {
+                return;
+            }
+            auto &state = registry_state();
+            {
+                std::lock_guard lock(state.mutex);
+                merge_into(*shard, state.retired);
+                std::erase(state.live_shards, shard);
+            }
+            delete shard;
+        }
+    };
+
+    ThreadShard *local_shard() noexcept
+    {
+        thread_local ShardHandle handle;
+        return handle.shard;
+    }
+
+    std::size_t register_metric(std::vector<MetricInfo> &metrics, std::size_t capacity,
+                                const std::string &name, const std::string &help, const std::string &labels)
+    {
+        auto &state = registry_state();
+        std::lock_guard lock(state.mutex);
+        if (metrics.size() >= capacity)
+        {
+            throw std::length_error("Too many metrics registered: " + name);
+        }
+        metrics.push_back({name, help, labels});
+        return metrics.size() - 1;
+    }
+
+    std::string series(const std::string &name, const std::string &labels, const std::string &extra = "")
+    {
+        if (labels.empty() && extra.empty())
+        {
+            return name;
+        }
+        std::string result = name + "{" + labels;
+        if (!labels.empty() && !extra.empty())
+        {
+            result += ",";
+        }
+        return result + extra + "}";
+    }
+
+    std::vector<std::string> family_names(const std::vector<MetricInfo> &metrics)
+    {
+        std::vector<std::string> names;
+        for (const auto &metric : metrics)
+        {
+            if (std::find(names.begin(), names.end(), metric.name) == names.end())
+            {
+                names.push_back(metric.name);
+            }
+        }
+        return names;
+    }
+}
+
+LatencyHistogram::LatencyHistogram(const std::string &name, const std::string &help, const std::string &labels)
+    : slot(register_metric(registry_state().histograms, MAX_HISTOGRAMS, name, help, labels))
+{
+}
+
+void LatencyHistogram::record(std::chrono::nanoseconds elapsed) const noexcept
+{
+    const uint64_t ns = elapsed.count() > 0 ? static_cast<uint64_t>(elapsed.count()) : 0;
+    ThreadShard *shard = local_shard();
+    HistogramShard *histogram = shard ? histogram_shard(*shard, slot) : nullptr;
+    if (!histogram)
+    {
+        return;
+    }
+    bump(histogram->buckets[bucket_index(ns)], 1);
+    bump(histogram->count, 1);
+    bump(histogram->sum_ns, ns);
+}
+
+std::size_t LatencyHistogram::bucket_index(uint64_t nanoseconds) noexcept
+{
+    nanoseconds = std::min(nanoseconds, (uint64_t{1} << (MAX_EXPONENT + 1)) - 1);
+    if (nanoseconds < SUB_BUCKETS)
+    {
+        return static_cast<std::size_t>(nanoseconds);
+    }
+    const std::size_t exponent = std::bit_width(nanoseconds) - 1;
+    const std::size_t sub = (nanoseconds >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::bucket_upper_bound(std::size_t index) noexcept
+{
+    if (index < SUB_BUCKETS)
+    {
+        return index;
+    }
+    const std::size_t exponent = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+    const uint64_t sub = index % SUB_BUCKETS;
+    return ((SUB_BUCKETS + sub + 1) << (exponent - SUB_BUCKET_BITS)) - 1;
+}
+
+MetricCounter::MetricCounter(const std::string &name, const std::string &help, const std::string &labels)
+    : slot(register_metric(registry_state().counters, MAX_COUNTERS, name, help, labels))
+{
+}
+
+void MetricCounter::increment(uint64_t delta) const noexcept
+{
+    if (ThreadShard *shard = local_shard())
+    {
+        bump(shard->counters[slot], delta);
+    }
+}
+
+MetricsRegistry &MetricsRegistry::instance()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+MetricsRegistry::~MetricsRegistry()
+{
+    stop_file_exporter();
+}
+
+std::string MetricsRegistry::render_prometheus() const
+{
+    auto &state = registry_state();
+    std::lock_guard lock(state.mutex);
+
+    std::vector<const ThreadShard *> shards(state.live_shards.begin(), state.live_shards.end());
+    shards.push_back(&state.retired);
+
+    std::ostringstream out;
+    out << std::setprecision(12);
+
+    for (const auto &name : family_names(state.histograms))
+    {
+        bool header_written = false;
+        for (std::size_t slot{0}; slot < state.histograms.size(); ++slot)
+        {
+            const MetricInfo &info = state.histograms[slot];
+            if (info.name != name)
+                continue;
+
+            if (!header_written)
+            {
+                out << "# HELP " << name << " " << info.help << "\n"
+                    << "# TYPE " << name << " histogram\n";
+                header_written = true;
+            }
+
+            std::array<uint64_t, LatencyHistogram::BUCKET_COUNT> buckets{};
+            uint64_t count{0};
+            uint64_t sum_ns{0};
+            for (const ThreadShard *shard : shards)
+            {
+                const HistogramShard *histogram = shard->histograms[slot].load(std::memory_order_acquire);
+                if (!histogram)
+                    continue;
+                for (std::size_t i{0}; i < LatencyHistogram::BUCKET_COUNT; ++i)
+                {
+                    buckets[i] += histogram->buckets[i].load(std::memory_order_relaxed);
+                }
+                count += histogram->count.load(std::memory_order_relaxed);
+                sum_ns += histogram->sum_ns.load(std::memory_order_relaxed);
+            }
+
+            // выводятся только непустые бакеты (накопительно) и +Inf
+            uint64_t cumulative{0};
+            for (std::size_t i{0}; i < LatencyHistogram::BUCKET_COUNT; ++i)
+            {
+                if (buckets[i] == 0)
+                    continue;
+                cumulative += buckets[i];
+                std::ostringstream le;
+                le << std::setprecision(12) << "le=\"" << static_cast<double>(LatencyHistogram::bucket_upper_bound(i)) / 1e9 << "\"";
+                out << series(name + "_bucket", info.labels, le.str()) << " " << cumulative << "\n";
+            }
+            out << series(name + "_bucket", info.labels, "le=\"+Inf\"") << " " << count << "\n"
+                << series(name + "_sum", info.labels) << " " << static_cast<double>(sum_ns) / 1e9 << "\n"
+                << series(name + "_count", info.labels) << " " << count << "\n";
+        }
+    }
+
+    for (const auto &name : family_names(state.counters))
+    {
+        bool header_written = false;
+        for (std::size_t slot{0}; slot < state.counters.size(); ++slot)
+        {
+            const MetricInfo &info = state.counters[slot];
+            if (info.name != name)
+                continue;
+
+            if (!header_written)
+            {
+                out << "# HELP " << name << " " << info.help << "\n"
+                    << "# TYPE " << name << " counter\n";
+                header_written = true;
+            }
+
+            uint64_t total{0};
+            for (const ThreadShard *shard : shards)
+            {
+                total += shard->counters[slot].load(std::memory_order_relaxed);
+            }
+            out << series(name, info.labels) << " " << total << "\n";
+        }
+    }
+
+    return out.str();
+}
+
+bool MetricsRegistry::write_prometheus_file(const std::string &path) const
+{
+    const std::string tmp_path = path + ".tmp";
+    {
+        std::ofstream file(tmp_path, std::ios::trunc);
+        if (!file.is_open())
+        {
+            return false;
+        }
+        file << render_prometheus();
+        if (!file.good())
+        {
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, path, ec);
+    return !ec;
+}
+
+void MetricsRegistry::start_file_exporter(const std::string &path, std::chrono::seconds interval)
+{
+    stop_file_exporter();
+
+    exporter_stop = false;
+    exporter = std::thread([this, path, interval]
+                           {
+        std::unique_lock lock(exporter_mutex);
+        while (!exporter_stop)
+        {
+            exporter_wakeup.wait_for(lock, interval, [this] { return exporter_stop; });
+            lock.unlock();
+            write_prometheus_file(path);
+            lock.lock();
+        } });
+}
+
+void MetricsRegistry::stop_file_exporter()
+{
+    {
+        std::lock_guard lock(exporter_mutex);
+        exporter_stop = true;
+    }
+    exporter_wakeup.notify_all();
+    if (exporter.joinable())
+    {
+        exporter.join();
+    }
+}
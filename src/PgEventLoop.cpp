@@ -0,0 +1,416 @@
+#include "../include/PgEventLoop.hpp"
+#include "../include/QueryLog.hpp"
+#include "../include/Metrics.hpp"
+#include "../include/Tracing.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // data.u64 события eventfd; у соединений - их индекс
+    constexpr uint64_t WAKEUP_TAG = ~uint64_t{0};
+    // PQputCopyData принимает int
+    constexpr std::size_t COPY_CHUNK_BYTES = std::size_t{1} << 20;
+
+    MetricCounter async_queries("mem_trainer_db_async_queries_total", "Queries submitted to the asynchronous event loop");
+    LatencyHistogram async_queue_wait("mem_trainer_db_async_queue_wait_seconds",
+                                      "Time an asynchronous query waits for a free connection");
+}
+
+PgEventLoop::PgEventLoop(std::string conninfo, std::size_t connections, SlowQueryLog *slow_log)
+    : conninfo(std::move(conninfo)),
+      slow_log(slow_log),
+      connections(std::max<std::size_t>(connections, 1))
+{
+}
+
+PgEventLoop::~PgEventLoop()
+{
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+    if (worker.joinable())
+    {
+        wake();
+        worker.join();
+    }
+#ifndef _WIN32
+    if (wakeup_fd >= 0)
+    {
+        ::close(wakeup_fd);
+    }
+    if (epoll_fd >= 0)
+    {
+        ::close(epoll_fd);
+    }
+#endif
+}
+
+bool PgEventLoop::start()
+{
+#ifdef _WIN32
+    std::lock_guard lock(mutex);
+    error = "asynchronous queries are only supported on Linux";
+    return false;
+#else
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd < 0 || wakeup_fd < 0)
+    {
+        std::lock_guard lock(mutex);
+        error = std::strerror(errno);
+        return false;
+    }
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = WAKEUP_TAG;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wakeup_fd, &event);
+
+    for (auto &connection : connections)
+    {
+        if (!open(connection))
+        {
+            return false;
+        }
+    }
+
+    worker = std::thread(&PgEventLoop::run, this);
+    return true;
+#endif
+}
+
+std::string PgEventLoop::last_error() const
+{
+    std::lock_guard lock(mutex);
+    return error;
+}
+
+void PgEventLoop::enqueue(Job job)
+{
+    async_queries.increment();
+    job.queued = std::chrono::steady_clock::now();
+    bool accepted = false;
+    {
+        std::lock_guard lock(mutex);
+        if (worker.joinable() && !stopping)
+        {
+            queue.push_back(std::move(job));
+            accepted = true;
+        }
+    }
+
+    if (!accepted)
+    {
+        job.complete(nullptr, "asynchronous query loop is not running");
+        return;
+    }
+    wake();
+}
+
+void PgEventLoop::wake()
+{
+#ifndef _WIN32
+    const uint64_t one{1};
+    [[maybe_unused]] const ssize_t written = ::write(wakeup_fd, &one, sizeof(one));
+#endif
+}
+
+void PgEventLoop::run()
+{
+#ifndef _WIN32
+    Tracer::instance().name_thread("pg_event_loop");
+    std::array<epoll_event, 16> events;
+    while (true)
+    {
+        // свободным соединениям - следующие запросы из очереди
+        bool busy = false;
+        for (auto &connection : connections)
+        {
+            while (connection.phase == Phase::IDLE)
+            {
+                std::unique_ptr<Job> job;
+                {
+                    std::lock_guard lock(mutex);
+                    if (queue.empty())
+                    {
+                        break;
+                    }
+                    job = std::make_unique<Job>(std::move(queue.front()));
+                    queue.pop_front();
+                }
+                begin(connection, std::move(job));
+            }
+            busy = busy || connection.phase != Phase::IDLE;
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            if (stopping && !busy && queue.empty())
+            {
+                return;
+            }
+        }
+
+        const int ready = epoll_wait(epoll_fd, events.data(), static_cast<int>(events.size()), -1);
+        if (ready < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        for (int i{0}; i < ready; ++i)
+        {
+            if (events[i].data.u64 == WAKEUP_TAG)
+            {
+                uint64_t counter;
+                [[maybe_unused]] const ssize_t read_bytes = ::read(wakeup_fd, &counter, sizeof(counter));
+                continue;
+            }
+            service(connections[events[i].data.u64], events[i].events);
+        }
+    }
+#endif
+}
+
+bool PgEventLoop::open(Connection &connection)
+{
+    connection.conn.reset(PQconnectdb(conninfo.c_str()));
+    if (PQstatus(connection.conn.get()) != CONNECTION_OK || PQsetnonblocking(connection.conn.get(), 1) != 0)
+    {
+        std::lock_guard lock(mutex);
+        error = PQerrorMessage(connection.conn.get());
+        connection.conn.reset();
+        return false;
+    }
+
+    connection.socket = PQsocket(connection.conn.get());
+#ifndef _WIN32
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.u64 = static_cast<uint64_t>(&connection - connections.data());
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, connection.socket, &event);
+#endif
+    return true;
+}
+
+void PgEventLoop::drop(Connection &connection)
+{
+#ifndef _WIN32
+    if (connection.socket >= 0)
+    {
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, connection.socket, nullptr);
+    }
+#endif
+    connection.socket = -1;
+    connection.conn.reset();
+}
+
+void PgEventLoop::watch(Connection &connection, bool writable)
+{
+#ifndef _WIN32
+    epoll_event event{};
+    event.events = EPOLLIN | (writable ? EPOLLOUT : 0u);
+    event.data.u64 = static_cast<uint64_t>(&connection - connections.data());
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connection.socket, &event);
+#endif
+}
+
+void PgEventLoop::begin(Connection &connection, std::unique_ptr<Job> job)
+{
+    const auto now = std::chrono::steady_clock::now();
+    async_queue_wait.record(now - job->queued);
+    job->started = now;
+    connection.job = std::move(job);
+    connection.copy_offset = 0;
+    connection.copy_ended = false;
+
+    // соединение, потерянное в простое, открывается заново (синхронно, как при старте)
+    if (PQstatus(connection.conn.get()) != CONNECTION_OK)
+    {
+        drop(connection);
+        if (!open(connection))
+        {
+            finish(connection, last_error());
+            return;
+        }
+    }
+
+    const PgQuery &query = connection.job->query;
+    std::vector<const char *> values;
+    values.reserve(query.params.size());
+    for (const auto &param : query.params)
+    {
+        values.push_back(param ? param->c_str() : nullptr);
+    }
+
+    if (!PQsendQueryParams(connection.conn.get(), query.statement->sql, static_cast<int32_t>(values.size()),
+                           nullptr, values.data(), nullptr, nullptr, 0))
+    {
+        finish(connection, PQerrorMessage(connection.conn.get()));
+        return;
+    }
+    connection.phase = Phase::SENDING;
+    flush(connection);
+}
+
+void PgEventLoop::service(Connection &connection, uint32_t events)
+{
+#ifndef _WIN32
+    PGconn *conn = connection.conn.get();
+    if (connection.phase == Phase::IDLE)
+    {
+        // уведомления сервера; закрытое сервером соединение снимается с epoll,
+        // иначе оно будет готово к чтению бесконечно
+        if (!PQconsumeInput(conn) || PQstatus(conn) != CONNECTION_OK)
+        {
+            drop(connection);
+        }
+        return;
+    }
+
+    if ((events & (EPOLLIN | EPOLLERR | EPOLLHUP)) && !PQconsumeInput(conn))
+    {
+        finish(connection, PQerrorMessage(conn));
+        return;
+    }
+    if (connection.phase == Phase::SENDING && !flush(connection))
+    {
+        return;
+    }
+    if (connection.phase == Phase::COPYING && !send_copy(connection))
+    {
+        return;
+    }
+    collect(connection);
+#endif
+}
+
+bool PgEventLoop::flush(Connection &connection)
+{
+    const int pending = PQflush(connection.conn.get());
+    if (pending < 0)
+    {
+        finish(connection, PQerrorMessage(connection.conn.get()));
+        return false;
+    }
+    // ответ читается и во время отправки: сервер может ответить ошибкой, не дочитав запрос
+    watch(connection, pending == 1);
+    if (pending == 0 && connection.phase == Phase::SENDING)
+    {
+        connection.phase = Phase::READING;
+    }
+    return true;
+}
+
+bool PgEventLoop::send_copy(Connection &connection)
+{
+    PGconn *conn = connection.conn.get();
+    const std::string &data = connection.job->query.copy_data;
+    while (connection.copy_offset < data.size())
+    {
+        const std::size_t length = std::min(COPY_CHUNK_BYTES, data.size() - connection.copy_offset);
+        const int sent = PQputCopyData(conn, data.data() + connection.copy_offset, static_cast<int32_t>(length));
+        if (sent < 0)
+        {
+            finish(connection, PQerrorMessage(conn));
+            return false;
+        }
+        if (sent == 0)
+        {
+            // буфер libpq полон: продолжим, когда сокет примет данные
+            watch(connection, true);
+            return true;
+        }
+        connection.copy_offset += length;
+    }
+
+    if (!connection.copy_ended)
+    {
+        const int ended = PQputCopyEnd(conn, nullptr);
+        if (ended < 0)
+        {
+            finish(connection, PQerrorMessage(conn));
+            return false;
+        }
+        if (ended == 0)
+        {
+            watch(connection, true);
+            return true;
+        }
+        connection.copy_ended = true;
+        connection.phase = Phase::SENDING;
+    }
+    return flush(connection);
+}
+
+void PgEventLoop::collect(Connection &connection)
+{
+    PGconn *conn = connection.conn.get();
+    while (connection.phase == Phase::READING && !PQisBusy(conn))
+    {
+        PGresult *res = PQgetResult(conn);
+        if (!res)
+        {
+            finish(connection);
+            return;
+        }
+        if (PQresultStatus(res) == PGRES_COPY_IN)
+        {
+            PQclear(res);
+            connection.phase = Phase::COPYING;
+            send_copy(connection);
+            return;
+        }
+        // у одного оператора итоговый результат последний перед nullptr
+        PQclear(connection.result);
+        connection.result = res;
+    }
+}
+
+void PgEventLoop::finish(Connection &connection, const std::optional<std::string> &failure)
+{
+    const Job job = std::move(*connection.job);
+    connection.job.reset();
+    const std::unique_ptr<PGresult, decltype(&PQclear)> res(std::exchange(connection.result, nullptr), PQclear);
+    connection.phase = Phase::IDLE;
+
+    std::string error_text;
+    if (failure)
+    {
+        // состояние протокола неизвестно: соединение откроется заново при следующем запросе
+        error_text = *failure;
+        drop(connection);
+    }
+    else
+    {
+        const ExecStatusType status = PQresultStatus(res.get());
+        if (status != PGRES_COMMAND_OK && status != PGRES_TUPLES_OK)
+        {
+            error_text = res ? PQresultErrorMessage(res.get()) : PQerrorMessage(connection.conn.get());
+        }
+        watch(connection, false);
+    }
+
+    const PGresult *result = failure ? nullptr : res.get();
+    // запросы соединений идут параллельно: у каждого соединения своя дорожка трассы
+    Tracer::set_lane(static_cast<uint16_t>(&connection - connections.data() + 1));
+    record_query(*job.query.statement, result,
+                 std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - job.started),
+                 job.query.params.size(), job.query.copy_data.size(), slow_log, error_text.c_str());
+    Tracer::set_lane(0);
+    if (!error_text.empty())
+    {
+        std::lock_guard lock(mutex);
+        error = error_text;
+    }
+    job.complete(result, error_text);
+}
@@ -0,0 +1,1259 @@
+#include "../include/PostgresStorage.hpp"
+#include "../include/Menu.hpp"
+#include "../include/ConfigFile.hpp"
+#include "../include/Metrics.hpp"
+#include "../include/QueryLog.hpp"
+#include "../include/PgRequest.hpp"
+#include "../include/Tracing.hpp"
+
+#include <iostream>
+#include <system_error>
+#include <format>
+#include <unordered_map>
+#include <chrono>
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+    LatencyHistogram connect_latency("mem_trainer_db_connect_duration_seconds", "Time to establish a database connection");
+    MetricCounter connect_ok("mem_trainer_db_connect_attempts_total", "Database connection attempts", "result=\"ok\"");
+    MetricCounter connect_failed("mem_trainer_db_connect_attempts_total", "Database connection attempts", "result=\"failed\"");
+
+    const SqlStatement get_user_credential_sql(
+        "get_user_credential",
+        "SELECT id, password FROM users WHERE username = $1");
+    const SqlStatement register_user_sql(
+        "register_user",
+        "INSERT INTO users (username, password) VALUES ($1, $2)");
+    // id берётся из последовательности заранее: больше $3 - строка не вставляется
+    const SqlStatement register_user_below_sql(
+        "register_user_below",
+        "WITH next AS (SELECT nextval(pg_get_serial_sequence('users', 'id')) AS id) "
+        "INSERT INTO users (id, username, password) SELECT id, $1, $2 FROM next WHERE id <= $3 RETURNING id");
+    const SqlStatement update_password_sql(
+        "update_password",
+        "UPDATE users SET password = $1 WHERE id = $2");
+    const SqlStatement save_progress_sql(
+        "save_progress",
+        "INSERT INTO user_progress (user_id, difficulty, sequence_length, success_rate, memorization_ms, answer_ms) "
+        "VALUES ($1, $2, $3, $4, $5, $6) RETURNING id");
+    const SqlStatement save_progress_items_sql(
+        "save_progress_items",
+        "COPY user_progress_items (progress_id, position, kind, correct) FROM STDIN");
+    const SqlStatement update_difficulty_sql(
+        "update_difficulty",
+        "UPDATE users SET difficulty_level = $1 WHERE id = $2");
+    // только вставка: строки users и user_score_daily не блокируются на каждый раунд
+    const SqlStatement update_score_sql(
+        "update_score",
+        "INSERT INTO score_events (user_id, delta) VALUES ($2, $1)");
+    // пачка событий переносится в итоги одной транзакцией; второй одновременный запуск
+    // не получает advisory-блокировку и ничего не делает, поэтому порядок обновления users
+    // не может привести к взаимной блокировке
+    const SqlStatement compact_scores_sql(
+        "compact_scores",
+        "WITH batch AS ("
+        "DELETE FROM score_events WHERE id IN ("
+        "SELECT id FROM score_events WHERE pg_try_advisory_xact_lock(hashtext('score_events')) "
+        "ORDER BY id LIMIT $1 FOR UPDATE SKIP LOCKED) "
+        "RETURNING user_id, day, delta), "
+        "daily AS ("
+        "INSERT INTO user_score_daily (user_id, day, score) "
+        "SELECT user_id, day, SUM(delta) FROM batch GROUP BY user_id, day "
+        "ON CONFLICT (user_id, day) DO UPDATE SET score = user_score_daily.score + EXCLUDED.score), "
+        "totals AS ("
+        "UPDATE users u SET total_score = u.total_score + t.delta "
+        "FROM (SELECT user_id, SUM(delta) AS delta FROM batch GROUP BY user_id) t "
+        "WHERE u.id = t.user_id) "
+        "SELECT COUNT(*) FROM batch");
+    // без ожидания на primary: pg_last_* возвращают NULL вне режима восстановления
+    const SqlStatement replication_lag_sql(
+        "replication_lag",
+        "SELECT CASE "
+        "WHEN NOT pg_is_in_recovery() THEN 0 "
+        "WHEN pg_last_wal_receive_lsn() = pg_last_wal_replay_lsn() THEN 0 "
+        "ELSE COALESCE(EXTRACT(EPOCH FROM now() - pg_last_xact_replay_timestamp()), 0) END::float8");
+    const SqlStatement get_user_difficulty_sql(
+        "get_user_difficulty",
+        "SELECT difficulty_level FROM users WHERE id = $1");
+    // $1 - массив '{1,2,3}': один запрос на пачку вместо запроса на каждый id
+    const SqlStatement get_unknown_users_sql(
+        "get_unknown_users",
+        "SELECT ids.id FROM unnest($1::bigint[]) AS ids(id) "
+        "WHERE NOT EXISTS (SELECT 1 FROM users WHERE users.id = ids.id)");
+    const SqlStatement get_user_progress_sql(
+        "get_user_progress",
+        "SELECT sequence_length, success_rate, training_date FROM user_progress "
+        "WHERE user_id = $1 ORDER BY training_date DESC");
+    // агрегирование на сервере: по строке на бакет, последние $3 бакетов в порядке времени.
+    // $2 - 'day' или 'week'
+    const SqlStatement get_progress_buckets_sql(
+        "get_progress_buckets",
+        "SELECT EXTRACT(EPOCH FROM bucket)::BIGINT, rounds, success_rate, sequence_length FROM ("
+        "SELECT date_trunc($2, training_date) AS bucket, COUNT(*) AS rounds, "
+        "AVG(success_rate)::float8 AS success_rate, AVG(sequence_length)::float8 AS sequence_length "
+        "FROM user_progress WHERE user_id = $1 "
+        "GROUP BY 1 ORDER BY 1 DESC LIMIT $3) buckets "
+        "ORDER BY bucket");
+    // свёрнутые итоги плюс ещё не перенесённые события. Очки только растут, поэтому
+    // в топ-N попадают лишь топ-N по total_score и пользователи с событиями
+    const SqlStatement leaderboard_all_time_sql(
+        "get_leaderboard_all_time",
+        "WITH pending AS ("
+        "SELECT user_id, SUM(delta) AS delta FROM score_events GROUP BY user_id), "
+        "candidates AS ("
+        "(SELECT id FROM users WHERE total_score > 0 ORDER BY total_score DESC LIMIT $1) "
+        "UNION SELECT user_id FROM pending) "
+        "SELECT u.username, u.total_score + COALESCE(p.delta, 0) AS score "
+        "FROM candidates c JOIN users u ON u.id = c.id "
+        "LEFT JOIN pending p ON p.user_id = u.id "
+        "WHERE u.total_score + COALESCE(p.delta, 0) > 0 "
+        "ORDER BY score DESC "
+        "LIMIT $1");
+    // читаются только бакеты окна [начало периода, начало следующего) и события из него
+    const SqlStatement leaderboard_period_sql(
+        "get_leaderboard_period",
+        "WITH bounds AS ("
+        "SELECT date_trunc($1, COALESCE($2::date, CURRENT_DATE)::timestamp) AS window_start), "
+        "window_days AS ("
+        "SELECT window_start::date AS first_day, "
+        "(window_start + ('1 ' || $1)::interval)::date AS end_day FROM bounds), "
+        "scores AS ("
+        "SELECT s.user_id, s.score FROM user_score_daily s, window_days w "
+        "WHERE s.day >= w.first_day AND s.day < w.end_day "
+        "UNION ALL "
+        "SELECT e.user_id, e.delta FROM score_events e, window_days w "
+        "WHERE e.day >= w.first_day AND e.day < w.end_day) "
+        "SELECT u.username, SUM(s.score) AS period_score "
+        "FROM scores s "
+        "JOIN users u ON u.id = s.user_id "
+        "GROUP BY u.id, u.username "
+        "HAVING SUM(s.score) > 0 "
+        "ORDER BY period_score DESC "
+        "LIMIT $3");
+    const SqlStatement get_user_schedule_sql(
+        "get_user_schedule",
+        "SELECT user_id, ease_factor, repetitions, interval_seconds, next_length, "
+        "EXTRACT(EPOCH FROM due_at AT TIME ZONE 'UTC')::BIGINT "
+        "FROM user_schedule WHERE user_id = $1");
+    const SqlStatement save_user_schedule_sql(
+        "save_user_schedule",
+        "INSERT INTO user_schedule (user_id, ease_factor, repetitions, interval_seconds, next_length, due_at) "
+        "VALUES ($1, $2, $3, $4, $5, to_timestamp($6) AT TIME ZONE 'UTC') "
+        "ON CONFLICT (user_id) DO UPDATE SET "
+        "ease_factor = EXCLUDED.ease_factor, repetitions = EXCLUDED.repetitions, "
+        "interval_seconds = EXCLUDED.interval_seconds, next_length = EXCLUDED.next_length, "
+        "due_at = EXCLUDED.due_at");
+    const SqlStatement get_due_schedules_sql(
+        "get_due_schedules",
+        "SELECT user_id, ease_factor, repetitions, interval_seconds, next_length, "
+        "EXTRACT(EPOCH FROM due_at AT TIME ZONE 'UTC')::BIGINT "
+        "FROM user_schedule "
+        "WHERE due_at >= to_timestamp($1) AT TIME ZONE 'UTC' AND due_at < to_timestamp($2) AT TIME ZONE 'UTC' "
+        "ORDER BY due_at LIMIT $3");
+    const SqlStatement get_weak_items_sql(
+        "get_weak_items",
+        "SELECT sketch FROM user_weak_items WHERE user_id = $1");
+    const SqlStatement save_weak_items_sql(
+        "save_weak_items",
+        "INSERT INTO user_weak_items (user_id, sketch) VALUES ($1, $2::bytea) "
+        "ON CONFLICT (user_id) DO UPDATE SET sketch = EXCLUDED.sketch, updated_at = CURRENT_TIMESTAMP");
+    const SqlStatement save_marathon_result_sql(
+        "save_marathon_result",
+        "INSERT INTO marathon_results (user_id, length, score, success_rate, memorization_ms, answer_ms) "
+        "VALUES ($1, $2, $3, $4, $5, $6)");
+    const SqlStatement get_daily_challenge_sql(
+        "get_daily_challenge",
+        "SELECT items FROM daily_challenges WHERE day = $1::date AND difficulty = $2");
+    // при гонке двух клиентов побеждает первая вставка, второй получает её строку
+    const SqlStatement create_daily_challenge_sql(
+        "create_daily_challenge",
+        "WITH inserted AS ("
+        "INSERT INTO daily_challenges (day, difficulty, items) VALUES ($1::date, $2, $3) "
+        "ON CONFLICT (day, difficulty) DO NOTHING RETURNING items) "
+        "SELECT items FROM inserted "
+        "UNION ALL "
+        "SELECT items FROM daily_challenges WHERE day = $1::date AND difficulty = $2 "
+        "LIMIT 1");
+    const SqlStatement save_daily_challenge_result_sql(
+        "save_daily_challenge_result",
+        "INSERT INTO daily_challenge_results (day, user_id, difficulty, score, success_rate) "
+        "VALUES ($1::date, $2, $3, $4, $5) "
+        "ON CONFLICT (day, user_id) DO NOTHING");
+    const SqlStatement get_daily_challenge_score_sql(
+        "get_daily_challenge_score",
+        "SELECT difficulty, score FROM daily_challenge_results WHERE day = $1::date AND user_id = $2");
+    const SqlStatement daily_leaderboard_sql(
+        "get_daily_leaderboard",
+        "SELECT u.username, r.score FROM daily_challenge_results r "
+        "JOIN users u ON u.id = r.user_id "
+        "WHERE r.day = $1::date AND r.difficulty = $3 "
+        "ORDER BY r.score DESC, r.completed_at "
+        "LIMIT $2");
+    const SqlStatement export_progress_sql(
+        "export_progress",
+        "COPY (SELECT user_id, EXTRACT(EPOCH FROM training_date)::BIGINT, sequence_length, success_rate, difficulty "
+        "FROM user_progress) TO STDOUT");
+    const SqlStatement save_exam_results_sql(
+        "save_exam_results",
+        "COPY exam_results (user_id, sequence_id, correct, total, success_rate) FROM STDIN");
+
+    // экранирование текстового поля для текстового формата COPY
+    void append_copy_text(std::string &buffer, std::string_view value)
+    {
+        for (const char c : value)
+        {
+            switch (c)
+            {
+            case '\\':
+                buffer += "\\\\";
+                break;
+            case '\t':
+                buffer += "\\t";
+                break;
+            case '\n':
+                buffer += "\\n";
+                break;
+            case '\r':
+                buffer += "\\r";
+                break;
+            default:
+                buffer += c;
+            }
+        }
+    }
+}
+
+PostgresStorage::PostgresStorage(const std::string &conninfo)
+    : connection_info(conninfo)
+{
+    std::cout << "Using explicit connection parameters\n";
+}
+
+// config.ini
+PostgresStorage::PostgresStorage()
+{
+    connection_info = parse_config_file();
+    if (connection_info.empty())
+    {
+        throw std::runtime_error("Invalid database configuration in config.ini");
+    }
+
+    slow_log = slow_query_log_from_config(ConfigFile("config.ini"));
+    auto menu = std::make_unique<Menu>();
+    menu->print_message("Using config.ini file connection\n");
+}
+
+// соединение закрывается deleter-ом shared_ptr (PQfinish)
+PostgresStorage::~PostgresStorage() = default;
+
+std::shared_ptr<SlowQueryLog> PostgresStorage::slow_query_log_from_config(const ConfigFile &config)
+{
+    const std::string path = config.get("database", "slow_query_log");
+    if (path.empty())
+    {
+        return nullptr;
+    }
+    auto log = std::make_shared<SlowQueryLog>(
+        path, std::chrono::milliseconds(config.get_int("database", "slow_query_ms", 100)));
+    if (!log->is_open())
+    {
+        throw std::runtime_error("Cannot open slow query log " + path);
+    }
+    return log;
+}
+
+std::string PostgresStorage::parse_config_file(const std::string &host, const std::string &port,
+                                               const std::string &dbname)
+{
+    ConfigFile config("config.ini");
+    if (!config.is_open())
+    {
+        throw std::runtime_error("Configuration file config.ini not found");
+    }
+
+    std::unordered_map<std::string, std::string> params = {
+        {"host", "localhost"},
+        {"port", "5432"},
+        {"dbname", ""},
+        {"user", ""},
+        {"password", ""}};
+
+    for (auto &[key, value] : params)
+    {
+        // ключи вне секций принимаются для совместимости со старыми конфигами
+        value = config.get("database", key, config.get("", key, value));
+    }
+    if (!host.empty())
+    {
+        params["host"] = host;
+    }
+    if (!port.empty())
+    {
+        params["port"] = port;
+    }
+    if (!dbname.empty())
+    {
+        params["dbname"] = dbname;
+    }
+
+    if (params["dbname"].empty() || params["user"].empty() || params["password"].empty())
+    {
+        throw std::runtime_error("Missing required database parameters in config.ini");
+    }
+
+    return std::format(
+        "host={} port={} dbname={} user={} password={}",
+        params["host"], params["port"], params["dbname"],
+        params["user"], params["password"]);
+}
+
+bool PostgresStorage::connect()
+{
+    ScopedLatency timer(connect_latency);
+    db_connection = std::shared_ptr<PGconn>(
+        PQconnectdb(connection_info.c_str()),
+        PQfinish);
+
+    if (PQstatus(db_connection.get()) != CONNECTION_OK)
+    {
+        connect_failed.increment();
+        std::cerr << "PQerrorMessage: " << PQerrorMessage(db_connection.get()) << std::endl;
+        return false;
+    }
+
+    connect_ok.increment();
+    return true;
+}
+
+namespace
+{
+    // в журнал - SQLSTATE и основное сообщение без DETAIL; значения в кавычках ("Key (username)=(alice)",
+    // "invalid input syntax ...: \"abc\"") вырезаются, как и параметры
+    std::string loggable_error(const PGresult *res, const char *connection_error)
+    {
+        const char *state = res ? PQresultErrorField(res, PG_DIAG_SQLSTATE) : nullptr;
+        const char *primary = res ? PQresultErrorField(res, PG_DIAG_MESSAGE_PRIMARY) : nullptr;
+        // без результата (обрыв соединения) - первая строка сообщения соединения
+        std::string_view message = primary ? primary : connection_error ? connection_error : "";
+        message = message.substr(0, message.find('\n'));
+
+        std::string text = state ? std::string(state) + ": " : std::string{};
+        bool quoted{false};
+        for (const char c : message)
+        {
+            if (c == '"')
+            {
+                text += quoted ? "<redacted>\"" : "\"";
+                quoted = !quoted;
+            }
+            else if (!quoted)
+            {
+                text += c;
+            }
+        }
+        if (quoted)
+        {
+            text += "<redacted>";
+        }
+        return text;
+    }
+}
+
+void record_query(const SqlStatement &statement, const PGresult *res, std::chrono::nanoseconds elapsed,
+                  std::size_t param_count, std::size_t copy_bytes, SlowQueryLog *slow_log, const char *error)
+{
+    const ExecStatusType status = PQresultStatus(res);
+    const bool failed = status != PGRES_COMMAND_OK && status != PGRES_TUPLES_OK &&
+                        status != PGRES_COPY_OUT && status != PGRES_COPY_IN;
+
+    int64_t rows{0};
+    std::size_t bytes{0};
+    if (status == PGRES_TUPLES_OK)
+    {
+        rows = PQntuples(res);
+        const int32_t fields = PQnfields(res);
+        for (int32_t row{0}; row < rows; ++row)
+        {
+            for (int32_t field{0}; field < fields; ++field)
+            {
+                bytes += PQgetlength(res, row, field);
+            }
+        }
+    }
+    else if (status == PGRES_COMMAND_OK)
+    {
+        // для COPY FROM STDIN - число скопированных строк
+        rows = std::atoll(PQcmdTuples(const_cast<PGresult *>(res)));
+        bytes = copy_bytes;
+    }
+
+    statement.latency.record(elapsed);
+    if (Tracer::enabled())
+    {
+        // спан запроса на потоке, где он завершился: синхронный вызов или цикл PgEventLoop
+        const auto finished = std::chrono::steady_clock::now();
+        Tracer::instance().record(statement.name, "sql",
+                                  finished - std::chrono::duration_cast<std::chrono::steady_clock::duration>(elapsed),
+                                  finished);
+    }
+    statement.rows.increment(static_cast<uint64_t>(rows));
+    statement.bytes.increment(bytes);
+    if (failed)
+    {
+        statement.errors.increment();
+    }
+
+    if (slow_log && slow_log->should_log(elapsed, failed))
+    {
+        slow_log->write(QueryRecord{
+            &statement,
+            elapsed,
+            rows,
+            bytes,
+            param_count,
+            failed,
+            PQresStatus(status),
+            failed ? loggable_error(res, error) : std::string{}});
+    }
+}
+
+PGresult *PostgresStorage::execute(const SqlStatement &statement, std::span<const char *const> values) const
+{
+    const auto started = std::chrono::steady_clock::now();
+    PGresult *res = PQexecParams(
+        get_connection(),
+        statement.sql,
+        static_cast<int32_t>(values.size()),
+        nullptr,
+        values.data(),
+        nullptr, // текстовые параметры с null-terminator
+        nullptr,
+        0);
+    const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started);
+
+    record_query(statement, res, elapsed, values.size(), 0, slow_log.get(), PQerrorMessage(get_connection()));
+    return res;
+}
+
+template <typename T>
+T PostgresStorage::run(const PgRequest<T> &request) const
+{
+    std::vector<const char *> values;
+    values.reserve(request.params.size());
+    for (const auto &param : request.params)
+    {
+        values.push_back(param ? param->c_str() : nullptr);
+    }
+
+    const std::unique_ptr<PGresult, decltype(&PQclear)> res(
+        request.copy ? copy_in(*request.statement, request.copy_data, request.copy_rows)
+                     : execute(*request.statement, values),
+        PQclear);
+    const ExecStatusType status = PQresultStatus(res.get());
+    const std::string error = status == PGRES_COMMAND_OK || status == PGRES_TUPLES_OK ? std::string{} : last_error();
+    return request.parse(res.get(), error);
+}
+
+
+bool PostgresStorage::is_connected() const
+{
+    return db_connection && PQstatus(get_connection()) == CONNECTION_OK;
+}
+
+std::string PostgresStorage::last_error() const
+{
+    return get_connection() ? PQerrorMessage(get_connection()) : "no connection";
+}
+
+std::optional<double> PostgresStorage::replication_lag_seconds() const
+{
+    if (!is_connected())
+    {
+        return std::nullopt;
+    }
+
+    PGresult *res = execute(replication_lag_sql, {});
+    if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) != 1)
+    {
+        PQclear(res);
+        return std::nullopt;
+    }
+
+    const double lag = std::strtod(PQgetvalue(res, 0, 0), nullptr);
+    PQclear(res);
+    return std::max(lag, 0.0);
+}
+
+namespace
+{
+    bool command_ok(const PGresult *res, const std::string &)
+    {
+        return PQresultStatus(res) == PGRES_COMMAND_OK;
+    }
+
+    void require_tuples(const PGresult *res, const std::string &error)
+    {
+        if (PQresultStatus(res) != PGRES_TUPLES_OK)
+        {
+            throw std::runtime_error("Database query failed: " + error);
+        }
+    }
+
+    LeaderboardRows read_leaderboard(const PGresult *res, const std::string &error)
+    {
+        require_tuples(res, error);
+
+        const uint32_t rows = PQntuples(res);
+        LeaderboardRows leaders;
+        leaders.reserve(rows);
+        for (std::size_t i{0}; i < rows; ++i)
+        {
+            leaders.emplace_back(
+                PQgetvalue(res, i, 0), // username
+                PQgetvalue(res, i, 1)  // score
+            );
+        }
+        return leaders;
+    }
+
+    UserSchedule read_schedule_row(const PGresult *res, int32_t row)
+    {
+        try
+        {
+            return UserSchedule{
+                static_cast<uint32_t>(std::stoul(PQgetvalue(res, row, 0))),
+                std::stof(PQgetvalue(res, row, 1)),
+                static_cast<uint32_t>(std::stoul(PQgetvalue(res, row, 2))),
+                std::stoll(PQgetvalue(res, row, 3)),
+                static_cast<uint32_t>(std::stoul(PQgetvalue(res, row, 4))),
+                std::stoll(PQgetvalue(res, row, 5))};
+        }
+        catch (const std::logic_error &e)
+        {
+            throw std::runtime_error("Invalid numeric format in database record");
+        }
+    }
+
+    // текстовый ввод bytea в hex-формате: \x и по две цифры на байт
+    std::string to_bytea_hex(const std::string &bytes)
+    {
+        static constexpr char DIGITS[] = "0123456789abcdef";
+        std::string hex;
+        hex.reserve(2 + bytes.size() * 2);
+        hex += "\\x";
+        for (const char byte : bytes)
+        {
+            hex += DIGITS[static_cast<uint8_t>(byte) >> 4];
+            hex += DIGITS[static_cast<uint8_t>(byte) & 0x0F];
+        }
+        return hex;
+    }
+
+    // единственная строка с единственным значением или nullopt
+    std::optional<std::string> read_single_text(const PGresult *res, const std::string &error)
+    {
+        require_tuples(res, error);
+
+        std::optional<std::string> value;
+        if (PQntuples(res) == 1)
+        {
+            value = PQgetvalue(res, 0, 0);
+        }
+        return value;
+    }
+}
+
+void PostgresStorage::require_connection() const
+{
+    if (!db_connection || PQstatus(get_connection()) != CONNECTION_OK)
+    {
+        throw std::runtime_error("Database connection is not established");
+    }
+}
+
+PgRequest<std::optional<UserCredential>> PostgresStorage::get_user_credential_request(const std::string &username)
+{
+    PgRequest<std::optional<UserCredential>> request{{&get_user_credential_sql, {username}}};
+    request.parse = [](const PGresult *res, const std::string &error)
+    {
+        if (PQresultStatus(res) != PGRES_TUPLES_OK)
+        {
+            throw std::runtime_error(error);
+        }
+
+        std::optional<UserCredential> credential;
+        if (PQntuples(res) == 1)
+        {
+            credential = UserCredential{std::stoi(PQgetvalue(res, 0, 0)), PQgetvalue(res, 0, 1)};
+        }
+        return credential;
+    };
+    return request;
+}
+
+std::optional<UserCredential> PostgresStorage::get_user_credential(const std::string &username) const
+{
+    return run(get_user_credential_request(username));
+}
+
+PgRequest<bool> PostgresStorage::register_user_request(const std::string &username, const std::string &password)
+{
+    return {{&register_user_sql, {username, password}}, command_ok};
+}
+
+bool PostgresStorage::register_user(const std::string &username, const std::string &password)
+{
+    return run(register_user_request(username, password));
+}
+
+std::optional<bool> PostgresStorage::register_user_below(const std::string &username, const std::string &password,
+                                                         int64_t max_id)
+{
+    PgRequest<std::optional<bool>> request{{&register_user_below_sql, {username, password, std::to_string(max_id)}}};
+    request.parse = [](const PGresult *res, const std::string &)
+    {
+        std::optional<bool> inserted;
+        if (PQresultStatus(res) == PGRES_TUPLES_OK)
+        {
+            inserted = PQntuples(res) == 1;
+        }
+        return inserted;
+    };
+    return run(request);
+}
+
+PgRequest<bool> PostgresStorage::update_password_request(uint32_t user_id, const std::string &password)
+{
+    return {{&update_password_sql, {password, std::to_string(user_id)}}, command_ok};
+}
+
+bool PostgresStorage::update_password(uint32_t user_id, const std::string &password)
+{
+    return run(update_password_request(user_id, password));
+}
+
+PgRequest<std::optional<int64_t>> PostgresStorage::save_progress_request(uint32_t user_id, int32_t difficulty,
+                                                                         uint32_t sequence_length, float success_rate,
+                                                                         uint32_t memorization_ms, uint32_t answer_ms)
+{
+    PgRequest<std::optional<int64_t>> request{{&save_progress_sql,
+                                               {std::to_string(user_id),
+                                                std::to_string(difficulty),
+                                                std::to_string(sequence_length),
+                                                std::to_string(success_rate),
+                                                std::to_string(memorization_ms),
+                                                std::to_string(answer_ms)}}};
+    request.parse = [](const PGresult *res, const std::string &)
+    {
+        std::optional<int64_t> progress_id;
+        if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) == 1)
+        {
+            progress_id = std::atoll(PQgetvalue(res, 0, 0));
+        }
+        return progress_id;
+    };
+    return request;
+}
+
+std::optional<int64_t> PostgresStorage::save_progress(uint32_t user_id, int32_t difficulty, uint32_t sequence_length,
+                                                      float success_rate, uint32_t memorization_ms, uint32_t answer_ms)
+{
+    return run(save_progress_request(user_id, difficulty, sequence_length, success_rate, memorization_ms, answer_ms));
+}
+
+PgRequest<bool> PostgresStorage::save_progress_items_request(const std::vector<ProgressItem> &items)
+{
+    // текстовый формат COPY: поля через табуляцию, строка на элемент
+    std::string buffer;
+    buffer.reserve(items.size() * 16);
+    for (const auto &item : items)
+    {
+        buffer += std::to_string(item.progress_id);
+        buffer += '\t';
+        buffer += std::to_string(item.position);
+        buffer += '\t';
+        buffer += std::to_string(item.kind);
+        buffer += item.correct ? "\tt\n" : "\tf\n";
+    }
+
+    return {{&save_progress_items_sql, {}, true, std::move(buffer), items.size()}, command_ok};
+}
+
+bool PostgresStorage::save_progress_items(std::vector<ProgressItem> &items)
+{
+    if (items.empty())
+    {
+        return true;
+    }
+    if (!run(save_progress_items_request(items)))
+    {
+        return false;
+    }
+    items.clear();
+    return true;
+}
+
+PgRequest<bool> PostgresStorage::update_difficulty_request(uint32_t user_id, uint32_t new_level)
+{
+    return {{&update_difficulty_sql, {std::to_string(new_level), std::to_string(user_id)}}, command_ok};
+}
+
+bool PostgresStorage::update_difficulty(uint32_t user_id, uint32_t new_level)
+{
+    return run(update_difficulty_request(user_id, new_level));
+}
+
+PgRequest<bool> PostgresStorage::update_score_request(uint32_t user_id, uint32_t score_delta)
+{
+    return {{&update_score_sql, {std::to_string(score_delta), std::to_string(user_id)}}, command_ok};
+}
+
+bool PostgresStorage::update_score(uint32_t user_id, uint32_t score_delta)
+{
+    return run(update_score_request(user_id, score_delta));
+}
+
+PgRequest<std::optional<std::size_t>> PostgresStorage::compact_scores_request(uint32_t max_events)
+{
+    PgRequest<std::optional<std::size_t>> request{{&compact_scores_sql, {std::to_string(max_events)}}};
+    request.parse = [](const PGresult *res, const std::string &)
+    {
+        std::optional<std::size_t> folded;
+        if (PQresultStatus(res) == PGRES_TUPLES_OK && PQntuples(res) == 1)
+        {
+            folded = static_cast<std::size_t>(std::stoull(PQgetvalue(res, 0, 0)));
+        }
+        return folded;
+    };
+    return request;
+}
+
+std::optional<std::size_t> PostgresStorage::compact_scores(uint32_t max_events)
+{
+    return run(compact_scores_request(max_events));
+}
+
+PgRequest<int32_t> PostgresStorage::get_user_difficulty_request(uint32_t user_id)
+{
+    PgRequest<int32_t> request{{&get_user_difficulty_sql, {std::to_string(user_id)}}};
+    request.parse = [](const PGresult *res, const std::string &)
+    {
+        if (PQresultStatus(res) != PGRES_TUPLES_OK || PQntuples(res) == 0)
+        {
+            return 0; // EASY по умолчанию
+        }
+        return std::stoi(PQgetvalue(res, 0, 0));
+    };
+    return request;
+}
+
+int32_t PostgresStorage::get_user_difficulty(uint32_t user_id) const
+{
+    if (!db_connection || PQstatus(get_connection()) != CONNECTION_OK)
+    {
+        throw std::runtime_error("Database connection error");
+    }
+    return run(get_user_difficulty_request(user_id));
+}
+
+PgRequest<std::vector<uint32_t>> PostgresStorage::get_unknown_users_request(const std::vector<uint32_t> &user_ids)
+{
+    std::string array{"{"};
+    for (const uint32_t user_id : user_ids)
+    {
+        if (array.size() > 1)
+        {
+            array += ',';
+        }
+        array += std::to_string(user_id);
+    }
+    array += '}';
+
+    PgRequest<std::vector<uint32_t>> request{{&get_unknown_users_sql, {std::move(array)}}};
+    request.parse = [](const PGresult *res, const std::string &error)
+    {
+        require_tuples(res, error);
+
+        const int rows = PQntuples(res);
+        std::vector<uint32_t> unknown;
+        unknown.reserve(rows);
+        for (int i{0}; i < rows; ++i)
+        {
+            unknown.push_back(static_cast<uint32_t>(std::stoul(PQgetvalue(res, i, 0))));
+        }
+        return unknown;
+    };
+    return request;
+}
+
+std::vector<uint32_t> PostgresStorage::get_unknown_users(const std::vector<uint32_t> &user_ids) const
+{
+    if (user_ids.empty())
+    {
+        return {};
+    }
+    require_connection();
+    return run(get_unknown_users_request(user_ids));
+}
+
+PgRequest<std::vector<UserProgress>> PostgresStorage::get_user_progress_request(uint32_t user_id)
+{
+    PgRequest<std::vector<UserProgress>> request{{&get_user_progress_sql, {std::to_string(user_id)}}};
+    request.parse = [](const PGresult *res, const std::string &error)
+    {
+        require_tuples(res, error);
+
+        const uint32_t rows = PQntuples(res);
+        std::vector<UserProgress> progress;
+        progress.reserve(rows);
+
+        for (std::size_t i{0}; i < rows; ++i)
+        {
+            UserProgress record;
+
+            const char *length_str = PQgetvalue(res, i, 0);
+            const char *rate_str = PQgetvalue(res, i, 1);
+
+            try
+            {
+                record.sequence_length = std::stoi(length_str);
+                record.success_rate = std::stof(rate_str);
+            }
+            catch (const std::invalid_argument &e)
+            {
+                throw std::runtime_error("Invalid numeric format in database record");
+            }
+            catch (const std::out_of_range &e)
+            {
+                throw std::runtime_error("Numeric value out of range in database record");
+            }
+
+            record.training_date = PQgetvalue(res, i, 2);
+            progress.push_back(std::move(record));
+        }
+        return progress;
+    };
+    return request;
+}
+
+std::vector<UserProgress> PostgresStorage::get_user_progress(uint32_t user_id) const
+{
+    require_connection();
+    return run(get_user_progress_request(user_id));
+}
+
+PgRequest<std::vector<ProgressPoint>> PostgresStorage::get_progress_buckets_request(uint32_t user_id,
+                                                                                   ProgressBucket bucket,
+                                                                                   uint32_t max_buckets)
+{
+    PgRequest<std::vector<ProgressPoint>> request{
+        {&get_progress_buckets_sql,
+         {std::to_string(user_id), bucket == ProgressBucket::WEEK ? "week" : "day", std::to_string(max_buckets)}}};
+    request.parse = [](const PGresult *res, const std::string &error)
+    {
+        require_tuples(res, error);
+
+        const uint32_t rows = PQntuples(res);
+        std::vector<ProgressPoint> points;
+        points.reserve(rows);
+        try
+        {
+            for (std::size_t i{0}; i < rows; ++i)
+            {
+                points.push_back(ProgressPoint{std::stoll(PQgetvalue(res, i, 0)),
+                                               static_cast<uint32_t>(std::stoul(PQgetvalue(res, i, 1))),
+                                               std::stof(PQgetvalue(res, i, 2)),
+                                               std::stof(PQgetvalue(res, i, 3))});
+            }
+        }
+        catch (const std::logic_error &e)
+        {
+            throw std::runtime_error("Invalid numeric format in database record");
+        }
+        return points;
+    };
+    return request;
+}
+
+std::vector<ProgressPoint> PostgresStorage::get_progress_buckets(uint32_t user_id, ProgressBucket bucket,
+                                                                 uint32_t max_buckets) const
+{
+    require_connection();
+    return run(get_progress_buckets_request(user_id, bucket, max_buckets));
+}
+
+PgRequest<LeaderboardRows> PostgresStorage::get_leaderboard_request(LeaderboardPeriod period, uint32_t limit,
+                                                                    const std::string &anchor_date)
+{
+    if (period == LeaderboardPeriod::ALL_TIME)
+    {
+        return {{&leaderboard_all_time_sql, {std::to_string(limit)}}, read_leaderboard};
+    }
+
+    const char *unit = "day";
+    if (period == LeaderboardPeriod::WEEK)
+    {
+        unit = "week";
+    }
+    else if (period == LeaderboardPeriod::MONTH)
+    {
+        unit = "month";
+    }
+
+    std::optional<std::string> anchor;
+    if (!anchor_date.empty())
+    {
+        anchor = anchor_date;
+    }
+    return {{&leaderboard_period_sql, {unit, std::move(anchor), std::to_string(limit)}}, read_leaderboard};
+}
+
+LeaderboardRows PostgresStorage::get_leaderboard(LeaderboardPeriod period, uint32_t limit,
+                                                 const std::string &anchor_date) const
+{
+    require_connection();
+    return run(get_leaderboard_request(period, limit, anchor_date));
+}
+
+PgRequest<std::optional<UserSchedule>> PostgresStorage::get_user_schedule_request(uint32_t user_id)
+{
+    PgRequest<std::optional<UserSchedule>> request{{&get_user_schedule_sql, {std::to_string(user_id)}}};
+    request.parse = [](const PGresult *res, const std::string &error)
+    {
+        require_tuples(res, error);
+
+        std::optional<UserSchedule> schedule;
+        if (PQntuples(res) == 1)
+        {
+            schedule = read_schedule_row(res, 0);
+        }
+        return schedule;
+    };
+    return request;
+}
+
+std::optional<UserSchedule> PostgresStorage::get_user_schedule(uint32_t user_id) const
+{
+    require_connection();
+    return run(get_user_schedule_request(user_id));
+}
+
+PgRequest<bool> PostgresStorage::save_user_schedule_request(const UserSchedule &schedule)
+{
+    return {{&save_user_schedule_sql,
+             {std::to_string(schedule.user_id),
+              std::to_string(schedule.ease_factor),
+              std::to_string(schedule.repetitions),
+              std::to_string(schedule.interval_seconds),
+              std::to_string(schedule.next_length),
+              std::to_string(schedule.due_at)}},
+            command_ok};
+}
+
+bool PostgresStorage::save_user_schedule(const UserSchedule &schedule)
+{
+    return run(save_user_schedule_request(schedule));
+}
+
+PgRequest<std::vector<UserSchedule>> PostgresStorage::get_due_schedules_request(int64_t due_from, int64_t due_before,
+                                                                                uint32_t limit)
+{
+    PgRequest<std::vector<UserSchedule>> request{
+        {&get_due_schedules_sql, {std::to_string(due_from), std::to_string(due_before), std::to_string(limit)}}};
+    request.parse = [](const PGresult *res, const std::string &error)
+    {
+        require_tuples(res, error);
+
+        const uint32_t rows = PQntuples(res);
+        std::vector<UserSchedule> schedules;
+        schedules.reserve(rows);
+        for (std::size_t i{0}; i < rows; ++i)
+        {
+            schedules.push_back(read_schedule_row(res, static_cast<int32_t>(i)));
+        }
+        return schedules;
+    };
+    return request;
+}
+
+std::vector<UserSchedule> PostgresStorage::get_due_schedules(int64_t due_from, int64_t due_before,
+                                                            uint32_t limit) const
+{
+    require_connection();
+    return run(get_due_schedules_request(due_from, due_before, limit));
+}
+
+PgRequest<std::optional<std::string>> PostgresStorage::get_weak_items_request(uint32_t user_id)
+{
+    PgRequest<std::optional<std::string>> request{{&get_weak_items_sql, {std::to_string(user_id)}}};
+    request.parse = [](const PGresult *res, const std::string &error)
+    {
+        require_tuples(res, error);
+
+        std::optional<std::string> sketch;
+        if (PQntuples(res) == 1)
+        {
+            std::size_t length{0};
+            const std::unique_ptr<unsigned char, decltype(&PQfreemem)> bytes(
+                PQunescapeBytea(reinterpret_cast<const unsigned char *>(PQgetvalue(res, 0, 0)), &length),
+                PQfreemem);
+            if (!bytes)
+            {
+                throw std::runtime_error("Invalid bytea value in database record");
+            }
+            sketch.emplace(reinterpret_cast<const char *>(bytes.get()), length);
+        }
+        return sketch;
+    };
+    return request;
+}
+
+std::optional<std::string> PostgresStorage::get_weak_items(uint32_t user_id) const
+{
+    require_connection();
+    return run(get_weak_items_request(user_id));
+}
+
+PgRequest<bool> PostgresStorage::save_weak_items_request(uint32_t user_id, const std::string &sketch)
+{
+    return {{&save_weak_items_sql, {std::to_string(user_id), to_bytea_hex(sketch)}}, command_ok};
+}
+
+bool PostgresStorage::save_weak_items(uint32_t user_id, const std::string &sketch)
+{
+    return run(save_weak_items_request(user_id, sketch));
+}
+
+PgRequest<bool> PostgresStorage::save_marathon_result_request(uint32_t user_id, uint32_t length, uint32_t score,
+                                                              float success_rate, uint32_t memorization_ms,
+                                                              uint32_t answer_ms)
+{
+    return {{&save_marathon_result_sql,
+             {std::to_string(user_id),
+              std::to_string(length),
+              std::to_string(score),
+              std::to_string(success_rate),
+              std::to_string(memorization_ms),
+              std::to_string(answer_ms)}},
+            command_ok};
+}
+
+bool PostgresStorage::save_marathon_result(uint32_t user_id, uint32_t length, uint32_t score, float success_rate,
+                                           uint32_t memorization_ms, uint32_t answer_ms)
+{
+    return run(save_marathon_result_request(user_id, length, score, success_rate, memorization_ms, answer_ms));
+}
+
+PgRequest<std::optional<std::string>> PostgresStorage::get_daily_challenge_request(const std::string &day,
+                                                                                   int32_t difficulty)
+{
+    return {{&get_daily_challenge_sql, {day, std::to_string(difficulty)}}, read_single_text};
+}
+
+std::optional<std::string> PostgresStorage::get_daily_challenge(const std::string &day, int32_t difficulty) const
+{
+    require_connection();
+    return run(get_daily_challenge_request(day, difficulty));
+}
+
+PgRequest<std::optional<std::string>> PostgresStorage::create_daily_challenge_request(const std::string &day,
+                                                                                      int32_t difficulty,
+                                                                                      const std::string &items)
+{
+    return {{&create_daily_challenge_sql, {day, std::to_string(difficulty), items}}, read_single_text};
+}
+
+std::optional<std::string> PostgresStorage::create_daily_challenge(const std::string &day, int32_t difficulty,
+                                                                   const std::string &items)
+{
+    require_connection();
+    return run(create_daily_challenge_request(day, difficulty, items));
+}
+
+PgRequest<bool> PostgresStorage::save_daily_challenge_result_request(const std::string &day, uint32_t user_id,
+                                                                     int32_t difficulty, uint32_t score,
+                                                                     float success_rate)
+{
+    PgRequest<bool> request{{&save_daily_challenge_result_sql,
+                             {day,
+                              std::to_string(user_id),
+                              std::to_string(difficulty),
+                              std::to_string(score),
+                              std::to_string(success_rate)}}};
+    request.parse = [](const PGresult *res, const std::string &)
+    {
+        return PQresultStatus(res) == PGRES_COMMAND_OK && std::atoi(PQcmdTuples(const_cast<PGresult *>(res))) == 1;
+    };
+    return request;
+}
+
+bool PostgresStorage::save_daily_challenge_result(const std::string &day, uint32_t user_id, int32_t difficulty,
+                                                  uint32_t score, float success_rate)
+{
+    return run(save_daily_challenge_result_request(day, user_id, difficulty, score, success_rate));
+}
+
+PgRequest<std::optional<DailyChallengeScore>> PostgresStorage::get_daily_challenge_score_request(
+    const std::string &day, uint32_t user_id)
+{
+    PgRequest<std::optional<DailyChallengeScore>> request{
+        {&get_daily_challenge_score_sql, {day, std::to_string(user_id)}}};
+    request.parse = [](const PGresult *res, const std::string &error)
+    {
+        require_tuples(res, error);
+
+        std::optional<DailyChallengeScore> score;
+        if (PQntuples(res) == 1)
+        {
+            score = DailyChallengeScore{std::stoi(PQgetvalue(res, 0, 0)),
+                                        static_cast<uint32_t>(std::stoul(PQgetvalue(res, 0, 1)))};
+        }
+        return score;
+    };
+    return request;
+}
+
+std::optional<DailyChallengeScore> PostgresStorage::get_daily_challenge_score(const std::string &day, uint32_t user_id) const
+{
+    require_connection();
+    return run(get_daily_challenge_score_request(day, user_id));
+}
+
+PgRequest<LeaderboardRows> PostgresStorage::get_daily_leaderboard_request(const std::string &day, int32_t difficulty,
+                                                                          uint32_t limit)
+{
+    return {{&daily_leaderboard_sql, {day, std::to_string(limit), std::to_string(difficulty)}}, read_leaderboard};
+}
+
+LeaderboardRows PostgresStorage::get_daily_leaderboard(const std::string &day, int32_t difficulty,
+                                                       uint32_t limit) const
+{
+    require_connection();
+    return run(get_daily_leaderboard_request(day, difficulty, limit));
+}
+
+std::size_t PostgresStorage::export_progress(const std::function<void(std::string_view)> &on_row) const
+{
+    if (!db_connection || PQstatus(get_connection()) != CONNECTION_OK)
+    {
+        throw std::runtime_error("Database connection is not established");
+    }
+
+    PGresult *res = execute(export_progress_sql, {});
+    if (PQresultStatus(res) != PGRES_COPY_OUT)
+    {
+        const std::string error_msg = last_error();
+        PQclear(res);
+        throw std::runtime_error("Database query failed: " + error_msg);
+    }
+    PQclear(res);
+
+    // строки приходят по одной; буфер выделяет libpq
+    std::size_t rows{0};
+    std::size_t bytes{0};
+    char *buffer = nullptr;
+    int32_t length;
+    while ((length = PQgetCopyData(get_connection(), &buffer, 0)) > 0)
+    {
+        std::string_view row(buffer, static_cast<std::size_t>(length));
+        if (!row.empty() && row.back() == '\n')
+        {
+            row.remove_suffix(1);
+        }
+        on_row(row);
+        PQfreemem(buffer);
+        ++rows;
+        bytes += static_cast<std::size_t>(length);
+    }
+    export_progress_sql.rows.increment(rows);
+    export_progress_sql.bytes.increment(bytes);
+
+    // итоговый результат COPY после -1
+    res = PQgetResult(get_connection());
+    const bool failed = length == -2 || PQresultStatus(res) != PGRES_COMMAND_OK;
+    const std::string error_msg = failed ? last_error() : std::string{};
+    PQclear(res);
+    while ((res = PQgetResult(get_connection())) != nullptr)
+    {
+        PQclear(res);
+    }
+
+    if (failed)
+    {
+        export_progress_sql.errors.increment();
+        throw std::runtime_error("COPY failed: " + error_msg);
+    }
+    return rows;
+}
+
+PgRequest<bool> PostgresStorage::save_exam_results_request(const std::vector<ExamResult> &results)
+{
+    std::string buffer;
+    buffer.reserve(results.size() * 40);
+    for (const auto &result : results)
+    {
+        buffer += std::to_string(result.user_id);
+        buffer += '\t';
+        append_copy_text(buffer, result.sequence_id);
+        buffer += '\t';
+        buffer += std::to_string(result.correct);
+        buffer += '\t';
+        buffer += std::to_string(result.total);
+        buffer += '\t';
+        buffer += std::to_string(result.total ? result.credit / result.total : 0.0f);
+        buffer += '\n';
+    }
+
+    return {{&save_exam_results_sql, {}, true, std::move(buffer), results.size()}, command_ok};
+}
+
+bool PostgresStorage::save_exam_results(const std::vector<ExamResult> &results)
+{
+    if (results.empty())
+    {
+        return true;
+    }
+    return run(save_exam_results_request(results));
+}
+
+PGresult *PostgresStorage::copy_in(const SqlStatement &statement, const std::string &buffer, std::size_t rows) const
+{
+    PGresult *res = execute(statement, {});
+    if (PQresultStatus(res) != PGRES_COPY_IN)
+    {
+        return res;
+    }
+    PQclear(res);
+
+    // крупный буфер уходит частями: PQputCopyData принимает int
+    constexpr std::size_t CHUNK_BYTES = std::size_t{1} << 20;
+    bool sent = true;
+    for (std::size_t offset{0}; sent && offset < buffer.size(); offset += CHUNK_BYTES)
+    {
+        const std::size_t length = std::min(CHUNK_BYTES, buffer.size() - offset);
+        sent = PQputCopyData(get_connection(), buffer.data() + offset, static_cast<int32_t>(length)) == 1;
+    }
+    // при ошибке отправки COPY прерывается, чтобы не оставить частичную пачку
+    PQputCopyEnd(get_connection(), sent ? nullptr : "client failed to send rows");
+
+    res = PQgetResult(get_connection());
+    const bool success = sent && PQresultStatus(res) == PGRES_COMMAND_OK;
+    PGresult *extra;
+    while ((extra = PQgetResult(get_connection())) != nullptr)
+    {
+        PQclear(extra);
+    }
+
+    if (success)
+    {
+        statement.rows.increment(rows);
+        statement.bytes.increment(buffer.size());
+    }
+    else
+    {
+        statement.errors.increment();
+    }
+    return res;
+}
@@ -0,0 +1,117 @@
+#include "../include/QueryLog.hpp"
+
+#include <sstream>
+#include <iomanip>
+#include <ctime>
+
+namespace
+{
+    std::string statement_label(const char *name)
+    {
+        return std::string("statement=\"") + name + "\"";
+    }
+
+    std::string json_escape(const std::string &value)
+    {
+        std::ostringstream out;
+        for (const char c : value)
+        {
+            switch (c)
+            {
+            case '"':
+                out << "\\\"";
+                break;
+            case '\\':
+                out << "\\\\";
+                break;
+            case '\n':
+                out << "\\n";
+                break;
+            case '\r':
+                out << "\\r";
+                break;
+            case '\t':
+                out << "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    out << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+                        << static_cast<int>(c) << std::dec;
+                }
+                else
+                {
+                    out << c;
+                }
+            }
+        }
+        return out.str();
+    }
+
+    std::string utc_timestamp()
+    {
+        const auto now = std::chrono::system_clock::now();
+        const std::time_t seconds = std::chrono::system_clock::to_time_t(now);
+        const auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+                                now.time_since_epoch())
+                                .count() %
+                            1000;
+
+        std::tm utc{};
+#ifdef _WIN32
+        gmtime_s(&utc, &seconds);
+#else
+        gmtime_r(&seconds, &utc);
+#endif
+        std::ostringstream out;
+        out << std::put_time(&utc, "%Y-%m-%dT%H:%M:%S") << "."
+            << std::setw(3) << std::setfill('0') << millis << "Z";
+        return out.str();
+    }
+}
+
+SqlStatement::SqlStatement(const char *statement_name, const char *statement_sql)
+    : name(statement_name),
+      sql(statement_sql),
+      latency("mem_trainer_db_query_duration_seconds", "Wall time of DatabaseSync calls by statement",
+              statement_label(statement_name)),
+      rows("mem_trainer_db_rows_total", "Rows returned or affected by statement",
+           statement_label(statement_name)),
+      bytes("mem_trainer_db_bytes_received_total", "Result bytes received by statement",
+            statement_label(statement_name)),
+      errors("mem_trainer_db_query_errors_total", "Failed queries by statement",
+             statement_label(statement_name))
+{
+}
+
+SlowQueryLog::SlowQueryLog(const std::string &path, std::chrono::milliseconds threshold)
+    : log(path, std::ios::app),
+      threshold(threshold)
+{
+}
+
+void SlowQueryLog::write(const QueryRecord &record)
+{
+    std::ostringstream line;
+    line << "{\"ts\":\"" << utc_timestamp() << "\""
+         << ",\"statement\":\"" << json_escape(record.statement->name) << "\""
+         << ",\"duration_ms\":" << std::fixed << std::setprecision(3)
+         << std::chrono::duration<double, std::milli>(record.elapsed).count()
+         << ",\"rows\":" << record.rows
+         << ",\"bytes\":" << record.bytes
+         << ",\"params\":[";
+    for (std::size_t i{0}; i < record.param_count; ++i)
+    {
+        line << (i ? "," : "") << "\"<redacted>\"";
+    }
+    line << "],\"status\":\"" << json_escape(record.status) << "\"";
+    if (record.failed)
+    {
+        line << ",\"error\":\"" << json_escape(record.error) << "\"";
+    }
+    line << ",\"query\":\"" << json_escape(record.statement->sql) << "\"}\n";
+
+    std::lock_guard lock(mutex);
+    log << line.str();
+    log.flush();
+}
@@ -3,6 +3,8 @@
 #include <random>
 #include <algorithm>
 #include <iterator>
+#include <limits>
+#include <cmath>
 
 namespace
 {
@@ -31,6 +33,15 @@ namespace
         std::uniform_real_distribution<float> dist(min, max);
         return dist(get_generator());
     }
+
+    // [0, bound): старшие 32 бита, умноженные на bound (без распределений стандартной библиотеки,
+    // у которых алгоритм не закреплён стандартом)
+    uint32_t bounded(RandomEngine &engine, uint32_t bound) noexcept
+    {
+        return static_cast<uint32_t>(((engine() >> 32) * bound) >> 32);
+    }
+
+    constexpr uint32_t MAX_NUMBER = 99999; // не больше 5 цифр, как у generate_integer
 }
 
 uint16_t NumberGenerator::generate_uint16() noexcept
@@ -69,3 +80,35 @@ std::string WordGenerator::generate_word() noexcept
     constexpr auto size = std::size(words);
     return words[generate_integer<std::size_t>(0, size - 1)];
 }
+
+std::string_view WordGenerator::generate_word_view() noexcept
+{
+    constexpr auto size = std::size(words);
+    return words[generate_integer<std::size_t>(0, size - 1)];
+}
+
+uint16_t NumberGenerator::generate_uint16(RandomEngine &engine) noexcept
+{
+    return static_cast<uint16_t>(bounded(engine, std::numeric_limits<uint16_t>::max() + 1u));
+}
+
+uint32_t NumberGenerator::generate_uint32(RandomEngine &engine) noexcept
+{
+    return bounded(engine, MAX_NUMBER + 1);
+}
+
+float NumberGenerator::generate_float(RandomEngine &engine) noexcept
+{
+    // [0, 10) с шагом 0.001
+    return static_cast<float>(bounded(engine, 10000)) / 1000;
+}
+
+char SymbolGenerator::generate_char(RandomEngine &engine) noexcept
+{
+    return symbols[bounded(engine, static_cast<uint32_t>(std::size(symbols)))];
+}
+
+std::string_view WordGenerator::generate_word_view(RandomEngine &engine) noexcept
+{
+    return words[bounded(engine, static_cast<uint32_t>(std::size(words)))];
+}
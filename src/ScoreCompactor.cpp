@@ -0,0 +1,111 @@
+#include "../include/ScoreCompactor.hpp"
+#include "../include/DatabaseSync.hpp"
+#include "../include/Metrics.hpp"
+#include "../include/NumberParsing.hpp"
+
+#include <iostream>
+#include <string>
+#include <string_view>
+
+namespace
+{
+    MetricCounter events_compacted("mem_trainer_score_events_compacted_total",
+                                   "Score events folded into users.total_score and user_score_daily");
+    MetricCounter compaction_failures("mem_trainer_score_compaction_failures_total",
+                                      "Score compaction batches that failed");
+
+    void print_usage()
+    {
+        std::cerr << "Usage: mem_trainer --compact-scores [--batch=<n>]\n"
+                     "  folds pending score_events into users.total_score and user_score_daily\n"
+                     "  --batch   events per transaction (default "
+                  << ScoreCompactor::DEFAULT_BATCH_EVENTS << ")\n";
+    }
+}
+
+ScoreCompactor::ScoreCompactor(DatabaseSync &db_sync, std::chrono::seconds interval, uint32_t batch_events)
+    : db_sync(db_sync), interval(interval), batch_events(batch_events ? batch_events : DEFAULT_BATCH_EVENTS),
+      last_run(std::chrono::steady_clock::now())
+{
+}
+
+void ScoreCompactor::maybe_compact()
+{
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_run < interval)
+    {
+        return;
+    }
+    last_run = now;
+
+    const auto folded = db_sync.compact_scores(batch_events);
+    if (!folded)
+    {
+        compaction_failures.increment();
+        std::cerr << "Failed to compact scores: " << db_sync.last_error() << "\n";
+        return;
+    }
+    events_compacted.increment(*folded);
+}
+
+std::optional<std::size_t> ScoreCompactor::compact_all()
+{
+    std::size_t total{0};
+    while (true)
+    {
+        const auto folded = db_sync.compact_scores(batch_events);
+        if (!folded)
+        {
+            compaction_failures.increment();
+            return std::nullopt;
+        }
+        events_compacted.increment(*folded);
+        total += *folded;
+        // неполная пачка: таблица пуста или пачку забрал другой процесс
+        if (*folded < batch_events)
+        {
+            return total;
+        }
+    }
+}
+
+int ScoreCompactor::run_cli(int argc, char **argv)
+{
+    uint32_t batch{DEFAULT_BATCH_EVENTS};
+    for (int i{2}; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        if (!arg.starts_with("--batch=") || !NumberParsing::parse_whole(arg.substr(8), batch))
+        {
+            print_usage();
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+
+    try
+    {
+        DatabaseSync db_sync;
+        if (!db_sync.connect())
+        {
+            std::cerr << "Failed to connect to database\n";
+            return 1;
+        }
+
+        const auto started = std::chrono::steady_clock::now();
+        const auto folded = ScoreCompactor(db_sync, std::chrono::seconds(0), batch).compact_all();
+        if (!folded)
+        {
+            std::cerr << "Failed to compact scores: " << db_sync.last_error() << "\n";
+            return 1;
+        }
+        std::cout << "Compacted " << *folded << " score events in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started).count()
+                  << " ms\n";
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,677 @@
+#include "../include/SessionLog.hpp"
+#include "../include/BlockCodec.hpp"
+
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <type_traits>
+#include <variant>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr std::array<uint8_t, 4> FILE_MAGIC = {'M', 'T', 'S', 'L'};
+    constexpr uint8_t FORMAT_VERSION = 1;
+    constexpr std::size_t FILE_HEADER_SIZE = 8;
+    // raw_size u32, stored_size u32, record_count u32, codec u8, 3 байта резерва, checksum u32
+    constexpr std::size_t BLOCK_HEADER_SIZE = 20;
+
+    constexpr uint8_t CODEC_NONE = 0;
+    constexpr uint8_t CODEC_LZ = 1;
+
+    constexpr uint8_t HAS_SEED = 0x10;
+
+    uint32_t checksum(std::span<const uint8_t> bytes) noexcept
+    {
+        // FNV-1a
+        uint32_t hash = 2166136261u;
+        for (const uint8_t byte : bytes)
+        {
+            hash = (hash ^ byte) * 16777619u;
+        }
+        return hash;
+    }
+
+    uint64_t zigzag(int64_t value) noexcept
+    {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    int64_t unzigzag(uint64_t value) noexcept
+    {
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    void put_varint(std::vector<uint8_t> &out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    template <typename T>
+    void put_fixed(std::vector<uint8_t> &out, T value)
+    {
+        for (std::size_t i{0}; i < sizeof(T); ++i)
+        {
+            out.push_back(static_cast<uint8_t>(static_cast<uint64_t>(value) >> (8 * i)));
+        }
+    }
+
+    void put_bytes(std::vector<uint8_t> &out, std::string_view bytes)
+    {
+        put_varint(out, bytes.size());
+        out.insert(out.end(), bytes.begin(), bytes.end());
+    }
+
+    template <typename T>
+    T read_fixed(const uint8_t *data) noexcept
+    {
+        uint64_t value{0};
+        for (std::size_t i{0}; i < sizeof(T); ++i)
+        {
+            value |= static_cast<uint64_t>(data[i]) << (8 * i);
+        }
+        return static_cast<T>(value);
+    }
+
+    // конец последнего целого блока: заголовок, размер в пределах файла и контрольная сумма
+    uint64_t valid_blocks_end(std::istream &in, uint64_t file_size)
+    {
+        uint64_t offset = FILE_HEADER_SIZE;
+        std::array<uint8_t, BLOCK_HEADER_SIZE> header{};
+        std::vector<uint8_t> stored;
+        while (file_size - offset >= BLOCK_HEADER_SIZE)
+        {
+            in.seekg(static_cast<std::streamoff>(offset));
+            if (!in.read(reinterpret_cast<char *>(header.data()), header.size()))
+            {
+                break;
+            }
+            const uint32_t stored_size = read_fixed<uint32_t>(header.data() + 4);
+            if (stored_size > file_size - offset - BLOCK_HEADER_SIZE)
+            {
+                break;
+            }
+            stored.resize(stored_size);
+            if (!in.read(reinterpret_cast<char *>(stored.data()), stored_size) ||
+                checksum(stored) != read_fixed<uint32_t>(header.data() + 16))
+            {
+                break;
+            }
+            offset += BLOCK_HEADER_SIZE + stored_size;
+        }
+        return offset;
+    }
+
+    // чтение полезной нагрузки блока с проверкой границ
+    class Cursor
+    {
+    public:
+        Cursor(std::span<const uint8_t> bytes, std::size_t position) noexcept
+            : bytes(bytes), position(position) {}
+
+        std::size_t offset() const noexcept { return position; }
+
+        bool varint(uint64_t &value) noexcept
+        {
+            value = 0;
+            for (uint32_t shift{0}; shift < 64; shift += 7)
+            {
+                if (position == bytes.size())
+                    return false;
+                const uint8_t byte = bytes[position++];
+                value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80))
+                    return true;
+            }
+            return false;
+        }
+
+        template <typename T>
+        bool fixed(T &value) noexcept
+        {
+            if (bytes.size() - position < sizeof(T))
+                return false;
+            value = read_fixed<T>(bytes.data() + position);
+            position += sizeof(T);
+            return true;
+        }
+
+        bool text(std::string_view &value) noexcept
+        {
+            uint64_t length;
+            if (!varint(length) || length > bytes.size() - position)
+                return false;
+            value = {reinterpret_cast<const char *>(bytes.data() + position), static_cast<std::size_t>(length)};
+            position += length;
+            return true;
+        }
+
+        bool raw(std::size_t length, const uint8_t *&value) noexcept
+        {
+            if (length > bytes.size() - position)
+                return false;
+            value = bytes.data() + position;
+            position += length;
+            return true;
+        }
+
+    private:
+        std::span<const uint8_t> bytes;
+        std::size_t position;
+    };
+}
+
+SessionLogWriter::SessionLogWriter(const std::string &path, uint32_t block_records)
+    : block_records(std::max<uint32_t>(block_records, 1))
+{
+    // у журнала один писатель: иначе обрезка хвоста ниже отрезала бы блок, который
+    // другой процесс пишет прямо сейчас
+    if (!lock_file(path + ".lock"))
+    {
+        std::cerr << "Session log " << path << " is used by another process, recording disabled\n";
+        return;
+    }
+
+    std::error_code error;
+    const auto existing = std::filesystem::file_size(path, error);
+    if (!error && existing > 0)
+    {
+        // дописывать можно только в журнал того же формата
+        std::ifstream current(path, std::ios::binary);
+        std::array<char, FILE_HEADER_SIZE> header{};
+        current.read(header.data(), header.size());
+        if (!current || !std::equal(FILE_MAGIC.begin(), FILE_MAGIC.end(), header.begin()) ||
+            static_cast<uint8_t>(header[4]) != FORMAT_VERSION)
+        {
+            std::cerr << "Session log " << path << " has an unknown format, recording disabled\n";
+            return;
+        }
+
+        // читатель останавливается на первом плохом блоке: оборванный при сбое хвост
+        // отрезается, иначе всё дописанное после него стало бы нечитаемым
+        const uint64_t valid = valid_blocks_end(current, existing);
+        if (valid != existing)
+        {
+            std::cerr << "Session log " << path << ": dropping " << existing - valid
+                      << " bytes of an incomplete block\n";
+            std::filesystem::resize_file(path, valid, error);
+            if (error)
+            {
+                std::cerr << "Cannot truncate " << path << ": " << error.message() << ", recording disabled\n";
+                return;
+            }
+        }
+    }
+
+    log.open(path, std::ios::binary | std::ios::app);
+    if (log.is_open() && (error || existing == 0))
+    {
+        std::array<char, FILE_HEADER_SIZE> header{};
+        std::copy(FILE_MAGIC.begin(), FILE_MAGIC.end(), header.begin());
+        header[4] = static_cast<char>(FORMAT_VERSION);
+        log.write(header.data(), header.size());
+        log.flush();
+    }
+}
+
+SessionLogWriter::~SessionLogWriter()
+{
+    flush();
+#ifdef _WIN32
+    if (lock_handle)
+    {
+        CloseHandle(lock_handle);
+    }
+#else
+    if (lock_descriptor >= 0)
+    {
+        // блокировка снимается вместе с закрытием дескриптора
+        ::close(lock_descriptor);
+    }
+#endif
+}
+
+bool SessionLogWriter::lock_file(const std::string &lock_path)
+{
+    // отдельный файл: на Windows блокировка диапазона запретила бы запись в сам журнал
+#ifdef _WIN32
+    HANDLE file = CreateFileA(lock_path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                              nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+    OVERLAPPED overlapped{};
+    if (!LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK | LOCKFILE_FAIL_IMMEDIATELY, 0, MAXDWORD, MAXDWORD, &overlapped))
+    {
+        CloseHandle(file);
+        return false;
+    }
+    lock_handle = file;
+#else
+    const int descriptor = ::open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (descriptor < 0)
+    {
+        return false;
+    }
+    if (::flock(descriptor, LOCK_EX | LOCK_NB) != 0)
+    {
+        ::close(descriptor);
+        return false;
+    }
+    lock_descriptor = descriptor;
+#endif
+    return true;
+}
+
+void SessionLogWriter::append(const SessionRecord &record)
+{
+    std::lock_guard lock(mutex);
+    if (!log.is_open())
+    {
+        return;
+    }
+
+    put_varint(block, zigzag(static_cast<int64_t>(record.user_id) - static_cast<int64_t>(previous_user_id)));
+    put_varint(block, zigzag(record.started_at_ms - previous_started_at));
+    previous_user_id = record.user_id;
+    previous_started_at = record.started_at_ms;
+
+    block.push_back(static_cast<uint8_t>(static_cast<uint8_t>(record.difficulty) |
+                                         (static_cast<uint8_t>(record.mode) << 2) |
+                                         (record.seed ? HAS_SEED : 0)));
+    if (record.seed)
+    {
+        put_fixed(block, record.seed);
+    }
+    put_varint(block, record.memorization_ms);
+    put_varint(block, record.answer_ms);
+
+    put_varint(block, record.items.size());
+    for (const auto &item : record.items)
+    {
+        block.push_back(static_cast<uint8_t>(item.index())); // совпадает с TaskGenerator::ItemKind
+        std::visit([this](const auto &value)
+                   {
+            using T = std::decay_t<decltype(value)>;
+            if constexpr (std::is_same_v<T, std::string_view>)
+                put_bytes(block, value);
+            else if constexpr (std::is_same_v<T, float>)
+                put_fixed(block, std::bit_cast<uint32_t>(value));
+            else if constexpr (std::is_same_v<T, char>)
+                block.push_back(static_cast<uint8_t>(value));
+            else
+                put_varint(block, value); }, item);
+    }
+
+    // верность ответов - битовая маска по элементам
+    for (std::size_t base{0}; base < record.items.size(); base += 8)
+    {
+        uint8_t bits{0};
+        for (std::size_t bit{0}; bit < 8 && base + bit < record.item_correct.size(); ++bit)
+        {
+            bits |= static_cast<uint8_t>((record.item_correct[base + bit] ? 1 : 0) << bit);
+        }
+        block.push_back(bits);
+    }
+
+    put_varint(block, record.answers.size());
+    for (const auto answer : record.answers)
+    {
+        put_bytes(block, answer);
+    }
+
+    if (++record_count >= block_records)
+    {
+        flush_locked();
+    }
+}
+
+void SessionLogWriter::flush()
+{
+    std::lock_guard lock(mutex);
+    flush_locked();
+}
+
+void SessionLogWriter::flush_locked()
+{
+    if (!log.is_open() || record_count == 0)
+    {
+        return;
+    }
+
+    compressed.clear();
+    BlockCodec::compress(block, compressed);
+    const bool use_lz = compressed.size() < block.size();
+    const std::span<const uint8_t> stored = use_lz ? std::span<const uint8_t>(compressed)
+                                                   : std::span<const uint8_t>(block);
+
+    // заголовок и данные - один буфер и одна запись в файл, открытый на дозапись (O_APPEND):
+    // блоки процессов, пишущих в общий журнал, не перемешиваются
+    frame.clear();
+    frame.reserve(BLOCK_HEADER_SIZE + stored.size());
+    put_fixed(frame, static_cast<uint32_t>(block.size()));
+    put_fixed(frame, static_cast<uint32_t>(stored.size()));
+    put_fixed(frame, record_count);
+    frame.push_back(use_lz ? CODEC_LZ : CODEC_NONE);
+    frame.insert(frame.end(), 3, 0);
+    put_fixed(frame, checksum(stored));
+    frame.insert(frame.end(), stored.begin(), stored.end());
+
+    log.write(reinterpret_cast<const char *>(frame.data()), static_cast<std::streamsize>(frame.size()));
+    log.flush();
+
+    block.clear();
+    record_count = 0;
+    previous_user_id = 0;
+    previous_started_at = 0;
+}
+
+SessionLogReader::SessionLogReader(const std::string &path)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+    file_handle = file;
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size))
+    {
+        return;
+    }
+    size = static_cast<std::size_t>(file_size.QuadPart);
+    if (size == 0)
+    {
+        opened = true; // пустой журнал: открыт, но записей нет
+        return;
+    }
+
+    mapping_handle = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping_handle)
+    {
+        return;
+    }
+    data = static_cast<const uint8_t *>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    if (!data)
+    {
+        return;
+    }
+#else
+    file_descriptor = ::open(path.c_str(), O_RDONLY);
+    if (file_descriptor < 0)
+    {
+        return;
+    }
+
+    struct stat file_status;
+    if (::fstat(file_descriptor, &file_status) != 0)
+    {
+        return;
+    }
+    size = static_cast<std::size_t>(file_status.st_size);
+    if (size == 0)
+    {
+        opened = true; // пустой журнал: открыт, но записей нет
+        return;
+    }
+
+    void *mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file_descriptor, 0);
+    if (mapped == MAP_FAILED)
+    {
+        return;
+    }
+    ::madvise(mapped, size, MADV_SEQUENTIAL);
+    data = static_cast<const uint8_t *>(mapped);
+#endif
+
+    opened = true;
+    rewind();
+}
+
+SessionLogReader::~SessionLogReader()
+{
+#ifdef _WIN32
+    if (data)
+    {
+        UnmapViewOfFile(data);
+    }
+    if (mapping_handle)
+    {
+        CloseHandle(mapping_handle);
+    }
+    if (file_handle)
+    {
+        CloseHandle(file_handle);
+    }
+#else
+    if (data)
+    {
+        ::munmap(const_cast<uint8_t *>(data), size);
+    }
+    if (file_descriptor >= 0)
+    {
+        ::close(file_descriptor);
+    }
+#endif
+}
+
+void SessionLogReader::rewind() noexcept
+{
+    records_left = 0;
+    damaged = false;
+    block_offset = size;
+    if (size == 0)
+    {
+        return;
+    }
+
+    if (size < FILE_HEADER_SIZE || !std::equal(FILE_MAGIC.begin(), FILE_MAGIC.end(), data) ||
+        data[4] != FORMAT_VERSION)
+    {
+        damaged = true;
+        return;
+    }
+    block_offset = FILE_HEADER_SIZE;
+}
+
+bool SessionLogReader::load_block()
+{
+    if (block_offset == size)
+    {
+        return false;
+    }
+    // недописанный хвост (процесс упал во время записи) тоже считается повреждением
+    if (size - block_offset < BLOCK_HEADER_SIZE)
+    {
+        damaged = true;
+        return false;
+    }
+
+    const uint8_t *header = data + block_offset;
+    const uint32_t raw_size = read_fixed<uint32_t>(header);
+    const uint32_t stored_size = read_fixed<uint32_t>(header + 4);
+    const uint32_t record_count = read_fixed<uint32_t>(header + 8);
+    const uint8_t codec = header[12];
+    const uint32_t expected_checksum = read_fixed<uint32_t>(header + 16);
+
+    if (stored_size > size - block_offset - BLOCK_HEADER_SIZE)
+    {
+        damaged = true;
+        return false;
+    }
+
+    const std::span<const uint8_t> stored(header + BLOCK_HEADER_SIZE, stored_size);
+    if (checksum(stored) != expected_checksum)
+    {
+        damaged = true;
+        return false;
+    }
+
+    if (codec == CODEC_NONE && raw_size == stored_size)
+    {
+        payload = stored;
+    }
+    else if (codec == CODEC_LZ)
+    {
+        decompressed.resize(raw_size);
+        if (!BlockCodec::decompress(stored, decompressed))
+        {
+            damaged = true;
+            return false;
+        }
+        payload = decompressed;
+    }
+    else
+    {
+        damaged = true;
+        return false;
+    }
+
+    block_offset += BLOCK_HEADER_SIZE + stored_size;
+    payload_position = 0;
+    records_left = record_count;
+    previous_user_id = 0;
+    previous_started_at = 0;
+    return true;
+}
+
+bool SessionLogReader::next(SessionRecord &record)
+{
+    if (damaged)
+    {
+        return false;
+    }
+    while (records_left == 0)
+    {
+        if (!load_block())
+        {
+            return false;
+        }
+    }
+
+    Cursor in(payload, payload_position);
+    auto fail = [this]
+    {
+        damaged = true;
+        return false;
+    };
+
+    uint64_t user_delta, started_delta;
+    uint8_t header;
+    if (!in.varint(user_delta) || !in.varint(started_delta) || !in.fixed(header))
+        return fail();
+    previous_user_id = static_cast<uint32_t>(previous_user_id + unzigzag(user_delta));
+    previous_started_at += unzigzag(started_delta);
+
+    record.user_id = previous_user_id;
+    record.started_at_ms = previous_started_at;
+    record.difficulty = static_cast<TaskGenerator::Difficulty>(header & 0x03);
+    record.mode = static_cast<SessionMode>((header >> 2) & 0x03);
+    record.seed = 0;
+    if ((header & HAS_SEED) && !in.fixed(record.seed))
+        return fail();
+
+    uint64_t memorization_ms, answer_ms, item_count;
+    if (!in.varint(memorization_ms) || !in.varint(answer_ms) || !in.varint(item_count) ||
+        item_count > payload.size())
+        return fail();
+    record.memorization_ms = static_cast<uint32_t>(memorization_ms);
+    record.answer_ms = static_cast<uint32_t>(answer_ms);
+
+    items.clear();
+    for (uint64_t i{0}; i < item_count; ++i)
+    {
+        uint8_t kind;
+        if (!in.fixed(kind))
+            return fail();
+
+        switch (static_cast<TaskGenerator::ItemKind>(kind))
+        {
+        case TaskGenerator::ItemKind::UINT16:
+        case TaskGenerator::ItemKind::UINT32:
+        {
+            uint64_t value;
+            if (!in.varint(value))
+                return fail();
+            if (kind == static_cast<uint8_t>(TaskGenerator::ItemKind::UINT16))
+                items.emplace_back(static_cast<uint16_t>(value));
+            else
+                items.emplace_back(static_cast<uint32_t>(value));
+            break;
+        }
+        case TaskGenerator::ItemKind::FLOAT:
+        {
+            uint32_t bits;
+            if (!in.fixed(bits))
+                return fail();
+            items.emplace_back(std::bit_cast<float>(bits));
+            break;
+        }
+        case TaskGenerator::ItemKind::SYMBOL:
+        {
+            uint8_t symbol;
+            if (!in.fixed(symbol))
+                return fail();
+            items.emplace_back(static_cast<char>(symbol));
+            break;
+        }
+        case TaskGenerator::ItemKind::WORD:
+        {
+            std::string_view word;
+            if (!in.text(word))
+                return fail();
+            items.emplace_back(word);
+            break;
+        }
+        default:
+            return fail();
+        }
+    }
+
+    const uint8_t *bits;
+    if (!in.raw((item_count + 7) / 8, bits))
+        return fail();
+    item_correct.resize(item_count);
+    for (uint64_t i{0}; i < item_count; ++i)
+    {
+        item_correct[i] = (bits[i / 8] >> (i % 8)) & 1;
+    }
+
+    uint64_t answer_count;
+    if (!in.varint(answer_count) || answer_count > payload.size())
+        return fail();
+    answers.resize(answer_count);
+    for (auto &answer : answers)
+    {
+        if (!in.text(answer))
+            return fail();
+    }
+
+    record.items = items;
+    record.item_correct = item_correct;
+    record.answers = answers;
+
+    payload_position = in.offset();
+    --records_left;
+    return true;
+}
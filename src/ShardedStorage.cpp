@@ -0,0 +1,834 @@
+#include "../include/ShardedStorage.hpp"
+#include "../include/PostgresStorage.hpp"
+#include "../include/ConfigFile.hpp"
+#include "../include/Metrics.hpp"
+
+#include <libpq-fe.h>
+
+#include <algorithm>
+#include <charconv>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <cctype>
+
+namespace
+{
+    MetricCounter users_moved("mem_trainer_shard_users_moved_total", "Users moved between shards by rebalancing");
+    MetricCounter move_failures("mem_trainer_shard_move_failures_total", "Failed user moves between shards");
+
+    // должна совпадать во всех процессах и версиях: std::hash для этого не годится
+    uint64_t fnv1a64(std::string_view bytes) noexcept
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (const char c : bytes)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // jump consistent hash (Lamping, Veach): при росте числа корзин с n до n + 1
+    // меняет корзину только ~1/(n + 1) ключей, и все они уходят в новую
+    std::size_t jump_hash(uint64_t key, std::size_t buckets) noexcept
+    {
+        int64_t bucket{-1};
+        int64_t next{0};
+        while (next < static_cast<int64_t>(buckets))
+        {
+            bucket = next;
+            key = key * 2862933555777941757ull + 1;
+            next = static_cast<int64_t>(static_cast<double>(bucket + 1) *
+                                        (static_cast<double>(int64_t{1} << 31) / static_cast<double>((key >> 33) + 1)));
+        }
+        return static_cast<std::size_t>(bucket);
+    }
+
+    using ResultHandle = std::unique_ptr<PGresult, void (*)(PGresult *)>;
+
+    ResultHandle run(PGconn *connection, const std::string &sql, std::initializer_list<const char *> values = {})
+    {
+        return ResultHandle(PQexecParams(connection, sql.c_str(), static_cast<int>(values.size()), nullptr,
+                                         values.begin(), nullptr, nullptr, 0),
+                            PQclear);
+    }
+
+    bool command_ok(const ResultHandle &result) noexcept
+    {
+        const ExecStatusType status = PQresultStatus(result.get());
+        return status == PGRES_COMMAND_OK || status == PGRES_TUPLES_OK;
+    }
+
+    void drain(PGconn *connection) noexcept
+    {
+        while (PGresult *res = PQgetResult(connection))
+        {
+            PQclear(res);
+        }
+    }
+
+    // COPY ... TO STDOUT из одной базы прямо в COPY ... FROM STDIN другой, без разбора строк
+    bool pipe_copy(PGconn *source, const std::string &copy_out, PGconn *target, const std::string &copy_in)
+    {
+        ResultHandle out(PQexec(source, copy_out.c_str()), PQclear);
+        if (PQresultStatus(out.get()) != PGRES_COPY_OUT)
+        {
+            return false;
+        }
+        ResultHandle in(PQexec(target, copy_in.c_str()), PQclear);
+        if (PQresultStatus(in.get()) != PGRES_COPY_IN)
+        {
+            // COPY OUT уже идёт: дочитываем, чтобы соединение осталось рабочим
+            char *buffer{nullptr};
+            while (PQgetCopyData(source, &buffer, 0) > 0)
+            {
+                PQfreemem(buffer);
+            }
+            drain(source);
+            return false;
+        }
+
+        bool sent{true};
+        char *buffer{nullptr};
+        int length{0};
+        while ((length = PQgetCopyData(source, &buffer, 0)) > 0)
+        {
+            sent = sent && PQputCopyData(target, buffer, length) == 1;
+            PQfreemem(buffer);
+        }
+        ResultHandle out_done(PQgetResult(source), PQclear);
+        const bool read_ok = length == -1 && PQresultStatus(out_done.get()) == PGRES_COMMAND_OK;
+        drain(source);
+
+        PQputCopyEnd(target, sent && read_ok ? nullptr : "source COPY failed");
+        ResultHandle in_done(PQgetResult(target), PQclear);
+        const bool write_ok = PQresultStatus(in_done.get()) == PGRES_COMMAND_OK;
+        drain(target);
+        return sent && read_ok && write_ok;
+    }
+
+    void print_usage()
+    {
+        std::cerr << "Usage: mem_trainer --rebalance-shards [--dry-run]\n"
+                     "  moves users whose home shard changed after editing [shards] databases=\n"
+                     "  --dry-run   only list the users that would move\n";
+    }
+}
+
+ShardedStorage::ShardedStorage(std::vector<std::unique_ptr<PostgresStorage>> shards)
+    : shards(std::move(shards))
+{
+    if (this->shards.empty() || this->shards.size() > MAX_SHARDS)
+    {
+        throw std::invalid_argument("ShardedStorage needs 1.." + std::to_string(MAX_SHARDS) + " shards");
+    }
+}
+
+ShardedStorage::~ShardedStorage() = default;
+
+std::vector<std::unique_ptr<PostgresStorage>> ShardedStorage::shards_from_config(const ConfigFile &config)
+{
+    std::vector<std::unique_ptr<PostgresStorage>> result;
+    const std::string databases = config.get("shards", "databases");
+    const auto slow_log = databases.empty() ? nullptr : PostgresStorage::slow_query_log_from_config(config);
+
+    // databases=host[:port]/dbname,...; порядок задаёт номер шарда и не должен меняться
+    std::size_t begin{0};
+    while (begin < databases.size())
+    {
+        const std::size_t end = std::min(databases.find(',', begin), databases.size());
+        std::string entry = databases.substr(begin, end - begin);
+        entry.erase(std::remove_if(entry.begin(), entry.end(), [](unsigned char c)
+                                   { return std::isspace(c) != 0; }),
+                    entry.end());
+        begin = end + 1;
+        if (entry.empty())
+        {
+            continue;
+        }
+
+        const std::size_t slash = entry.find('/');
+        const std::string address = entry.substr(0, slash);
+        const std::string dbname = slash == std::string::npos ? "" : entry.substr(slash + 1);
+        const std::size_t colon = address.rfind(':');
+        const std::string host = address.substr(0, colon);
+        const std::string port = colon == std::string::npos ? "" : address.substr(colon + 1);
+        result.push_back(std::make_unique<PostgresStorage>(PostgresStorage::parse_config_file(host, port, dbname)));
+        result.back()->set_slow_query_log(slow_log);
+    }
+
+    if (result.size() > MAX_SHARDS)
+    {
+        throw std::runtime_error("[shards] lists more than " + std::to_string(MAX_SHARDS) + " databases");
+    }
+    return result;
+}
+
+std::size_t ShardedStorage::home_shard(std::string_view username) const noexcept
+{
+    return jump_hash(fnv1a64(username), shards.size());
+}
+
+PostgresStorage *ShardedStorage::route(int64_t id) const
+{
+    const std::size_t shard = shard_of(id);
+    if (id < 0 || shard >= shards.size())
+    {
+        error = "id " + std::to_string(id) + " does not belong to a configured shard";
+        return nullptr;
+    }
+    error.clear();
+    last_shard = shard;
+    return shards[shard].get();
+}
+
+PostgresStorage &ShardedStorage::route_read(int64_t id) const
+{
+    if (PostgresStorage *shard = route(id))
+    {
+        return *shard;
+    }
+    throw std::runtime_error(error);
+}
+
+template <typename Query>
+auto ShardedStorage::scatter(Query &&query) const -> std::vector<decltype(query(std::declval<PostgresStorage &>()))>
+{
+    using Result = decltype(query(std::declval<PostgresStorage &>()));
+
+    // у каждого шарда своё соединение, поэтому запросы идут одновременно; шард 0 - в этом потоке
+    std::vector<std::future<Result>> pending;
+    pending.reserve(shards.size() - 1);
+    for (std::size_t i{1}; i < shards.size(); ++i)
+    {
+        pending.push_back(std::async(std::launch::async, [&query, &shard = *shards[i]]
+                                     { return query(shard); }));
+    }
+
+    std::vector<Result> results;
+    results.reserve(shards.size());
+    results.push_back(query(*shards[0]));
+    for (auto &part : pending)
+    {
+        results.push_back(part.get());
+    }
+    return results;
+}
+
+LeaderboardRows ShardedStorage::merge_top(std::vector<LeaderboardRows> parts, uint32_t limit)
+{
+    // каждый шард уже отдал свой топ-N, значит общий топ-N - среди них
+    struct Entry
+    {
+        int64_t score;
+        std::pair<std::string, std::string> row;
+    };
+    std::vector<Entry> entries;
+    for (auto &part : parts)
+    {
+        for (auto &row : part)
+        {
+            int64_t score{0};
+            std::from_chars(row.second.data(), row.second.data() + row.second.size(), score);
+            entries.push_back(Entry{score, std::move(row)});
+        }
+    }
+
+    const std::size_t keep = std::min<std::size_t>(limit, entries.size());
+    std::partial_sort(entries.begin(), entries.begin() + static_cast<std::ptrdiff_t>(keep), entries.end(),
+                      [](const Entry &a, const Entry &b)
+                      { return a.score != b.score ? a.score > b.score : a.row.first < b.row.first; });
+
+    LeaderboardRows merged;
+    merged.reserve(keep);
+    for (std::size_t i{0}; i < keep; ++i)
+    {
+        merged.push_back(std::move(entries[i].row));
+    }
+    return merged;
+}
+
+bool ShardedStorage::connect()
+{
+    bool connected{true};
+    for (std::size_t i{0}; i < shards.size(); ++i)
+    {
+        if (!shards[i]->connect())
+        {
+            std::cerr << "Shard " << i << " is unavailable\n";
+            last_shard = i;
+            connected = false;
+        }
+    }
+    return connected;
+}
+
+bool ShardedStorage::is_connected() const
+{
+    return std::all_of(shards.begin(), shards.end(), [](const auto &shard)
+                       { return shard->is_connected(); });
+}
+
+std::string ShardedStorage::last_error() const
+{
+    return error.empty() ? "shard " + std::to_string(last_shard) + ": " + shards[last_shard]->last_error() : error;
+}
+
+std::optional<UserCredential> ShardedStorage::get_user_credential(const std::string &username) const
+{
+    // сначала домашний шард; в остальных пользователь бывает только до rebalance
+    const std::size_t home = home_shard(username);
+    std::optional<UserCredential> credential;
+    std::size_t found_in{home};
+    credential = shards[home]->get_user_credential(username);
+    for (std::size_t i{0}; !credential && i < shards.size(); ++i)
+    {
+        if (i != home)
+        {
+            credential = shards[i]->get_user_credential(username);
+            found_in = i;
+        }
+    }
+    if (!credential)
+    {
+        return std::nullopt;
+    }
+
+    const int64_t id = global_id(credential->user_id, found_in);
+    if (id > std::numeric_limits<int32_t>::max())
+    {
+        throw std::runtime_error("user id " + std::to_string(credential->user_id) + " in shard " +
+                                 std::to_string(found_in) + " does not fit the sharded id range");
+    }
+    credential->user_id = static_cast<int32_t>(id);
+    return credential;
+}
+
+bool ShardedStorage::register_user(const std::string &username, const std::string &password)
+{
+    const std::size_t home = home_shard(username);
+    error.clear();
+    last_shard = home;
+    const auto inserted = shards[home]->register_user_below(username, password, MAX_LOCAL_USER_ID);
+    if (inserted && !*inserted)
+    {
+        error = "shard " + std::to_string(home) + " has no user ids left (local ids are limited to " +
+                std::to_string(MAX_LOCAL_USER_ID) + "); add a shard";
+        return false;
+    }
+    return inserted.value_or(false);
+}
+
+bool ShardedStorage::update_password(uint32_t user_id, const std::string &password)
+{
+    PostgresStorage *shard = route(user_id);
+    return shard && shard->update_password(static_cast<uint32_t>(local_id(user_id)), password);
+}
+
+std::optional<int64_t> ShardedStorage::save_progress(uint32_t user_id, int32_t difficulty, uint32_t sequence_length,
+                                                     float success_rate, uint32_t memorization_ms, uint32_t answer_ms)
+{
+    PostgresStorage *shard = route(user_id);
+    if (!shard)
+    {
+        return std::nullopt;
+    }
+    const auto progress_id = shard->save_progress(static_cast<uint32_t>(local_id(user_id)), difficulty,
+                                                  sequence_length, success_rate, memorization_ms, answer_ms);
+    if (!progress_id)
+    {
+        return std::nullopt;
+    }
+    return global_id(*progress_id, shard_of(user_id));
+}
+
+bool ShardedStorage::save_progress_items(std::vector<ProgressItem> &items)
+{
+    std::vector<std::vector<ProgressItem>> by_shard(shards.size());
+    for (const auto &item : items)
+    {
+        if (!route(item.progress_id))
+        {
+            return false;
+        }
+        ProgressItem local = item;
+        local.progress_id = local_id(item.progress_id);
+        by_shard[shard_of(item.progress_id)].push_back(local);
+    }
+
+    // шарды фиксируют свои части независимо: повтор должен получить только незаписанные строки,
+    // иначе записанные нарушат первичный ключ и пачка не пройдёт никогда
+    items.clear();
+    for (std::size_t i{0}; i < shards.size(); ++i)
+    {
+        if (!by_shard[i].empty() && !shards[i]->save_progress_items(by_shard[i]))
+        {
+            last_shard = i;
+            for (ProgressItem &item : by_shard[i])
+            {
+                item.progress_id = global_id(item.progress_id, i);
+                items.push_back(item);
+            }
+        }
+    }
+    return items.empty();
+}
+
+bool ShardedStorage::save_exam_results(const std::vector<ExamResult> &results)
+{
+    std::vector<std::vector<ExamResult>> by_shard(shards.size());
+    for (const auto &result : results)
+    {
+        if (!route(result.user_id))
+        {
+            return false;
+        }
+        ExamResult local = result;
+        local.user_id = static_cast<uint32_t>(local_id(result.user_id));
+        by_shard[shard_of(result.user_id)].push_back(local);
+    }
+
+    bool saved{true};
+    for (std::size_t i{0}; i < shards.size(); ++i)
+    {
+        if (!by_shard[i].empty() && !shards[i]->save_exam_results(by_shard[i]))
+        {
+            last_shard = i;
+            saved = false;
+        }
+    }
+    return saved;
+}
+
+bool ShardedStorage::update_difficulty(uint32_t user_id, uint32_t new_level)
+{
+    PostgresStorage *shard = route(user_id);
+    return shard && shard->update_difficulty(static_cast<uint32_t>(local_id(user_id)), new_level);
+}
+
+bool ShardedStorage::update_score(uint32_t user_id, uint32_t score_delta)
+{
+    PostgresStorage *shard = route(user_id);
+    return shard && shard->update_score(static_cast<uint32_t>(local_id(user_id)), score_delta);
+}
+
+std::optional<std::size_t> ShardedStorage::compact_scores(uint32_t max_events)
+{
+    // шарды независимы; неудача одного не мешает остальным
+    std::optional<std::size_t> total;
+    for (std::size_t i{0}; i < shards.size(); ++i)
+    {
+        if (const auto folded = shards[i]->compact_scores(max_events))
+        {
+            total = total.value_or(0) + *folded;
+        }
+        else
+        {
+            last_shard = i;
+        }
+    }
+    return total;
+}
+
+std::vector<UserProgress> ShardedStorage::get_user_progress(uint32_t user_id) const
+{
+    return route_read(user_id).get_user_progress(static_cast<uint32_t>(local_id(user_id)));
+}
+
+std::vector<ProgressPoint> ShardedStorage::get_progress_buckets(uint32_t user_id, ProgressBucket bucket,
+                                                                uint32_t max_buckets) const
+{
+    return route_read(user_id).get_progress_buckets(static_cast<uint32_t>(local_id(user_id)), bucket, max_buckets);
+}
+
+int32_t ShardedStorage::get_user_difficulty(uint32_t user_id) const
+{
+    return route_read(user_id).get_user_difficulty(static_cast<uint32_t>(local_id(user_id)));
+}
+
+std::vector<uint32_t> ShardedStorage::get_unknown_users(const std::vector<uint32_t> &user_ids) const
+{
+    // id чужого шарда не может принадлежать пользователю - он неизвестен без запроса
+    std::vector<uint32_t> unknown;
+    std::vector<std::vector<uint32_t>> by_shard(shards.size());
+    for (const uint32_t user_id : user_ids)
+    {
+        const std::size_t shard = shard_of(user_id);
+        if (shard < shards.size())
+        {
+            by_shard[shard].push_back(static_cast<uint32_t>(local_id(user_id)));
+        }
+        else
+        {
+            unknown.push_back(user_id);
+        }
+    }
+
+    for (std::size_t i{0}; i < shards.size(); ++i)
+    {
+        if (by_shard[i].empty())
+        {
+            continue;
+        }
+        last_shard = i;
+        for (const uint32_t local : shards[i]->get_unknown_users(by_shard[i]))
+        {
+            unknown.push_back(static_cast<uint32_t>(global_id(local, i)));
+        }
+    }
+    return unknown;
+}
+
+std::optional<UserSchedule> ShardedStorage::get_user_schedule(uint32_t user_id) const
+{
+    auto schedule = route_read(user_id).get_user_schedule(static_cast<uint32_t>(local_id(user_id)));
+    if (schedule)
+    {
+        schedule->user_id = user_id;
+    }
+    return schedule;
+}
+
+bool ShardedStorage::save_user_schedule(const UserSchedule &schedule)
+{
+    PostgresStorage *shard = route(schedule.user_id);
+    if (!shard)
+    {
+        return false;
+    }
+    UserSchedule local = schedule;
+    local.user_id = static_cast<uint32_t>(local_id(schedule.user_id));
+    return shard->save_user_schedule(local);
+}
+
+std::vector<UserSchedule> ShardedStorage::get_due_schedules(int64_t due_from, int64_t due_before,
+                                                           uint32_t limit) const
+{
+    auto parts = scatter([&](PostgresStorage &shard)
+                         { return shard.get_due_schedules(due_from, due_before, limit); });
+
+    std::vector<UserSchedule> merged;
+    for (std::size_t i{0}; i < parts.size(); ++i)
+    {
+        for (auto &schedule : parts[i])
+        {
+            schedule.user_id = static_cast<uint32_t>(global_id(schedule.user_id, i));
+            merged.push_back(schedule);
+        }
+    }
+    const std::size_t keep = std::min<std::size_t>(limit, merged.size());
+    std::partial_sort(merged.begin(), merged.begin() + static_cast<std::ptrdiff_t>(keep), merged.end(),
+                      [](const UserSchedule &a, const UserSchedule &b)
+                      { return a.due_at < b.due_at; });
+    merged.resize(keep);
+    return merged;
+}
+
+std::optional<std::string> ShardedStorage::get_weak_items(uint32_t user_id) const
+{
+    return route_read(user_id).get_weak_items(static_cast<uint32_t>(local_id(user_id)));
+}
+
+bool ShardedStorage::save_weak_items(uint32_t user_id, const std::string &sketch)
+{
+    PostgresStorage *shard = route(user_id);
+    return shard && shard->save_weak_items(static_cast<uint32_t>(local_id(user_id)), sketch);
+}
+
+bool ShardedStorage::save_marathon_result(uint32_t user_id, uint32_t length, uint32_t score, float success_rate,
+                                          uint32_t memorization_ms, uint32_t answer_ms)
+{
+    PostgresStorage *shard = route(user_id);
+    return shard && shard->save_marathon_result(static_cast<uint32_t>(local_id(user_id)), length, score,
+                                                success_rate, memorization_ms, answer_ms);
+}
+
+LeaderboardRows ShardedStorage::get_leaderboard(LeaderboardPeriod period, uint32_t limit,
+                                                const std::string &anchor_date) const
+{
+    return merge_top(scatter([&](PostgresStorage &shard)
+                             { return shard.get_leaderboard(period, limit, anchor_date); }),
+                     limit);
+}
+
+std::optional<std::string> ShardedStorage::get_daily_challenge(const std::string &day, int32_t difficulty) const
+{
+    last_shard = 0;
+    return shards[0]->get_daily_challenge(day, difficulty);
+}
+
+std::optional<std::string> ShardedStorage::create_daily_challenge(const std::string &day, int32_t difficulty,
+                                                                  const std::string &items)
+{
+    error.clear();
+    last_shard = 0;
+    return shards[0]->create_daily_challenge(day, difficulty, items);
+}
+
+bool ShardedStorage::save_daily_challenge_result(const std::string &day, uint32_t user_id, int32_t difficulty,
+                                                 uint32_t score, float success_rate)
+{
+    PostgresStorage *shard = route(user_id);
+    return shard && shard->save_daily_challenge_result(day, static_cast<uint32_t>(local_id(user_id)), difficulty,
+                                                       score, success_rate);
+}
+
+std::optional<DailyChallengeScore> ShardedStorage::get_daily_challenge_score(const std::string &day, uint32_t user_id) const
+{
+    return route_read(user_id).get_daily_challenge_score(day, static_cast<uint32_t>(local_id(user_id)));
+}
+
+LeaderboardRows ShardedStorage::get_daily_leaderboard(const std::string &day, int32_t difficulty,
+                                                      uint32_t limit) const
+{
+    return merge_top(scatter([&](PostgresStorage &shard)
+                             { return shard.get_daily_leaderboard(day, difficulty, limit); }),
+                     limit);
+}
+
+std::size_t ShardedStorage::export_progress(const std::function<void(std::string_view)> &on_row) const
+{
+    // шарды по очереди: on_row не обязан быть потокобезопасным
+    std::size_t rows{0};
+    std::string rewritten;
+    for (std::size_t i{0}; i < shards.size(); ++i)
+    {
+        last_shard = i;
+        rows += shards[i]->export_progress([&](std::string_view row)
+                                           {
+            // первое поле - user_id шарда
+            int64_t local{0};
+            const auto parsed = std::from_chars(row.data(), row.data() + row.size(), local);
+            if (parsed.ec != std::errc{})
+            {
+                on_row(row);
+                return;
+            }
+            rewritten = std::to_string(global_id(local, i));
+            rewritten.append(parsed.ptr, row.data() + row.size());
+            on_row(rewritten); });
+    }
+    return rows;
+}
+
+bool ShardedStorage::move_user(std::size_t from, std::size_t to, int64_t local, const std::string &username)
+{
+    PGconn *source = shards[from]->get_connection();
+    PGconn *target = shards[to]->get_connection();
+    const std::string old_id = std::to_string(local);
+
+    auto fetched = run(source, "SELECT password, difficulty_level, total_score, last_session FROM users WHERE id = $1",
+                       {old_id.c_str()});
+    if (PQresultStatus(fetched.get()) != PGRES_TUPLES_OK || PQntuples(fetched.get()) != 1)
+    {
+        error = "cannot read user " + username + " from shard " + std::to_string(from);
+        return false;
+    }
+    const std::string password = PQgetvalue(fetched.get(), 0, 0);
+
+    // прерванный перенос: копия уже закоммичена в целевой базе, осталось удалить исходную.
+    // Соль делает совпадение хэша у двух разных пользователей невозможным
+    auto existing = run(target, "SELECT 1 FROM users WHERE username = $1 AND password = $2",
+                        {username.c_str(), password.c_str()});
+    const bool copied = PQresultStatus(existing.get()) == PGRES_TUPLES_OK && PQntuples(existing.get()) > 0;
+
+    if (!copied)
+    {
+        if (!command_ok(run(target, "BEGIN")))
+        {
+            error = "shard " + std::to_string(to) + ": " + PQerrorMessage(target);
+            return false;
+        }
+
+        auto inserted = run(target,
+                            "INSERT INTO users (username, password, difficulty_level, total_score, last_session) "
+                            "VALUES ($1, $2, $3, $4, $5) RETURNING id",
+                            {username.c_str(), password.c_str(), PQgetvalue(fetched.get(), 0, 1),
+                             PQgetvalue(fetched.get(), 0, 2), PQgetvalue(fetched.get(), 0, 3)});
+        bool ok = PQresultStatus(inserted.get()) == PGRES_TUPLES_OK && PQntuples(inserted.get()) == 1;
+        const std::string new_id = ok ? PQgetvalue(inserted.get(), 0, 0) : "";
+        if (ok && std::atoll(new_id.c_str()) > MAX_LOCAL_USER_ID)
+        {
+            error = "moving " + username + " to shard " + std::to_string(to) + ": the shard has no user ids left";
+            run(target, "ROLLBACK");
+            return false;
+        }
+
+        // id прогресса в целевой базе новые: соответствие старых и новых - во временной таблице
+        const auto step = [&](const std::string &sql)
+        {
+            ok = ok && command_ok(run(target, sql));
+        };
+        const auto copy = [&](const std::string &out, const std::string &in)
+        {
+            ok = ok && pipe_copy(source, "COPY (" + out + ") TO STDOUT", target, "COPY " + in + " FROM STDIN");
+        };
+        step("CREATE TEMP TABLE move_progress (old_id INTEGER, sequence_length INTEGER, success_rate DOUBLE PRECISION, "
+             "training_date TIMESTAMP, memorization_ms INTEGER, answer_ms INTEGER, difficulty INTEGER) ON COMMIT DROP");
+        step("CREATE TEMP TABLE move_items (progress_id INTEGER, position SMALLINT, kind SMALLINT, correct BOOLEAN) "
+             "ON COMMIT DROP");
+        copy("SELECT id, sequence_length, success_rate, training_date, memorization_ms, answer_ms, difficulty "
+             "FROM user_progress WHERE user_id = " + old_id,
+             "move_progress");
+        copy("SELECT i.progress_id, i.position, i.kind, i.correct FROM user_progress_items i "
+             "JOIN user_progress p ON p.id = i.progress_id WHERE p.user_id = " + old_id,
+             "move_items");
+        step("CREATE TEMP TABLE move_ids ON COMMIT DROP AS SELECT old_id, "
+             "nextval(pg_get_serial_sequence('user_progress', 'id'))::INTEGER AS new_id FROM move_progress");
+        step("INSERT INTO user_progress (id, user_id, sequence_length, success_rate, training_date, memorization_ms, "
+             "answer_ms, difficulty) SELECT m.new_id, " + new_id + ", p.sequence_length, p.success_rate, "
+             "p.training_date, p.memorization_ms, p.answer_ms, p.difficulty "
+             "FROM move_progress p JOIN move_ids m USING (old_id)");
+        step("INSERT INTO user_progress_items (progress_id, position, kind, correct) "
+             "SELECT m.new_id, i.position, i.kind, i.correct FROM move_items i "
+             "JOIN move_ids m ON m.old_id = i.progress_id");
+
+        // остальные таблицы: новый id подставляется прямо в запрос COPY источника
+        copy("SELECT " + new_id + ", sequence_id, correct, total, success_rate, graded_at "
+             "FROM exam_results WHERE user_id = " + old_id,
+             "exam_results (user_id, sequence_id, correct, total, success_rate, graded_at)");
+        copy("SELECT " + new_id + ", day, score FROM user_score_daily WHERE user_id = " + old_id,
+             "user_score_daily (user_id, day, score)");
+        copy("SELECT " + new_id + ", day, delta FROM score_events WHERE user_id = " + old_id,
+             "score_events (user_id, day, delta)");
+        copy("SELECT " + new_id + ", ease_factor, repetitions, interval_seconds, next_length, due_at "
+             "FROM user_schedule WHERE user_id = " + old_id,
+             "user_schedule (user_id, ease_factor, repetitions, interval_seconds, next_length, due_at)");
+        copy("SELECT " + new_id + ", sketch, updated_at FROM user_weak_items WHERE user_id = " + old_id,
+             "user_weak_items (user_id, sketch, updated_at)");
+        copy("SELECT day, " + new_id + ", difficulty, score, success_rate, completed_at "
+             "FROM daily_challenge_results WHERE user_id = " + old_id,
+             "daily_challenge_results (day, user_id, difficulty, score, success_rate, completed_at)");
+        copy("SELECT " + new_id + ", length, score, success_rate, memorization_ms, answer_ms, played_at "
+             "FROM marathon_results WHERE user_id = " + old_id,
+             "marathon_results (user_id, length, score, success_rate, memorization_ms, answer_ms, played_at)");
+
+        if (!ok)
+        {
+            error = "moving " + username + " to shard " + std::to_string(to) + ": " + PQerrorMessage(target) +
+                    PQerrorMessage(source);
+            run(target, "ROLLBACK");
+            return false;
+        }
+        if (!command_ok(run(target, "COMMIT")))
+        {
+            error = "shard " + std::to_string(to) + ": " + PQerrorMessage(target);
+            return false;
+        }
+    }
+
+    // остальные строки пользователя удаляются каскадом
+    if (!command_ok(run(source, "DELETE FROM users WHERE id = $1", {old_id.c_str()})))
+    {
+        error = "copied " + username + " to shard " + std::to_string(to) + " but could not delete it from shard " +
+                std::to_string(from) + ": " + PQerrorMessage(source);
+        return false;
+    }
+    return true;
+}
+
+ShardedStorage::RebalanceReport ShardedStorage::rebalance(bool dry_run,
+                                                          const std::function<void(std::string_view)> &on_user)
+{
+    constexpr const char *PAGE_SQL = "SELECT id, username FROM users WHERE id > $1 ORDER BY id LIMIT 1000";
+
+    RebalanceReport report;
+    for (std::size_t from{0}; from < shards.size(); ++from)
+    {
+        PGconn *connection = shards[from]->get_connection();
+        std::string after = "0";
+        while (true)
+        {
+            auto page = run(connection, PAGE_SQL, {after.c_str()});
+            if (PQresultStatus(page.get()) != PGRES_TUPLES_OK)
+            {
+                throw std::runtime_error("shard " + std::to_string(from) + ": " + PQerrorMessage(connection));
+            }
+            const int rows = PQntuples(page.get());
+            if (rows == 0)
+            {
+                break;
+            }
+
+            for (int row{0}; row < rows; ++row)
+            {
+                const int64_t local = std::atoll(PQgetvalue(page.get(), row, 0));
+                const std::string username = PQgetvalue(page.get(), row, 1);
+                ++report.scanned;
+
+                const std::size_t to = home_shard(username);
+                if (to == from)
+                {
+                    continue;
+                }
+                on_user(username + ": shard " + std::to_string(from) + " -> " + std::to_string(to));
+                if (dry_run)
+                {
+                    ++report.moved;
+                }
+                else if (move_user(from, to, local, username))
+                {
+                    ++report.moved;
+                    users_moved.increment();
+                }
+                else
+                {
+                    ++report.failed;
+                    move_failures.increment();
+                    on_user("  failed: " + error);
+                }
+            }
+            after = PQgetvalue(page.get(), rows - 1, 0);
+        }
+    }
+    return report;
+}
+
+int ShardedStorage::run_cli(int argc, char **argv)
+{
+    bool dry_run{false};
+    for (int i{2}; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        if (arg == "--dry-run")
+            dry_run = true;
+        else
+        {
+            print_usage();
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+
+    try
+    {
+        auto shards = shards_from_config(ConfigFile("config.ini"));
+        if (shards.empty())
+        {
+            std::cerr << "No [shards] databases= in config.ini\n";
+            return 1;
+        }
+        ShardedStorage storage(std::move(shards));
+        if (!storage.connect())
+        {
+            std::cerr << "Failed to connect to all shards: " << storage.last_error() << "\n";
+            return 1;
+        }
+
+        const auto report = storage.rebalance(dry_run, [](std::string_view line)
+                                              { std::cout << line << "\n"; });
+        std::cout << (dry_run ? "Would move " : "Moved ") << report.moved << " of " << report.scanned << " users";
+        if (report.failed)
+        {
+            std::cout << ", " << report.failed << " failed (run again to retry)";
+        }
+        std::cout << "\n";
+        return report.failed ? 1 : 0;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,228 @@
+#include "../include/SharedLeaderboard.hpp"
+
+#include <iostream>
+#include <thread>
+#include <charconv>
+#include <cstring>
+#include <algorithm>
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr uint32_t LAYOUT_VERSION = 2;
+    constexpr uint32_t READ_ATTEMPTS = 64;
+
+    int64_t unix_now_ms() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+
+    uint32_t process_id() noexcept
+    {
+#ifdef _WIN32
+        return static_cast<uint32_t>(GetCurrentProcessId());
+#else
+        return static_cast<uint32_t>(getpid());
+#endif
+    }
+}
+
+SharedLeaderboard::SharedLeaderboard(const std::string &name, std::chrono::seconds max_age)
+    : max_age(max_age)
+{
+    void *address = nullptr;
+#ifdef _WIN32
+    // "Local\" - пространство имён сеанса; имя без ведущего '/'
+    const std::string object_name = "Local\\" + (name.starts_with('/') ? name.substr(1) : name);
+    mapping_handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0,
+                                        static_cast<DWORD>(sizeof(Segment)), object_name.c_str());
+    if (mapping_handle)
+    {
+        address = MapViewOfFile(mapping_handle, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(Segment));
+    }
+#else
+    const int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0660);
+    if (fd >= 0)
+    {
+        // новый объект нулевой длины; ftruncate до того же размера в другом процессе безвреден
+        struct stat info{};
+        if (fstat(fd, &info) == 0 &&
+            (info.st_size >= static_cast<off_t>(sizeof(Segment)) || ftruncate(fd, sizeof(Segment)) == 0))
+        {
+            address = mmap(nullptr, sizeof(Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (address == MAP_FAILED)
+            {
+                address = nullptr;
+            }
+        }
+        close(fd);
+    }
+#endif
+    if (!address)
+    {
+        std::cerr << "Shared leaderboard " << name << " is unavailable, using the database\n";
+        return;
+    }
+
+    // атомики в нулевой памяти уже в корректном состоянии, конструкторы не вызываются
+    segment = std::launder(static_cast<Segment *>(address));
+    uint32_t layout{0};
+    if (!segment->layout.compare_exchange_strong(layout, LAYOUT_VERSION) && layout != LAYOUT_VERSION)
+    {
+        std::cerr << "Shared leaderboard " << name << " has an incompatible layout, using the database\n";
+#ifdef _WIN32
+        UnmapViewOfFile(segment);
+#else
+        munmap(segment, sizeof(Segment));
+#endif
+        segment = nullptr;
+    }
+}
+
+SharedLeaderboard::~SharedLeaderboard()
+{
+    // сегмент не удаляется: им пользуются другие процессы, данные восстановит следующий писатель
+#ifdef _WIN32
+    if (segment)
+    {
+        UnmapViewOfFile(segment);
+    }
+    if (mapping_handle)
+    {
+        CloseHandle(mapping_handle);
+    }
+#else
+    if (segment)
+    {
+        munmap(segment, sizeof(Segment));
+    }
+#endif
+}
+
+std::optional<LeaderboardRows> SharedLeaderboard::read(Board board, int64_t day, bool allow_stale) const
+{
+    if (!segment)
+    {
+        return std::nullopt;
+    }
+
+    BoardSlot slot;
+    for (uint32_t attempt{0}; attempt < READ_ATTEMPTS; ++attempt)
+    {
+        const uint32_t before = segment->sequence.load(std::memory_order_acquire);
+        if (before & 1u)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        // копия может быть рваной; она используется, только если sequence не изменился
+        const int64_t segment_day = segment->day;
+        const int64_t refreshed_at_ms = segment->refreshed_at_ms;
+        std::memcpy(&slot, &segment->boards[static_cast<std::size_t>(board)], sizeof(slot));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (segment->sequence.load(std::memory_order_relaxed) != before)
+        {
+            continue;
+        }
+
+        const bool fresh = unix_now_ms() - refreshed_at_ms <
+                           std::chrono::duration_cast<std::chrono::milliseconds>(max_age).count();
+        if (refreshed_at_ms == 0 || segment_day != day || (!fresh && !allow_stale))
+        {
+            return std::nullopt;
+        }
+
+        LeaderboardRows rows;
+        rows.reserve(slot.count);
+        for (uint32_t i{0}; i < slot.count && i < TOP_N; ++i)
+        {
+            const Entry &entry = slot.entries[i];
+            rows.emplace_back(std::string(entry.username, strnlen(entry.username, NAME_BYTES)),
+                              std::to_string(entry.score));
+        }
+        return rows;
+    }
+    return std::nullopt;
+}
+
+bool SharedLeaderboard::try_acquire_refresh()
+{
+    if (!segment)
+    {
+        return false;
+    }
+
+    const uint64_t now_seconds = static_cast<uint64_t>(unix_now_ms() / 1000);
+    const uint64_t pid = process_id();
+    const uint64_t lease = ((now_seconds + static_cast<uint64_t>(max_age.count())) << 32) | pid;
+
+    uint64_t current = segment->lease.load(std::memory_order_relaxed);
+    const bool own = (current & 0xFFFFFFFFu) == pid;
+    const bool expired = (current >> 32) <= now_seconds;
+    if (!own && !expired)
+    {
+        return false;
+    }
+    if (!segment->lease.compare_exchange_strong(current, lease, std::memory_order_acq_rel))
+    {
+        return false;
+    }
+
+    // прежний владелец умер посреди записи: sequence остался нечётным навсегда
+    uint32_t sequence = segment->sequence.load(std::memory_order_relaxed);
+    if (!own && (sequence & 1u))
+    {
+        segment->sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_release);
+    }
+    return true;
+}
+
+bool SharedLeaderboard::publish(int64_t day, const Snapshot &boards)
+{
+    if (!segment)
+    {
+        return false;
+    }
+
+    uint32_t sequence = segment->sequence.load(std::memory_order_relaxed);
+    if ((sequence & 1u) ||
+        !segment->sequence.compare_exchange_strong(sequence, sequence + 1, std::memory_order_relaxed))
+    {
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+
+    for (std::size_t board{0}; board < BOARD_COUNT; ++board)
+    {
+        BoardSlot &slot = segment->boards[board];
+        const LeaderboardRows &rows = boards[board];
+        slot.count = static_cast<uint32_t>(std::min(rows.size(), TOP_N));
+        for (uint32_t i{0}; i < slot.count; ++i)
+        {
+            Entry &entry = slot.entries[i];
+            std::memset(entry.username, 0, NAME_BYTES);
+            std::memcpy(entry.username, rows[i].first.data(), std::min(rows[i].first.size(), NAME_BYTES - 1));
+            entry.score = 0;
+            const std::string &score = rows[i].second;
+            std::from_chars(score.data(), score.data() + score.size(), entry.score);
+        }
+    }
+    segment->day = day;
+    segment->refreshed_at_ms = unix_now_ms();
+
+    segment->sequence.store(sequence + 2, std::memory_order_release);
+    return true;
+}
@@ -1,35 +1,223 @@
 #include "../include/TaskGenerator.hpp"
 #include "../include/RandomGenerators.hpp"
+#include "../include/Metrics.hpp"
+#include "../include/Tracing.hpp"
+#include "../include/WeightedSampling.hpp"
+#include "../include/WeakItemSketch.hpp"
 
 #include <random>
 #include <algorithm>
+#include <iterator>
+#include <thread>
+#include <type_traits>
+#include <utility>
 
 namespace
 {
-    // генератор случайных чисел
+    LatencyHistogram generate_latency("mem_trainer_generate_sequence_duration_seconds",
+                                      "Time spent in TaskGenerator::generate_sequence");
+    LatencyHistogram batch_latency("mem_trainer_generate_batch_duration_seconds",
+                                   "Time spent in TaskGenerator::generate_batch");
+
+    static_assert(std::is_trivially_destructible_v<TaskGenerator::TaskItemView>,
+                  "TaskBatch releases its arena without running destructors");
+
+    // генератор случайных чисел: один 64-битный вызов на элемент
     auto &get_generator()
     {
-        static std::random_device rd;
-        static std::mt19937 gen(rd());
+        thread_local std::mt19937_64 gen(std::random_device{}());
         return gen;
     }
 
-    // выбор случайного типа числа
-    TaskGenerator::TaskItem generate_random_number()
+    using WeightedSampling::AliasTable;
+    using WeightedSampling::build_alias_table;
+    using WeightedSampling::sample;
+
+    struct CompiledProfile
+    {
+        AliasTable<TaskGenerator::MAX_LAYOUTS> layouts;
+        std::array<AliasTable<TaskGenerator::ITEM_KIND_COUNT>, TaskGenerator::MAX_LAYOUTS> items;
+    };
+
+    constexpr CompiledProfile compile_profile(const TaskGenerator::DifficultyProfile &profile)
+    {
+        std::array<double, TaskGenerator::MAX_LAYOUTS> layout_weights{};
+        CompiledProfile compiled{};
+        for (std::size_t i{0}; i < TaskGenerator::MAX_LAYOUTS; ++i)
+        {
+            layout_weights[i] = profile.layouts[i].weight;
+            compiled.items[i] = build_alias_table(profile.layouts[i].item_weights);
+        }
+        compiled.layouts = build_alias_table(layout_weights);
+        return compiled;
+    }
+
+    template <TaskGenerator::Difficulty Level>
+    struct ProfileTables
+    {
+        static constexpr CompiledProfile tables =
+            compile_profile(TaskGenerator::PROFILES[static_cast<std::size_t>(Level)]);
+    };
+
+    template <typename Item>
+    using ItemFactory = Item (*)();
+
+    // порядок совпадает с TaskGenerator::ItemKind
+    template <typename Item>
+    constexpr std::array<ItemFactory<Item>, TaskGenerator::ITEM_KIND_COUNT> ITEM_FACTORIES = {
+        []
+        { return Item{NumberGenerator::generate_uint16()}; },
+        []
+        { return Item{NumberGenerator::generate_uint32()}; },
+        []
+        { return Item{NumberGenerator::generate_float()}; },
+        []
+        { return Item{SymbolGenerator::generate_char()}; },
+        []
+        {
+            if constexpr (std::is_same_v<Item, TaskGenerator::TaskItemView>)
+                return Item{WordGenerator::generate_word_view()};
+            else
+                return Item{WordGenerator::generate_word()};
+        }};
+
+    using SeededItemFactory = TaskGenerator::TaskItem (*)(RandomEngine &);
+
+    constexpr std::array<SeededItemFactory, TaskGenerator::ITEM_KIND_COUNT> SEEDED_ITEM_FACTORIES = {
+        [](RandomEngine &engine)
+        { return TaskGenerator::TaskItem{NumberGenerator::generate_uint16(engine)}; },
+        [](RandomEngine &engine)
+        { return TaskGenerator::TaskItem{NumberGenerator::generate_uint32(engine)}; },
+        [](RandomEngine &engine)
+        { return TaskGenerator::TaskItem{NumberGenerator::generate_float(engine)}; },
+        [](RandomEngine &engine)
+        { return TaskGenerator::TaskItem{SymbolGenerator::generate_char(engine)}; },
+        [](RandomEngine &engine)
+        { return TaskGenerator::TaskItem{std::string(WordGenerator::generate_word_view(engine))}; }};
+
+    // слова и символы - с весами слабых элементов пользователя, остальные типы как обычно
+    TaskGenerator::TaskItemView biased_view(std::size_t kind, const WeakItemBias &bias, RandomEngine &gen)
     {
-        static std::uniform_int_distribution<uint32_t> dist(0, 2);
-        switch (dist(get_generator()))
+        switch (static_cast<TaskGenerator::ItemKind>(kind))
         {
-        case 0:
-            return NumberGenerator::generate_uint16();
-        case 1:
-            return NumberGenerator::generate_uint32();
-        case 2:
-            return NumberGenerator::generate_float();
+        case TaskGenerator::ItemKind::WORD:
+            return bias.word(gen());
+        case TaskGenerator::ItemKind::SYMBOL:
+            return bias.symbol(gen());
         default:
-            return NumberGenerator::generate_uint16(); // никогда не случится
+            return ITEM_FACTORIES<TaskGenerator::TaskItemView>[kind]();
+        }
+    }
+
+    template <TaskGenerator::Difficulty Level, typename Item, typename Output>
+    void fill_sequence(Output out, std::size_t length, const WeakItemBias *bias)
+    {
+        constexpr const CompiledProfile &profile = ProfileTables<Level>::tables;
+        auto &gen = get_generator();
+
+        // одна выборка на раскладку и по одной на каждый элемент
+        const auto &items = profile.items[sample(profile.layouts, gen())];
+        for (std::size_t i{0}; i < length; ++i)
+        {
+            const std::size_t kind = sample(items, gen());
+            if (!bias)
+            {
+                *out++ = ITEM_FACTORIES<Item>[kind]();
+            }
+            else if constexpr (std::is_same_v<Item, TaskGenerator::TaskItemView>)
+            {
+                *out++ = biased_view(kind, *bias, gen);
+            }
+            else
+            {
+                *out++ = TaskGenerator::to_item(biased_view(kind, *bias, gen));
+            }
+        }
+    }
+
+    template <TaskGenerator::Difficulty Level>
+    std::vector<TaskGenerator::TaskItem> generate_for(std::size_t length, const WeakItemBias *bias)
+    {
+        std::vector<TaskGenerator::TaskItem> result;
+        result.reserve(length);
+        fill_sequence<Level, TaskGenerator::TaskItem>(std::back_inserter(result), length, bias);
+        return result;
+    }
+
+    template <TaskGenerator::Difficulty Level>
+    std::vector<TaskGenerator::TaskItem> generate_seeded_for(std::size_t length, uint64_t seed)
+    {
+        constexpr const CompiledProfile &profile = ProfileTables<Level>::tables;
+        RandomEngine engine(seed);
+
+        std::vector<TaskGenerator::TaskItem> result;
+        result.reserve(length);
+        const auto &items = profile.items[sample(profile.layouts, engine())];
+        for (std::size_t i{0}; i < length; ++i)
+        {
+            result.push_back(SEEDED_ITEM_FACTORIES[sample(items, engine())](engine));
+        }
+        return result;
+    }
+
+    template <TaskGenerator::Difficulty Level>
+    void fill_views(TaskGenerator::TaskItemView *out, std::size_t length, const WeakItemBias *bias)
+    {
+        fill_sequence<Level, TaskGenerator::TaskItemView>(out, length, bias);
+    }
+
+    // bias принадлежит корутине: поток может пережить TaskGenerator
+    template <TaskGenerator::Difficulty Level>
+    Generator<TaskGenerator::TaskItemView> stream_for(std::shared_ptr<const WeakItemBias> bias)
+    {
+        constexpr const CompiledProfile &profile = ProfileTables<Level>::tables;
+
+        const auto &items = profile.items[sample(profile.layouts, get_generator()())];
+        while (true)
+        {
+            // генератор берётся заново после каждой приостановки: thread_local того потока, где идёт next()
+            auto &gen = get_generator();
+            const std::size_t kind = sample(items, gen());
+            co_yield bias ? biased_view(kind, *bias, gen) : ITEM_FACTORIES<TaskGenerator::TaskItemView>[kind]();
         }
     }
+
+    using SequenceFactory = std::vector<TaskGenerator::TaskItem> (*)(std::size_t, const WeakItemBias *);
+    using SeededSequenceFactory = std::vector<TaskGenerator::TaskItem> (*)(std::size_t, uint64_t);
+    using ViewFiller = void (*)(TaskGenerator::TaskItemView *, std::size_t, const WeakItemBias *);
+    using StreamFactory = Generator<TaskGenerator::TaskItemView> (*)(std::shared_ptr<const WeakItemBias>);
+
+    template <std::size_t... Levels>
+    constexpr std::array<SequenceFactory, sizeof...(Levels)> make_generators(std::index_sequence<Levels...>)
+    {
+        return {&generate_for<static_cast<TaskGenerator::Difficulty>(Levels)>...};
+    }
+
+    template <std::size_t... Levels>
+    constexpr std::array<SeededSequenceFactory, sizeof...(Levels)> make_seeded_generators(std::index_sequence<Levels...>)
+    {
+        return {&generate_seeded_for<static_cast<TaskGenerator::Difficulty>(Levels)>...};
+    }
+
+    template <std::size_t... Levels>
+    constexpr std::array<ViewFiller, sizeof...(Levels)> make_view_fillers(std::index_sequence<Levels...>)
+    {
+        return {&fill_views<static_cast<TaskGenerator::Difficulty>(Levels)>...};
+    }
+
+    template <std::size_t... Levels>
+    constexpr std::array<StreamFactory, sizeof...(Levels)> make_streams(std::index_sequence<Levels...>)
+    {
+        return {&stream_for<static_cast<TaskGenerator::Difficulty>(Levels)>...};
+    }
+
+    constexpr auto GENERATORS = make_generators(std::make_index_sequence<TaskGenerator::DIFFICULTY_COUNT>{});
+    constexpr auto SEEDED_GENERATORS = make_seeded_generators(std::make_index_sequence<TaskGenerator::DIFFICULTY_COUNT>{});
+    constexpr auto VIEW_FILLERS = make_view_fillers(std::make_index_sequence<TaskGenerator::DIFFICULTY_COUNT>{});
+    constexpr auto STREAMS = make_streams(std::make_index_sequence<TaskGenerator::DIFFICULTY_COUNT>{});
+
+    // меньше этого числа последовательностей на поток запуск потока не окупается
+    constexpr std::size_t MIN_SEQUENCES_PER_THREAD = 256;
 }
 
 TaskGenerator::TaskGenerator(Difficulty initial_difficulty)
@@ -40,114 +228,136 @@ void TaskGenerator::set_difficulty(Difficulty new_difficulty)
     current_difficulty = new_difficulty;
 }
 
+void TaskGenerator::set_weak_items(std::shared_ptr<const WeakItemBias> bias)
+{
+    weak_items = std::move(bias);
+}
+
 std::vector<TaskGenerator::TaskItem> TaskGenerator::generate_sequence(std::size_t length)
 {
+    ScopedLatency timer(generate_latency);
+    const TraceSpan span("generate_sequence", "generator");
     const auto params = get_params_for_difficulty(current_difficulty);
     length = std::clamp(length, params.min_length, params.max_length);
 
-    auto &gen = get_generator();
-    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    return GENERATORS[static_cast<std::size_t>(current_difficulty)](length, weak_items.get());
+}
 
-    if (current_difficulty == Difficulty::EASY)
-    {
-        if (params.mixed_types && dist(gen) > 0.5f)
-        {
-            std::vector<TaskItem> result;
-            result.reserve(length);
+std::pmr::vector<TaskGenerator::TaskItemView> TaskGenerator::generate_sequence(
+    std::size_t length, std::pmr::memory_resource *resource) const
+{
+    ScopedLatency timer(generate_latency);
+    const TraceSpan span("generate_sequence", "generator");
+    const auto params = get_params_for_difficulty(current_difficulty);
+    length = std::clamp(length, params.min_length, params.max_length);
 
-            for (std::size_t i{0}; i < length; ++i)
-            {
-                const float choice = dist(gen);
-                if (choice < 0.4f)
-                {
-                    result.push_back(::generate_random_number());
-                }
-                else if (choice < 0.7f)
-                {
-                    result.push_back(TaskItem{SymbolGenerator::generate_char()});
-                }
-                else
-                {
-                    result.push_back(TaskItem{WordGenerator::generate_word()});
-                }
-            }
-            return result;
-        }
+    std::pmr::vector<TaskItemView> result(length, resource);
+    VIEW_FILLERS[static_cast<std::size_t>(current_difficulty)](result.data(), length, weak_items.get());
+    return result;
+}
 
-        if (dist(gen) < params.float_probability)
-        {
-            return generate_number_sequence(length);
-        }
-        return (dist(gen) < 0.6f) ? generate_symbol_sequence(length)
-                                  : generate_word_sequence(length);
+std::vector<TaskGenerator::TaskItem> TaskGenerator::generate_sequence(std::size_t length, uint64_t seed) const
+{
+    ScopedLatency timer(generate_latency);
+    const TraceSpan span("generate_sequence", "generator");
+    const auto params = get_params_for_difficulty(current_difficulty);
+    length = std::clamp(length, params.min_length, params.max_length);
+
+    return SEEDED_GENERATORS[static_cast<std::size_t>(current_difficulty)](length, seed);
+}
+
+Generator<TaskGenerator::TaskItemView> TaskGenerator::stream() const
+{
+    return STREAMS[static_cast<std::size_t>(current_difficulty)](weak_items);
+}
+
+TaskBatch TaskGenerator::generate_batch(std::size_t count, std::size_t length, BatchMode mode) const
+{
+    ScopedLatency timer(batch_latency);
+    const TraceSpan span("generate_batch", "generator");
+    const auto params = get_params_for_difficulty(current_difficulty);
+    length = std::clamp(length, params.min_length, params.max_length);
+
+    TaskBatch batch(count, length);
+    const ViewFiller fill = VIEW_FILLERS[static_cast<std::size_t>(current_difficulty)];
+
+    std::size_t workers{1};
+    if (mode == BatchMode::PARALLEL)
+    {
+        workers = std::clamp<std::size_t>(count / MIN_SEQUENCES_PER_THREAD, 1,
+                                          std::max(1u, std::thread::hardware_concurrency()));
     }
-    else
+
+    // каждый поток пишет в свой непрерывный диапазон и использует свой thread_local генератор
+    // bias только читается: таблицы общие для всех потоков
+    auto fill_range = [&batch, fill, length, bias = weak_items.get()](std::size_t begin, std::size_t end)
     {
-        if (params.mixed_types && dist(gen) > 0.5f)
+        for (std::size_t i{begin}; i < end; ++i)
         {
-            std::vector<TaskItem> result;
-            result.reserve(length);
-
-            for (std::size_t i{0}; i < length; ++i)
-            {
-                const float choice = dist(gen);
-                if (choice < 0.5f)
-                {
-                    result.push_back(::generate_random_number());
-                }
-                else
-                {
-                    result.push_back(TaskItem{WordGenerator::generate_word()});
-                }
-            }
-            return result;
+            fill(batch.items + i * length, length, bias);
         }
+    };
 
-        if (dist(gen) < params.float_probability)
-        {
-            return generate_number_sequence(length);
-        }
-        return generate_word_sequence(length);
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    const std::size_t chunk = (count + workers - 1) / workers;
+    for (std::size_t worker{1}; worker < workers; ++worker)
+    {
+        const std::size_t begin = std::min(count, worker * chunk);
+        const std::size_t end = std::min(count, begin + chunk);
+        threads.emplace_back(fill_range, begin, end);
     }
+    fill_range(0, std::min(count, chunk));
+
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+    return batch;
 }
 
-std::vector<TaskGenerator::TaskItem> TaskGenerator::generate_number_sequence(std::size_t length) const // принимает количество чисел для генерации
+TaskGenerator::TaskItem TaskGenerator::to_item(const TaskItemView &view)
 {
-    std::vector<TaskItem> result;
-    result.reserve(length);
-    std::generate_n(std::back_inserter(result), length, generate_random_number);
-    return result;
+    return std::visit([](const auto &value) -> TaskItem
+                      {
+        using T = std::decay_t<decltype(value)>;
+        if constexpr (std::is_same_v<T, std::string_view>)
+            return std::string(value);
+        else
+            return value; }, view);
 }
 
-std::vector<TaskGenerator::TaskItem> TaskGenerator::generate_symbol_sequence(std::size_t length) const // принимает количество символов для генерации
+TaskGenerator::TaskItemView TaskGenerator::to_view(const TaskItem &item) noexcept
 {
-    std::vector<TaskItem> result;
-    result.reserve(length);
-    std::generate_n(std::back_inserter(result), length,
-                    []
-                    { return SymbolGenerator::generate_char(); });
-    return result;
+    return std::visit([](const auto &value) -> TaskItemView
+                      { return value; }, item);
 }
 
-std::vector<TaskGenerator::TaskItem> TaskGenerator::generate_word_sequence(std::size_t length) const // принимает количество слов для генерации
+TaskBatch::TaskBatch(std::size_t count, std::size_t length)
+    : arena(std::make_unique<std::pmr::monotonic_buffer_resource>()),
+      count(count),
+      length(length)
 {
-    std::vector<TaskItem> result;
-    result.reserve(length);
-    std::generate_n(std::back_inserter(result), length,
-                    []
-                    { return WordGenerator::generate_word(); });
-    return result;
+    std::pmr::polymorphic_allocator<TaskGenerator::TaskItemView> allocator(arena.get());
+    items = allocator.allocate(count * length);
+    std::uninitialized_default_construct_n(items, count * length);
+}
+
+void TaskBatch::release() noexcept
+{
+    // элементы тривиально разрушаемы, поэтому достаточно отдать арену целиком
+    if (arena)
+    {
+        arena->release();
+    }
+    items = nullptr;
+    count = 0;
+    length = 0;
 }
 
 TaskGenerator::DifficultyParams TaskGenerator::get_params_for_difficulty(
     Difficulty level) noexcept
 {
-    static constexpr DifficultyParams params[] = {
-        // EASY
-        {3, 4, 0.2f, true},
-        // MEDIUM
-        {5, 6, 0.3f, false},
-        // HARD
-        {6, 8, 0.3f, false}};
-    return params[static_cast<uint32_t>(level)];
+    const auto &profile = PROFILES[static_cast<std::size_t>(level)];
+    return {profile.min_length, profile.max_length};
 }
@@ -0,0 +1,307 @@
+#include "../include/Tracing.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <sstream>
+#include <iomanip>
+#include <fstream>
+#include <filesystem>
+#include <system_error>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace
+{
+    struct TraceEvent
+    {
+        const char *name;
+        const char *category;
+        int64_t begin_ns; // от начала трассировки
+        int64_t duration_ns;
+        uint16_t lane;
+    };
+
+    // кольцо одного потока; мьютекс берёт только писатель-владелец и render_json,
+    // поэтому он практически всегда свободен
+    struct ThreadBuffer
+    {
+        std::mutex mutex;
+        std::vector<TraceEvent> events;
+        uint64_t written{0};
+        uint32_t tid{0};
+        const char *thread_name{nullptr};
+    };
+
+    // буферы завершившихся потоков остаются здесь до записи трассы
+    struct TracerState
+    {
+        std::mutex mutex;
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        // кольца завершившихся потоков, ждущие нового владельца
+        std::vector<std::shared_ptr<ThreadBuffer>> free_buffers;
+        std::size_t capacity{Tracer::DEFAULT_EVENTS_PER_THREAD};
+        std::chrono::steady_clock::time_point origin{};
+        std::string file;
+        uint32_t next_tid{1};
+    };
+
+    TracerState &tracer_state()
+    {
+        static TracerState state;
+        return state;
+    }
+
+    thread_local uint16_t current_lane{0};
+
+    // кольцо живёт, пока жив поток, затем возвращается в free_buffers и достаётся следующему
+    // потоку вместе со своим tid и уже записанными событиями. Короткие потоки (std::async в
+    // ShardedStorage::scatter) так переиспользуют одни и те же кольца, а не заводят новое на каждый запрос
+    struct BufferHandle
+    {
+        std::shared_ptr<ThreadBuffer> buffer;
+
+        BufferHandle()
+        {
+            auto &state = tracer_state();
+            std::lock_guard lock(state.mutex);
+            if (!state.free_buffers.empty())
+            {
+                buffer = std::move(state.free_buffers.back());
+                state.free_buffers.pop_back();
+                std::lock_guard buffer_lock(buffer->mutex);
+                buffer->thread_name = nullptr;
+                return;
+            }
+            buffer = std::make_shared<ThreadBuffer>();
+            buffer->events.resize(state.capacity);
+            buffer->tid = state.next_tid++;
+            state.buffers.push_back(buffer);
+        }
+
+        ~BufferHandle()
+        {
+            auto &state = tracer_state();
+            std::lock_guard lock(state.mutex);
+            state.free_buffers.push_back(std::move(buffer));
+        }
+
+        BufferHandle(const BufferHandle &) = delete;
+        BufferHandle &operator=(const BufferHandle &) = delete;
+    };
+
+    ThreadBuffer &local_buffer()
+    {
+        thread_local BufferHandle handle;
+        return *handle.buffer;
+    }
+
+    // имена - литералы из кода, поэтому достаточно экранировать кавычку и обратную косую черту
+    void write_json_text(std::ostream &out, const char *value)
+    {
+        for (const char *c = value; *c; ++c)
+        {
+            if (*c == '"' || *c == '\\')
+            {
+                out << '\\';
+            }
+            out << *c;
+        }
+    }
+
+    void write_json_string(std::ostream &out, const char *value)
+    {
+        out << '"';
+        write_json_text(out, value);
+        out << '"';
+    }
+
+    // Chrome trace считает время в микросекундах; дробная часть сохраняет наносекунды
+    void write_microseconds(std::ostream &out, int64_t nanoseconds)
+    {
+        out << nanoseconds / 1000 << '.' << std::setw(3) << std::setfill('0') << nanoseconds % 1000;
+    }
+}
+
+Tracer &Tracer::instance()
+{
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::start(const std::string &file, std::size_t events_per_thread)
+{
+    auto &state = tracer_state();
+    std::lock_guard lock(state.mutex);
+    if (active.load(std::memory_order_relaxed))
+    {
+        return;
+    }
+    // размер кольца задаётся до первого спана: буферы создаются при первой записи потока
+    if (state.buffers.empty())
+    {
+        state.capacity = std::max<std::size_t>(events_per_thread, 1);
+    }
+    state.file = file;
+    state.origin = std::chrono::steady_clock::now();
+    // release: поток, увидевший флаг в record(), видит и origin
+    active.store(true, std::memory_order_release);
+}
+
+bool Tracer::stop()
+{
+    std::string file;
+    {
+        auto &state = tracer_state();
+        std::lock_guard lock(state.mutex);
+        if (!active.exchange(false, std::memory_order_relaxed))
+        {
+            return false;
+        }
+        file = state.file;
+    }
+
+    const std::string tmp_path = file + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ios::trunc);
+        if (!out.is_open())
+        {
+            return false;
+        }
+        out << render_json();
+        if (!out.good())
+        {
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tmp_path, file, ec);
+    return !ec;
+}
+
+void Tracer::record(const char *name, const char *category, std::chrono::steady_clock::time_point begin,
+                    std::chrono::steady_clock::time_point end) noexcept
+{
+    if (!active.load(std::memory_order_acquire))
+    {
+        return;
+    }
+    ThreadBuffer &buffer = local_buffer();
+    // спан, начатый до start(), обрезается по началу трассы
+    const auto origin = tracer_state().origin;
+    begin = std::max(begin, origin);
+    end = std::max(end, begin);
+
+    std::lock_guard lock(buffer.mutex);
+    buffer.events[buffer.written % buffer.events.size()] = TraceEvent{
+        name, category,
+        std::chrono::duration_cast<std::chrono::nanoseconds>(begin - origin).count(),
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count(),
+        current_lane};
+    ++buffer.written;
+}
+
+void Tracer::name_thread(const char *name)
+{
+    if (!enabled())
+    {
+        return;
+    }
+    ThreadBuffer &buffer = local_buffer();
+    std::lock_guard lock(buffer.mutex);
+    buffer.thread_name = name;
+}
+
+void Tracer::set_lane(uint16_t lane) noexcept
+{
+    current_lane = lane;
+}
+
+std::string Tracer::render_json() const
+{
+#ifdef _WIN32
+    constexpr int pid = 1;
+#else
+    const int pid = static_cast<int>(::getpid());
+#endif
+
+    auto &state = tracer_state();
+    std::lock_guard state_lock(state.mutex);
+
+    std::ostringstream out;
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    const auto separator = [&]
+    {
+        out << (first ? "\n" : ",\n");
+        first = false;
+    };
+
+    for (const auto &buffer : state.buffers)
+    {
+        std::lock_guard lock(buffer->mutex);
+        // дорожка lane потока - отдельный tid: номер дорожки в старших 16 битах
+        const auto track = [&](uint16_t lane)
+        {
+            return static_cast<uint32_t>(lane) << 16 | (buffer->tid & 0xFFFF);
+        };
+
+        // в кольце - последние capacity событий, от старых к новым
+        const uint64_t capacity = buffer->events.size();
+        const uint64_t first_event = buffer->written > capacity ? buffer->written - capacity : 0;
+
+        std::vector<uint16_t> lanes{0};
+        for (uint64_t i{first_event}; i < buffer->written; ++i)
+        {
+            const uint16_t lane = buffer->events[i % capacity].lane;
+            if (std::find(lanes.begin(), lanes.end(), lane) == lanes.end())
+            {
+                lanes.push_back(lane);
+            }
+        }
+        for (const uint16_t lane : lanes)
+        {
+            if (!buffer->thread_name && lane == 0)
+            {
+                continue;
+            }
+            separator();
+            out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << pid << ",\"tid\":" << track(lane)
+                << ",\"args\":{\"name\":\"";
+            if (buffer->thread_name)
+            {
+                write_json_text(out, buffer->thread_name);
+            }
+            else
+            {
+                out << "thread " << buffer->tid;
+            }
+            if (lane != 0)
+            {
+                out << " #" << lane;
+            }
+            out << "\"}}";
+        }
+
+        for (uint64_t i{first_event}; i < buffer->written; ++i)
+        {
+            const TraceEvent &event = buffer->events[i % capacity];
+            separator();
+            out << "{\"ph\":\"X\",\"name\":";
+            write_json_string(out, event.name);
+            out << ",\"cat\":";
+            write_json_string(out, event.category);
+            out << ",\"pid\":" << pid << ",\"tid\":" << track(event.lane) << ",\"ts\":";
+            write_microseconds(out, event.begin_ns);
+            out << ",\"dur\":";
+            write_microseconds(out, event.duration_ns);
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+    return out.str();
+}
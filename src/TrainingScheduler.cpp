@@ -0,0 +1,360 @@
+#include "../include/TrainingScheduler.hpp"
+#include "../include/NumberParsing.hpp"
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <utility>
+
+namespace
+{
+    constexpr float INITIAL_EASE = 2.5f;
+    constexpr float MIN_EASE = 1.3f;
+    constexpr int64_t DAY = 24 * 60 * 60;
+    constexpr int64_t RELEARN_INTERVAL = 10 * 60; // повтор после провала через 10 минут
+    constexpr int64_t MAX_INTERVAL = 365 * DAY;   // due_at остаётся в диапазоне timestamp
+
+    void print_usage()
+    {
+        std::cerr << "Usage: mem_trainer --due-list [--limit=<n>] [--watch] [--refresh=<seconds>]\n"
+                     "  prints users due for training, one tab-separated line each: due_at, user_id, next_length\n"
+                     "  --limit    schedules loaded per refresh (default "
+                  << TrainingScheduler::DEFAULT_DUE_LIMIT << ")\n"
+                     "  --watch    keep running and print each user when they become due\n"
+                     "  --refresh  seconds between reloads from user_schedule (default "
+                  << TrainingScheduler::DEFAULT_REFRESH_SECONDS << ")\n";
+    }
+
+    int64_t unix_now() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::seconds>(
+                   std::chrono::system_clock::now().time_since_epoch())
+            .count();
+    }
+}
+
+UserSchedule TrainingScheduler::initial_schedule(uint32_t user_id, std::size_t length, int64_t now) noexcept
+{
+    return UserSchedule{user_id, INITIAL_EASE, 0, 0, static_cast<uint32_t>(length), now};
+}
+
+UserSchedule TrainingScheduler::review(const UserSchedule &schedule, float success_rate,
+                                       TaskGenerator::Difficulty difficulty, int64_t now) noexcept
+{
+    // оценка 0..5 как в SM-2
+    const int32_t quality = static_cast<int32_t>(std::lround(std::clamp(success_rate, 0.0f, 1.0f) * 5));
+
+    UserSchedule next = schedule;
+    // тренировка до срока меняет только длину: иначе интервал рос бы с каждым раундом подряд
+    const bool due = now >= schedule.due_at;
+    if (due)
+    {
+        if (quality >= 3)
+        {
+            if (next.repetitions == 0)
+            {
+                next.interval_seconds = DAY;
+            }
+            else if (next.repetitions == 1)
+            {
+                next.interval_seconds = 6 * DAY;
+            }
+            else
+            {
+                next.interval_seconds = static_cast<int64_t>(std::llround(
+                    std::min(static_cast<double>(next.interval_seconds) * next.ease_factor,
+                             static_cast<double>(MAX_INTERVAL))));
+            }
+            next.repetitions++;
+        }
+        else
+        {
+            next.repetitions = 0;
+            next.interval_seconds = RELEARN_INTERVAL;
+        }
+
+        const float q_gap = static_cast<float>(5 - quality);
+        next.ease_factor = std::max(MIN_EASE, next.ease_factor + 0.1f - q_gap * (0.08f + q_gap * 0.02f));
+        next.interval_seconds = std::clamp<int64_t>(next.interval_seconds, 0, MAX_INTERVAL);
+        next.due_at = now + next.interval_seconds;
+    }
+
+    // длина растёт при уверенном результате и сокращается при провале
+    const auto params = TaskGenerator::get_params_for_difficulty(difficulty);
+    std::size_t length = next.next_length;
+    if (quality >= 4)
+    {
+        length++;
+    }
+    else if (quality <= 2 && length > 0)
+    {
+        length--;
+    }
+    next.next_length = static_cast<uint32_t>(std::clamp(length, params.min_length, params.max_length));
+    return next;
+}
+
+void TrainingScheduler::schedule(const UserSchedule &entry)
+{
+    auto it = positions.find(entry.user_id);
+    if (it != positions.end())
+    {
+        const std::size_t index = it->second;
+        const int64_t old_due = heap[index].due_at;
+        heap[index] = entry;
+        if (entry.due_at < old_due)
+        {
+            sift_up(index);
+        }
+        else
+        {
+            sift_down(index);
+        }
+        return;
+    }
+
+    heap.push_back(entry);
+    positions[entry.user_id] = heap.size() - 1;
+    sift_up(heap.size() - 1);
+}
+
+bool TrainingScheduler::remove(uint32_t user_id)
+{
+    auto it = positions.find(user_id);
+    if (it == positions.end())
+    {
+        return false;
+    }
+    extract(it->second);
+    return true;
+}
+
+std::optional<UserSchedule> TrainingScheduler::pop_due(int64_t now)
+{
+    if (heap.empty() || heap.front().due_at > now)
+    {
+        return std::nullopt;
+    }
+    return extract(0);
+}
+
+std::vector<UserSchedule> TrainingScheduler::pop_all_due(int64_t now, std::size_t limit)
+{
+    std::vector<UserSchedule> due;
+    while (due.size() < limit)
+    {
+        auto entry = pop_due(now);
+        if (!entry)
+        {
+            break;
+        }
+        due.push_back(*entry);
+    }
+    return due;
+}
+
+std::optional<int64_t> TrainingScheduler::next_due_at() const noexcept
+{
+    if (heap.empty())
+    {
+        return std::nullopt;
+    }
+    return heap.front().due_at;
+}
+
+std::size_t TrainingScheduler::size() const noexcept
+{
+    return heap.size();
+}
+
+void TrainingScheduler::sift_up(std::size_t index)
+{
+    while (index > 0)
+    {
+        const std::size_t parent = (index - 1) / 2;
+        if (heap[parent].due_at <= heap[index].due_at)
+        {
+            break;
+        }
+        swap_nodes(parent, index);
+        index = parent;
+    }
+}
+
+void TrainingScheduler::sift_down(std::size_t index)
+{
+    const std::size_t count = heap.size();
+    while (true)
+    {
+        const std::size_t left = 2 * index + 1;
+        const std::size_t right = left + 1;
+        std::size_t smallest = index;
+
+        if (left < count && heap[left].due_at < heap[smallest].due_at)
+        {
+            smallest = left;
+        }
+        if (right < count && heap[right].due_at < heap[smallest].due_at)
+        {
+            smallest = right;
+        }
+        if (smallest == index)
+        {
+            break;
+        }
+        swap_nodes(index, smallest);
+        index = smallest;
+    }
+}
+
+void TrainingScheduler::swap_nodes(std::size_t a, std::size_t b)
+{
+    std::swap(heap[a], heap[b]);
+    positions[heap[a].user_id] = a;
+    positions[heap[b].user_id] = b;
+}
+
+UserSchedule TrainingScheduler::extract(std::size_t index)
+{
+    UserSchedule entry = heap[index];
+    const std::size_t last = heap.size() - 1;
+    if (index != last)
+    {
+        swap_nodes(index, last);
+    }
+    heap.pop_back();
+    positions.erase(entry.user_id);
+
+    if (index < heap.size())
+    {
+        sift_down(index);
+        sift_up(index);
+    }
+    return entry;
+}
+
+int TrainingScheduler::run_cli(int argc, char **argv)
+{
+    uint32_t limit{DEFAULT_DUE_LIMIT};
+    int64_t refresh{DEFAULT_REFRESH_SECONDS};
+    bool watch{false};
+    for (int i{2}; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        bool valid{true};
+        if (arg.starts_with("--limit="))
+            valid = NumberParsing::parse_whole(arg.substr(8), limit) && limit > 0;
+        else if (arg.starts_with("--refresh="))
+            valid = NumberParsing::parse_whole(arg.substr(10), refresh) && refresh > 0;
+        else if (arg == "--watch")
+            watch = true;
+        else
+            valid = false;
+        if (!valid)
+        {
+            print_usage();
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+
+    try
+    {
+        DatabaseSync db_sync;
+        if (!db_sync.connect())
+        {
+            std::cerr << "Failed to connect to database\n";
+            return 1;
+        }
+
+        // в куче - расписания, срок которых наступит до следующей перезагрузки; индексный запрос
+        // по user_schedule.due_at отдаёт это окно, а ближайшего пользователя куча даёт за O(log n).
+        // Перезагрузка читает due_at начиная с прошлой: новый срок не раньше момента записи, а
+        // объявленные просроченные пользователи не занимают limit
+        TrainingScheduler scheduler;
+        std::unordered_map<uint32_t, int64_t> loaded;    // user_id -> due_at загруженного срока
+        std::unordered_map<uint32_t, int64_t> announced; // user_id -> due_at уже напечатанного срока
+        int64_t window_from{0};
+        int64_t reload_at{0};
+        while (true)
+        {
+            int64_t now = unix_now();
+            if (now >= reload_at)
+            {
+                // строка сверх limit показывает, что окно прочитано не целиком
+                const uint32_t page = limit < UINT32_MAX ? limit + 1 : limit;
+                const std::vector<UserSchedule> rows = db_sync.get_due_schedules(window_from, now + refresh, page);
+                const bool full = rows.size() > limit;
+                std::unordered_set<uint32_t> fresh;
+                for (const UserSchedule &entry : rows)
+                {
+                    fresh.insert(entry.user_id);
+                    const auto it = announced.find(entry.user_id);
+                    if (it == announced.end() || it->second != entry.due_at)
+                    {
+                        scheduler.schedule(entry);
+                    }
+                }
+                // окно прочитано целиком: пользователь из него пропал - потренировался и получил
+                // срок за пределами окна
+                if (!full)
+                {
+                    for (const auto &[user_id, due_at] : loaded)
+                    {
+                        if (due_at >= window_from && !fresh.contains(user_id))
+                        {
+                            scheduler.remove(user_id);
+                            announced.erase(user_id);
+                        }
+                    }
+                }
+                for (const UserSchedule &entry : rows)
+                {
+                    loaded[entry.user_id] = entry.due_at;
+                }
+
+                if (!full)
+                {
+                    window_from = now;
+                    reload_at = now + refresh;
+                }
+                else
+                {
+                    // остаток окна дочитывается сразу после последнего загруженного срока
+                    if (rows.back().due_at == window_from)
+                    {
+                        std::cerr << "More than " << limit << " schedules are due at " << window_from
+                                  << ", raise --limit\n";
+                    }
+                    window_from = std::max(rows.back().due_at, window_from + 1);
+                    reload_at = now;
+                }
+                std::erase_if(loaded, [&](const auto &entry) { return entry.second < window_from; });
+                std::erase_if(announced, [&](const auto &entry) { return entry.second < window_from; });
+            }
+
+            for (const UserSchedule &entry : scheduler.pop_all_due(now, limit))
+            {
+                announced[entry.user_id] = entry.due_at;
+                std::cout << entry.due_at << '\t' << entry.user_id << '\t' << entry.next_length << '\n';
+            }
+            std::cout.flush();
+            if (!watch)
+            {
+                return 0;
+            }
+
+            now = unix_now();
+            const int64_t wake_at = std::min(reload_at, scheduler.next_due_at().value_or(reload_at));
+            std::this_thread::sleep_for(std::chrono::seconds(std::max<int64_t>(wake_at - now, 1)));
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+}
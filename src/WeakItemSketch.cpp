@@ -0,0 +1,178 @@
+#include "../include/WeakItemSketch.hpp"
+
+#include <algorithm>
+#include <variant>
+
+namespace
+{
+    constexpr uint8_t FORMAT_VERSION = 1;
+    constexpr uint8_t WORD_TAG = 'w';
+    constexpr uint8_t SYMBOL_TAG = 's';
+
+    static_assert((WeakItemSketch::WIDTH & (WeakItemSketch::WIDTH - 1)) == 0, "WIDTH must be a power of two");
+
+    // FNV-1a с байтом типа впереди: слово "a" и символ 'a' - разные ключи
+    uint64_t item_hash(uint8_t tag, std::string_view bytes) noexcept
+    {
+        uint64_t hash = 14695981039346656037ull;
+        hash = (hash ^ tag) * 1099511628211ull;
+        for (const char byte : bytes)
+        {
+            hash = (hash ^ static_cast<uint8_t>(byte)) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // индекс в строке row: двойное хэширование h1 + row * h2 вместо DEPTH независимых функций
+    std::size_t slot(uint64_t hash, std::size_t row) noexcept
+    {
+        const uint64_t h1 = hash & 0xFFFFFFFFu;
+        const uint64_t h2 = (hash >> 32) | 1;
+        return static_cast<std::size_t>((h1 + row * h2) & (WeakItemSketch::WIDTH - 1));
+    }
+}
+
+void WeakItemSketch::record_round(std::span<const TaskGenerator::TaskItemView> sequence,
+                                  std::span<const uint8_t> item_correct) noexcept
+{
+    const std::size_t count = std::min(sequence.size(), item_correct.size());
+    for (std::size_t i{0}; i < count; ++i)
+    {
+        if (item_correct[i] == 0)
+        {
+            record_miss(sequence[i]);
+        }
+    }
+}
+
+void WeakItemSketch::record_miss(const TaskGenerator::TaskItemView &item) noexcept
+{
+    if (const auto *word = std::get_if<std::string_view>(&item))
+    {
+        add(item_hash(WORD_TAG, *word));
+    }
+    else if (const auto *symbol = std::get_if<char>(&item))
+    {
+        add(item_hash(SYMBOL_TAG, std::string_view(symbol, 1)));
+    }
+}
+
+uint32_t WeakItemSketch::misses(std::string_view word) const noexcept
+{
+    return estimate(item_hash(WORD_TAG, word));
+}
+
+uint32_t WeakItemSketch::misses(char symbol) const noexcept
+{
+    return estimate(item_hash(SYMBOL_TAG, std::string_view(&symbol, 1)));
+}
+
+bool WeakItemSketch::empty() const noexcept
+{
+    // любой учтённый промах оставляет ненулевой счётчик в каждой строке
+    return std::all_of(counters[0].begin(), counters[0].end(), [](uint8_t count)
+                       { return count == 0; });
+}
+
+void WeakItemSketch::add(uint64_t hash) noexcept
+{
+    uint32_t target = estimate(hash) + 1;
+    if (target > UINT8_MAX)
+    {
+        // счётчик насыщен: внеочередное старение вместо переполнения
+        decay();
+        target = estimate(hash) + 1;
+    }
+    for (std::size_t row{0}; row < DEPTH; ++row)
+    {
+        uint8_t &counter = counters[row][slot(hash, row)];
+        counter = static_cast<uint8_t>(std::max<uint32_t>(counter, target));
+    }
+
+    if (++since_decay >= DECAY_MISSES)
+    {
+        decay();
+    }
+}
+
+uint32_t WeakItemSketch::estimate(uint64_t hash) const noexcept
+{
+    uint32_t minimum = UINT8_MAX;
+    for (std::size_t row{0}; row < DEPTH; ++row)
+    {
+        minimum = std::min<uint32_t>(minimum, counters[row][slot(hash, row)]);
+    }
+    return minimum;
+}
+
+void WeakItemSketch::decay() noexcept
+{
+    for (auto &row : counters)
+    {
+        for (uint8_t &counter : row)
+        {
+            counter >>= 1;
+        }
+    }
+    since_decay = 0;
+}
+
+std::string WeakItemSketch::serialize() const
+{
+    std::string bytes;
+    bytes.reserve(SERIALIZED_BYTES);
+    bytes += static_cast<char>(FORMAT_VERSION);
+    bytes.append(3, '\0');
+    for (std::size_t shift{0}; shift < 32; shift += 8)
+    {
+        bytes += static_cast<char>((since_decay >> shift) & 0xFF);
+    }
+    for (const auto &row : counters)
+    {
+        bytes.append(reinterpret_cast<const char *>(row.data()), row.size());
+    }
+    return bytes;
+}
+
+std::optional<WeakItemSketch> WeakItemSketch::deserialize(std::string_view bytes)
+{
+    if (bytes.size() != SERIALIZED_BYTES || static_cast<uint8_t>(bytes[0]) != FORMAT_VERSION)
+    {
+        return std::nullopt;
+    }
+
+    WeakItemSketch sketch;
+    for (std::size_t i{0}; i < 4; ++i)
+    {
+        sketch.since_decay |= static_cast<uint32_t>(static_cast<uint8_t>(bytes[4 + i])) << (8 * i);
+    }
+    std::size_t offset{8};
+    for (auto &row : sketch.counters)
+    {
+        std::copy_n(reinterpret_cast<const uint8_t *>(bytes.data() + offset), WIDTH, row.begin());
+        offset += WIDTH;
+    }
+    return sketch;
+}
+
+WeakItemBias::WeakItemBias(const WeakItemSketch &sketch)
+{
+    const auto weight = [](uint32_t misses)
+    {
+        return 1.0 + WEAK_WEIGHT * std::min(misses, WEAK_CAP);
+    };
+
+    std::array<double, WordGenerator::WORD_COUNT> word_weights{};
+    for (std::size_t i{0}; i < word_weights.size(); ++i)
+    {
+        word_weights[i] = weight(sketch.misses(WordGenerator::word_at(i)));
+    }
+    std::array<double, SymbolGenerator::SYMBOL_COUNT> symbol_weights{};
+    for (std::size_t i{0}; i < symbol_weights.size(); ++i)
+    {
+        symbol_weights[i] = weight(sketch.misses(SymbolGenerator::symbol_at(i)));
+    }
+
+    words = WeightedSampling::build_alias_table(word_weights);
+    symbols = WeightedSampling::build_alias_table(symbol_weights);
+}
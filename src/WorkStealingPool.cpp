@@ -0,0 +1,145 @@
+#include "../include/WorkStealingPool.hpp"
+
+#include <algorithm>
+
+WorkStealingPool::WorkStealingPool(unsigned threads)
+{
+    const unsigned workers = std::max(1u, threads ? threads : std::thread::hardware_concurrency());
+    queues.reserve(workers);
+    for (unsigned i{0}; i < workers; ++i)
+    {
+        queues.push_back(std::make_unique<Queue>());
+    }
+
+    this->threads.reserve(workers - 1);
+    for (unsigned worker{1}; worker < workers; ++worker)
+    {
+        this->threads.emplace_back(&WorkStealingPool::worker_loop, this, worker);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+    {
+        std::lock_guard lock(state_mutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+}
+
+void WorkStealingPool::run(std::size_t count, const Task &task)
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    {
+        std::lock_guard lock(state_mutex);
+        current = &task;
+        remaining.store(count);
+    }
+
+    // непрерывные диапазоны: соседние задачи одного потока трогают соседние данные
+    const std::size_t workers = queues.size();
+    const std::size_t chunk = (count + workers - 1) / workers;
+    for (std::size_t worker{0}; worker < workers; ++worker)
+    {
+        const std::size_t begin = std::min(count, worker * chunk);
+        const std::size_t end = std::min(count, begin + chunk);
+        std::lock_guard lock(queues[worker]->mutex);
+        for (std::size_t index{begin}; index < end; ++index)
+        {
+            queues[worker]->tasks.push_back(index);
+        }
+    }
+
+    {
+        std::lock_guard lock(state_mutex);
+        ++generation;
+    }
+    wakeup.notify_all();
+
+    drain(0);
+
+    // ждать и опустения очередей, и выхода всех потоков из drain, чтобы task оставалась живой
+    std::unique_lock lock(state_mutex);
+    finished.wait(lock, [this]
+                  { return remaining.load() == 0 && busy == 0; });
+    current = nullptr;
+}
+
+void WorkStealingPool::worker_loop(unsigned worker)
+{
+    uint64_t seen{0};
+    while (true)
+    {
+        {
+            std::unique_lock lock(state_mutex);
+            wakeup.wait(lock, [this, seen]
+                        { return stopping || generation != seen; });
+            if (stopping)
+            {
+                return;
+            }
+            seen = generation;
+            ++busy;
+        }
+
+        drain(worker);
+
+        {
+            std::lock_guard lock(state_mutex);
+            --busy;
+        }
+        finished.notify_all();
+    }
+}
+
+void WorkStealingPool::drain(unsigned worker)
+{
+    std::size_t index;
+    while (pop_local(worker, index) || steal(worker, index))
+    {
+        (*current)(index, worker);
+        if (remaining.fetch_sub(1) == 1)
+        {
+            std::lock_guard lock(state_mutex);
+            finished.notify_all();
+        }
+    }
+}
+
+bool WorkStealingPool::pop_local(unsigned worker, std::size_t &index)
+{
+    Queue &queue = *queues[worker];
+    std::lock_guard lock(queue.mutex);
+    if (queue.tasks.empty())
+    {
+        return false;
+    }
+    index = queue.tasks.back();
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool WorkStealingPool::steal(unsigned thief, std::size_t &index)
+{
+    const std::size_t workers = queues.size();
+    for (std::size_t offset{1}; offset < workers; ++offset)
+    {
+        Queue &queue = *queues[(thief + offset) % workers];
+        std::lock_guard lock(queue.mutex);
+        if (!queue.tasks.empty())
+        {
+            index = queue.tasks.front();
+            queue.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
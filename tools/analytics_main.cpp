@@ -0,0 +1,122 @@
+#include "../include/Analytics.hpp"
+#include "../include/DatabaseSync.hpp"
+
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <chrono>
+
+namespace
+{
+    void print_usage()
+    {
+        std::cerr << "Usage: mem_trainer_analytics [--source=db|log] [--log=<session log>]\n"
+                     "                             [--out=<directory>] [--threads=<n>]\n"
+                     "  --source=db   read user_progress via COPY (config.ini), default\n"
+                     "  --source=log  read the binary session log ([recording] file=)\n"
+                     "  --out         write learning_curve.csv, success_percentiles.csv and\n"
+                     "                retention_cohorts.csv instead of the console summary\n";
+    }
+
+    bool write_csv(const std::filesystem::path &path, void (*writer)(const AnalyticsReport &, std::ostream &),
+                   const AnalyticsReport &report)
+    {
+        std::ofstream out(path);
+        if (!out)
+        {
+            std::cerr << "Cannot write " << path << "\n";
+            return false;
+        }
+        writer(report, out);
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string source = "db";
+    std::string log_path;
+    std::string out_dir;
+    unsigned threads{0};
+
+    for (int i{1}; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        if (arg.starts_with("--source="))
+            source = arg.substr(9);
+        else if (arg.starts_with("--log="))
+            log_path = arg.substr(6);
+        else if (arg.starts_with("--out="))
+            out_dir = arg.substr(6);
+        else if (arg.starts_with("--threads="))
+            threads = static_cast<unsigned>(std::stoul(std::string(arg.substr(10))));
+        else
+        {
+            print_usage();
+            return arg == "--help" ? 0 : 2;
+        }
+    }
+
+    try
+    {
+        const auto started = std::chrono::steady_clock::now();
+        HistoryColumns history;
+        if (source == "db")
+        {
+            DatabaseSync db_sync;
+            if (!db_sync.connect())
+            {
+                std::cerr << "Failed to connect to database\n";
+                return 1;
+            }
+            history = Analytics::load_from_database(db_sync);
+        }
+        else if (source == "log")
+        {
+            if (log_path.empty())
+            {
+                print_usage();
+                return 2;
+            }
+            history = Analytics::load_from_session_log(log_path);
+        }
+        else
+        {
+            print_usage();
+            return 2;
+        }
+        const auto loaded = std::chrono::steady_clock::now();
+
+        const AnalyticsReport report = Analytics::analyze(history, threads);
+        const auto analyzed = std::chrono::steady_clock::now();
+
+        if (out_dir.empty())
+        {
+            Analytics::write_summary(report, std::cout);
+        }
+        else
+        {
+            const std::filesystem::path dir(out_dir);
+            std::filesystem::create_directories(dir);
+            if (!write_csv(dir / "learning_curve.csv", Analytics::write_learning_curve_csv, report) ||
+                !write_csv(dir / "success_percentiles.csv", Analytics::write_percentiles_csv, report) ||
+                !write_csv(dir / "retention_cohorts.csv", Analytics::write_retention_csv, report))
+            {
+                return 1;
+            }
+        }
+
+        using ms = std::chrono::milliseconds;
+        std::cerr << "Loaded " << history.size() << " rounds in "
+                  << std::chrono::duration_cast<ms>(loaded - started).count() << " ms, analyzed in "
+                  << std::chrono::duration_cast<ms>(analyzed - loaded).count() << " ms\n";
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}